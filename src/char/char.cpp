@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unordered_set>
 
 #include "../common/cbasetypes.hpp"
 #include "../common/cli.hpp"
@@ -70,6 +71,7 @@ int subnet_count = 0;
 DBMap* auth_db; // uint32 account_id -> struct auth_node*
 DBMap* online_char_db; // uint32 account_id -> struct online_char_data*
 DBMap* char_db_; // uint32 char_id -> struct mmo_charstatus*
+static std::unordered_set<uint32> char_save_failed; // char_id of characters whose last save failed, their next save writes everything
 DBMap* char_get_authdb() { return auth_db; }
 DBMap* char_get_onlinedb() { return online_char_db; }
 DBMap* char_get_chardb() { return char_db_; }
@@ -159,6 +161,7 @@ void char_set_char_offline(uint32 char_id, uint32 account_id){
 	{
 		struct mmo_charstatus* cp = (struct mmo_charstatus*)idb_get(char_db_,char_id);
 		inter_guild_CharOffline(char_id, cp?cp->guild_id:-1);
+		inter_storage_charoffline(char_id);
 		if (cp)
 			idb_remove(char_db_,char_id);
 
@@ -264,23 +267,73 @@ DBData char_create_charstatus(DBKey key, va_list args) {
 	return db_ptr2data(cp);
 }
 
-int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
+/**
+ * Returns the sections of mmo_charstatus that overlap a changed byte range, see char_mmo_char_tosql
+ * @param pos: Offset of the range in mmo_charstatus
+ * @param len: Length of the range
+ * @return e_char_save_section flags
+ */
+uint8 char_mmo_char_sections(size_t pos, size_t len){
+	const struct {
+		size_t offset;
+		size_t size;
+		uint8 section;
+	} arrays[] = {
+		{ offsetof(struct mmo_charstatus, memo_point), sizeof(((struct mmo_charstatus*)0)->memo_point), CHARSAVE_MEMO },
+		{ offsetof(struct mmo_charstatus, skill), sizeof(((struct mmo_charstatus*)0)->skill), CHARSAVE_SKILL },
+		{ offsetof(struct mmo_charstatus, friends), sizeof(((struct mmo_charstatus*)0)->friends), CHARSAVE_FRIENDS },
+#ifdef HOTKEY_SAVING
+		{ offsetof(struct mmo_charstatus, hotkeys), sizeof(((struct mmo_charstatus*)0)->hotkeys), CHARSAVE_HOTKEYS },
+#endif
+	};
+	uint8 sections = 0;
+	size_t covered = 0;
+
+	for( size_t i = 0; i < ARRAYLENGTH(arrays); i++ ){
+		size_t start = zmax(pos, arrays[i].offset), end = zmin(pos + len, arrays[i].offset + arrays[i].size);
+
+		if( start < end ){
+			sections |= arrays[i].section;
+			covered += end - start;
+		}
+	}
+
+	// Everything outside of the arrays belongs to the single values
+	if( covered < len )
+		sections |= CHARSAVE_FIELDS;
+
+	return sections;
+}
+
+/**
+ * Writes the parts of a character that differ from the cached copy in char_db_
+ * @param char_id: Character ID
+ * @param p: Character status to save
+ * @param sections: e_char_save_section flags of the parts that may have changed, the others are not compared
+ * @return 0
+ */
+int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p, uint8 sections){
 	int i = 0;
 	int count = 0;
 	int diff = 0;
 	char save_status[128]; //For displaying save information. [Skotlex]
 	struct mmo_charstatus *cp;
-	int errors = 0; //If there are any errors while saving, "cp" will not be updated at the end.
+	bool force; // The last save failed, write everything again
+	std::vector<std::string> queries; // Statements executed asynchronously
 	StringBuf buf;
 
 	if (char_id!=p->char_id) return 0;
 
 	cp = (struct mmo_charstatus *)idb_ensure(char_db_, char_id, char_create_charstatus);
+	force = ( char_save_failed.erase(char_id) > 0 );
 
 	StringBuf_Init(&buf);
 	memset(save_status, 0, sizeof(save_status));
 
-	if (
+	if( force )
+		sections = CHARSAVE_ALL;
+
+	if ( (sections&CHARSAVE_FIELDS) && (force ||
 		(p->base_exp != cp->base_exp) || (p->base_level != cp->base_level) ||
 		(p->job_level != cp->job_level) || (p->job_exp != cp->job_exp) ||
 		(p->zeny != cp->zeny) ||
@@ -300,9 +353,9 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 		(p->unban_time != cp->unban_time) || (p->font != cp->font) || (p->uniqueitem_counter != cp->uniqueitem_counter) ||
 		(p->hotkey_rowshift != cp->hotkey_rowshift) || (p->clan_id != cp->clan_id ) || (p->title_id != cp->title_id) ||
 		(p->show_equip != cp->show_equip) || (p->hotkey_rowshift2 != cp->hotkey_rowshift2)
-	)
+	) )
 	{	//Save status
-		if( SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `base_level`='%d', `job_level`='%d',"
+		Sql_AsyncAppend(queries, "UPDATE `%s` SET `base_level`='%d', `job_level`='%d',"
 			"`base_exp`='%u', `job_exp`='%u', `zeny`='%d',"
 			"`max_hp`='%u',`hp`='%u',`max_sp`='%u',`sp`='%u',`status_point`='%d',`skill_point`='%d',"
 			"`str`='%d',`agi`='%d',`vit`='%d',`int`='%d',`dex`='%d',`luk`='%d',"
@@ -323,25 +376,21 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 			(unsigned long)p->delete_date, // FIXME: platform-dependent size
 			p->robe, p->character_moves, p->font, p->uniqueitem_counter,
 			p->hotkey_rowshift, p->clan_id, p->title_id, p->show_equip, p->hotkey_rowshift2,
-			p->account_id, p->char_id) )
-		{
-			Sql_ShowDebug(sql_handle);
-			errors++;
-		} else
-			strcat(save_status, " status");
+			p->account_id, p->char_id);
+		strcat(save_status, " status");
 	}
 
 	//Values that will seldom change (to speed up saving)
-	if (
+	if ( (sections&CHARSAVE_FIELDS) && (force ||
 		(p->hair != cp->hair) || (p->hair_color != cp->hair_color) || (p->clothes_color != cp->clothes_color) ||
 		(p->body != cp->body) || (p->class_ != cp->class_) ||
 		(p->partner_id != cp->partner_id) || (p->father != cp->father) ||
 		(p->mother != cp->mother) || (p->child != cp->child) ||
  		(p->karma != cp->karma) || (p->manner != cp->manner) ||
 		(p->fame != cp->fame)
-	)
+	) )
 	{
-		if( SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `class`='%d',"
+		Sql_AsyncAppend(queries, "UPDATE `%s` SET `class`='%d',"
 			"`hair`='%d', `hair_color`='%d', `clothes_color`='%d', `body`='%d',"
 			"`partner_id`='%u', `father`='%u', `mother`='%u', `child`='%u',"
 			"`karma`='%d',`manner`='%d', `fame`='%d'"
@@ -350,37 +399,29 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 			p->hair, p->hair_color, p->clothes_color, p->body,
 			p->partner_id, p->father, p->mother, p->child,
 			p->karma, p->manner, p->fame,
-			p->account_id, p->char_id) )
-		{
-			Sql_ShowDebug(sql_handle);
-			errors++;
-		} else
-			strcat(save_status, " status2");
+			p->account_id, p->char_id);
+		strcat(save_status, " status2");
 	}
 
 	/* Mercenary Owner */
-	if( (p->mer_id != cp->mer_id) ||
+	if( (sections&CHARSAVE_FIELDS) && (force || (p->mer_id != cp->mer_id) ||
 		(p->arch_calls != cp->arch_calls) || (p->arch_faith != cp->arch_faith) ||
 		(p->spear_calls != cp->spear_calls) || (p->spear_faith != cp->spear_faith) ||
-		(p->sword_calls != cp->sword_calls) || (p->sword_faith != cp->sword_faith) )
+		(p->sword_calls != cp->sword_calls) || (p->sword_faith != cp->sword_faith)) )
 	{
 		if (mercenary_owner_tosql(char_id, p))
 			strcat(save_status, " mercenary");
 		else
-			errors++;
+			char_save_failed.insert(char_id);
 	}
 
 	//memo points
-	if( memcmp(p->memo_point, cp->memo_point, sizeof(p->memo_point)) )
+	if( (sections&CHARSAVE_MEMO) && (force || memcmp(p->memo_point, cp->memo_point, sizeof(p->memo_point))) )
 	{
 		char esc_mapname[NAME_LENGTH*2+1];
 
 		//`memo` (`memo_id`,`char_id`,`map`,`x`,`y`)
-		if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `char_id`='%d'", schema_config.memo_db, p->char_id) )
-		{
-			Sql_ShowDebug(sql_handle);
-			errors++;
-		}
+		Sql_AsyncAppend(queries, "DELETE FROM `%s` WHERE `char_id`='%d'", schema_config.memo_db, p->char_id);
 
 		//insert here.
 		StringBuf_Clear(&buf);
@@ -397,25 +438,15 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 			}
 		}
 		if( count )
-		{
-			if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
-			{
-				Sql_ShowDebug(sql_handle);
-				errors++;
-			}
-		}
+			queries.push_back(StringBuf_Value(&buf));
 		strcat(save_status, " memo");
 	}
 
 	//skills
-	if( memcmp(p->skill, cp->skill, sizeof(p->skill)) )
+	if( (sections&CHARSAVE_SKILL) && (force || memcmp(p->skill, cp->skill, sizeof(p->skill))) )
 	{
 		//`skill` (`char_id`, `id`, `lv`)
-		if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `char_id`='%d'", schema_config.skill_db, p->char_id) )
-		{
-			Sql_ShowDebug(sql_handle);
-			errors++;
-		}
+		Sql_AsyncAppend(queries, "DELETE FROM `%s` WHERE `char_id`='%d'", schema_config.skill_db, p->char_id);
 
 		StringBuf_Clear(&buf);
 		StringBuf_Printf(&buf, "INSERT INTO `%s`(`char_id`,`id`,`lv`,`flag`) VALUES ", schema_config.skill_db);
@@ -436,19 +467,13 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 			}
 		}
 		if( count )
-		{
-			if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
-			{
-				Sql_ShowDebug(sql_handle);
-				errors++;
-			}
-		}
+			queries.push_back(StringBuf_Value(&buf));
 
 		strcat(save_status, " skills");
 	}
 
-	diff = 0;
-	for(i = 0; i < MAX_FRIENDS; i++){
+	diff = force;
+	for(i = 0; i < MAX_FRIENDS && !diff && (sections&CHARSAVE_FRIENDS); i++){
 		if(p->friends[i].char_id != cp->friends[i].char_id ||
 			p->friends[i].account_id != cp->friends[i].account_id){
 			diff = 1;
@@ -458,11 +483,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 
 	if(diff == 1)
 	{	//Save friends
-		if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `char_id`='%d'", schema_config.friend_db, char_id) )
-		{
-			Sql_ShowDebug(sql_handle);
-			errors++;
-		}
+		Sql_AsyncAppend(queries, "DELETE FROM `%s` WHERE `char_id`='%d'", schema_config.friend_db, char_id);
 
 		StringBuf_Clear(&buf);
 		StringBuf_Printf(&buf, "INSERT INTO `%s` (`char_id`, `friend_id`) VALUES ", schema_config.friend_db);
@@ -477,13 +498,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 			}
 		}
 		if( count )
-		{
-			if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
-			{
-				Sql_ShowDebug(sql_handle);
-				errors++;
-			}
-		}
+			queries.push_back(StringBuf_Value(&buf));
 		strcat(save_status, " friends");
 	}
 
@@ -492,8 +507,8 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 	StringBuf_Clear(&buf);
 	StringBuf_Printf(&buf, "REPLACE INTO `%s` (`char_id`, `hotkey`, `type`, `itemskill_id`, `skill_lvl`) VALUES ", schema_config.hotkey_db);
 	diff = 0;
-	for(i = 0; i < ARRAYLENGTH(p->hotkeys); i++){
-		if(memcmp(&p->hotkeys[i], &cp->hotkeys[i], sizeof(struct hotkey)))
+	for(i = 0; i < ARRAYLENGTH(p->hotkeys) && (sections&CHARSAVE_HOTKEYS); i++){
+		if(force || memcmp(&p->hotkeys[i], &cp->hotkeys[i], sizeof(struct hotkey)))
 		{
 			if( diff )
 				StringBuf_AppendStr(&buf, ",");// not the first hotkey
@@ -502,57 +517,219 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 		}
 	}
 	if(diff) {
-		if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
-		{
-			Sql_ShowDebug(sql_handle);
-			errors++;
-		} else
-			strcat(save_status, " hotkeys");
+		queries.push_back(StringBuf_Value(&buf));
+		strcat(save_status, " hotkeys");
 	}
 #endif
 	StringBuf_Destroy(&buf);
-	if (save_status[0]!='\0' && charserv_config.save_log)
-		ShowInfo("Saved char %d - %s:%s.\n", char_id, p->name, save_status);
-	if (!errors)
-		memcpy(cp, p, sizeof(struct mmo_charstatus));
+
+	// The cache is updated right away, a failed save is written completely the next time
+	memcpy(cp, p, sizeof(struct mmo_charstatus));
+
+	std::string name(p->name), status(save_status);
+
+	Sql_AsyncExecute(sql_handle, p->account_id, queries, [char_id, name, status](bool success) {
+		if (!success)
+			char_save_failed.insert(char_id);
+		else if (!status.empty() && charserv_config.save_log)
+			ShowInfo("Saved char %d - %s:%s.\n", char_id, name.c_str(), status.c_str());
+	});
 	return 0;
 }
 
-/// Saves an array of 'item' entries into the specified table.
-int char_memitemdata_to_sql(const struct item items[], int max, int id, enum storage_type tableswitch, uint8 stor_id) {
-	StringBuf buf;
-	SqlStmt* stmt;
-	int i, j, offset = 0, errors = 0;
-	const char *tablename, *selectoption, *printname;
-	struct item item; // temp storage variable
-	bool* flag; // bit array for inventory matching
-	bool found;
-
+/**
+ * Returns the table of an item storage and the column of its owner
+ * @param tableswitch: Storage type
+ * @param stor_id: Storage ID of TABLE_STORAGE
+ * @param tablename: Table name
+ * @param selectoption: Owner column
+ * @param printname: Printable storage name
+ * @return false for an invalid storage type
+ */
+static bool char_memitemdata_table(enum storage_type tableswitch, uint8 stor_id, const char** tablename, const char** selectoption, const char** printname) {
 	switch (tableswitch) {
 		case TABLE_INVENTORY:
-			printname = "Inventory";
-			tablename = schema_config.inventory_db;
-			selectoption = "char_id";
+			*printname = "Inventory";
+			*tablename = schema_config.inventory_db;
+			*selectoption = "char_id";
 			break;
 		case TABLE_CART:
-			printname = "Cart";
-			tablename = schema_config.cart_db;
-			selectoption = "char_id";
+			*printname = "Cart";
+			*tablename = schema_config.cart_db;
+			*selectoption = "char_id";
 			break;
 		case TABLE_STORAGE:
-			printname = inter_premiumStorage_getPrintableName(stor_id);
-			tablename = inter_premiumStorage_getTableName(stor_id);
-			selectoption = "account_id";
+			*printname = inter_premiumStorage_getPrintableName(stor_id);
+			*tablename = inter_premiumStorage_getTableName(stor_id);
+			*selectoption = "account_id";
 			break;
 		case TABLE_GUILD_STORAGE:
-			printname = "Guild Storage";
-			tablename = schema_config.guild_storage_db;
-			selectoption = "guild_id";
+			*printname = "Guild Storage";
+			*tablename = schema_config.guild_storage_db;
+			*selectoption = "guild_id";
 			break;
 		default:
 			ShowError("Invalid table name!\n");
-			return 1;
+			return false;
 	}
+	return true;
+}
+
+/**
+ * Inserts a single item row
+ * @param item: Item to insert
+ * @param id: Owner ID
+ * @param tableswitch: Storage type
+ * @param tablename: Table name
+ * @param selectoption: Owner column
+ * @return Row id of the new row, 0 on failure
+ */
+static int char_memitem_insert(const struct item* item, int id, enum storage_type tableswitch, const char* tablename, const char* selectoption) {
+	StringBuf buf;
+	int j, row_id = 0;
+
+	StringBuf_Init(&buf);
+	StringBuf_Printf(&buf, "INSERT INTO `%s`(`%s`, `nameid`, `amount`, `equip`, `identify`, `refine`, `attribute`, `expire_time`, `bound`, `unique_id`", tablename, selectoption);
+	if (tableswitch == TABLE_INVENTORY)
+		StringBuf_Printf(&buf, ", `favorite`, `equip_switch`");
+	for( j = 0; j < MAX_SLOTS; ++j )
+		StringBuf_Printf(&buf, ", `card%d`", j);
+	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+		StringBuf_Printf(&buf, ", `option_id%d`", j);
+		StringBuf_Printf(&buf, ", `option_val%d`", j);
+		StringBuf_Printf(&buf, ", `option_parm%d`", j);
+	}
+	StringBuf_Printf(&buf, ") VALUES ('%d', '%hu', '%d', '%u', '%d', '%d', '%d', '%u', '%d', '%" PRIu64 "'",
+		id, item->nameid, item->amount, item->equip, item->identify, item->refine, item->attribute, item->expire_time, item->bound, item->unique_id);
+	if (tableswitch == TABLE_INVENTORY)
+		StringBuf_Printf(&buf, ", '%d', '%u'", item->favorite, item->equipSwitch);
+	for( j = 0; j < MAX_SLOTS; ++j )
+		StringBuf_Printf(&buf, ", '%hu'", item->card[j]);
+	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+		StringBuf_Printf(&buf, ", '%d'", item->option[j].id);
+		StringBuf_Printf(&buf, ", '%d'", item->option[j].value);
+		StringBuf_Printf(&buf, ", '%d'", item->option[j].param);
+	}
+	StringBuf_AppendStr(&buf, ")");
+
+	if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
+		Sql_ShowDebug(sql_handle);
+	else
+		row_id = (int)Sql_LastInsertId(sql_handle);
+
+	StringBuf_Destroy(&buf);
+	return row_id;
+}
+
+/**
+ * Overwrites a single item row with another item
+ * @param item: New content of the row
+ * @param row_id: Row to update
+ * @param tableswitch: Storage type
+ * @param tablename: Table name
+ * @return false on failure
+ */
+static bool char_memitem_update(const struct item* item, int row_id, enum storage_type tableswitch, const char* tablename) {
+	StringBuf buf;
+	int j;
+	bool ok = true;
+
+	StringBuf_Init(&buf);
+	StringBuf_Printf(&buf, "UPDATE `%s` SET `nameid`='%hu', `amount`='%d', `equip`='%u', `identify`='%d', `refine`='%d',`attribute`='%d', `expire_time`='%u', `bound`='%d', `unique_id`='%" PRIu64 "'",
+		tablename, item->nameid, item->amount, item->equip, item->identify, item->refine, item->attribute, item->expire_time, item->bound, item->unique_id);
+	if (tableswitch == TABLE_INVENTORY)
+		StringBuf_Printf(&buf, ", `favorite`='%d', `equip_switch`='%u'", item->favorite, item->equipSwitch);
+	for( j = 0; j < MAX_SLOTS; ++j )
+		StringBuf_Printf(&buf, ", `card%d`=%hu", j, item->card[j]);
+	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+		StringBuf_Printf(&buf, ", `option_id%d`=%d", j, item->option[j].id);
+		StringBuf_Printf(&buf, ", `option_val%d`=%d", j, item->option[j].value);
+		StringBuf_Printf(&buf, ", `option_parm%d`=%d", j, item->option[j].param);
+	}
+	StringBuf_Printf(&buf, " WHERE `id`='%d' LIMIT 1", row_id);
+
+	if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) ) {
+		Sql_ShowDebug(sql_handle);
+		ok = false;
+	}
+
+	StringBuf_Destroy(&buf);
+	return ok;
+}
+
+/**
+ * Saves changed slots of an inventory or cart by the row ids of their previous content.
+ * Unlike char_memitemdata_to_sql the table is not read first: emptied slots are deleted,
+ * filled slots are inserted and all other changed slots are updated in place.
+ * @param items: Current content of all slots
+ * @param indexes: Slots to write
+ * @param count: Number of slots to write
+ * @param cache: Content of all slots as it is in the table, updated to items for the written slots
+ * @param row_ids: Row id of each slot of cache, 0 for empty slots
+ * @param id: Character ID
+ * @param tableswitch: TABLE_INVENTORY or TABLE_CART
+ * @return 0 if success, or error count
+ */
+int char_memitemdata_slots_to_sql(const struct item items[], const uint16 indexes[], int count, struct item cache[], int row_ids[], int id, enum storage_type tableswitch) {
+	const char *tablename, *selectoption, *printname;
+	int i, errors = 0;
+
+	if( !char_memitemdata_table(tableswitch, 0, &tablename, &selectoption, &printname) )
+		return 1;
+
+	for( i = 0; i < count; i++ ) {
+		uint16 index = indexes[i];
+		const struct item* item = &items[index];
+
+		if( item->nameid == 0 ) {
+			if( row_ids[index] && SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `id`='%d' LIMIT 1", tablename, row_ids[index]) ) {
+				Sql_ShowDebug(sql_handle);
+				errors++;
+				continue;
+			}
+			row_ids[index] = 0;
+		} else if( row_ids[index] == 0 ) {
+			if( (row_ids[index] = char_memitem_insert(item, id, tableswitch, tablename, selectoption)) == 0 ) {
+				errors++;
+				continue;
+			}
+		} else if( !char_memitem_update(item, row_ids[index], tableswitch, tablename) ) {
+			errors++;
+			continue;
+		}
+		memcpy(&cache[index], item, sizeof(struct item));
+	}
+
+	if( count > 0 )
+		ShowInfo("Saved %d %s slots to table %s for %s: %d\n", count, printname, tablename, selectoption, id);
+
+	return errors;
+}
+
+/**
+ * Saves an array of 'item' entries into the specified table.
+ * @param items: Items to save
+ * @param max: Number of items
+ * @param id: Owner ID
+ * @param tableswitch: Storage type
+ * @param stor_id: Storage ID of TABLE_STORAGE
+ * @param row_ids: If set, receives the row id of each slot, 0 for empty slots
+ * @return 0 if success, or error count
+ */
+int char_memitemdata_to_sql(const struct item items[], int max, int id, enum storage_type tableswitch, uint8 stor_id, int row_ids[]) {
+	StringBuf buf;
+	SqlStmt* stmt;
+	int i, j, offset = 0, errors = 0;
+	const char *tablename, *selectoption, *printname;
+	struct item item; // temp storage variable
+	bool* flag; // bit array for inventory matching
+	bool found;
+
+	if( !char_memitemdata_table(tableswitch, stor_id, &tablename, &selectoption, &printname) )
+		return 1;
+
+	if( row_ids != nullptr )
+		memset(row_ids, 0, sizeof(int) * max);
 
 	// The following code compares inventory with current database values
 	// and performs modification/deletion/insertion only on relevant rows.
@@ -666,6 +843,8 @@ int char_memitemdata_to_sql(const struct item items[], int max, int id, enum sto
 				}
 
 				found = flag[i] = true; //Item dealt with,
+				if( row_ids != nullptr )
+					row_ids[i] = item.id;
 				break; //skip to next item in the db.
 			}
 		}
@@ -701,6 +880,13 @@ int char_memitemdata_to_sql(const struct item items[], int max, int id, enum sto
 		if( items[i].nameid == 0 || flag[i] )
 			continue;
 
+		// The ids of the new rows are needed, so they are inserted one by one
+		if( row_ids != nullptr ) {
+			if( (row_ids[i] = char_memitem_insert(&items[i], id, tableswitch, tablename, selectoption)) == 0 )
+				errors++;
+			continue;
+		}
+
 		if( found )
 			StringBuf_AppendStr(&buf, ",");
 		else
@@ -888,6 +1074,9 @@ int char_mmo_chars_fromsql(struct char_session_data* sd, uint8* buf, uint8* coun
 	char last_map[MAP_NAME_LENGTH_EXT];
 	char sex[2];
 
+	// Pending saves of the account's characters have to reach the database first
+	Sql_AsyncWait(sd->account_id);
+
 	stmt = SqlStmt_Malloc(sql_handle);
 	if( stmt == NULL ) {
 		SqlStmt_ShowDebug(stmt);
@@ -1009,6 +1198,10 @@ int char_mmo_char_fromsql(uint32 char_id, struct mmo_charstatus* p, bool load_ev
 
 	if (charserv_config.save_log) ShowInfo("Char load request (%d)\n", char_id);
 
+	// Pending saves of the character have to reach the database first
+	if( (cp = (struct mmo_charstatus*)idb_get(char_db_, char_id)) != NULL )
+		Sql_AsyncWait(cp->account_id);
+
 	stmt = SqlStmt_Malloc(sql_handle);
 	if( stmt == NULL )
 	{
@@ -1221,7 +1414,7 @@ int char_mmo_char_fromsql(uint32 char_id, struct mmo_charstatus* p, bool load_ev
 
 //==========================================================================================================
 int char_mmo_sql_init(void) {
-	char_db_= idb_alloc(DB_OPT_RELEASE_DATA);
+	char_db_= idb_flat_alloc(DB_OPT_RELEASE_DATA);
 
 	ShowStatus("Characters per Account: '%d'.\n", charserv_config.char_config.char_per_account);
 
@@ -1498,10 +1691,40 @@ int char_make_new_char( struct char_session_data* sd, char* name_, int str, int
 	return char_id;
 }
 
+/**
+ * Waits until the pending saves of a character are written.
+ * Has to be called before writing the character's row outside of char_mmo_char_tosql,
+ * otherwise a pending save could overwrite the change with older data.
+ * @param char_id: ID of the character
+ */
+void char_wait_saves(uint32 char_id){
+	char* data;
+	uint32 account_id;
+
+	// The account is the key of the saves, and it never changes
+	if( SQL_ERROR == Sql_Query(sql_handle, "SELECT `account_id` FROM `%s` WHERE `char_id`='%d'", schema_config.char_db, char_id) ){
+		Sql_ShowDebug(sql_handle);
+		return;
+	}
+
+	if( SQL_SUCCESS != Sql_NextRow(sql_handle) ){
+		Sql_FreeResult(sql_handle);
+		return;
+	}
+
+	Sql_GetData(sql_handle, 0, &data, NULL);
+	account_id = strtoul(data, NULL, 10);
+	Sql_FreeResult(sql_handle);
+
+	Sql_AsyncWait(account_id);
+}
+
 /*----------------------------------------------------------------------------------------------------------*/
 /* Divorce Players */
 /*----------------------------------------------------------------------------------------------------------*/
 int char_divorce_char_sql(int partner_id1, int partner_id2){
+	char_wait_saves(partner_id1);
+	char_wait_saves(partner_id2);
 	if( SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `partner_id`='0' WHERE `char_id`='%d' OR `char_id`='%d' LIMIT 2", schema_config.char_db, partner_id1, partner_id2) )
 		Sql_ShowDebug(sql_handle);
 	if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE (`nameid`='%hu' OR `nameid`='%hu') AND (`char_id`='%d' OR `char_id`='%d') LIMIT 2", schema_config.inventory_db, WEDDING_RING_M, WEDDING_RING_F, partner_id1, partner_id2) )
@@ -1595,6 +1818,10 @@ enum e_char_del_response char_delete(struct char_session_data* sd, uint32 char_i
 	{ // Char is Baby
 		unsigned char buf[64];
 
+		if( father_id )
+			char_wait_saves(father_id);
+		if( mother_id )
+			char_wait_saves(mother_id);
 		if( SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `child`='0' WHERE `char_id`='%d' OR `char_id`='%d'", schema_config.char_db, father_id, mother_id) )
 			Sql_ShowDebug(sql_handle);
 		if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `id` = '410' AND (`char_id`='%d' OR `char_id`='%d')", schema_config.skill_db, father_id, mother_id) )
@@ -283,13 +283,26 @@ TIMER_FUNC(char_chardb_waiting_disconnect);
 
 int char_mmo_gender(const struct char_session_data *sd, const struct mmo_charstatus *p, char sex);
 int char_mmo_char_tobuf(uint8* buffer, struct mmo_charstatus* p);
-int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p);
+/// Parts of mmo_charstatus that char_mmo_char_tosql compares and writes
+enum e_char_save_section : uint8 {
+	CHARSAVE_FIELDS = 0x01, ///< Values of the char table and the mercenary owner
+	CHARSAVE_MEMO = 0x02,
+	CHARSAVE_SKILL = 0x04,
+	CHARSAVE_FRIENDS = 0x08,
+	CHARSAVE_HOTKEYS = 0x10,
+	CHARSAVE_ALL = 0x1f,
+};
+
+int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p, uint8 sections = CHARSAVE_ALL);
+uint8 char_mmo_char_sections(size_t pos, size_t len);
 int char_mmo_char_fromsql(uint32 char_id, struct mmo_charstatus* p, bool load_everything);
 int char_mmo_chars_fromsql(struct char_session_data* sd, uint8* buf, uint8* count = nullptr);
 enum e_char_del_response char_delete(struct char_session_data* sd, uint32 char_id);
 int char_rename_char_sql(struct char_session_data *sd, uint32 char_id);
+void char_wait_saves(uint32 char_id);
 int char_divorce_char_sql(int partner_id1, int partner_id2);
-int char_memitemdata_to_sql(const struct item items[], int max, int id, enum storage_type tableswitch, uint8 stor_id);
+int char_memitemdata_to_sql(const struct item items[], int max, int id, enum storage_type tableswitch, uint8 stor_id, int row_ids[] = nullptr);
+int char_memitemdata_slots_to_sql(const struct item items[], const uint16 indexes[], int count, struct item cache[], int row_ids[], int id, enum storage_type tableswitch);
 bool char_memitemdata_from_sql(struct s_storage* p, int max, int id, enum storage_type tableswitch, uint8 stor_id);
 
 int char_married(int pl1,int pl2);
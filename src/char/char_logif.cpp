@@ -416,6 +416,7 @@ void chlogif_parse_change_sex_sub(int sex, int acc, int char_id, int class_, int
 	else if (class_ == JOB_BABY_KAGEROU || class_ == JOB_BABY_OBORO)
 		class_ = (sex == SEX_MALE ? JOB_BABY_KAGEROU : JOB_BABY_OBORO);
 
+	Sql_AsyncWait(acc); // A pending character save could still write the old equipment and class
 	if (SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `equip` = '0' WHERE `char_id` = '%d'", schema_config.inventory_db, char_id))
 		Sql_ShowDebug(sql_handle);
 
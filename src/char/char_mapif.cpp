@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h> //memcpy
 
+#include "../common/grfio.hpp" // grfio_crc32
 #include "../common/malloc.hpp"
 #include "../common/showmsg.hpp"
 #include "../common/socket.hpp"
@@ -429,6 +430,100 @@ int chmapif_parse_reqsavechar(int fd, int id){
 	return 1;
 }
 
+/**
+ * Map-serv request to save the changed blocks of mmo_char_status in sql
+ * The blocks are applied to the cached status of the character, if the cache does not
+ * match the map-server's base or the result, the complete status is requested instead.
+ * Only the sections of mmo_charstatus the blocks overlap are compared and written.
+ * ZA 0x2b2c
+ * <cmd>.W <len>.W <aid>.L <cid>.L <quit>.B <base crc>.L <crc>.L <block size>.W <count>.W { <block>.W <data>.?B }*count
+ * AZ 0x2b29
+ * <cmd>.W <aid>.L <cid>.L
+ * @param fd: wich fd to parse from
+ * @param id: wich map_serv id
+ * @return : 0 not enough data received, 1 success
+ */
+int chmapif_parse_reqsavechar_delta(int fd, int id){
+	if (RFIFOREST(fd) < 4 || RFIFOREST(fd) < RFIFOW(fd,2))
+		return 0;
+	else {
+		uint32 aid = RFIFOL(fd,4), cid = RFIFOL(fd,8);
+		int size = RFIFOW(fd,2), block_size = RFIFOW(fd,21), count = RFIFOW(fd,23);
+		struct online_char_data* character;
+		struct mmo_charstatus* cp;
+		struct mmo_charstatus char_dat;
+		DBMap* online_char_db = char_get_onlinedb();
+		int i, offset = 25;
+		uint8 sections = 0;
+		bool valid;
+
+		if (size < 25 || block_size == 0) {
+			ShowError("parse_from_map (save-char-delta): Invalid packet for character (%d:%d).\n", aid, cid);
+			RFIFOSKIP(fd,size);
+			return 1;
+		}
+
+		//Check account only if this ain't final save. Final-save goes through because of the char-map reconnect
+		if (!RFIFOB(fd,12) && (
+			(character = (struct online_char_data*)idb_get(online_char_db, aid)) == NULL ||
+			character->char_id != cid))
+		{	//This may be valid on char-server reconnection, when re-sending characters that already logged off.
+			ShowError("parse_from_map (save-char-delta): Received data for non-existant/offline character (%d:%d).\n", aid, cid);
+			char_set_char_online(id, cid, aid);
+			RFIFOSKIP(fd,size);
+			return 1;
+		}
+
+		cp = (struct mmo_charstatus*)idb_get(char_get_chardb(), cid);
+		valid = ( cp != NULL && (uint32)grfio_crc32((unsigned char*)cp, sizeof(struct mmo_charstatus)) == RFIFOL(fd,13) );
+
+		if (valid) {
+			memcpy(&char_dat, cp, sizeof(struct mmo_charstatus));
+			for (i = 0; i < count && valid; i++) {
+				size_t pos, len;
+
+				if (offset + 2 > size) {
+					valid = false;
+					break;
+				}
+				pos = (size_t)RFIFOW(fd,offset) * block_size;
+				len = ( pos < sizeof(struct mmo_charstatus) ) ? umin(block_size, (uint32)(sizeof(struct mmo_charstatus) - pos)) : 0;
+				if (len == 0 || offset + 2 + (int)len > size) {
+					valid = false;
+					break;
+				}
+				memcpy((unsigned char*)&char_dat + pos, RFIFOP(fd,offset + 2), len);
+				sections |= char_mmo_char_sections(pos, len);
+				offset += 2 + len;
+			}
+			valid = ( valid && offset == size && (uint32)grfio_crc32((unsigned char*)&char_dat, sizeof(struct mmo_charstatus)) == RFIFOL(fd,17) );
+		}
+
+		if (valid) // Only the sections of the changed blocks have to be compared
+			char_mmo_char_tosql(cid, &char_dat, sections);
+		else {
+			// The cached status differs from the map-server's, request the complete status
+			WFIFOHEAD(fd,10);
+			WFIFOW(fd,0) = 0x2b29;
+			WFIFOL(fd,2) = aid;
+			WFIFOL(fd,6) = cid;
+			WFIFOSET(fd,10);
+		}
+
+		if (RFIFOB(fd,12))
+		{	//Flag, set character offline after saving. [Skotlex]
+			char_set_char_offline(cid, aid);
+			WFIFOHEAD(fd,10);
+			WFIFOW(fd,0) = 0x2b21; //Save ack only needed on final save.
+			WFIFOL(fd,2) = aid;
+			WFIFOL(fd,6) = cid;
+			WFIFOSET(fd,10);
+		}
+		RFIFOSKIP(fd,size);
+	}
+	return 1;
+}
+
 /**
  * Inform mapserv of a new character selection request
  * @param fd : FD link tomapserv
@@ -1199,6 +1294,7 @@ int chmapif_parse_reqcharban(int fd){
 			unban_time += timediff; //alterate the time
 			if( unban_time < now ) unban_time=0; //we have totally reduce the time
 
+			Sql_AsyncWait(t_aid); // A pending character save could still write the old ban time
 			if( SQL_SUCCESS != SqlStmt_Prepare(stmt,
 					  "UPDATE `%s` SET `unban_time` = ? WHERE `char_id` = ? LIMIT 1",
 					  schema_config.char_db)
@@ -1427,7 +1523,7 @@ int chmapif_parse(int fd){
 			case 0x2b26: next=chmapif_parse_reqauth(fd,id); break;
 			case 0x2b28: next=chmapif_parse_reqcharban(fd); break; //charban
 			case 0x2b2a: next=chmapif_parse_reqcharunban(fd); break; //charunban
-			//case 0x2b2c: /*free*/; break;
+			case 0x2b2c: next=chmapif_parse_reqsavechar_delta(fd,id); break;
 			case 0x2b2d: next=chmapif_bonus_script_get(fd); break; //Load data
 			case 0x2b2e: next=chmapif_bonus_script_save(fd); break;//Save data
 			default:
@@ -122,6 +122,7 @@ int inter_guild_tosql(struct guild *g,int flag)
 	char esc_master[NAME_LENGTH*2+1];
 	char new_guild = 0;
 	int i=0;
+	std::vector<std::string> queries; // Statements executed asynchronously, after the guild was created
 
 	if (g->guild_id<=0 && g->guild_id != -1) return 0;
 
@@ -224,8 +225,7 @@ int inter_guild_tosql(struct guild *g,int flag)
 			StringBuf_Printf(&buf, "`guild_lv`=%d, `skill_point`=%d, `exp`=%" PRIu64 ", `next_exp`=%u, `max_member`=%d", g->guild_lv, g->skill_point, g->exp, g->next_exp, g->max_member);
 		}
 		StringBuf_Printf(&buf, " WHERE `guild_id`=%d", g->guild_id);
-		if( SQL_ERROR == Sql_Query(sql_handle, "%s", StringBuf_Value(&buf)) )
-			Sql_ShowDebug(sql_handle);
+		queries.push_back(StringBuf_Value(&buf));
 		StringBuf_Destroy(&buf);
 	}
 
@@ -239,15 +239,17 @@ int inter_guild_tosql(struct guild *g,int flag)
 				continue;
 			if(m->account_id) {
 				//Since nothing references guild member table as foreign keys, it's safe to use REPLACE INTO
-				if( SQL_ERROR == Sql_Query(sql_handle, "REPLACE INTO `%s` (`guild_id`,`char_id`,`exp`,`position`) "
+				Sql_AsyncAppend(queries, "REPLACE INTO `%s` (`guild_id`,`char_id`,`exp`,`position`) "
 					"VALUES ('%d','%d','%" PRIu64 "','%d')",
-					schema_config.guild_member_db, g->guild_id, m->char_id, m->exp, m->position ) )
-					Sql_ShowDebug(sql_handle);
+					schema_config.guild_member_db, g->guild_id, m->char_id, m->exp, m->position );
 				if (m->modified&GS_MEMBER_NEW || new_guild == 1)
 				{
-					if( SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `guild_id` = '%d' WHERE `char_id` = '%d'",
-						schema_config.char_db, g->guild_id, m->char_id) )
-						Sql_ShowDebug(sql_handle);
+					// The character row is written in the order of the character's own saves
+					std::vector<std::string> char_queries;
+
+					Sql_AsyncAppend(char_queries, "UPDATE `%s` SET `guild_id` = '%d' WHERE `char_id` = '%d'",
+						schema_config.char_db, g->guild_id, m->char_id);
+					Sql_AsyncExecute(sql_handle, m->account_id, char_queries);
 				}
 				m->modified = GS_MEMBER_UNMODIFIED;
 			}
@@ -262,9 +264,8 @@ int inter_guild_tosql(struct guild *g,int flag)
 			if (!p->modified)
 				continue;
 			Sql_EscapeStringLen(sql_handle, esc_name, p->name, strnlen(p->name, NAME_LENGTH));
-			if( SQL_ERROR == Sql_Query(sql_handle, "REPLACE INTO `%s` (`guild_id`,`position`,`name`,`mode`,`exp_mode`) VALUES ('%d','%d','%s','%d','%d')",
-				schema_config.guild_position_db, g->guild_id, i, esc_name, p->mode, p->exp_mode) )
-				Sql_ShowDebug(sql_handle);
+			Sql_AsyncAppend(queries, "REPLACE INTO `%s` (`guild_id`,`position`,`name`,`mode`,`exp_mode`) VALUES ('%d','%d','%s','%d','%d')",
+				schema_config.guild_position_db, g->guild_id, i, esc_name, p->mode, p->exp_mode);
 			p->modified = GS_POSITION_UNMODIFIED;
 		}
 	}
@@ -276,24 +277,18 @@ int inter_guild_tosql(struct guild *g,int flag)
 		// their info changed, not to mention this would also mess up oppositions!
 		// [Skotlex]
 		//if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `guild_id`='%d' OR `alliance_id`='%d'", guild_alliance_db, g->guild_id, g->guild_id) )
-		if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `guild_id`='%d'", schema_config.guild_alliance_db, g->guild_id) )
-		{
-			Sql_ShowDebug(sql_handle);
-		}
-		else
+		Sql_AsyncAppend(queries, "DELETE FROM `%s` WHERE `guild_id`='%d'", schema_config.guild_alliance_db, g->guild_id);
+
+		//printf("- Insert guild %d to guild_alliance\n",g->guild_id);
+		for(i=0;i<MAX_GUILDALLIANCE;i++)
 		{
-			//printf("- Insert guild %d to guild_alliance\n",g->guild_id);
-			for(i=0;i<MAX_GUILDALLIANCE;i++)
+			struct guild_alliance *a=&g->alliance[i];
+			if(a->guild_id>0)
 			{
-				struct guild_alliance *a=&g->alliance[i];
-				if(a->guild_id>0)
-				{
-					Sql_EscapeStringLen(sql_handle, esc_name, a->name, strnlen(a->name, NAME_LENGTH));
-					if( SQL_ERROR == Sql_Query(sql_handle, "REPLACE INTO `%s` (`guild_id`,`opposition`,`alliance_id`,`name`) "
-						"VALUES ('%d','%d','%d','%s')",
-						schema_config.guild_alliance_db, g->guild_id, a->opposition, a->guild_id, esc_name) )
-						Sql_ShowDebug(sql_handle);
-				}
+				Sql_EscapeStringLen(sql_handle, esc_name, a->name, strnlen(a->name, NAME_LENGTH));
+				Sql_AsyncAppend(queries, "REPLACE INTO `%s` (`guild_id`,`opposition`,`alliance_id`,`name`) "
+					"VALUES ('%d','%d','%d','%s')",
+					schema_config.guild_alliance_db, g->guild_id, a->opposition, a->guild_id, esc_name);
 			}
 		}
 	}
@@ -308,9 +303,8 @@ int inter_guild_tosql(struct guild *g,int flag)
 
 				Sql_EscapeStringLen(sql_handle, esc_name, e->name, strnlen(e->name, NAME_LENGTH));
 				Sql_EscapeStringLen(sql_handle, esc_mes, e->mes, strnlen(e->mes, sizeof(e->mes)));
-				if( SQL_ERROR == Sql_Query(sql_handle, "REPLACE INTO `%s` (`guild_id`,`account_id`,`name`,`mes`) "
-					"VALUES ('%d','%d','%s','%s')", schema_config.guild_expulsion_db, g->guild_id, e->account_id, esc_name, esc_mes) )
-					Sql_ShowDebug(sql_handle);
+				Sql_AsyncAppend(queries, "REPLACE INTO `%s` (`guild_id`,`account_id`,`name`,`mes`) "
+					"VALUES ('%d','%d','%s','%s')", schema_config.guild_expulsion_db, g->guild_id, e->account_id, esc_name, esc_mes);
 			}
 		}
 	}
@@ -320,13 +314,14 @@ int inter_guild_tosql(struct guild *g,int flag)
 		//printf("- Insert guild %d to guild_skill\n",g->guild_id);
 		for(i=0;i<MAX_GUILDSKILL;i++){
 			if (g->skill[i].id>0 && g->skill[i].lv>0){
-				if( SQL_ERROR == Sql_Query(sql_handle, "REPLACE INTO `%s` (`guild_id`,`id`,`lv`) VALUES ('%d','%d','%d')",
-					schema_config.guild_skill_db, g->guild_id, g->skill[i].id, g->skill[i].lv) )
-					Sql_ShowDebug(sql_handle);
+				Sql_AsyncAppend(queries, "REPLACE INTO `%s` (`guild_id`,`id`,`lv`) VALUES ('%d','%d','%d')",
+					schema_config.guild_skill_db, g->guild_id, g->skill[i].id, g->skill[i].lv);
 			}
 		}
 	}
 
+	Sql_AsyncExecute(sql_handle, g->guild_id, queries);
+
 	if (charserv_config.save_log)
 		ShowInfo("Saved guild (%d - %s):%s\n",g->guild_id,g->name,t_info);
 	return 1;
@@ -352,6 +347,9 @@ struct guild * inter_guild_fromsql(int guild_id)
 	ShowInfo("Guild load request (%d)...\n", guild_id);
 #endif
 
+	// Pending saves of the unloaded guild have to reach the database first
+	Sql_AsyncWait(guild_id);
+
 	if( SQL_ERROR == Sql_Query(sql_handle, "SELECT g.`name`,c.`name`,g.`guild_lv`,g.`connect_member`,g.`max_member`,g.`average_lv`,g.`exp`,g.`next_exp`,g.`skill_point`,g.`mes1`,g.`mes2`,g.`emblem_len`,g.`emblem_id`,COALESCE(UNIX_TIMESTAMP(g.`last_master_change`),0), g.`emblem_data` "
 		"FROM `%s` g LEFT JOIN `%s` c ON c.`char_id` = g.`char_id` WHERE g.`guild_id`='%d'", schema_config.guild_db, schema_config.char_db, guild_id) )
 	{
@@ -761,7 +759,7 @@ int inter_guild_sql_init(void)
 	const char *filename[]={ DBPATH"exp_guild.txt", DBIMPORT"/exp_guild.txt"};
 	int i;
 	//Initialize the guild cache
-	guild_db_= idb_alloc(DB_OPT_RELEASE_DATA);
+	guild_db_= idb_flat_alloc(DB_OPT_RELEASE_DATA);
 	castle_db = idb_alloc(DB_OPT_RELEASE_DATA);
 
 	//Read exp file
@@ -1302,6 +1300,7 @@ int mapif_parse_GuildLeave(int fd, int guild_id, uint32 account_id, uint32 char_
 	if( g == NULL )
 	{
 		// Unknown guild, just update the player
+		Sql_AsyncWait(account_id); // A pending character save could still write the old guild
 		if( SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `guild_id`='0' WHERE `account_id`='%d' AND `char_id`='%d'", schema_config.char_db, account_id, char_id) )
 			Sql_ShowDebug(sql_handle);
 		// mapif_guild_withdraw(guild_id,account_id,char_id,flag,g->member[i].name,mes);
@@ -1335,6 +1334,8 @@ int mapif_parse_GuildLeave(int fd, int guild_id, uint32 account_id, uint32 char_
 	}
 
 	mapif_guild_withdraw(guild_id,account_id,char_id,flag,g->member[i].name,mes);
+	Sql_AsyncWait(guild_id); // A pending save could still write the member
+	Sql_AsyncWait(account_id); // A pending character save could still write the old guild
 	inter_guild_removemember_tosql(g->member[i].char_id);
 
 	memset(&g->member[i],0,sizeof(struct guild_member));
@@ -1413,6 +1414,13 @@ int mapif_parse_BreakGuild(int fd,int guild_id)
 	if(g==NULL)
 		return 0;
 
+	// Pending saves have to be written before the guild is deleted
+	Sql_AsyncWait(guild_id);
+	for( int i = 0; i < g->max_member; i++ ){
+		if( g->member[i].account_id )
+			Sql_AsyncWait(g->member[i].account_id);
+	}
+
 	// Delete guild from sql
 	//printf("- Delete guild %d from guild\n",guild_id);
 	if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `guild_id` = '%d'", schema_config.guild_db, guild_id) )
@@ -6,7 +6,10 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unordered_map>
+#include <vector>
 
+#include "../common/grfio.hpp" // grfio_crc32
 #include "../common/malloc.hpp"
 #include "../common/mmo.hpp"
 #include "../common/showmsg.hpp"
@@ -18,6 +21,68 @@
 #include "inter.hpp"
 #include "int_guild.hpp"
 
+/// Inventory or cart of an online character as it is in the table, the base of delta saves (0x308c)
+struct s_storage_cache {
+	std::vector<struct item> items; ///< Content of each slot, without the row id
+	std::vector<int> row_ids; ///< Row id of each slot, 0 for empty slots
+};
+
+static std::unordered_map<uint32, s_storage_cache> inventory_cache; ///< Inventories by char_id
+static std::unordered_map<uint32, s_storage_cache> cart_cache; ///< Carts by char_id
+
+/**
+ * Get the cache of a storage type that supports delta saves
+ * @param type: Storage type
+ * @param max: Number of slots
+ * @return Cache, or nullptr for other storage types
+ */
+static std::unordered_map<uint32, s_storage_cache>* inter_storage_cachedb(int type, int* max) {
+	switch( type ){
+		case TABLE_INVENTORY:
+			*max = MAX_INVENTORY;
+			return &inventory_cache;
+		case TABLE_CART:
+			*max = MAX_CART;
+			return &cart_cache;
+		default:
+			return nullptr;
+	}
+}
+
+/**
+ * Remember the items of an inventory or cart as they were loaded or saved
+ * The row ids are kept apart from the items, the map-server leaves them out of delta saves.
+ * @param type: Storage type
+ * @param char_id: Character ID
+ * @param items: Items of all slots
+ * @param row_ids: Row id of each slot, nullptr to take them from the items
+ */
+static void inter_storage_setcache(int type, uint32 char_id, const struct item items[], const int row_ids[]) {
+	int max;
+	std::unordered_map<uint32, s_storage_cache>* db = inter_storage_cachedb(type, &max);
+
+	if( db == nullptr )
+		return;
+
+	s_storage_cache& cache = (*db)[char_id];
+
+	cache.items.assign(items, items + max);
+	cache.row_ids.resize(max);
+	for( int i = 0; i < max; i++ ){
+		cache.row_ids[i] = ( row_ids != nullptr ) ? row_ids[i] : items[i].id;
+		cache.items[i].id = 0;
+	}
+}
+
+/**
+ * Forget the inventory and cart of a character that went offline
+ * @param char_id: Character ID
+ */
+void inter_storage_charoffline(uint32 char_id) {
+	inventory_cache.erase(char_id);
+	cart_cache.erase(char_id);
+}
+
 /**
  * Get max storage amount
  * @param id: Storage ID
@@ -71,7 +136,14 @@ const char *inter_premiumStorage_getPrintableName(uint8 id) {
  */
 int inventory_tosql(uint32 char_id, struct s_storage* p)
 {
-	return char_memitemdata_to_sql(p->u.items_inventory, MAX_INVENTORY, char_id, TABLE_INVENTORY, p->stor_id);
+	int row_ids[MAX_INVENTORY];
+	int errors = char_memitemdata_to_sql(p->u.items_inventory, MAX_INVENTORY, char_id, TABLE_INVENTORY, p->stor_id, row_ids);
+
+	if( errors )
+		inventory_cache.erase(char_id);
+	else
+		inter_storage_setcache(TABLE_INVENTORY, char_id, p->u.items_inventory, row_ids);
+	return errors;
 }
 
 /**
@@ -93,7 +165,14 @@ int storage_tosql(uint32 account_id, struct s_storage* p)
  */
 int cart_tosql(uint32 char_id, struct s_storage* p)
 {
-	return char_memitemdata_to_sql(p->u.items_cart, MAX_CART, char_id, TABLE_CART, p->stor_id);
+	int row_ids[MAX_CART];
+	int errors = char_memitemdata_to_sql(p->u.items_cart, MAX_CART, char_id, TABLE_CART, p->stor_id, row_ids);
+
+	if( errors )
+		cart_cache.erase(char_id);
+	else
+		inter_storage_setcache(TABLE_CART, char_id, p->u.items_cart, row_ids);
+	return errors;
 }
 
 /**
@@ -179,6 +258,8 @@ void inter_storage_sql_init(void)
 // storage data finalize
 void inter_storage_sql_final(void)
 {
+	inventory_cache.clear();
+	cart_cache.clear();
 	return;
 }
 
@@ -333,6 +414,9 @@ bool mapif_parse_itembound_retrieve(int fd)
 
 	StringBuf_Init(&buf);
 
+	// Pending character saves could still write the inventory and the look
+	Sql_AsyncWait(account_id);
+
 	// Get bound items from player's inventory
 	StringBuf_AppendStr(&buf, "SELECT `id`, `nameid`, `amount`, `equip`, `identify`, `refine`, `attribute`, `expire_time`, `bound`");
 	for( j = 0; j < MAX_SLOTS; ++j )
@@ -536,6 +620,10 @@ bool mapif_parse_StorageLoad(int fd) {
 		default: return false;
 	}
 
+	// The map-server bases its delta saves on the loaded items
+	if( res )
+		inter_storage_setcache(type, cid, stor.u.items_inventory, nullptr);
+
 	mode = RFIFOB(fd, 12);
 	stor.state.put = (mode&STOR_MODE_PUT) ? 1 : 0;
 	stor.state.get = (mode&STOR_MODE_GET) ? 1 : 0;
@@ -579,6 +667,67 @@ bool mapif_parse_StorageSave(int fd) {
 	return false;
 }
 
+/**
+ * Asking to save the changed slots of a player's inventory/cart
+ * The slots are written by the row ids of the cached items, without reading the table.
+ * If the cache does not match the map-server's base or the result, the complete items are requested instead.
+ * ZI 0x308c <size>.W <type>.B <account_id>.L <char_id>.L <base crc>.L <crc>.L <count>.W { <index>.W <item>.?B }*count
+ * IZ 0x388d <account_id>.L <char_id>.L <type>.B
+ * @param fd
+ */
+bool mapif_parse_StorageSaveDelta(int fd) {
+	int size = RFIFOW(fd, 2), type = RFIFOB(fd, 4), count = RFIFOW(fd, 21), max;
+	uint32 aid = RFIFOL(fd, 5), cid = RFIFOL(fd, 9);
+	const size_t entry_size = 2 + sizeof(struct item);
+	std::unordered_map<uint32, s_storage_cache>* db = inter_storage_cachedb(type, &max);
+	std::vector<struct item> items;
+	std::vector<uint16> indexes;
+	bool valid = false;
+
+	if( db == nullptr )
+		return false;
+
+	auto it = db->find(cid);
+
+	if( it != db->end() && size == 23 + count * (int)entry_size
+		&& (uint32)grfio_crc32((unsigned char*)it->second.items.data(), (unsigned int)(sizeof(struct item) * max)) == RFIFOL(fd, 13) )
+	{
+		items = it->second.items;
+		valid = true;
+		for( int i = 0; i < count; i++ ){
+			uint16 index = RFIFOW(fd, 23 + i * entry_size);
+
+			if( index >= max ){
+				valid = false;
+				break;
+			}
+			memcpy(&items[index], RFIFOP(fd, 23 + i * entry_size + 2), sizeof(struct item));
+			indexes.push_back(index);
+		}
+		valid = ( valid && (uint32)grfio_crc32((unsigned char*)items.data(), (unsigned int)(sizeof(struct item) * max)) == RFIFOL(fd, 17) );
+	}
+
+	if( !valid ){
+		// The cached items differ from the map-server's, request the complete items
+		WFIFOHEAD(fd, 11);
+		WFIFOW(fd, 0) = 0x388d;
+		WFIFOL(fd, 2) = aid;
+		WFIFOL(fd, 6) = cid;
+		WFIFOB(fd, 10) = type;
+		WFIFOSET(fd, 11);
+		return false;
+	}
+
+	if( char_memitemdata_slots_to_sql(items.data(), indexes.data(), (int)indexes.size(), it->second.items.data(), it->second.row_ids.data(), cid, (enum storage_type)type) ){
+		// The table may not match the cache anymore, the next save writes the complete items
+		db->erase(it);
+		mapif_storage_saved(fd, aid, cid, false, type, 0);
+		return false;
+	}
+
+	mapif_storage_saved(fd, aid, cid, true, type, 0);
+	return true;
+}
 
 /*==========================================
  * Parse packet from map-server
@@ -594,6 +743,7 @@ bool inter_storage_parse_frommap(int fd)
 #endif
 		case 0x308a: mapif_parse_StorageLoad(fd); break;
 		case 0x308b: mapif_parse_StorageSave(fd); break;
+		case 0x308c: mapif_parse_StorageSaveDelta(fd); break;
 		default:
 			return false;
 	}
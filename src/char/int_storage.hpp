@@ -16,6 +16,7 @@ const char *inter_premiumStorage_getTableName(uint8 id);
 const char *inter_premiumStorage_getPrintableName(uint8 id);
 
 bool inter_storage_parse_frommap(int fd);
+void inter_storage_charoffline(uint32 char_id);
 
 bool guild_storage_tosql(int guild_id, struct s_storage *p);
 
@@ -49,6 +49,7 @@ char char_server_ip[64] = "127.0.0.1";
 char char_server_id[32] = "ragnarok";
 char char_server_pw[32] = ""; // Allow user to send empty password (bugreport:7787)
 char char_server_db[32] = "ragnarok";
+int char_server_async_threads = 2;
 char default_codepage[32] = ""; //Feature by irmin.
 unsigned int party_share_level = 10;
 
@@ -62,7 +63,7 @@ int inter_recv_packet_length[] = {
 	-1,-1,10,10,  0,-1,12, 0,  0, 0, 0, 0,  0, 0,  0, 0,	// 3050-  Auction System [Zephyrus]
 	 6,-1, 6,-1, 16+NAME_LENGTH+ACHIEVEMENT_NAME_LENGTH, 0, 0, 0,  0, 0, 0, 0,  0, 0,  0, 0,	// 3060-  Quest system [Kevin] [Inkfish] / Achievements [Aleos]
 	-1,10, 6,-1,  0, 0, 0, 0,  0, 0, 0, 0, -1,10,  6,-1,	// 3070-  Mercenary packets [Zephyrus], Elemental packets [pakpil]
-	48,14,-1, 6,  0, 0, 0, 0,  0, 0,13,-1,  0, 0,  0, 0,	// 3080-  Pet System, Storage
+	48,14,-1, 6,  0, 0, 0, 0,  0, 0,13,-1, -1, 0,  0, 0,	// 3080-  Pet System, Storage
 	-1,10,-1, 6,  0, 0, 0, 0,  0, 0, 0, 0,  0, 0,  0, 0,	// 3090-  Homunculus packets [albator]
 	 2,-1, 6, 6,  0, 0, 0, 0,  0, 0, 0, 0,  0, 0,  0, 0,	// 30A0-  Clan packets
 };
@@ -815,6 +816,8 @@ int inter_config_read(const char* cfgName)
 			safestrncpy(char_server_pw,w2,sizeof(char_server_pw));
 		else if(!strcmpi(w1,"char_server_db"))
 			safestrncpy(char_server_db,w2,sizeof(char_server_db));
+		else if(!strcmpi(w1,"char_server_async_threads"))
+			char_server_async_threads = atoi(w2);
 		else if(!strcmpi(w1,"default_codepage"))
 			safestrncpy(default_codepage,w2,sizeof(default_codepage));
 		else if(!strcmpi(w1,"party_share_level"))
@@ -949,6 +952,13 @@ int inter_init_sql(const char *file)
 			Sql_ShowDebug(sql_handle);
 	}
 
+	if( char_server_async_threads > 0 ) {
+		if( SQL_ERROR == Sql_AsyncInit(char_server_async_threads, char_server_id, char_server_pw, char_server_ip, (uint16)char_server_port, char_server_db, default_codepage) )
+			ShowError("Couldn't open the background save connections, saving synchronously.\n");
+		else
+			ShowInfo("Saving in the background with '" CL_WHITE "%d" CL_RESET "' connections.\n", char_server_async_threads);
+	}
+
 	wis_db = idb_alloc(DB_OPT_RELEASE_DATA);
 	interServerDb.load();
 	inter_guild_sql_init();
@@ -982,6 +992,9 @@ void inter_final(void)
 	inter_auction_sql_final();
 	inter_clan_final();
 
+	// Write the pending saves, including the guilds saved above
+	Sql_AsyncFinal();
+
 	if(geoip_cache) aFree(geoip_cache);
 	
 	return;
@@ -3,8 +3,216 @@
 
 #include "database.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 #include "showmsg.hpp"
 
+/// A file parsed by the preloading workers
+struct s_yaml_preload{
+	std::string path;
+	YAML::Node rootNode;
+	bool done;
+	bool failed; // The file is parsed again by load(), which reports the error
+};
+
+static std::mutex yaml_preload_mutex;
+static std::condition_variable yaml_preload_cond;
+static std::unordered_map<std::string, std::shared_ptr<s_yaml_preload>> yaml_preload_files;
+static std::deque<std::shared_ptr<s_yaml_preload>> yaml_preload_queue;
+static std::vector<std::thread> yaml_preload_workers;
+static bool yaml_preload_stopping = false;
+
+/// Queues a file for the preloading workers, unless it was queued already. Requires yaml_preload_mutex.
+static void yaml_preload_queue_file( const std::string& path ){
+	if( yaml_preload_files.find( path ) != yaml_preload_files.end() ){
+		return;
+	}
+
+	std::shared_ptr<s_yaml_preload> file = std::make_shared<s_yaml_preload>();
+
+	file->path = path;
+	file->done = false;
+	file->failed = false;
+
+	yaml_preload_files[path] = file;
+	yaml_preload_queue.push_back( file );
+	yaml_preload_cond.notify_all();
+}
+
+/// Preloading worker: only uses yaml-cpp, never the memory manager or the console
+static void yaml_preload_worker(){
+	std::unique_lock<std::mutex> lock( yaml_preload_mutex );
+
+	while( true ){
+		yaml_preload_cond.wait( lock, [] { return yaml_preload_stopping || !yaml_preload_queue.empty(); } );
+
+		if( yaml_preload_stopping ){
+			return;
+		}
+
+		std::shared_ptr<s_yaml_preload> file = yaml_preload_queue.front();
+		YAML::Node rootNode;
+		bool failed = false;
+
+		yaml_preload_queue.pop_front();
+		lock.unlock();
+
+		try{
+			rootNode = YAML::LoadFile( file->path );
+		}catch( const YAML::Exception& ){
+			failed = true;
+		}
+
+		// Imports are queued as well, with the same mode filter as parseImports
+		std::vector<std::string> imports;
+
+		try{
+			if( !failed && rootNode["Footer"] && rootNode["Footer"]["Imports"] ){
+				for( const YAML::Node& node : rootNode["Footer"]["Imports"] ){
+					if( !node["Path"] ){
+						continue;
+					}
+
+					if( node["Mode"] ){
+#ifdef RENEWAL
+						const std::string compiledMode = "Renewal";
+#else
+						const std::string compiledMode = "Prerenewal";
+#endif
+
+						if( node["Mode"].as<std::string>() != compiledMode ){
+							continue;
+						}
+					}
+
+					imports.push_back( node["Path"].as<std::string>() );
+				}
+			}
+		}catch( const YAML::Exception& ){
+			// load() reports invalid imports
+		}
+
+		lock.lock();
+
+		file->rootNode = rootNode;
+		file->failed = failed;
+		file->done = true;
+
+		for( const std::string& import : imports ){
+			yaml_preload_queue_file( import );
+		}
+
+		yaml_preload_cond.notify_all();
+	}
+}
+
+/**
+ * Takes the preloaded root node of a file, waiting for the workers if needed.
+ * @param path: File to take
+ * @param rootNode: Parsed file
+ * @return true if the file was preloaded successfully
+ */
+static bool yaml_preload_take( const std::string& path, YAML::Node& rootNode ){
+	std::unique_lock<std::mutex> lock( yaml_preload_mutex );
+	auto it = yaml_preload_files.find( path );
+
+	if( it == yaml_preload_files.end() ){
+		return false;
+	}
+
+	std::shared_ptr<s_yaml_preload> file = it->second;
+
+	// Not picked up by a worker yet, parse it on this thread instead
+	if( !file->done && std::find( yaml_preload_queue.begin(), yaml_preload_queue.end(), file ) != yaml_preload_queue.end() ){
+		yaml_preload_queue.erase( std::find( yaml_preload_queue.begin(), yaml_preload_queue.end(), file ) );
+		yaml_preload_files.erase( it );
+		return false;
+	}
+
+	yaml_preload_cond.wait( lock, [&file] { return file->done; } );
+
+	// A file is only used once, reloading parses it again
+	yaml_preload_files.erase( path );
+
+	if( file->failed ){
+		return false;
+	}
+
+	rootNode = file->rootNode;
+
+	return true;
+}
+
+std::vector<YamlDatabase*>& YamlDatabase::instances(){
+	static std::vector<YamlDatabase*> databases;
+
+	return databases;
+}
+
+YamlDatabase::~YamlDatabase(){
+	std::vector<YamlDatabase*>& databases = instances();
+
+	databases.erase( std::remove( databases.begin(), databases.end(), this ), databases.end() );
+}
+
+/**
+ * Starts parsing the files of every database and their imports on worker threads.
+ * load() then only has to wait for the parsed file and fill the database from it.
+ * Filling the databases stays on the main thread in the existing order, so lookups into other databases still work.
+ */
+void YamlDatabase::startPreloading(){
+	if( !yaml_preload_workers.empty() ){
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock( yaml_preload_mutex );
+
+	for( YamlDatabase* database : instances() ){
+		yaml_preload_queue_file( database->getDefaultLocation() );
+	}
+
+	size_t count = std::min<size_t>( std::max<unsigned int>( std::thread::hardware_concurrency(), 1 ), yaml_preload_queue.size() );
+
+	yaml_preload_stopping = false;
+
+	// Workers must be joined even when the server exits during its startup
+	static bool registered = false;
+
+	if( !registered ){
+		atexit( YamlDatabase::stopPreloading );
+		registered = true;
+	}
+
+	for( size_t i = 0; i < count; i++ ){
+		yaml_preload_workers.push_back( std::thread( yaml_preload_worker ) );
+	}
+}
+
+/**
+ * Stops the preloading workers and drops files that no database loaded.
+ */
+void YamlDatabase::stopPreloading(){
+	{
+		std::unique_lock<std::mutex> lock( yaml_preload_mutex );
+
+		yaml_preload_stopping = true;
+		yaml_preload_cond.notify_all();
+	}
+
+	for( std::thread& worker : yaml_preload_workers ){
+		worker.join();
+	}
+
+	yaml_preload_workers.clear();
+	yaml_preload_files.clear();
+	yaml_preload_queue.clear();
+}
+
 bool YamlDatabase::nodeExists( const YAML::Node& node, const std::string& name ){
 	try{
 		if( node[name] ){
@@ -82,7 +290,15 @@ bool YamlDatabase::verifyCompatibility( const YAML::Node& rootNode ){
 }
 
 bool YamlDatabase::load(){
-	return this->load( this->getDefaultLocation() );
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	bool result = this->load( this->getDefaultLocation() );
+
+	int64 duration = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start ).count();
+
+	ShowStatus( "Done loading the '" CL_WHITE "%s" CL_RESET "' database in '" CL_WHITE "%" PRId64 CL_RESET "' ms.\n", this->type.c_str(), duration );
+
+	return result;
 }
 
 bool YamlDatabase::reload(){
@@ -95,7 +311,9 @@ bool YamlDatabase::load(const std::string& path) {
 	YAML::Node rootNode;
 
 	try {
-		rootNode = YAML::LoadFile(path);
+		if( !yaml_preload_take( path, rootNode ) ){
+			rootNode = YAML::LoadFile(path);
+		}
 	}
 	catch(YAML::Exception &e) {
 		ShowError("Failed to read %s database file from '" CL_WHITE "%s" CL_RESET "'.\n", this->type.c_str(), path.c_str());
@@ -23,6 +23,8 @@ private:
 	uint16 minimumVersion;
 	std::string currentFile;
 
+	static std::vector<YamlDatabase*>& instances();
+
 	bool verifyCompatibility( const YAML::Node& rootNode );
 	bool load( const std::string& path );
 	void parse( const YAML::Node& rootNode );
@@ -58,15 +60,23 @@ public:
 		this->type = type_;
 		this->version = version_;
 		this->minimumVersion = minimumVersion_;
+
+		instances().push_back( this );
 	}
 
 	YamlDatabase( const std::string& type_, uint16 version_ ) : YamlDatabase( type_, version_, version_ ){
 		// Empty since everything is handled by the real constructor
 	}
 
+	virtual ~YamlDatabase();
+
 	bool load();
 	bool reload();
 
+	// Parse the files of all databases on worker threads ahead of their loading
+	static void startPreloading();
+	static void stopPreloading();
+
 	// Functions that need to be implemented for each type
 	virtual void clear() = 0;
 	virtual const std::string getDefaultLocation() = 0;
@@ -73,6 +73,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef _MSC_VER
+#include <intrin.h> // _BitScanForward64()
+#endif
+
 #include "ers.hpp"
 #include "malloc.hpp"
 #include "mmo.hpp"
@@ -88,6 +92,7 @@
  *  DBNode          - Structure of a node in RED-BLACK trees.                *
  *  struct db_free  - Structure that holds a deleted node to be freed.       *
  *  DBMap_impl      - Structure of the database.                             *
+ *  DBFlatMap_impl  - Structure of the flat (open-addressing) database.      *
  *  stats           - Statistics about the database system.                  *
 \*****************************************************************************/
 
@@ -223,6 +228,140 @@ typedef struct DBIterator_impl {
 	DBNode *node;
 } DBIterator_impl;
 
+/**
+ * Number of slots in a group of a flat database.
+ * The control bytes of a group are matched together as one 64-bit word.
+ * @private
+ * @see DBFlatMap_impl#ctrl
+ */
+#define FLAT_GROUP_SIZE 8
+
+/**
+ * Number of entries in a chunk of a flat database (log2).
+ * Entries are never moved, so pointers to their data stay valid.
+ * @private
+ * @see DBFlatMap_impl#chunks
+ */
+#define FLAT_CHUNK_SHIFT 9
+#define FLAT_CHUNK_SIZE (1<<FLAT_CHUNK_SHIFT)
+
+/**
+ * Control bytes of the slots of a flat database.
+ * Used slots hold the lowest 7 bits of the hash of their key instead.
+ * @private
+ * @see DBFlatMap_impl#ctrl
+ */
+#define FLAT_CTRL_EMPTY   0x80
+#define FLAT_CTRL_DELETED 0xFE
+
+/**
+ * Marks the end of the entry lists of a flat database.
+ * @private
+ */
+#define FLAT_ENTRY_NONE UINT32_MAX
+
+/**
+ * Slot of the index of a flat database.
+ * @param key Key of the entry
+ * @param entry Index of the entry
+ * @private
+ * @see DBFlatMap_impl#slots
+ */
+template <typename K> struct DBFlatSlot {
+	K key;
+	uint32 entry;
+};
+
+/**
+ * Entry of a flat database.
+ * @param key Key of this database entry
+ * @param next Next entry in the free or pending list, if deleted
+ * @param data Data of this database entry
+ * @param deleted If the entry is deleted
+ * @param pending If the entry is in the pending list
+ * @private
+ * @see DBFlatMap_impl#chunks
+ */
+template <typename K> struct DBFlatEntry {
+	K key;
+	uint32 next;
+	DBData data;
+	bool deleted;
+	bool pending;
+};
+
+/**
+ * Database with integer keys kept in an open-addressing hashtable.
+ * The index is probed in groups of FLAT_GROUP_SIZE control bytes and only
+ * points to the entries, which are allocated in chunks and iterated in
+ * allocation order. Entries removed while the database is locked keep their
+ * slot in the index until it is unlocked, so a key that is put again revives
+ * its entry and iterators never see an entry twice.
+ * @param vtable Interface of the database
+ * @param alloc_file File where the database was allocated
+ * @param alloc_line Line in the file where the database was allocated
+ * @param free_lock Lock for reusing the entries
+ * @param ctrl Control bytes of the index
+ * @param slots Slots of the index
+ * @param group_mask Number of groups in the index minus one
+ * @param growth_left Number of empty slots that can be used before rehashing
+ * @param chunks Chunks of entries
+ * @param chunk_count Number of allocated chunks
+ * @param entry_count Number of entries ever used since the last clear
+ * @param free_head First reusable entry
+ * @param pending_head First entry removed while the database was locked
+ * @param pending_count Number of entries in the pending list
+ * @param release Releaser of the database
+ * @param type Type of the database
+ * @param options Options of the database
+ * @param item_count Number of items in the database
+ * @param global_lock Global lock of the database
+ * @private
+ * @see #db_flat_alloc(const char*,const char*,int,DBType,DBOptions)
+ */
+template <typename K> struct DBFlatMap_impl {
+	// Database interface
+	struct DBMap vtable;
+	// File and line of allocation
+	const char *alloc_file;
+	int alloc_line;
+	// Lock system
+	unsigned int free_lock;
+	// Index
+	uint8 *ctrl;
+	DBFlatSlot<K> *slots;
+	uint32 group_mask;
+	uint32 growth_left;
+	// Entries
+	DBFlatEntry<K> **chunks;
+	uint32 chunk_count;
+	uint32 entry_count;
+	uint32 free_head;
+	uint32 pending_head;
+	uint32 pending_count;
+	// Other
+	DBReleaser release;
+	DBType type;
+	DBOptions options;
+	uint32 item_count;
+	unsigned global_lock : 1;
+};
+
+/**
+ * Iterator of a flat database.
+ * @param vtable Interface of the iterator
+ * @param db Parent database
+ * @param pos Index of the current entry
+ * @private
+ * @see #DBFlatMap_impl
+ */
+typedef struct DBFlatIterator_impl {
+	// Iterator interface
+	struct DBIterator vtable;
+	DBMap* db;
+	int64 pos;
+} DBFlatIterator_impl;
+
 #if defined(DB_ENABLE_STATS)
 /**
  * Structure with what is counted when the database statistics are enabled.
@@ -336,6 +475,7 @@ static struct db_stats {
 /* [Ind/Hercules] */
 struct eri *db_iterator_ers;
 struct eri *db_alloc_ers;
+struct eri *db_flat_iterator_ers;
 
 /*****************************************************************************\
  *  (2) Section of private functions used by the database system.            *
@@ -2341,182 +2481,1129 @@ static DBOptions db_obj_options(DBMap* self)
 }
 
 /*****************************************************************************\
- *  (5) Section with public functions.
- *  db_fix_options     - Apply database type restrictions to the options.
- *  db_default_cmp     - Get the default comparator for a type of database.
- *  db_default_hash    - Get the default hasher for a type of database.
- *  db_default_release - Get the default releaser for a type of database with the specified options.
- *  db_custom_release  - Get a releaser that behaves a certain way.
- *  db_alloc           - Allocate a new database.
- *  db_i2key           - Manual cast from 'int' to 'DBKey'.
- *  db_ui2key          - Manual cast from 'unsigned int' to 'DBKey'.
- *  db_str2key         - Manual cast from 'unsigned char *' to 'DBKey'.
- *  db_i642key         - Manual cast from 'int64' to 'DBKey'.
- *  db_ui642key        - Manual cast from 'uin64' to 'DBKey'.
- *  db_i2data          - Manual cast from 'int' to 'DBData'.
- *  db_ui2data         - Manual cast from 'unsigned int' to 'DBData'.
- *  db_ptr2data        - Manual cast from 'void*' to 'DBData'.
- *  db_data2i          - Gets 'int' value from 'DBData'.
- *  db_data2ui         - Gets 'unsigned int' value from 'DBData'.
- *  db_data2ptr        - Gets 'void*' value from 'DBData'.
- *  db_init            - Initializes the database system.
- *  db_final           - Finalizes the database system.
+ *  (4b) Section with the functions of the flat databases.                   *
+ *  db_flat_key          - Gets the integer key from a DBKey.                *
+ *  db_flat_hash         - Mixes an integer key into a hash.                 *
+ *  db_flat_find         - Finds the slot of a key in the index.             *
+ *  db_flat_find_item    - Finds the slot of a key that was not removed.     *
+ *  db_flat_rehash       - Grows the index or purges its deleted slots.      *
+ *  db_flat_insert_slot  - Adds a key to the index.                          *
+ *  db_flat_erase_slot   - Removes a slot from the index.                    *
+ *  db_flat_entry_alloc  - Gets an unused entry.                             *
+ *  db_flat_entry_revive - Revives an entry removed while locked.            *
+ *  db_flat_remove_slot  - Removes the entry of a slot from the database.    *
+ *  db_flat_lock         - Increments the free_lock of a database.           *
+ *  db_flat_unlock       - Decrements the free_lock of a database.           *
+ *  dbit_flat_obj_*      - Interface of the iterator of flat databases.      *
+ *  db_flat_obj_*        - Interface of the flat databases.                  *
 \*****************************************************************************/
 
+#define FLAT_LSBS 0x0101010101010101ULL
+#define FLAT_MSBS 0x8080808080808080ULL
+
+/// Gets the key of a flat database from the DBKey union.
+template <typename K> static inline K db_flat_key(DBKey key);
+template <> inline int db_flat_key<int>(DBKey key){ return key.i; }
+template <> inline unsigned int db_flat_key<unsigned int>(DBKey key){ return key.ui; }
+template <> inline int64 db_flat_key<int64>(DBKey key){ return key.i64; }
+template <> inline uint64 db_flat_key<uint64>(DBKey key){ return key.ui64; }
+
+/// Puts the key of a flat database in the DBKey union.
+static inline DBKey db_flat_dbkey(int key){ DBKey ret; ret.i = key; return ret; }
+static inline DBKey db_flat_dbkey(unsigned int key){ DBKey ret; ret.ui = key; return ret; }
+static inline DBKey db_flat_dbkey(int64 key){ DBKey ret; ret.i64 = key; return ret; }
+static inline DBKey db_flat_dbkey(uint64 key){ DBKey ret; ret.ui64 = key; return ret; }
+
+/// Mixes the bits of an integer key, so consecutive ids spread over all groups.
+static inline uint64 db_flat_hash(uint64 key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return key;
+}
+
+/// Returns the index of the lowest set bit, the value must not be 0.
+static inline uint32 db_flat_ffs(uint64 value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return (uint32)index;
+#else
+	return (uint32)__builtin_ctzll(value);
+#endif
+}
+
+/// Loads the control bytes of a group.
+static inline uint64 db_flat_group(const uint8 *ctrl, uint32 group)
+{
+	uint64 value;
+
+	memcpy(&value, ctrl + group * FLAT_GROUP_SIZE, sizeof(value));
+	return value;
+}
+
+/// Returns the high bit of every control byte that may belong to the given hash.
+static inline uint64 db_flat_match(uint64 group, uint8 h2)
+{
+	uint64 x = group ^ (FLAT_LSBS * h2);
+
+	return (x - FLAT_LSBS) & ~x & FLAT_MSBS;
+}
+
+/// Returns the high bit of every empty control byte.
+static inline uint64 db_flat_match_empty(uint64 group)
+{
+	return group & ~(group << 6) & FLAT_MSBS;
+}
+
+/// Returns the high bit of every empty or deleted control byte.
+static inline uint64 db_flat_match_free(uint64 group)
+{
+	return group & FLAT_MSBS;
+}
+
+/// Returns the entry with the given index.
+template <typename K> static inline DBFlatEntry<K>* db_flat_entry(DBFlatMap_impl<K>* db, uint32 index)
+{
+	return &db->chunks[index >> FLAT_CHUNK_SHIFT][index & (FLAT_CHUNK_SIZE - 1)];
+}
+
 /**
- * Returns the fixed options according to the database type.
- * Sets required options and unsets unsupported options.
- * For numeric databases DB_OPT_DUP_KEY and DB_OPT_RELEASE_KEY are unset.
- * @param type Type of the database
- * @param options Original options of the database
- * @return Fixed options of the database
+ * Finds the slot of the key in the index of the database.
+ * @param db Target database
+ * @param key Key being searched
+ * @return Slot of the key or -1 if not found
  * @private
- * @see #db_default_release(DBType,DBOptions)
- * @see #db_alloc(const char *,int,DBType,DBOptions,unsigned short)
  */
-DBOptions db_fix_options(DBType type, DBOptions options)
+template <typename K> static int64 db_flat_find(DBFlatMap_impl<K>* db, K key)
 {
-	DB_COUNTSTAT(db_fix_options);
-	switch (type) {
-		case DB_INT:
-		case DB_UINT:
-		case DB_INT64:
-		case DB_UINT64: // Numeric database, do nothing with the keys
-			return (DBOptions)(options&~(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY));
+	uint64 hash;
+	uint8 h2;
+	uint32 group, probe;
 
-		default:
-			ShowError("db_fix_options: Unknown database type %u with options %x\n", type, options);
-		case DB_STRING:
-		case DB_ISTRING: // String databases, no fix required
-			return options;
+	if( db->ctrl == NULL )
+		return -1;
+
+	hash = db_flat_hash((uint64)key);
+	h2 = (uint8)(hash >> 57);
+	group = (uint32)hash & db->group_mask;
+	for( probe = 1; ; probe++ ){
+		uint64 ctrl = db_flat_group(db->ctrl, group);
+		uint64 match;
+
+		for( match = db_flat_match(ctrl, h2); match != 0; match &= match - 1 ){
+			uint32 slot = group * FLAT_GROUP_SIZE + db_flat_ffs(match) / 8;
+
+			if( db->slots[slot].key == key )
+				return slot;
+		}
+		// A key never probes past a group that still has an empty slot
+		if( db_flat_match_empty(ctrl) )
+			return -1;
+		group = (group + probe) & db->group_mask;
 	}
 }
 
 /**
- * Returns the default comparator for the specified type of database.
- * @param type Type of database
- * @return Comparator for the type of database or NULL if unknown database
- * @public
- * @see #db_int_cmp(DBKey,DBKey,unsigned short)
- * @see #db_uint_cmp(DBKey,DBKey,unsigned short)
- * @see #db_string_cmp(DBKey,DBKey,unsigned short)
- * @see #db_istring_cmp(DBKey,DBKey,unsigned short)
- * @see #db_int64_cmp(DBKey,DBKey,unsigned short)
- * @see #db_uint64_cmp(DBKey,DBKey,unsigned short)
+ * Finds the slot of a key whose entry was not removed.
+ * @param db Target database
+ * @param key Key being searched
+ * @return Slot of the key or -1 if not found
+ * @private
  */
-DBComparator db_default_cmp(DBType type)
+template <typename K> static int64 db_flat_find_item(DBFlatMap_impl<K>* db, K key)
 {
-	DB_COUNTSTAT(db_default_cmp);
-	switch (type) {
-		case DB_INT:     return &db_int_cmp;
-		case DB_UINT:    return &db_uint_cmp;
-		case DB_STRING:  return &db_string_cmp;
-		case DB_ISTRING: return &db_istring_cmp;
-		case DB_INT64:   return &db_int64_cmp;
-		case DB_UINT64:  return &db_uint64_cmp;
-		default:
-			ShowError("db_default_cmp: Unknown database type %u\n", type);
-			return NULL;
+	int64 slot = db_flat_find(db, key);
+
+	if( slot >= 0 && db_flat_entry(db, db->slots[slot].entry)->deleted )
+		return -1; // removed while locked
+	return slot;
+}
+
+/// Returns the first empty or deleted slot in the probe sequence of the hash.
+template <typename K> static uint32 db_flat_find_free(DBFlatMap_impl<K>* db, uint64 hash)
+{
+	uint32 group = (uint32)hash & db->group_mask;
+	uint32 probe;
+
+	for( probe = 1; ; probe++ ){
+		uint64 match = db_flat_match_free(db_flat_group(db->ctrl, group));
+
+		if( match != 0 )
+			return group * FLAT_GROUP_SIZE + db_flat_ffs(match) / 8;
+		group = (group + probe) & db->group_mask;
 	}
 }
 
 /**
- * Returns the default hasher for the specified type of database.
- * @param type Type of database
- * @return Hasher of the type of database or NULL if unknown database
- * @public
- * @see #db_int_hash(DBKey,unsigned short)
- * @see #db_uint_hash(DBKey,unsigned short)
- * @see #db_string_hash(DBKey,unsigned short)
- * @see #db_istring_hash(DBKey,unsigned short)
- * @see #db_int64_hash(DBKey,unsigned short)
- * @see #db_uint64_hash(DBKey,unsigned short)
+ * Rebuilds the index of the database.
+ * The index doubles when it is at least half full with used slots, otherwise
+ * it keeps its size and only drops the deleted slots.
+ * The entries are not touched, so data pointers and iterators stay valid.
+ * @param db Target database
+ * @private
  */
-DBHasher db_default_hash(DBType type)
+template <typename K> static void db_flat_rehash(DBFlatMap_impl<K>* db)
 {
-	DB_COUNTSTAT(db_default_hash);
-	switch (type) {
-		case DB_INT:     return &db_int_hash;
-		case DB_UINT:    return &db_uint_hash;
-		case DB_STRING:  return &db_string_hash;
-		case DB_ISTRING: return &db_istring_hash;
-		case DB_INT64:   return &db_int64_hash;
-		case DB_UINT64:  return &db_uint64_hash;
-		default:
-			ShowError("db_default_hash: Unknown database type %u\n", type);
-			return NULL;
+	uint8 *old_ctrl = db->ctrl;
+	DBFlatSlot<K> *old_slots = db->slots;
+	uint32 old_capacity = ( old_ctrl != NULL ) ? ( db->group_mask + 1 ) * FLAT_GROUP_SIZE : 0;
+	uint32 groups = ( old_ctrl != NULL ) ? db->group_mask + 1 : 2;
+	uint32 capacity, used = 0, i;
+
+	// The slots of the pending entries are still used
+	if( old_ctrl != NULL && db->item_count + db->pending_count >= old_capacity / 2 )
+		groups *= 2;
+	capacity = groups * FLAT_GROUP_SIZE;
+
+	CREATE(db->ctrl, uint8, capacity);
+	CREATE(db->slots, DBFlatSlot<K>, capacity);
+	memset(db->ctrl, FLAT_CTRL_EMPTY, capacity);
+	db->group_mask = groups - 1;
+
+	for( i = 0; i < old_capacity; i++ ){
+		uint64 hash;
+		uint32 slot;
+
+		if( old_ctrl[i]&FLAT_CTRL_EMPTY )
+			continue; // empty or deleted
+
+		hash = db_flat_hash((uint64)old_slots[i].key);
+		slot = db_flat_find_free(db, hash);
+		db->ctrl[slot] = (uint8)(hash >> 57);
+		db->slots[slot] = old_slots[i];
+		used++;
+	}
+	db->growth_left = capacity - capacity / 8 - used;
+
+	if( old_ctrl != NULL ){
+		aFree(old_ctrl);
+		aFree(old_slots);
 	}
 }
 
 /**
- * Returns the default releaser for the specified type of database with the
- * specified options.
- * NOTE: the options are fixed with {@link #db_fix_options(DBType,DBOptions)}
- * before choosing the releaser.
- * @param type Type of database
- * @param options Options of the database
- * @return Default releaser for the type of database with the specified options
- * @public
- * @see #db_release_nothing(DBKey,DBData,DBRelease)
- * @see #db_release_key(DBKey,DBData,DBRelease)
- * @see #db_release_data(DBKey,DBData,DBRelease)
- * @see #db_release_both(DBKey,DBData,DBRelease)
- * @see #db_custom_release(DBRelease)
+ * Adds a key that is not in the index yet.
+ * @param db Target database
+ * @param key Key of the entry
+ * @param entry Index of the entry
+ * @private
  */
-DBReleaser db_default_release(DBType type, DBOptions options)
+template <typename K> static void db_flat_insert_slot(DBFlatMap_impl<K>* db, K key, uint32 entry)
 {
-	DB_COUNTSTAT(db_default_release);
-	options = db_fix_options(type, options);
-	if (options&DB_OPT_RELEASE_DATA) { // Release data, what about the key?
-		if (options&(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY))
-			return &db_release_both; // Release both key and data
-		return &db_release_data; // Only release data
+	uint64 hash = db_flat_hash((uint64)key);
+	uint32 slot;
+
+	if( db->ctrl == NULL )
+		db_flat_rehash(db);
+
+	slot = db_flat_find_free(db, hash);
+	if( db->growth_left == 0 && db->ctrl[slot] != FLAT_CTRL_DELETED ){
+		db_flat_rehash(db);
+		slot = db_flat_find_free(db, hash);
 	}
-	if (options&(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY))
-		return &db_release_key; // Only release key
-	return &db_release_nothing; // Release nothing
+	if( db->ctrl[slot] == FLAT_CTRL_EMPTY )
+		db->growth_left--;
+	db->ctrl[slot] = (uint8)(hash >> 57);
+	db->slots[slot].key = key;
+	db->slots[slot].entry = entry;
 }
 
 /**
- * Returns the releaser that releases the specified release options.
- * @param which Options that specified what the releaser releases
- * @return Releaser for the specified release options
- * @public
- * @see #db_release_nothing(DBKey,DBData,DBRelease)
- * @see #db_release_key(DBKey,DBData,DBRelease)
- * @see #db_release_data(DBKey,DBData,DBRelease)
- * @see #db_release_both(DBKey,DBData,DBRelease)
- * @see #db_default_release(DBType,DBOptions)
+ * Removes a slot from the index.
+ * A group that still has an empty slot never made a probe go past it, so the
+ * slot can be emptied again. Otherwise it has to stay as a deleted marker.
+ * @param db Target database
+ * @param slot Slot being removed
+ * @private
  */
-DBReleaser db_custom_release(DBRelease which)
+template <typename K> static void db_flat_erase_slot(DBFlatMap_impl<K>* db, uint32 slot)
 {
-	DB_COUNTSTAT(db_custom_release);
-	switch (which) {
-		case DB_RELEASE_NOTHING: return &db_release_nothing;
-		case DB_RELEASE_KEY:     return &db_release_key;
-		case DB_RELEASE_DATA:    return &db_release_data;
-		case DB_RELEASE_BOTH:    return &db_release_both;
-		default:
-			ShowError("db_custom_release: Unknown release options %u\n", which);
-			return NULL;
+	if( db_flat_match_empty(db_flat_group(db->ctrl, slot / FLAT_GROUP_SIZE)) ){
+		db->ctrl[slot] = FLAT_CTRL_EMPTY;
+		db->growth_left++;
+	}else{
+		db->ctrl[slot] = FLAT_CTRL_DELETED;
 	}
 }
 
 /**
- * Allocate a new database of the specified type.
- * NOTE: the options are fixed by {@link #db_fix_options(DBType,DBOptions)}
- * before creating the database.
- * @param file File where the database is being allocated
- * @param line Line of the file where the database is being allocated
- * @param type Type of database
- * @param options Options of the database
- * @param maxlen Maximum length of the string to be used as key in string
- *          databases. If 0, the maximum number of maxlen is used (64K).
- * @return The interface of the database
- * @public
- * @see #DBMap_impl
- * @see #db_fix_options(DBType,DBOptions)
- */
+ * Gets an unused entry, reusing the entries removed while unlocked first.
+ * @param db Target database
+ * @param key Key of the new entry
+ * @return Index of the entry
+ * @private
+ */
+template <typename K> static uint32 db_flat_entry_alloc(DBFlatMap_impl<K>* db, K key)
+{
+	DBFlatEntry<K> *entry;
+	uint32 index;
+
+	if( db->free_head != FLAT_ENTRY_NONE ){
+		index = db->free_head;
+		db->free_head = db_flat_entry(db, index)->next;
+	}else{
+		index = db->entry_count++;
+		if( ( index >> FLAT_CHUNK_SHIFT ) == db->chunk_count ){
+			RECREATE(db->chunks, DBFlatEntry<K>*, db->chunk_count + 1);
+			CREATE(db->chunks[db->chunk_count], DBFlatEntry<K>, FLAT_CHUNK_SIZE);
+			db->chunk_count++;
+		}
+	}
+
+	entry = db_flat_entry(db, index);
+	entry->key = key;
+	entry->next = FLAT_ENTRY_NONE;
+	entry->data.type = DB_DATA_PTR;
+	entry->data.u.ptr = NULL;
+	entry->deleted = false;
+	entry->pending = false;
+	db->item_count++;
+	return index;
+}
+
+/**
+ * Revives the entry of a slot that was removed while the database was locked.
+ * The entry stays in the pending list, db_flat_unlock skips it.
+ * @param db Target database
+ * @param slot Slot of the entry
+ * @return The entry
+ * @private
+ */
+template <typename K> static DBFlatEntry<K>* db_flat_entry_revive(DBFlatMap_impl<K>* db, uint32 slot)
+{
+	DBFlatEntry<K> *entry = db_flat_entry(db, db->slots[slot].entry);
+
+	entry->data.type = DB_DATA_PTR;
+	entry->data.u.ptr = NULL;
+	entry->deleted = false;
+	db->item_count++;
+	return entry;
+}
+
+/**
+ * Removes the entry of a slot from the database.
+ * While the database is locked the entry is only marked as deleted and keeps
+ * its slot, both are freed once the last lock is gone.
+ * Puts the data of the entry in out_data, if out_data is not NULL (unless data has been released)
+ * @param db Target database
+ * @param slot Slot of the entry
+ * @param out_data Data of the removed entry
+ * @private
+ */
+template <typename K> static void db_flat_remove_slot(DBFlatMap_impl<K>* db, uint32 slot, DBData *out_data)
+{
+	uint32 index = db->slots[slot].entry;
+	DBFlatEntry<K> *entry = db_flat_entry(db, index);
+
+	db->release(db_flat_dbkey(entry->key), entry->data, DB_RELEASE_DATA);
+	if( out_data )
+		memcpy(out_data, &entry->data, sizeof(DBData));
+	entry->deleted = true;
+	if( db->free_lock ){
+		if( !entry->pending ){ // not revived from the pending list
+			entry->pending = true;
+			entry->next = db->pending_head;
+			db->pending_head = index;
+			db->pending_count++;
+		}
+	}else{
+		db_flat_erase_slot(db, slot);
+		entry->next = db->free_head;
+		db->free_head = index;
+	}
+	db->item_count--;
+}
+
+/**
+ * Increments the free_lock of the database.
+ * @param db Target database
+ * @private
+ */
+template <typename K> static void db_flat_lock(DBFlatMap_impl<K>* db)
+{
+	if( db->free_lock == (unsigned int)~0 ){
+		ShowFatalError("db_flat_lock: free_lock overflow\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		exit(EXIT_FAILURE);
+	}
+	db->free_lock++;
+}
+
+/**
+ * Decrements the free_lock of the database.
+ * If it was the last lock, the entries removed meanwhile become reusable.
+ * @param db Target database
+ * @private
+ */
+template <typename K> static void db_flat_unlock(DBFlatMap_impl<K>* db)
+{
+	if( db->free_lock == 0 ){
+		ShowWarning("db_flat_unlock: free_lock was already 0\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+	}else{
+		db->free_lock--;
+	}
+	if( db->free_lock )
+		return; // Not last lock
+
+	while( db->pending_head != FLAT_ENTRY_NONE ){
+		uint32 index = db->pending_head;
+		DBFlatEntry<K> *entry = db_flat_entry(db, index);
+
+		db->pending_head = entry->next;
+		entry->pending = false;
+		if( !entry->deleted )
+			continue; // revived
+		db_flat_erase_slot(db, (uint32)db_flat_find(db, entry->key));
+		entry->next = db->free_head;
+		db->free_head = index;
+	}
+	db->pending_count = 0;
+}
+
+/**
+ * Fetches the next entry in the flat database.
+ * @see DBIterator#next
+ */
+template <typename K> static DBData* dbit_flat_obj_next(DBIterator* self, DBKey* out_key)
+{
+	DBFlatIterator_impl* it = (DBFlatIterator_impl*)self;
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)it->db;
+	int64 pos;
+
+	DB_COUNTSTAT(dbit_next);
+	for( pos = it->pos + 1; pos < db->entry_count; pos++ ){
+		DBFlatEntry<K> *entry = db_flat_entry(db, (uint32)pos);
+
+		if( !entry->deleted ){
+			it->pos = pos;
+			if( out_key )
+				*out_key = db_flat_dbkey(entry->key);
+			return &entry->data;
+		}
+	}
+	it->pos = db->entry_count;
+	return NULL;// not found
+}
+
+/**
+ * Fetches the previous entry in the flat database.
+ * @see DBIterator#prev
+ */
+template <typename K> static DBData* dbit_flat_obj_prev(DBIterator* self, DBKey* out_key)
+{
+	DBFlatIterator_impl* it = (DBFlatIterator_impl*)self;
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)it->db;
+	int64 pos;
+
+	DB_COUNTSTAT(dbit_prev);
+	for( pos = i64min(it->pos, db->entry_count) - 1; pos >= 0; pos-- ){
+		DBFlatEntry<K> *entry = db_flat_entry(db, (uint32)pos);
+
+		if( !entry->deleted ){
+			it->pos = pos;
+			if( out_key )
+				*out_key = db_flat_dbkey(entry->key);
+			return &entry->data;
+		}
+	}
+	it->pos = -1;
+	return NULL;// not found
+}
+
+/**
+ * Fetches the first entry in the flat database.
+ * @see DBIterator#first
+ */
+template <typename K> static DBData* dbit_flat_obj_first(DBIterator* self, DBKey* out_key)
+{
+	DBFlatIterator_impl* it = (DBFlatIterator_impl*)self;
+
+	DB_COUNTSTAT(dbit_first);
+	// position before the first entry
+	it->pos = -1;
+	return self->next(self, out_key);
+}
+
+/**
+ * Fetches the last entry in the flat database.
+ * @see DBIterator#last
+ */
+template <typename K> static DBData* dbit_flat_obj_last(DBIterator* self, DBKey* out_key)
+{
+	DBFlatIterator_impl* it = (DBFlatIterator_impl*)self;
+
+	DB_COUNTSTAT(dbit_last);
+	// position after the last entry
+	it->pos = ((DBFlatMap_impl<K>*)it->db)->entry_count;
+	return self->prev(self, out_key);
+}
+
+/**
+ * Returns true if the fetched entry exists.
+ * @see DBIterator#exists
+ */
+template <typename K> static bool dbit_flat_obj_exists(DBIterator* self)
+{
+	DBFlatIterator_impl* it = (DBFlatIterator_impl*)self;
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)it->db;
+
+	DB_COUNTSTAT(dbit_exists);
+	return ( it->pos >= 0 && it->pos < db->entry_count && !db_flat_entry(db, (uint32)it->pos)->deleted );
+}
+
+/**
+ * Removes the current entry from the flat database.
+ * @see DBIterator#remove
+ */
+template <typename K> static int dbit_flat_obj_remove(DBIterator* self, DBData *out_data)
+{
+	DBFlatIterator_impl* it = (DBFlatIterator_impl*)self;
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)it->db;
+	int64 slot;
+
+	DB_COUNTSTAT(dbit_remove);
+	if( !self->exists(self) )
+		return 0;
+
+	slot = db_flat_find_item(db, db_flat_entry(db, (uint32)it->pos)->key);
+	if( slot < 0 )
+		return 0;
+	db_flat_remove_slot(db, (uint32)slot, out_data);
+	return 1;
+}
+
+/**
+ * Destroys this iterator and unlocks the flat database.
+ * @see DBIterator#destroy
+ */
+template <typename K> static void dbit_flat_obj_destroy(DBIterator* self)
+{
+	DBFlatIterator_impl* it = (DBFlatIterator_impl*)self;
+
+	DB_COUNTSTAT(dbit_destroy);
+	// unlock the database
+	db_flat_unlock((DBFlatMap_impl<K>*)it->db);
+	// free iterator
+	ers_free(db_flat_iterator_ers,self);
+}
+
+/**
+ * Returns a new iterator for this flat database.
+ * Entries are visited in the order they were allocated in.
+ * @see DBMap#iterator
+ */
+template <typename K> static DBIterator* db_flat_obj_iterator(DBMap* self)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+	DBFlatIterator_impl* it;
+
+	DB_COUNTSTAT(db_iterator);
+	it = ers_alloc(db_flat_iterator_ers, struct DBFlatIterator_impl);
+	/* Interface of the iterator **/
+	it->vtable.first   = dbit_flat_obj_first<K>;
+	it->vtable.last    = dbit_flat_obj_last<K>;
+	it->vtable.next    = dbit_flat_obj_next<K>;
+	it->vtable.prev    = dbit_flat_obj_prev<K>;
+	it->vtable.exists  = dbit_flat_obj_exists<K>;
+	it->vtable.remove  = dbit_flat_obj_remove<K>;
+	it->vtable.destroy = dbit_flat_obj_destroy<K>;
+	/* Initial state (before the first entry) */
+	it->db = self;
+	it->pos = -1;
+	/* Lock the database */
+	db_flat_lock(db);
+	return &it->vtable;
+}
+
+/**
+ * Returns true if the entry exists.
+ * @see DBMap#exists
+ */
+template <typename K> static bool db_flat_obj_exists(DBMap* self, DBKey key)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+
+	DB_COUNTSTAT(db_exists);
+	if (db == NULL) return false; // nullpo candidate
+
+	return db_flat_find_item(db, db_flat_key<K>(key)) >= 0;
+}
+
+/**
+ * Get the data of the entry identified by the key.
+ * @see DBMap#get
+ */
+template <typename K> static DBData* db_flat_obj_get(DBMap* self, DBKey key)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+	int64 slot;
+
+	DB_COUNTSTAT(db_get);
+	if (db == NULL) return NULL; // nullpo candidate
+
+	slot = db_flat_find_item(db, db_flat_key<K>(key));
+	if( slot < 0 )
+		return NULL;
+	return &db_flat_entry(db, db->slots[slot].entry)->data;
+}
+
+/**
+ * Get the data of the entries matched by <code>match</code>.
+ * @see DBMap#vgetall
+ */
+template <typename K> static unsigned int db_flat_obj_vgetall(DBMap* self, DBData **buf, unsigned int max, DBMatcher match, va_list args)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+	unsigned int ret = 0;
+	uint32 i;
+
+	DB_COUNTSTAT(db_vgetall);
+	if (db == NULL) return 0; // nullpo candidate
+	if (match == NULL) return 0; // nullpo candidate
+
+	db_flat_lock(db);
+	for( i = 0; i < db->entry_count; i++ ){
+		DBFlatEntry<K> *entry = db_flat_entry(db, i);
+		va_list argscopy;
+
+		if( entry->deleted )
+			continue;
+
+		va_copy(argscopy, args);
+		if (match(db_flat_dbkey(entry->key), entry->data, argscopy) == 0) {
+			if (buf && ret < max)
+				buf[ret] = &entry->data;
+			ret++;
+		}
+		va_end(argscopy);
+	}
+	db_flat_unlock(db);
+	return ret;
+}
+
+/**
+ * Get the data of the entry identified by the key, creating it if it does
+ * not exist yet.
+ * @see DBMap#vensure
+ */
+template <typename K> static DBData* db_flat_obj_vensure(DBMap* self, DBKey key, DBCreateData create, va_list args)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+	DBFlatEntry<K> *entry;
+	K k = db_flat_key<K>(key);
+	int64 slot;
+	uint32 index;
+	va_list argscopy;
+
+	DB_COUNTSTAT(db_vensure);
+	if (db == NULL) return NULL; // nullpo candidate
+	if (create == NULL) {
+		ShowError("db_ensure: Create function is NULL for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return NULL; // nullpo candidate
+	}
+
+	slot = db_flat_find(db, k);
+	if( slot >= 0 && !db_flat_entry(db, db->slots[slot].entry)->deleted )
+		return &db_flat_entry(db, db->slots[slot].entry)->data;
+
+	if (db->item_count == UINT32_MAX) {
+		ShowError("db_vensure: item_count overflow, aborting item insertion.\n"
+				"Database allocated at %s:%d",
+				db->alloc_file, db->alloc_line);
+		return NULL;
+	}
+
+	if( slot >= 0 ) // removed while locked
+		entry = db_flat_entry_revive(db, (uint32)slot);
+	else{
+		index = db_flat_entry_alloc(db, k);
+		db_flat_insert_slot(db, k, index);
+		entry = db_flat_entry(db, index);
+	}
+	// Entries never move, so the creator may use the database meanwhile
+	va_copy(argscopy, args);
+	entry->data = create(key, argscopy);
+	va_end(argscopy);
+	return &entry->data;
+}
+
+/**
+ * Put the data identified by the key in the database.
+ * Puts the previous data in out_data, if out_data is not NULL. (unless data has been released)
+ * @see DBMap#put
+ */
+template <typename K> static int db_flat_obj_put(DBMap* self, DBKey key, DBData data, DBData *out_data)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+	DBFlatEntry<K> *entry;
+	K k = db_flat_key<K>(key);
+	int64 slot;
+	int retval = 0;
+
+	DB_COUNTSTAT(db_put);
+	if (db == NULL) return 0; // nullpo candidate
+	if (db->global_lock) {
+		ShowError("db_put: Database is being destroyed, aborting entry insertion.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+	if (!(db->options&DB_OPT_ALLOW_NULL_DATA) && (data.type == DB_DATA_PTR && data.u.ptr == NULL)) {
+		ShowError("db_put: Attempted to use non-allowed NULL data for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+
+	slot = db_flat_find(db, k);
+	if( slot >= 0 && !db_flat_entry(db, db->slots[slot].entry)->deleted ){ // equal entry, replace
+		entry = db_flat_entry(db, db->slots[slot].entry);
+		db->release(db_flat_dbkey(entry->key), entry->data, DB_RELEASE_BOTH);
+		if (out_data)
+			memcpy(out_data, &entry->data, sizeof(*out_data));
+		retval = 1;
+	}else{
+		if (db->item_count == UINT32_MAX) {
+			ShowError("db_put: item_count overflow, aborting item insertion.\n"
+					"Database allocated at %s:%d",
+					db->alloc_file, db->alloc_line);
+			return 0;
+		}
+		if( slot >= 0 ) // removed while locked
+			entry = db_flat_entry_revive(db, (uint32)slot);
+		else{
+			uint32 index = db_flat_entry_alloc(db, k);
+
+			db_flat_insert_slot(db, k, index);
+			entry = db_flat_entry(db, index);
+		}
+	}
+	entry->data = data;
+	return retval;
+}
+
+/**
+ * Remove an entry from the database.
+ * Puts the previous data in out_data, if out_data is not NULL. (unless data has been released)
+ * @see DBMap#remove
+ */
+template <typename K> static int db_flat_obj_remove(DBMap* self, DBKey key, DBData *out_data)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+	int64 slot;
+
+	DB_COUNTSTAT(db_remove);
+	if (db == NULL) return 0; // nullpo candidate
+	if (db->global_lock) {
+		ShowError("db_remove: Database is being destroyed. Aborting entry deletion.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+
+	slot = db_flat_find_item(db, db_flat_key<K>(key));
+	if( slot < 0 )
+		return 0;
+	db_flat_remove_slot(db, (uint32)slot, out_data);
+	return 1;
+}
+
+/**
+ * Apply <code>func</code> to every entry in the database.
+ * @see DBMap#vforeach
+ */
+template <typename K> static int db_flat_obj_vforeach(DBMap* self, DBApply func, va_list args)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+	int sum = 0;
+	uint32 i;
+
+	DB_COUNTSTAT(db_vforeach);
+	if (db == NULL) return 0; // nullpo candidate
+	if (func == NULL) {
+		ShowError("db_foreach: Passed function is NULL for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+
+	db_flat_lock(db);
+	for( i = 0; i < db->entry_count; i++ ){
+		DBFlatEntry<K> *entry = db_flat_entry(db, i);
+
+		if( !entry->deleted ){
+			va_list argscopy;
+			va_copy(argscopy, args);
+			sum += func(db_flat_dbkey(entry->key), &entry->data, argscopy);
+			va_end(argscopy);
+		}
+	}
+	db_flat_unlock(db);
+	return sum;
+}
+
+/**
+ * Removes all entries from the database.
+ * The index and the chunks of entries are kept for reuse.
+ * @see DBMap#vclear
+ */
+template <typename K> static int db_flat_obj_vclear(DBMap* self, DBApply func, va_list args)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+	int sum = 0;
+	uint32 i;
+
+	DB_COUNTSTAT(db_vclear);
+	if (db == NULL) return 0; // nullpo candidate
+
+	db_flat_lock(db);
+	for( i = 0; i < db->entry_count; i++ ){
+		DBFlatEntry<K> *entry = db_flat_entry(db, i);
+
+		if( entry->deleted )
+			continue;
+		if (func)
+		{
+			va_list argscopy;
+			va_copy(argscopy, args);
+			sum += func(db_flat_dbkey(entry->key), &entry->data, argscopy);
+			va_end(argscopy);
+		}
+		db->release(db_flat_dbkey(entry->key), entry->data, DB_RELEASE_BOTH);
+		entry->deleted = true;
+	}
+	if( db->ctrl != NULL ){
+		uint32 capacity = ( db->group_mask + 1 ) * FLAT_GROUP_SIZE;
+
+		memset(db->ctrl, FLAT_CTRL_EMPTY, capacity);
+		db->growth_left = capacity - capacity / 8;
+	}
+	db->entry_count = 0;
+	db->free_head = FLAT_ENTRY_NONE;
+	db->pending_head = FLAT_ENTRY_NONE;
+	db->pending_count = 0;
+	db->item_count = 0;
+	db_flat_unlock(db);
+	return sum;
+}
+
+/**
+ * Finalize the database, feeing all the memory it uses.
+ * @see DBMap#vdestroy
+ */
+template <typename K> static int db_flat_obj_vdestroy(DBMap* self, DBApply func, va_list args)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+	int sum;
+	uint32 i;
+
+	DB_COUNTSTAT(db_vdestroy);
+	if (db == NULL) return 0; // nullpo candidate
+	if (db->global_lock) {
+		ShowError("db_vdestroy: Database is already locked for destruction. Aborting second database destruction.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		return 0;
+	}
+	if (db->free_lock)
+		ShowWarning("db_vdestroy: Database is still in use, %u lock(s) left. Continuing database destruction.\n"
+				"Database allocated at %s:%d\n",
+				db->free_lock, db->alloc_file, db->alloc_line);
+
+	db->global_lock = 1;
+	sum = self->vclear(self, func, args);
+	if( db->ctrl != NULL ){
+		aFree(db->ctrl);
+		aFree(db->slots);
+	}
+	for( i = 0; i < db->chunk_count; i++ )
+		aFree(db->chunks[i]);
+	if( db->chunks != NULL )
+		aFree(db->chunks);
+	aFree(db);
+	return sum;
+}
+
+/**
+ * Return the size of the database (number of items in the database).
+ * @see DBMap#size
+ */
+template <typename K> static unsigned int db_flat_obj_size(DBMap* self)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+
+	DB_COUNTSTAT(db_size);
+	if (db == NULL) return 0; // nullpo candidate
+
+	return db->item_count;
+}
+
+/**
+ * Return the type of the database.
+ * @see DBMap#type
+ */
+template <typename K> static DBType db_flat_obj_type(DBMap* self)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+
+	DB_COUNTSTAT(db_type);
+	if (db == NULL) return (DBType)-1; // nullpo candidate
+
+	return db->type;
+}
+
+/**
+ * Return the options of the database.
+ * @see DBMap#options
+ */
+template <typename K> static DBOptions db_flat_obj_options(DBMap* self)
+{
+	DBFlatMap_impl<K>* db = (DBFlatMap_impl<K>*)self;
+
+	DB_COUNTSTAT(db_options);
+	if (db == NULL) return DB_OPT_BASE; // nullpo candidate
+
+	return db->options;
+}
+
+/**
+ * Allocates a flat database with keys of type K.
+ * The functions that only forward their variable arguments are shared with
+ * the default databases.
+ * @private
+ * @see #db_flat_alloc(const char*,const char*,int,DBType,DBOptions)
+ */
+template <typename K> static DBMap* db_flat_alloc_type(const char *file, int line, DBType type, DBOptions options)
+{
+	DBFlatMap_impl<K>* db;
+
+	CREATE(db, DBFlatMap_impl<K>, 1);
+	/* Interface of the database */
+	db->vtable.iterator = db_flat_obj_iterator<K>;
+	db->vtable.exists   = db_flat_obj_exists<K>;
+	db->vtable.get      = db_flat_obj_get<K>;
+	db->vtable.getall   = db_obj_getall;
+	db->vtable.vgetall  = db_flat_obj_vgetall<K>;
+	db->vtable.ensure   = db_obj_ensure;
+	db->vtable.vensure  = db_flat_obj_vensure<K>;
+	db->vtable.put      = db_flat_obj_put<K>;
+	db->vtable.remove   = db_flat_obj_remove<K>;
+	db->vtable.foreach  = db_obj_foreach;
+	db->vtable.vforeach = db_flat_obj_vforeach<K>;
+	db->vtable.clear    = db_obj_clear;
+	db->vtable.vclear   = db_flat_obj_vclear<K>;
+	db->vtable.destroy  = db_obj_destroy;
+	db->vtable.vdestroy = db_flat_obj_vdestroy<K>;
+	db->vtable.size     = db_flat_obj_size<K>;
+	db->vtable.type     = db_flat_obj_type<K>;
+	db->vtable.options  = db_flat_obj_options<K>;
+	/* File and line of allocation */
+	db->alloc_file = file;
+	db->alloc_line = line;
+	/* Lock system */
+	db->free_lock = 0;
+	/* Index, allocated with the first entry */
+	db->ctrl = NULL;
+	db->slots = NULL;
+	db->group_mask = 0;
+	db->growth_left = 0;
+	/* Entries */
+	db->chunks = NULL;
+	db->chunk_count = 0;
+	db->entry_count = 0;
+	db->free_head = FLAT_ENTRY_NONE;
+	db->pending_head = FLAT_ENTRY_NONE;
+	db->pending_count = 0;
+	/* Other */
+	db->release = db_default_release(type, options);
+	db->type = type;
+	db->options = options;
+	db->item_count = 0;
+	db->global_lock = 0;
+
+	return &db->vtable;
+}
+
+/*****************************************************************************\
+ *  (5) Section with public functions.
+ *  db_fix_options     - Apply database type restrictions to the options.
+ *  db_default_cmp     - Get the default comparator for a type of database.
+ *  db_default_hash    - Get the default hasher for a type of database.
+ *  db_default_release - Get the default releaser for a type of database with the specified options.
+ *  db_custom_release  - Get a releaser that behaves a certain way.
+ *  db_alloc           - Allocate a new database.
+ *  db_flat_alloc      - Allocate a new flat database for integer keys.
+ *  db_i2key           - Manual cast from 'int' to 'DBKey'.
+ *  db_ui2key          - Manual cast from 'unsigned int' to 'DBKey'.
+ *  db_str2key         - Manual cast from 'unsigned char *' to 'DBKey'.
+ *  db_i642key         - Manual cast from 'int64' to 'DBKey'.
+ *  db_ui642key        - Manual cast from 'uin64' to 'DBKey'.
+ *  db_i2data          - Manual cast from 'int' to 'DBData'.
+ *  db_ui2data         - Manual cast from 'unsigned int' to 'DBData'.
+ *  db_ptr2data        - Manual cast from 'void*' to 'DBData'.
+ *  db_data2i          - Gets 'int' value from 'DBData'.
+ *  db_data2ui         - Gets 'unsigned int' value from 'DBData'.
+ *  db_data2ptr        - Gets 'void*' value from 'DBData'.
+ *  db_init            - Initializes the database system.
+ *  db_final           - Finalizes the database system.
+\*****************************************************************************/
+
+/**
+ * Returns the fixed options according to the database type.
+ * Sets required options and unsets unsupported options.
+ * For numeric databases DB_OPT_DUP_KEY and DB_OPT_RELEASE_KEY are unset.
+ * @param type Type of the database
+ * @param options Original options of the database
+ * @return Fixed options of the database
+ * @private
+ * @see #db_default_release(DBType,DBOptions)
+ * @see #db_alloc(const char *,int,DBType,DBOptions,unsigned short)
+ */
+DBOptions db_fix_options(DBType type, DBOptions options)
+{
+	DB_COUNTSTAT(db_fix_options);
+	switch (type) {
+		case DB_INT:
+		case DB_UINT:
+		case DB_INT64:
+		case DB_UINT64: // Numeric database, do nothing with the keys
+			return (DBOptions)(options&~(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY));
+
+		default:
+			ShowError("db_fix_options: Unknown database type %u with options %x\n", type, options);
+		case DB_STRING:
+		case DB_ISTRING: // String databases, no fix required
+			return options;
+	}
+}
+
+/**
+ * Returns the default comparator for the specified type of database.
+ * @param type Type of database
+ * @return Comparator for the type of database or NULL if unknown database
+ * @public
+ * @see #db_int_cmp(DBKey,DBKey,unsigned short)
+ * @see #db_uint_cmp(DBKey,DBKey,unsigned short)
+ * @see #db_string_cmp(DBKey,DBKey,unsigned short)
+ * @see #db_istring_cmp(DBKey,DBKey,unsigned short)
+ * @see #db_int64_cmp(DBKey,DBKey,unsigned short)
+ * @see #db_uint64_cmp(DBKey,DBKey,unsigned short)
+ */
+DBComparator db_default_cmp(DBType type)
+{
+	DB_COUNTSTAT(db_default_cmp);
+	switch (type) {
+		case DB_INT:     return &db_int_cmp;
+		case DB_UINT:    return &db_uint_cmp;
+		case DB_STRING:  return &db_string_cmp;
+		case DB_ISTRING: return &db_istring_cmp;
+		case DB_INT64:   return &db_int64_cmp;
+		case DB_UINT64:  return &db_uint64_cmp;
+		default:
+			ShowError("db_default_cmp: Unknown database type %u\n", type);
+			return NULL;
+	}
+}
+
+/**
+ * Returns the default hasher for the specified type of database.
+ * @param type Type of database
+ * @return Hasher of the type of database or NULL if unknown database
+ * @public
+ * @see #db_int_hash(DBKey,unsigned short)
+ * @see #db_uint_hash(DBKey,unsigned short)
+ * @see #db_string_hash(DBKey,unsigned short)
+ * @see #db_istring_hash(DBKey,unsigned short)
+ * @see #db_int64_hash(DBKey,unsigned short)
+ * @see #db_uint64_hash(DBKey,unsigned short)
+ */
+DBHasher db_default_hash(DBType type)
+{
+	DB_COUNTSTAT(db_default_hash);
+	switch (type) {
+		case DB_INT:     return &db_int_hash;
+		case DB_UINT:    return &db_uint_hash;
+		case DB_STRING:  return &db_string_hash;
+		case DB_ISTRING: return &db_istring_hash;
+		case DB_INT64:   return &db_int64_hash;
+		case DB_UINT64:  return &db_uint64_hash;
+		default:
+			ShowError("db_default_hash: Unknown database type %u\n", type);
+			return NULL;
+	}
+}
+
+/**
+ * Returns the default releaser for the specified type of database with the
+ * specified options.
+ * NOTE: the options are fixed with {@link #db_fix_options(DBType,DBOptions)}
+ * before choosing the releaser.
+ * @param type Type of database
+ * @param options Options of the database
+ * @return Default releaser for the type of database with the specified options
+ * @public
+ * @see #db_release_nothing(DBKey,DBData,DBRelease)
+ * @see #db_release_key(DBKey,DBData,DBRelease)
+ * @see #db_release_data(DBKey,DBData,DBRelease)
+ * @see #db_release_both(DBKey,DBData,DBRelease)
+ * @see #db_custom_release(DBRelease)
+ */
+DBReleaser db_default_release(DBType type, DBOptions options)
+{
+	DB_COUNTSTAT(db_default_release);
+	options = db_fix_options(type, options);
+	if (options&DB_OPT_RELEASE_DATA) { // Release data, what about the key?
+		if (options&(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY))
+			return &db_release_both; // Release both key and data
+		return &db_release_data; // Only release data
+	}
+	if (options&(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY))
+		return &db_release_key; // Only release key
+	return &db_release_nothing; // Release nothing
+}
+
+/**
+ * Returns the releaser that releases the specified release options.
+ * @param which Options that specified what the releaser releases
+ * @return Releaser for the specified release options
+ * @public
+ * @see #db_release_nothing(DBKey,DBData,DBRelease)
+ * @see #db_release_key(DBKey,DBData,DBRelease)
+ * @see #db_release_data(DBKey,DBData,DBRelease)
+ * @see #db_release_both(DBKey,DBData,DBRelease)
+ * @see #db_default_release(DBType,DBOptions)
+ */
+DBReleaser db_custom_release(DBRelease which)
+{
+	DB_COUNTSTAT(db_custom_release);
+	switch (which) {
+		case DB_RELEASE_NOTHING: return &db_release_nothing;
+		case DB_RELEASE_KEY:     return &db_release_key;
+		case DB_RELEASE_DATA:    return &db_release_data;
+		case DB_RELEASE_BOTH:    return &db_release_both;
+		default:
+			ShowError("db_custom_release: Unknown release options %u\n", which);
+			return NULL;
+	}
+}
+
+/**
+ * Allocate a new database of the specified type.
+ * NOTE: the options are fixed by {@link #db_fix_options(DBType,DBOptions)}
+ * before creating the database.
+ * @param file File where the database is being allocated
+ * @param line Line of the file where the database is being allocated
+ * @param type Type of database
+ * @param options Options of the database
+ * @param maxlen Maximum length of the string to be used as key in string
+ *          databases. If 0, the maximum number of maxlen is used (64K).
+ * @return The interface of the database
+ * @public
+ * @see #DBMap_impl
+ * @see #db_fix_options(DBType,DBOptions)
+ */
 DBMap* db_alloc(const char *file, const char *func, int line, DBType type, DBOptions options, unsigned short maxlen) {
 	DBMap_impl* db;
 	unsigned int i;
@@ -2584,6 +3671,44 @@ DBMap* db_alloc(const char *file, const char *func, int line, DBType type, DBOpt
 	return &db->vtable;
 }
 
+/**
+ * Allocate a new flat database of the specified type.
+ * Only integer keys are supported, other types get a default database.
+ * NOTE: the options are fixed by {@link #db_fix_options(DBType,DBOptions)}
+ * before creating the database.
+ * @param file File where the database is being allocated
+ * @param line Line of the file where the database is being allocated
+ * @param type Type of database
+ * @param options Options of the database
+ * @return The interface of the database
+ * @public
+ * @see #DBFlatMap_impl
+ * @see #db_alloc(const char*,const char*,int,DBType,DBOptions,unsigned short)
+ */
+DBMap* db_flat_alloc(const char *file, const char *func, int line, DBType type, DBOptions options) {
+#ifdef DB_ENABLE_STATS
+	DB_COUNTSTAT(db_alloc);
+	switch (type) {
+		case DB_INT: DB_COUNTSTAT(db_int_alloc); break;
+		case DB_UINT: DB_COUNTSTAT(db_uint_alloc); break;
+		case DB_INT64: DB_COUNTSTAT(db_int64_alloc); break;
+		case DB_UINT64: DB_COUNTSTAT(db_uint64_alloc); break;
+		default: break;
+	}
+#endif /* DB_ENABLE_STATS */
+	options = db_fix_options(type, options);
+
+	switch (type) {
+		case DB_INT: return db_flat_alloc_type<int>(file, line, type, options);
+		case DB_UINT: return db_flat_alloc_type<unsigned int>(file, line, type, options);
+		case DB_INT64: return db_flat_alloc_type<int64>(file, line, type, options);
+		case DB_UINT64: return db_flat_alloc_type<uint64>(file, line, type, options);
+		default:
+			ShowError("db_flat_alloc: Unsupported key type %d for db allocated at %s:%d, using a default database.\n", type, file, line);
+			return db_alloc(file, func, line, type, options, 0);
+	}
+}
+
 /**
  * Manual cast from 'int' to the union DBKey.
  * @param key Key to be casted
@@ -2793,6 +3918,8 @@ void db_init(void) {
 	db_alloc_ers = ers_new(sizeof(struct DBMap_impl),"db.cpp::db_alloc_ers",ERS_CACHE_OPTIONS);
 	ers_chunk_size(db_alloc_ers, 50);
 	ers_chunk_size(db_iterator_ers, 10);
+	db_flat_iterator_ers = ers_new(sizeof(struct DBFlatIterator_impl),"db.cpp::db_flat_iterator_ers",ERS_CACHE_OPTIONS);
+	ers_chunk_size(db_flat_iterator_ers, 10);
 	DB_COUNTSTAT(db_init);
 }
 
@@ -2897,6 +4024,7 @@ void db_final(void)
 #endif /* DB_ENABLE_STATS */
 	ers_destroy(db_iterator_ers);
 	ers_destroy(db_alloc_ers);
+	ers_destroy(db_flat_iterator_ers);
 }
 
 // Link DB System - jAthena
@@ -705,6 +705,10 @@ struct DBMap {
 #define stridb_alloc(opt,maxlen)  db_alloc(__FILE__,__func__,__LINE__,DB_ISTRING,(opt),(maxlen))
 #define i64db_alloc(opt)          db_alloc(__FILE__,__func__,__LINE__,DB_INT64,(opt),sizeof(int64))
 #define ui64db_alloc(opt)         db_alloc(__FILE__,__func__,__LINE__,DB_UINT64,(opt),sizeof(uint64))
+#define idb_flat_alloc(opt)       db_flat_alloc(__FILE__,__func__,__LINE__,DB_INT,(opt))
+#define uidb_flat_alloc(opt)      db_flat_alloc(__FILE__,__func__,__LINE__,DB_UINT,(opt))
+#define i64db_flat_alloc(opt)     db_flat_alloc(__FILE__,__func__,__LINE__,DB_INT64,(opt))
+#define ui64db_flat_alloc(opt)    db_flat_alloc(__FILE__,__func__,__LINE__,DB_UINT64,(opt))
 #define db_destroy(db)            ( (db)->destroy((db),NULL) )
 // Other macros
 #define db_clear(db)        ( (db)->clear((db),NULL) )
@@ -727,6 +731,7 @@ struct DBMap {
  *           with the fixed options.                                         *
  *  db_custom_release  - Get the releaser that behaves as specified.         *
  *  db_alloc           - Allocate a new database.                            *
+ *  db_flat_alloc      - Allocate a new flat database for integer keys.      *
  *  db_i2key           - Manual cast from 'int' to 'DBKey'.                  *
  *  db_ui2key          - Manual cast from 'unsigned int' to 'DBKey'.         *
  *  db_str2key         - Manual cast from 'unsigned char *' to 'DBKey'.      *
@@ -827,6 +832,23 @@ DBReleaser db_custom_release(DBRelease which);
  */
 DBMap* db_alloc(const char *file, const char *func, int line, DBType type, DBOptions options, unsigned short maxlen);
 
+/**
+ * Allocate a new flat database of the specified type.
+ * Same interface as {@link #db_alloc}, but the entries of integer keys are
+ * found through an open-addressing hashtable instead of the RED-BLACK trees,
+ * which is faster for large id databases that are mostly read.
+ * Iterators visit the entries in the order they were allocated in.
+ * Other key types fall back to {@link #db_alloc}.
+ * @param file File where the database is being allocated
+ * @param line Line of the file where the database is being allocated
+ * @param type Type of database
+ * @param options Options of the database
+ * @return The interface of the database
+ * @public
+ * @see #db_alloc(const char*,const char*,int,DBType,DBOptions,unsigned short)
+ */
+DBMap* db_flat_alloc(const char *file, const char *func, int line, DBType type, DBOptions options);
+
 /**
  * Manual cast from 'int' to the union DBKey.
  * @param key Key to be casted
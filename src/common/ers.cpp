@@ -28,11 +28,20 @@
  *    destroyed so memory will usually only be recovered near the end.       *
  *  - Always wastes space for entries smaller than a pointer.                *
  *                                                                           *
- *  WARNING: The system is not thread-safe at the moment.                    *
+ *  WARNING: The system is only thread-safe for managers created with       *
+ *           ERS_OPT_THREAD_SAFE, and only for allocating and freeing.       *
+ *                                                                           *
+ *  <H2>Thread-safe managers:</H2>                                           *
+ *  Each thread keeps two magazines (stacks of free entries) per cache and   *
+ *  allocates from and frees to them without synchronization. Full and      *
+ *  empty magazines are exchanged with a lock-free depot of the cache. Only  *
+ *  refilling magazines from the blocks of the cache takes its lock.        *
+ *  [Bonwick, "Magazines and Vmem"]                                          *
  *                                                                           *
  *  HISTORY:                                                                 *
  *    0.1 - Initial version                                                  *
  *    1.0 - ERS Rework                                                       *
+ *    1.1 - Thread-safe managers                                             *
  *                                                                           *
  * @version 1.0 - ERS Rework                                                 *
  * @author GreenBox @ rAthena Project                                        *
@@ -42,6 +51,8 @@
 
 #include "ers.hpp"
 
+#include <atomic>
+#include <mutex>
 #include <stdlib.h>
 #include <string.h>
 
@@ -54,6 +65,10 @@
 
 #define ERS_BLOCK_ENTRIES 2048
 
+#define ERS_MAGAZINE_SIZE 32 // Entries per magazine of a thread-safe cache
+#define ERS_MAGAZINE_MAX 1024 // Magazines per thread-safe cache, entries beyond those go back to the blocks
+#define ERS_THREAD_CACHES 32 // Maximum amount of thread-safe caches
+
 struct ers_list
 {
 	struct ers_list *Next;
@@ -61,6 +76,76 @@ struct ers_list
 
 struct ers_instance_t;
 
+/// Stack of free entries of a thread-safe cache, owned by a thread or stored in the depot
+struct ers_magazine
+{
+	// Index + 1 of the next magazine in a depot stack, 0 for none
+	std::atomic<uint32> Next;
+
+	// Entries in the magazine
+	uint32 Rounds;
+
+	struct ers_list *Entries[ERS_MAGAZINE_SIZE];
+};
+
+/// Lock-free stack of the magazines of a depot. [Treiber]
+/// The head holds a tag in the upper half, which changes on every update and prevents ABA.
+class ErsMagazineStack {
+private:
+	std::atomic<uint64> head; // tag << 32 | index + 1 of the top magazine
+
+public:
+	ErsMagazineStack(){
+		this->head.store( 0, std::memory_order_relaxed );
+	}
+
+	void push( struct ers_magazine *magazines, uint32 index ){
+		uint64 head = this->head.load( std::memory_order_relaxed );
+		uint64 top;
+
+		do{
+			magazines[index].Next.store( (uint32)head, std::memory_order_relaxed );
+			top = ( ( ( head >> 32 ) + 1 ) << 32 ) | ( index + 1 );
+		}while( !this->head.compare_exchange_weak( head, top, std::memory_order_release, std::memory_order_relaxed ) );
+	}
+
+	/// @return Index + 1 of the magazine, 0 if the stack is empty
+	uint32 pop( struct ers_magazine *magazines ){
+		uint64 head = this->head.load( std::memory_order_acquire );
+		uint64 top;
+
+		do{
+			if( (uint32)head == 0 )
+				return 0;
+
+			top = ( ( ( head >> 32 ) + 1 ) << 32 ) | magazines[(uint32)head - 1].Next.load( std::memory_order_relaxed );
+		}while( !this->head.compare_exchange_weak( head, top, std::memory_order_acquire, std::memory_order_acquire ) );
+
+		return (uint32)head;
+	}
+};
+
+/// Shared part of a thread-safe cache
+struct ers_depot
+{
+	// Index in ErsThreadCaches and in the per-thread slots
+	uint32 Slot;
+
+	// Tells the per-thread slots of this cache apart from those of a destroyed cache in the same slot
+	uint32 Serial;
+
+	struct ers_magazine *Magazines;
+
+	// Full and empty magazines that no thread owns
+	ErsMagazineStack Full, Empty;
+
+	// Guards the blocks, the reuse list and the free count of the cache
+	std::mutex Lock;
+
+	// Statistics, flushed by the threads whenever they exchange magazines
+	std::atomic<uint64> Allocs, Frees, MagazineHits, DepotHits;
+};
+
 typedef struct ers_cache
 {
 	// Allocated object size, including ers_list size
@@ -90,9 +175,18 @@ typedef struct ers_cache
 	// Default = ERS_BLOCK_ENTRIES, can be adjusted for performance for individual cache sizes.
 	unsigned int ChunkSize;
 
+	// Entries in all blocks
+	unsigned int Capacity;
+
+	// Allocations, and those that reused a freed entry (single-threaded caches only)
+	uint64 Allocs, Reuses;
+
 	// Misc options, some options are shared from the instance
 	enum ERSOptions Options;
 
+	// Magazines and statistics of thread-safe caches, NULL otherwise
+	struct ers_depot *Depot;
+
 	// Linked list
 	struct ers_cache *Next, *Prev;
 } ers_cache_t;
@@ -121,6 +215,44 @@ struct ers_instance_t {
 static ers_cache_t *CacheList = NULL;
 static struct ers_instance_t *InstanceList = NULL;
 
+/// Thread-safe caches by slot, the serial is 0 for free slots
+static struct {
+	std::atomic<uint32> Serial;
+	ers_cache_t *Cache;
+} ErsThreadCaches[ERS_THREAD_CACHES];
+
+static uint32 ErsThreadSerial = 0;
+
+/// Magazines of a thread for a thread-safe cache
+struct ers_thread_slot
+{
+	// Serial of the cache the magazines belong to
+	uint32 Serial;
+
+	// Index + 1 of the magazine to use first and of the spare one, 0 if none
+	uint32 Loaded, Previous;
+
+	// Statistics that were not flushed to the depot yet
+	uint64 Allocs, Frees, MagazineHits, DepotHits;
+};
+
+static void ers_thread_release(ers_cache_t *cache, struct ers_thread_slot *slot);
+
+/// Magazines of the current thread, returned to the depots when the thread ends
+struct ers_thread_state
+{
+	struct ers_thread_slot Slots[ERS_THREAD_CACHES];
+
+	~ers_thread_state(){
+		for( uint32 i = 0; i < ERS_THREAD_CACHES; i++ ){
+			if( this->Slots[i].Serial != 0 && this->Slots[i].Serial == ErsThreadCaches[i].Serial.load( std::memory_order_acquire ) )
+				ers_thread_release( ErsThreadCaches[i].Cache, &this->Slots[i] );
+		}
+	}
+};
+
+static thread_local struct ers_thread_state ErsThread;
+
 /**
  * @param Options the options from the instance seeking a cache, we use it to give it a cache with matching configuration
  **/
@@ -128,7 +260,7 @@ static ers_cache_t *ers_find_cache(unsigned int size, enum ERSOptions Options) {
 	ers_cache_t *cache;
 
 	for (cache = CacheList; cache; cache = cache->Next)
-		if ( cache->ObjectSize == size && cache->Options == ( Options & ERS_CACHE_OPTIONS ) )
+		if ( cache->ObjectSize == size && cache->Options == ( Options & ( ERS_CACHE_OPTIONS|ERS_OPT_THREAD_SAFE ) ) )
 			return cache;
 
 	CREATE(cache, ers_cache_t, 1);
@@ -141,7 +273,44 @@ static ers_cache_t *ers_find_cache(unsigned int size, enum ERSOptions Options) {
 	cache->UsedObjs = 0;
 	cache->Max = 0;
 	cache->ChunkSize = ERS_BLOCK_ENTRIES;
-	cache->Options = (enum ERSOptions)(Options & ERS_CACHE_OPTIONS);
+	cache->Options = (enum ERSOptions)(Options & ( ERS_CACHE_OPTIONS|ERS_OPT_THREAD_SAFE ));
+	cache->Depot = NULL;
+
+	if( cache->Options & ERS_OPT_THREAD_SAFE ){
+		uint32 i;
+
+		for (i = 0; i < ERS_THREAD_CACHES; i++)
+			if (ErsThreadCaches[i].Serial.load(std::memory_order_relaxed) == 0)
+				break;
+
+		if( i == ERS_THREAD_CACHES ){
+			ShowError("ers_find_cache: Too many thread-safe caches, using a single-threaded one for size '%u'.\n", size);
+			cache->Options = (enum ERSOptions)(cache->Options & ~ERS_OPT_THREAD_SAFE);
+		}else{
+			struct ers_depot *depot = new struct ers_depot;
+
+			depot->Slot = i;
+			depot->Serial = ++ErsThreadSerial;
+			// The memory manager is not thread-safe, the magazines and blocks of these caches use the system allocator
+			depot->Magazines = (struct ers_magazine *)calloc(ERS_MAGAZINE_MAX, sizeof(struct ers_magazine));
+			depot->Allocs = 0;
+			depot->Frees = 0;
+			depot->MagazineHits = 0;
+			depot->DepotHits = 0;
+
+			if( depot->Magazines == NULL ){
+				ShowFatalError("ers_find_cache: Out of memory!\n");
+				exit(EXIT_FAILURE);
+			}
+
+			for( uint32 j = ERS_MAGAZINE_MAX; j > 0; j-- )
+				depot->Empty.push(depot->Magazines, j - 1);
+
+			cache->Depot = depot;
+			ErsThreadCaches[i].Cache = cache;
+			ErsThreadCaches[i].Serial.store(depot->Serial, std::memory_order_release);
+		}
+	}
 
 	if (CacheList == NULL)
 	{
@@ -162,8 +331,21 @@ static void ers_free_cache(ers_cache_t *cache, bool remove)
 {
 	unsigned int i;
 
-	for (i = 0; i < cache->Used; i++)
-		aFree(cache->Blocks[i]);
+	if (cache->Depot) {
+		ErsThreadCaches[cache->Depot->Slot].Serial.store(0, std::memory_order_release);
+
+		for (i = 0; i < cache->Used; i++)
+			free(cache->Blocks[i]);
+
+		free(cache->Blocks);
+		free(cache->Depot->Magazines);
+		delete cache->Depot;
+	} else {
+		for (i = 0; i < cache->Used; i++)
+			aFree(cache->Blocks[i]);
+
+		aFree(cache->Blocks);
+	}
 
 	if (cache->Next)
 		cache->Next->Prev = cache->Prev;
@@ -173,11 +355,209 @@ static void ers_free_cache(ers_cache_t *cache, bool remove)
 	else
 		CacheList = cache->Next;
 
-	aFree(cache->Blocks);
-
 	aFree(cache);
 }
 
+/**
+ * Takes an entry from the reuse list or the blocks of a thread-safe cache.
+ * The lock of the depot must be held.
+ **/
+static struct ers_list *ers_slab_alloc(ers_cache_t *cache)
+{
+	struct ers_list *entry;
+
+	if (cache->ReuseList != NULL) {
+		entry = cache->ReuseList;
+		cache->ReuseList = entry->Next;
+		return entry;
+	}
+
+	if (cache->Free == 0) {
+		if (cache->Used == cache->Max) {
+			unsigned char **blocks = (unsigned char **)realloc(cache->Blocks, ((cache->Max * 4) + 3) * sizeof(unsigned char *));
+
+			if (blocks == NULL)
+				return NULL;
+
+			cache->Blocks = blocks;
+			cache->Max = (cache->Max * 4) + 3;
+		}
+
+		if ((cache->Blocks[cache->Used] = (unsigned char *)calloc(cache->ChunkSize, cache->ObjectSize)) == NULL)
+			return NULL;
+
+		cache->Used++;
+		cache->Free = cache->ChunkSize;
+		cache->Capacity += cache->ChunkSize;
+	}
+
+	cache->Free--;
+	return (struct ers_list *)&cache->Blocks[cache->Used - 1][cache->Free * cache->ObjectSize];
+}
+
+/// Flushes the statistics of a thread to the depot
+static void ers_thread_flush(struct ers_depot *depot, struct ers_thread_slot *slot)
+{
+	depot->Allocs.fetch_add(slot->Allocs, std::memory_order_relaxed);
+	depot->Frees.fetch_add(slot->Frees, std::memory_order_relaxed);
+	depot->MagazineHits.fetch_add(slot->MagazineHits, std::memory_order_relaxed);
+	depot->DepotHits.fetch_add(slot->DepotHits, std::memory_order_relaxed);
+	slot->Allocs = slot->Frees = slot->MagazineHits = slot->DepotHits = 0;
+}
+
+/// Returns the magazine of a thread to the depot, its entries go back to the blocks unless it is full
+static void ers_thread_return(ers_cache_t *cache, uint32 index)
+{
+	struct ers_depot *depot = cache->Depot;
+	struct ers_magazine *magazine = &depot->Magazines[index - 1];
+
+	if (magazine->Rounds == ERS_MAGAZINE_SIZE) {
+		depot->Full.push(depot->Magazines, index - 1);
+		return;
+	}
+
+	if (magazine->Rounds > 0) {
+		std::lock_guard<std::mutex> lock(depot->Lock);
+
+		while (magazine->Rounds > 0) {
+			struct ers_list *entry = magazine->Entries[--magazine->Rounds];
+
+			entry->Next = cache->ReuseList;
+			cache->ReuseList = entry;
+		}
+	}
+
+	depot->Empty.push(depot->Magazines, index - 1);
+}
+
+/// Returns all magazines of a thread to the depot
+static void ers_thread_release(ers_cache_t *cache, struct ers_thread_slot *slot)
+{
+	ers_thread_flush(cache->Depot, slot);
+
+	if (slot->Loaded)
+		ers_thread_return(cache, slot->Loaded);
+	if (slot->Previous)
+		ers_thread_return(cache, slot->Previous);
+
+	slot->Loaded = slot->Previous = 0;
+	slot->Serial = 0;
+}
+
+/// Returns the magazines of the current thread for a thread-safe cache
+static struct ers_thread_slot *ers_thread_slot(ers_cache_t *cache)
+{
+	struct ers_thread_slot *slot = &ErsThread.Slots[cache->Depot->Slot];
+
+	if (slot->Serial != cache->Depot->Serial) { // Left over from a destroyed cache, its magazines are gone
+		memset(slot, 0, sizeof(*slot));
+		slot->Serial = cache->Depot->Serial;
+	}
+
+	return slot;
+}
+
+static struct ers_list *ers_thread_alloc(ers_cache_t *cache)
+{
+	struct ers_depot *depot = cache->Depot;
+	struct ers_thread_slot *slot = ers_thread_slot(cache);
+	struct ers_magazine *magazine;
+	struct ers_list *entry = NULL;
+	uint32 index;
+
+	slot->Allocs++;
+
+	if (slot->Loaded && depot->Magazines[slot->Loaded - 1].Rounds > 0) {
+		magazine = &depot->Magazines[slot->Loaded - 1];
+		slot->MagazineHits++;
+		return magazine->Entries[--magazine->Rounds];
+	}
+
+	if (slot->Previous && depot->Magazines[slot->Previous - 1].Rounds > 0) { // The spare one is full
+		SWAP(slot->Loaded, slot->Previous);
+		magazine = &depot->Magazines[slot->Loaded - 1];
+		slot->MagazineHits++;
+		return magazine->Entries[--magazine->Rounds];
+	}
+
+	// Both are empty, trade one for a full magazine of the depot
+	ers_thread_flush(depot, slot);
+
+	if ((index = depot->Full.pop(depot->Magazines)) != 0) {
+		if (slot->Previous)
+			depot->Empty.push(depot->Magazines, slot->Previous - 1);
+		slot->Previous = slot->Loaded;
+		slot->Loaded = index;
+		slot->DepotHits++;
+		magazine = &depot->Magazines[index - 1];
+		return magazine->Entries[--magazine->Rounds];
+	}
+
+	// The depot is empty too, fill the loaded magazine from the blocks
+	if (slot->Loaded == 0)
+		slot->Loaded = depot->Empty.pop(depot->Magazines);
+
+	std::lock_guard<std::mutex> lock(depot->Lock);
+
+	if (slot->Loaded) {
+		magazine = &depot->Magazines[slot->Loaded - 1];
+
+		while (magazine->Rounds < ERS_MAGAZINE_SIZE - 1 && (entry = ers_slab_alloc(cache)) != NULL)
+			magazine->Entries[magazine->Rounds++] = entry;
+	}
+
+	entry = ers_slab_alloc(cache);
+
+	if (entry == NULL) {
+		ShowFatalError("ers_obj_alloc_entry: Out of memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return entry;
+}
+
+static void ers_thread_free(ers_cache_t *cache, struct ers_list *entry)
+{
+	struct ers_depot *depot = cache->Depot;
+	struct ers_thread_slot *slot = ers_thread_slot(cache);
+	struct ers_magazine *magazine;
+	uint32 index;
+
+	slot->Frees++;
+
+	if (slot->Loaded && depot->Magazines[slot->Loaded - 1].Rounds < ERS_MAGAZINE_SIZE) {
+		magazine = &depot->Magazines[slot->Loaded - 1];
+		magazine->Entries[magazine->Rounds++] = entry;
+		return;
+	}
+
+	if (slot->Previous && depot->Magazines[slot->Previous - 1].Rounds < ERS_MAGAZINE_SIZE) { // The spare one is empty
+		SWAP(slot->Loaded, slot->Previous);
+		magazine = &depot->Magazines[slot->Loaded - 1];
+		magazine->Entries[magazine->Rounds++] = entry;
+		return;
+	}
+
+	// Both are full, hand one to the depot and continue with an empty magazine
+	ers_thread_flush(depot, slot);
+
+	if ((index = depot->Empty.pop(depot->Magazines)) != 0) {
+		if (slot->Previous)
+			depot->Full.push(depot->Magazines, slot->Previous - 1);
+		slot->Previous = slot->Loaded;
+		slot->Loaded = index;
+		magazine = &depot->Magazines[index - 1];
+		magazine->Entries[magazine->Rounds++] = entry;
+		return;
+	}
+
+	// No magazine left, the entry goes back to the blocks
+	std::lock_guard<std::mutex> lock(depot->Lock);
+
+	entry->Next = cache->ReuseList;
+	cache->ReuseList = entry;
+}
+
 static void *ers_obj_alloc_entry(ERS *self)
 {
 	struct ers_instance_t *instance = (struct ers_instance_t *)self;
@@ -188,9 +568,15 @@ static void *ers_obj_alloc_entry(ERS *self)
 		return NULL;
 	}
 
+	if (instance->Cache->Depot)
+		return (void *)((unsigned char *)ers_thread_alloc(instance->Cache) + sizeof(struct ers_list));
+
+	instance->Cache->Allocs++;
+
 	if (instance->Cache->ReuseList != NULL) {
 		ret = (void *)((unsigned char *)instance->Cache->ReuseList + sizeof(struct ers_list));
 		instance->Cache->ReuseList = instance->Cache->ReuseList->Next;
+		instance->Cache->Reuses++;
 	} else if (instance->Cache->Free > 0) {
 		instance->Cache->Free--;
 		ret = &instance->Cache->Blocks[instance->Cache->Used - 1][instance->Cache->Free * instance->Cache->ObjectSize + sizeof(struct ers_list)];
@@ -202,6 +588,7 @@ static void *ers_obj_alloc_entry(ERS *self)
 
 		CREATE(instance->Cache->Blocks[instance->Cache->Used], unsigned char, instance->Cache->ObjectSize * instance->Cache->ChunkSize);
 		instance->Cache->Used++;
+		instance->Cache->Capacity += instance->Cache->ChunkSize;
 
 		instance->Cache->Free = instance->Cache->ChunkSize -1;
 		ret = &instance->Cache->Blocks[instance->Cache->Used - 1][instance->Cache->Free * instance->Cache->ObjectSize + sizeof(struct ers_list)];
@@ -229,6 +616,11 @@ static void ers_obj_free_entry(ERS *self, void *entry)
 	if( instance->Cache->Options & ERS_OPT_CLEAN )
 		memset((unsigned char*)reuse + sizeof(struct ers_list), 0, instance->Cache->ObjectSize - sizeof(struct ers_list));
 
+	if (instance->Cache->Depot) {
+		ers_thread_free(instance->Cache, reuse);
+		return;
+	}
+
 	reuse->Next = instance->Cache->ReuseList;
 	instance->Cache->ReuseList = reuse;
 	instance->Count--;
@@ -260,8 +652,19 @@ static void ers_obj_destroy(ERS *self)
 		if (!(instance->Options & ERS_OPT_CLEAR))
 			ShowWarning("Memory leak detected at ERS '%s', %d objects not freed.\n", instance->Name, instance->Count);
 
-	if (--instance->Cache->ReferenceCount <= 0)
+	if (--instance->Cache->ReferenceCount <= 0) {
+		if (instance->Cache->Depot) {
+			// Thread-safe caches only count their objects per cache, other threads must have ended by now
+			struct ers_depot *depot = instance->Cache->Depot;
+
+			ers_thread_release(instance->Cache, ers_thread_slot(instance->Cache));
+
+			if (depot->Allocs > depot->Frees && !(instance->Options & ERS_OPT_CLEAR))
+				ShowWarning("Memory leak detected at ERS '%s', %" PRIu64 " objects not freed.\n", instance->Name, (uint64)(depot->Allocs - depot->Frees));
+		}
+
 		ers_free_cache(instance->Cache, true);
+	}
 
 	if (instance->Next)
 		instance->Next->Prev = instance->Prev;
@@ -334,21 +737,42 @@ void ers_report(void) {
 	unsigned int cache_c = 0, blocks_u = 0, blocks_a = 0, memory_b = 0, memory_t = 0;
 
 	for (cache = CacheList; cache; cache = cache->Next) {
+		unsigned int used = cache->UsedObjs;
+		uint64 allocs = cache->Allocs, reuses = cache->Reuses;
+
+		if (cache->Depot) {
+			struct ers_depot *depot = cache->Depot;
+
+			// Only the statistics of this thread are current, other threads flush theirs when they exchange magazines
+			ers_thread_flush(depot, ers_thread_slot(cache));
+
+			allocs = depot->Allocs;
+			used = (unsigned int)(allocs - depot->Frees);
+		}
+
 		cache_c++;
 		ShowMessage(CL_BOLD"[ERS Cache of size '" CL_NORMAL "" CL_WHITE "%u" CL_NORMAL "" CL_BOLD "' report]\n" CL_NORMAL, cache->ObjectSize);
 		ShowMessage("\tinstances          : %u\n", cache->ReferenceCount);
-		ShowMessage("\tblocks in use      : %u/%u\n", cache->UsedObjs, cache->UsedObjs+cache->Free);
-		ShowMessage("\tblocks unused      : %u\n", cache->Free);
-		ShowMessage("\tmemory in use      : %.2f MB\n", cache->UsedObjs == 0 ? 0. : (double)((cache->UsedObjs * cache->ObjectSize)/1024)/1024);
-		ShowMessage("\tmemory allocated   : %.2f MB\n", (cache->Free+cache->UsedObjs) == 0 ? 0. : (double)(((cache->UsedObjs+cache->Free) * cache->ObjectSize)/1024)/1024);
-		blocks_u += cache->UsedObjs;
-		blocks_a += cache->UsedObjs + cache->Free;
-		memory_b += cache->UsedObjs * cache->ObjectSize;
-		memory_t += (cache->UsedObjs+cache->Free) * cache->ObjectSize;
+		ShowMessage("\tblocks in use      : %u/%u\n", used, cache->Capacity);
+		ShowMessage("\tblocks unused      : %u (%.1f%% of the allocated memory)\n", cache->Capacity - used, cache->Capacity == 0 ? 0. : 100. * (cache->Capacity - used) / cache->Capacity);
+		ShowMessage("\tmemory in use      : %.2f MB\n", used == 0 ? 0. : (double)((used * cache->ObjectSize)/1024)/1024);
+		ShowMessage("\tmemory allocated   : %.2f MB\n", cache->Capacity == 0 ? 0. : (double)((cache->Capacity * cache->ObjectSize)/1024)/1024);
+		if (cache->Depot) {
+			struct ers_depot *depot = cache->Depot;
+
+			ShowMessage("\tallocations        : %" PRIu64 ", %.1f%% from the thread magazines, %.1f%% from the depot\n", allocs,
+				allocs == 0 ? 0. : 100. * depot->MagazineHits / allocs, allocs == 0 ? 0. : 100. * depot->DepotHits / allocs);
+		} else
+			ShowMessage("\tallocations        : %" PRIu64 ", %.1f%% reused a freed block\n", allocs, allocs == 0 ? 0. : 100. * reuses / allocs);
+		blocks_u += used;
+		blocks_a += cache->Capacity;
+		memory_b += used * cache->ObjectSize;
+		memory_t += cache->Capacity * cache->ObjectSize;
 	}
 	ShowInfo("ers_report: '" CL_WHITE "%u" CL_NORMAL "' caches in use\n",cache_c);
 	ShowInfo("ers_report: '" CL_WHITE "%u" CL_NORMAL "' blocks in use, consuming '" CL_WHITE "%.2f MB" CL_NORMAL "'\n",blocks_u,(double)((memory_b)/1024)/1024);
 	ShowInfo("ers_report: '" CL_WHITE "%u" CL_NORMAL "' blocks total, consuming '" CL_WHITE "%.2f MB" CL_NORMAL "' \n",blocks_a,(double)((memory_t)/1024)/1024);
+	ShowInfo("ers_report: '" CL_WHITE "%.1f%%" CL_NORMAL "' of the allocated memory is unused\n", memory_t == 0 ? 0. : 100. * (memory_t - memory_b) / memory_t);
 }
 
 /**
@@ -28,7 +28,8 @@
  *    destroyed so memory will usually only be recovered near the end.       *
  *  - Always wastes space for entries smaller than a pointer.                *
  *                                                                           *
- *  WARNING: The system is not thread-safe at the moment.                    *
+ *  WARNING: The system is only thread-safe for managers created with       *
+ *           ERS_OPT_THREAD_SAFE, and only for allocating and freeing.       *
  *                                                                           *
  *  HISTORY:                                                                 *
  *    0.1 - Initial version                                                  *
@@ -77,6 +78,7 @@ enum ERSOptions {
 	ERS_OPT_FREE_NAME   = 0x04,/* name is dynamic memory, and should be freed */
 	ERS_OPT_CLEAN       = 0x08,/* clears used memory upon ers_free so that its all new to be reused on the next alloc */
 	ERS_OPT_FLEX_CHUNK  = 0x10,/* signs that it should look for its own cache given it'll have a dynamic chunk size, so that it doesn't affect the other ERS it'd otherwise be sharing */
+	ERS_OPT_THREAD_SAFE = 0x20,/* entries can be allocated and freed from any thread, through per-thread magazines and a lock-free depot; the manager itself is still created and destroyed by the main thread */
 
 	/* Compound, is used to determine whether it should be looking for a cache of matching options */
 	ERS_CACHE_OPTIONS   = ERS_OPT_CLEAN|ERS_OPT_FLEX_CHUNK,
@@ -164,7 +166,9 @@ ERS *ers_new(uint32 size, const char *name, enum ERSOptions options);
 
 /**
  * Print a report about the current state of the Entry Reusage System.
- * Shows information about the global system and each entry manager.
+ * Shows information about the global system and each entry manager,
+ * including how many allocations reused a freed entry and how much of the
+ * allocated memory is unused.
  * The number of entries are checked and a warning is shown if extra reusable
  * entries are found.
  * The extra entries are included in the count of reusable entries.
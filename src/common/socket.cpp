@@ -5,6 +5,28 @@
 
 #include <stdlib.h>
 
+#if defined(SOCKET_EPOLL) && !defined(MINICORE)
+	// Allows the recv/send system calls to be offloaded to dedicated I/O threads
+	#define SOCKET_IOTHREADS
+#endif
+
+#if defined(SOCKET_IOURING) && defined(MINICORE)
+	// The tools do not run an event loop
+	#undef SOCKET_IOURING
+#endif
+
+#if defined(SOCKET_EPOLL) && defined(SOCKET_IOURING)
+	#error Only one event dispatcher can be used, either SOCKET_EPOLL or SOCKET_IOURING
+#endif
+
+#ifdef SOCKET_IOTHREADS
+	#include <algorithm>
+	#include <atomic>
+	#include <chrono>
+	#include <thread>
+	#include <vector>
+#endif
+
 #ifdef WIN32
 	#include "winapi.hpp"
 #else
@@ -15,6 +37,7 @@
 	#include <sys/ioctl.h>
 	#include <sys/socket.h>
 	#include <sys/time.h>
+	#include <sys/uio.h>
 	#include <unistd.h>
 
 	#if defined(__linux__) || defined(__linux)
@@ -23,6 +46,15 @@
 		#ifdef SOCKET_EPOLL
 			#include <sys/epoll.h>
 		#endif
+		#ifdef SOCKET_IOTHREADS
+			#include <signal.h>
+			#include <sys/eventfd.h>
+		#endif
+		#ifdef SOCKET_IOURING
+			#include <linux/io_uring.h>
+			#include <sys/mman.h>
+			#include <sys/syscall.h>
+		#endif
 	#else 
 		#include <netinet/in.h>
 		#include <netinet/tcp.h>
@@ -215,7 +247,9 @@ char* sErr(int code)
 	#define MSG_NOSIGNAL 0
 #endif
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IOURING)
+	// io_uring based Event Dispatcher, see below
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher
 	fd_set readfds;
 #else
@@ -226,6 +260,10 @@ char* sErr(int code)
 	static struct epoll_event *epevents = nullptr;
 #endif
 
+#ifdef SOCKET_IOTHREADS
+	static int io_threads = 0;
+#endif
+
 int fd_max;
 time_t last_tick;
 time_t stall_time = 60;
@@ -267,6 +305,10 @@ uint32 send_shortlist_set[(MAXCONN+31)/32];// to know if specific fd's are alrea
 #endif
 
 static int create_session(int fd, RecvFunc func_recv, SendFunc func_send, ParseFunc func_parse);
+static int connect_client_setup(int fd, struct sockaddr_in* client_address);
+
+/// Returns true if the session has data queued for sending
+#define session_sendpending(s) ( (s)->wdata_size > 0 || (s)->wshared_count > 0 )
 
 #ifndef MINICORE
 	int ip_rules = 1;
@@ -320,148 +362,1806 @@ void setsocketopts(int fd,int delay_timeout){
 #endif
 #endif
 
-	// Set the socket into no-delay mode; otherwise packets get delayed for up to 200ms, likely creating server-side lag.
-	// The RO protocol is mainly single-packet request/response, plus the FIFO model already does packet grouping anyway.
-	sSetsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&yes, sizeof(yes));
+	// Set the socket into no-delay mode; otherwise packets get delayed for up to 200ms, likely creating server-side lag.
+	// The RO protocol is mainly single-packet request/response, plus the FIFO model already does packet grouping anyway.
+	sSetsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&yes, sizeof(yes));
+
+	// force the socket into no-wait, graceful-close mode (should be the default, but better make sure)
+	//(https://msdn.microsoft.com/en-us/library/windows/desktop/ms737582%28v=vs.85%29.aspx)
+	{
+		struct linger opt;
+		opt.l_onoff = 0; // SO_DONTLINGER
+		opt.l_linger = 0; // Do not care
+		if( sSetsockopt(fd, SOL_SOCKET, SO_LINGER, (char*)&opt, sizeof(opt)) )
+			ShowWarning("setsocketopts: Unable to set SO_LINGER mode for connection #%d!\n", fd);
+	}
+	if(delay_timeout){
+#if defined(WIN32)
+		int timeout = delay_timeout * 1000;
+#else
+		struct timeval timeout;
+		timeout.tv_sec = delay_timeout;
+		timeout.tv_usec = 0;
+#endif
+
+		if (sSetsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout,sizeof(timeout)) < 0)
+			ShowError("setsocketopts: Unable to set SO_RCVTIMEO timeout for connection #%d!\n", fd);
+		if (sSetsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, (char *)&timeout,sizeof(timeout)) < 0)
+			ShowError("setsocketopts: Unable to set SO_SNDTIMEO timeout for connection #%d!\n", fd);
+	}
+}
+
+/*======================================
+ *	CORE : Socket Sub Function
+ *--------------------------------------*/
+void set_eof(int fd)
+{
+	if( session_isActive(fd) )
+	{
+#ifdef SEND_SHORTLIST
+		// Add this socket to the shortlist for eof handling.
+		send_shortlist_add_fd(fd);
+#endif
+		session[fd]->flag.eof = 1;
+	}
+}
+
+int recv_to_fifo(int fd)
+{
+	int len;
+
+	if( !session_isActive(fd) )
+		return -1;
+
+	len = sRecv(fd, (char *) session[fd]->rdata + session[fd]->rdata_size, (int)RFIFOSPACE(fd), 0);
+
+	if( len == SOCKET_ERROR )
+	{//An exception has occured
+		if( sErrno != S_EWOULDBLOCK ) {
+			//ShowDebug("recv_to_fifo: %s, closing connection #%d\n", error_msg(), fd);
+			set_eof(fd);
+		}
+		return 0;
+	}
+
+	if( len == 0 )
+	{//Normal connection end.
+		set_eof(fd);
+		return 0;
+	}
+
+	session[fd]->rdata_size += len;
+	session[fd]->rdata_tick = last_tick;
+#ifdef SHOW_SERVER_STATS
+	socket_data_i += len;
+	socket_data_qi += len;
+	if (!session[fd]->flag.server)
+	{
+		socket_data_ci += len;
+	}
+#endif
+	return 0;
+}
+
+#ifdef WFIFO_SHARED
+/// Maximum amount of I/O vectors that are sent at once
+#define WFIFO_IOV_MAX 256
+
+/// Releases all shared packet buffers of a session.
+static void wfifo_shared_clear(int fd)
+{
+	struct socket_data* s = session[fd];
+	size_t i;
+
+	for( i = 0; i < s->wshared_count; i++ )
+		packet_buffer_release(s->wshared[i].buf);
+
+	s->wshared_count = 0;
+	s->wshared_size = 0;
+	s->wshared_pos = 0;
+}
+
+/// Sends the write fifo data and the shared packet buffers in between with a single system call.
+static int send_shared_from_fifo(int fd)
+{
+	struct socket_data* s = session[fd];
+	struct iovec iov[WFIFO_IOV_MAX];
+	struct msghdr msg;
+	size_t pos = 0; // position in the write fifo
+	size_t i;
+	int count = 0;
+
+	for( i = 0; i < s->wshared_count && count + 2 <= WFIFO_IOV_MAX; i++ )
+	{
+		struct wfifo_shared* ws = &s->wshared[i];
+		size_t skip = ( i == 0 ) ? s->wshared_pos : 0;
+
+		if( ws->offset > pos )
+		{// write fifo data in front of the shared buffer
+			iov[count].iov_base = s->wdata + pos;
+			iov[count].iov_len = ws->offset - pos;
+			count++;
+			pos = ws->offset;
+		}
+
+		iov[count].iov_base = ws->buf->data + skip;
+		iov[count].iov_len = ws->buf->len - skip;
+		count++;
+	}
+
+	if( i == s->wshared_count && pos < s->wdata_size )
+	{// write fifo data after the last shared buffer
+		iov[count].iov_base = s->wdata + pos;
+		iov[count].iov_len = s->wdata_size - pos;
+		count++;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+
+	return (int)sendmsg(fd, &msg, MSG_NOSIGNAL);
+}
+
+/// Removes 'len' sent bytes from the front of the write fifo and the shared packet buffers.
+static void wfifo_shared_consume(int fd, size_t len)
+{
+	struct socket_data* s = session[fd];
+	size_t pos = 0; // sent bytes of the write fifo
+	size_t done = 0; // completely sent shared buffers
+
+	while( len > 0 )
+	{
+		size_t next = ( done < s->wshared_count ) ? s->wshared[done].offset : s->wdata_size;
+		size_t n = ( len < next - pos ) ? len : next - pos;
+		size_t rest;
+
+		pos += n;
+		len -= n;
+
+		if( len == 0 || done == s->wshared_count )
+			break;
+
+		rest = s->wshared[done].buf->len - s->wshared_pos;
+
+		if( len < rest )
+		{// partially sent
+			s->wshared_pos += len;
+			s->wshared_size -= len;
+			break;
+		}
+
+		len -= rest;
+		s->wshared_size -= rest;
+		s->wshared_pos = 0;
+		packet_buffer_release(s->wshared[done].buf);
+		done++;
+	}
+
+	if( pos > 0 )
+	{
+		if( pos < s->wdata_size )
+			memmove(s->wdata, s->wdata + pos, s->wdata_size - pos);
+		s->wdata_size -= pos;
+	}
+
+	if( done > 0 )
+	{
+		s->wshared_count -= done;
+		memmove(s->wshared, s->wshared + done, s->wshared_count * sizeof(struct wfifo_shared));
+	}
+
+	for( size_t i = 0; i < s->wshared_count; i++ )
+		s->wshared[i].offset -= pos;
+}
+
+#if defined(SOCKET_IOTHREADS) || defined(SOCKET_IOURING)
+/// Copies the write fifo data and the shared packet buffers in between to 'out' and empties the send queue.
+/// 'out' has to be able to hold wdata_size + wshared_size bytes.
+static void wfifo_linearize(int fd, uint8* out)
+{
+	struct socket_data* s = session[fd];
+	size_t pos = 0; // position in the write fifo
+	size_t i;
+
+	for( i = 0; i < s->wshared_count; i++ )
+	{
+		struct wfifo_shared* ws = &s->wshared[i];
+		size_t skip = ( i == 0 ) ? s->wshared_pos : 0;
+
+		memcpy(out, s->wdata + pos, ws->offset - pos);
+		out += ws->offset - pos;
+		pos = ws->offset;
+		memcpy(out, ws->buf->data + skip, ws->buf->len - skip);
+		out += ws->buf->len - skip;
+	}
+
+	memcpy(out, s->wdata + pos, s->wdata_size - pos);
+
+	s->wdata_size = 0;
+	wfifo_shared_clear(fd);
+}
+#endif
+#endif
+
+int send_from_fifo(int fd)
+{
+	int len;
+
+	if( !session_isValid(fd) )
+		return -1;
+
+	if( !session_sendpending(session[fd]) )
+		return 0; // nothing to send
+
+#ifdef WFIFO_SHARED
+	if( session[fd]->wshared_count > 0 )
+		len = send_shared_from_fifo(fd);
+	else
+#endif
+	len = sSend(fd, (const char *) session[fd]->wdata, (int)session[fd]->wdata_size, MSG_NOSIGNAL);
+
+	if( len == SOCKET_ERROR )
+	{//An exception has occured
+		if( sErrno != S_EWOULDBLOCK ) {
+			//ShowDebug("send_from_fifo: %s, ending connection #%d\n", error_msg(), fd);
+#ifdef SHOW_SERVER_STATS
+			socket_data_qo -= session[fd]->wdata_size + session[fd]->wshared_size;
+#endif
+			session[fd]->wdata_size = 0; //Clear the send queue as we can't send anymore. [Skotlex]
+#ifdef WFIFO_SHARED
+			wfifo_shared_clear(fd);
+#endif
+			set_eof(fd);
+		}
+		return 0;
+	}
+
+	if( len > 0 )
+	{
+		session[fd]->wdata_tick = last_tick;
+
+#ifdef WFIFO_SHARED
+		if( session[fd]->wshared_count > 0 )
+			wfifo_shared_consume(fd, len);
+		else
+#endif
+		{
+			// some data could not be transferred?
+			// shift unsent data to the beginning of the queue
+			if( (size_t)len < session[fd]->wdata_size )
+				memmove(session[fd]->wdata, session[fd]->wdata + len, session[fd]->wdata_size - len);
+
+			session[fd]->wdata_size -= len;
+		}
+#ifdef SHOW_SERVER_STATS
+		socket_data_o += len;
+		socket_data_qo -= len;
+		if (!session[fd]->flag.server)
+		{
+			socket_data_co += len;
+		}
+#endif
+	}
+
+	return 0;
+}
+
+/// Best effort - there's no warranty that the data will be sent.
+void flush_fifo(int fd)
+{
+	if(session[fd] != NULL)
+		session[fd]->func_send(fd);
+}
+
+void flush_fifos(void)
+{
+	int i;
+	for(i = 1; i < fd_max; i++)
+		flush_fifo(i);
+}
+
+#ifdef SOCKET_IOTHREADS
+/*======================================
+ *	CORE : Network I/O threads
+ *--------------------------------------
+ * When io_threads is set, every connection is handed over to one of the I/O threads,
+ * each running its own epoll instance. The I/O threads perform the recv/send system
+ * calls and hand the data over to the main thread through lock-free message queues,
+ * so packet parsing and everything after it still runs on the main thread only.
+ *
+ * Since the memory manager is not thread safe, buffers that cross threads are
+ * allocated with the system malloc.
+ *
+ * A connection that is closed by the main thread stays open in its I/O thread until
+ * the data that was still queued for it was sent, or IOTHREAD_LINGER passed.
+ *--------------------------------------*/
+
+/// Maximum amount of I/O threads
+#define IOTHREAD_MAX 32
+
+/// Time in milliseconds a closed connection may take to send its remaining data
+#define IOTHREAD_LINGER 5000
+
+enum e_iomsg_type : uint8 {
+	// main thread -> I/O thread
+	IOMSG_ADD = 0, // start watching a connection
+	IOMSG_REARM, // main thread consumed the last received data, receive up to len bytes
+	IOMSG_SEND, // send len bytes of data
+	IOMSG_CLOSE, // send the remaining len bytes of data, then close the connection
+	IOMSG_STOP, // terminate the thread
+	// I/O thread -> main thread
+	IOMSG_RECV, // received len bytes of data into the receive buffer of the connection
+	IOMSG_SENT, // sent len bytes of data, ready for more
+	IOMSG_EOF, // connection was closed by the remote side or failed
+};
+
+struct s_iomsg {
+	std::atomic<s_iomsg*> next;
+	e_iomsg_type type;
+	int fd;
+	uint32 generation;
+	size_t len;
+	uint8* data;
+};
+
+/// Intrusive multi-producer single-consumer queue. [Vyukov]
+/// Producers never block, the consumer may see an empty queue while a push is in progress.
+class IoMessageQueue {
+private:
+	std::atomic<s_iomsg*> head;
+	s_iomsg* tail;
+	s_iomsg stub;
+
+public:
+	IoMessageQueue(){
+		this->stub.next.store( nullptr, std::memory_order_relaxed );
+		this->head.store( &this->stub, std::memory_order_relaxed );
+		this->tail = &this->stub;
+	}
+
+	void push( s_iomsg* msg ){
+		msg->next.store( nullptr, std::memory_order_relaxed );
+		s_iomsg* prev = this->head.exchange( msg, std::memory_order_acq_rel );
+		prev->next.store( msg, std::memory_order_release );
+	}
+
+	s_iomsg* pop(){
+		s_iomsg* tail = this->tail;
+		s_iomsg* next = tail->next.load( std::memory_order_acquire );
+
+		if( tail == &this->stub ){
+			if( next == nullptr ){
+				return nullptr;
+			}
+
+			this->tail = next;
+			tail = next;
+			next = next->next.load( std::memory_order_acquire );
+		}
+
+		if( next != nullptr ){
+			this->tail = next;
+			return tail;
+		}
+
+		if( tail != this->head.load( std::memory_order_acquire ) ){
+			return nullptr; // a producer is in the middle of a push
+		}
+
+		this->push( &this->stub );
+
+		next = tail->next.load( std::memory_order_acquire );
+
+		if( next != nullptr ){
+			this->tail = next;
+			return tail;
+		}
+
+		return nullptr;
+	}
+};
+
+struct s_iothread {
+	std::thread thread;
+	int epfd; // epoll instance of the thread
+	int wakeup_fd; // eventfd, signaled by the main thread when the inbox was filled
+	int notify_fd; // eventfd, signaled by the I/O thread when the outbox was filled
+	bool wakeup_pending; // main thread posted messages that have not been signaled yet
+	bool notify_pending; // I/O thread delivered messages that have not been signaled yet
+	IoMessageQueue inbox;
+	IoMessageQueue outbox;
+	std::vector<int> closing; // connections that still send their remaining data before they are closed
+};
+
+/// Main thread view of a connection that is handled by an I/O thread
+struct s_iothread_session {
+	bool assigned; // connection is handled by an I/O thread
+	bool sending; // a send request is in flight
+	bool rearm; // received data was delivered, a new receive has to be armed
+	uint8 thread;
+	uint32 generation; // distinguishes messages of a closed connection from its successor on the same fd
+};
+
+/// I/O thread view of a connection, only accessed by the owning thread
+struct s_iothread_fd {
+	bool active;
+	bool failed;
+	bool closing; // closed by the main thread, the connection is closed once the pending data was sent
+	uint32 generation;
+	uint32 events; // currently registered epoll events
+	size_t recv_len; // bytes allowed to be received, zero when waiting for a rearm
+	uint8* recv_buf; // receive buffer, reused until the connection is closed
+	size_t recv_size; // capacity of recv_buf
+	uint8* send_data; // pending send data
+	size_t send_len;
+	size_t send_pos;
+	std::chrono::steady_clock::time_point close_deadline; // the connection is closed at this point even if data is left
+};
+
+static int iothread_count = 0;
+static s_iothread iothreads[IOTHREAD_MAX];
+static s_iothread_session iothread_session[MAXCONN];
+static s_iothread_fd iothread_fd[MAXCONN];
+static int iothread_rearm_list[MAXCONN];
+static int iothread_rearm_count = 0;
+
+/// Marker for the wakeup eventfd of an I/O thread in its epoll instance
+#define IOTHREAD_WAKEUP_EVENT UINT64_MAX
+
+static s_iomsg* iomsg_create( e_iomsg_type type, int fd, uint32 generation ){
+	s_iomsg* msg = (s_iomsg*)malloc( sizeof( s_iomsg ) );
+
+	if( msg == nullptr ){
+		ShowFatalError( "iomsg_create: Out of memory!\n" );
+		exit( EXIT_FAILURE );
+	}
+
+	msg->type = type;
+	msg->fd = fd;
+	msg->generation = generation;
+	msg->len = 0;
+	msg->data = nullptr;
+
+	return msg;
+}
+
+static void iomsg_free( s_iomsg* msg ){
+	// Received data points into the receive buffer of the connection
+	if( msg->data != nullptr && msg->type != IOMSG_RECV ){
+		free( msg->data );
+	}
+
+	free( msg );
+}
+
+static void eventfd_signal( int efd ){
+	uint64 value = 1;
+
+	while( write( efd, &value, sizeof( value ) ) < 0 && errno == EINTR );
+}
+
+static void eventfd_clear( int efd ){
+	uint64 value;
+
+	while( read( efd, &value, sizeof( value ) ) < 0 && errno == EINTR );
+}
+
+/// Returns true if the fd is the notification eventfd of an I/O thread.
+static bool iothread_is_notify_fd( int fd ){
+	for( int i = 0; i < iothread_count; i++ ){
+		if( iothreads[i].notify_fd == fd ){
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/// Queues a message for an I/O thread. The thread is signaled in iothread_flush.
+static void iothread_post( int thread, s_iomsg* msg ){
+	iothreads[thread].inbox.push( msg );
+	iothreads[thread].wakeup_pending = true;
+}
+
+/// Wakes up all I/O threads that have pending messages.
+static void iothread_flush( void ){
+	for( int i = 0; i < iothread_count; i++ ){
+		if( iothreads[i].wakeup_pending ){
+			iothreads[i].wakeup_pending = false;
+			eventfd_signal( iothreads[i].wakeup_fd );
+		}
+	}
+}
+
+/// [I/O thread] Queues a message for the main thread. The main thread is signaled at the end of the cycle.
+static void iothread_deliver( s_iothread* t, s_iomsg* msg ){
+	t->outbox.push( msg );
+	t->notify_pending = true;
+}
+
+/// [I/O thread] Updates the registered epoll events of a connection.
+static void iothread_fd_update( s_iothread* t, int fd ){
+	s_iothread_fd* iofd = &iothread_fd[fd];
+	uint32 events = 0;
+
+	if( iofd->recv_len > 0 ){
+		events |= EPOLLIN;
+	}
+
+	if( iofd->send_data != nullptr ){
+		events |= EPOLLOUT;
+	}
+
+	if( events == iofd->events ){
+		return;
+	}
+
+	struct epoll_event ev = {};
+
+	ev.events = events;
+	ev.data.fd = fd;
+
+	epoll_ctl( t->epfd, EPOLL_CTL_MOD, fd, &ev );
+	iofd->events = events;
+}
+
+/// [I/O thread] Closes a connection and releases its buffers.
+static void iothread_fd_close( s_iothread* t, int fd ){
+	s_iothread_fd* iofd = &iothread_fd[fd];
+
+	if( iofd->send_data != nullptr ){
+		free( iofd->send_data );
+		iofd->send_data = nullptr;
+	}
+
+	if( iofd->recv_buf != nullptr ){
+		free( iofd->recv_buf );
+		iofd->recv_buf = nullptr;
+		iofd->recv_size = 0;
+	}
+
+	if( iofd->closing ){
+		t->closing.erase( std::remove( t->closing.begin(), t->closing.end(), fd ), t->closing.end() );
+		iofd->closing = false;
+	}
+
+	epoll_ctl( t->epfd, EPOLL_CTL_DEL, fd, nullptr );
+	sShutdown( fd, SHUT_RDWR );
+	sClose( fd );
+	iofd->active = false;
+}
+
+/// [I/O thread] Marks a connection as failed and tells the main thread about it.
+static void iothread_fd_fail( s_iothread* t, int fd ){
+	s_iothread_fd* iofd = &iothread_fd[fd];
+
+	if( iofd->failed ){
+		return;
+	}
+
+	// The main thread already let go of the connection
+	if( iofd->closing ){
+		iothread_fd_close( t, fd );
+		return;
+	}
+
+	iofd->failed = true;
+	iofd->recv_len = 0;
+
+	if( iofd->send_data != nullptr ){
+		free( iofd->send_data );
+		iofd->send_data = nullptr;
+	}
+
+	iothread_fd_update( t, fd );
+
+	iothread_deliver( t, iomsg_create( IOMSG_EOF, fd, iofd->generation ) );
+}
+
+/// [I/O thread] Receives data from a connection.
+static void iothread_fd_recv( s_iothread* t, int fd ){
+	s_iothread_fd* iofd = &iothread_fd[fd];
+
+	// The main thread copied the previous data before it rearmed the connection, so the buffer is free again
+	if( iofd->recv_size < iofd->recv_len ){
+		uint8* buf = (uint8*)realloc( iofd->recv_buf, iofd->recv_len );
+
+		if( buf == nullptr ){
+			return; // try again on the next event
+		}
+
+		iofd->recv_buf = buf;
+		iofd->recv_size = iofd->recv_len;
+	}
+
+	ssize_t len = sRecv( fd, (char*)iofd->recv_buf, iofd->recv_len, 0 );
+
+	if( len <= 0 ){
+		if( len == 0 || ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) ){
+			iothread_fd_fail( t, fd );
+		}
+
+		return;
+	}
+
+	s_iomsg* msg = iomsg_create( IOMSG_RECV, fd, iofd->generation );
+
+	msg->data = iofd->recv_buf;
+	msg->len = len;
+
+	iothread_deliver( t, msg );
+
+	// Wait until the main thread consumed the data
+	iofd->recv_len = 0;
+	iothread_fd_update( t, fd );
+}
+
+/// [I/O thread] Sends pending data of a connection.
+/// Returns true when the pending data was sent completely.
+static bool iothread_fd_send( s_iothread* t, int fd ){
+	s_iothread_fd* iofd = &iothread_fd[fd];
+
+	while( iofd->send_pos < iofd->send_len ){
+		ssize_t len = sSend( fd, (const char*)iofd->send_data + iofd->send_pos, iofd->send_len - iofd->send_pos, MSG_NOSIGNAL );
+
+		if( len < 0 ){
+			if( errno == EINTR ){
+				continue;
+			}
+
+			if( errno != EAGAIN && errno != EWOULDBLOCK ){
+				iothread_fd_fail( t, fd );
+			}
+
+			return false;
+		}
+
+		iofd->send_pos += len;
+	}
+
+	if( iofd->closing ){
+		iothread_fd_close( t, fd );
+		return true;
+	}
+
+	s_iomsg* msg = iomsg_create( IOMSG_SENT, fd, iofd->generation );
+
+	msg->len = iofd->send_len;
+
+	iothread_deliver( t, msg );
+
+	free( iofd->send_data );
+	iofd->send_data = nullptr;
+	iofd->send_len = 0;
+	iofd->send_pos = 0;
+
+	return true;
+}
+
+/// [I/O thread] Processes a message from the main thread.
+/// Returns false if the thread should terminate.
+static bool iothread_process( s_iothread* t, s_iomsg* msg ){
+	int fd = msg->fd;
+	s_iothread_fd* iofd = &iothread_fd[fd];
+
+	switch( msg->type ){
+		case IOMSG_ADD: {
+			struct epoll_event ev = {};
+
+			iofd->active = true;
+			iofd->failed = false;
+			iofd->closing = false;
+			iofd->generation = msg->generation;
+			iofd->recv_len = msg->len;
+			iofd->events = EPOLLIN;
+			iofd->send_data = nullptr;
+			iofd->send_len = 0;
+			iofd->send_pos = 0;
+
+			ev.events = EPOLLIN;
+			ev.data.fd = fd;
+
+			if( epoll_ctl( t->epfd, EPOLL_CTL_ADD, fd, &ev ) == SOCKET_ERROR ){
+				iofd->events = 0;
+				iothread_fd_fail( t, fd );
+			}
+			break;
+		}
+
+		case IOMSG_REARM:
+			if( iofd->active && !iofd->failed && iofd->generation == msg->generation ){
+				iofd->recv_len = msg->len;
+				iothread_fd_update( t, fd );
+			}
+			break;
+
+		case IOMSG_SEND:
+			if( iofd->active && !iofd->failed && iofd->generation == msg->generation && iofd->send_data == nullptr ){
+				iofd->send_data = msg->data;
+				iofd->send_len = msg->len;
+				iofd->send_pos = 0;
+				msg->data = nullptr; // owned by the connection now
+
+				if( !iothread_fd_send( t, fd ) ){
+					iothread_fd_update( t, fd );
+				}
+			}
+			break;
+
+		case IOMSG_CLOSE:
+			if( iofd->active && iofd->generation == msg->generation ){
+				if( iofd->failed ){
+					iothread_fd_close( t, fd );
+					break;
+				}
+
+				// Queue the remaining data behind the send that is still in flight
+				if( msg->len > 0 ){
+					if( iofd->send_data == nullptr ){
+						iofd->send_data = msg->data;
+						iofd->send_len = msg->len;
+						iofd->send_pos = 0;
+						msg->data = nullptr; // owned by the connection now
+					}else{
+						size_t left = iofd->send_len - iofd->send_pos;
+						uint8* data = (uint8*)malloc( left + msg->len );
+
+						if( data != nullptr ){
+							memcpy( data, iofd->send_data + iofd->send_pos, left );
+							memcpy( data + left, msg->data, msg->len );
+							free( iofd->send_data );
+							iofd->send_data = data;
+							iofd->send_len = left + msg->len;
+							iofd->send_pos = 0;
+						}
+					}
+				}
+
+				if( iofd->send_data == nullptr ){
+					iothread_fd_close( t, fd );
+					break;
+				}
+
+				iofd->closing = true;
+				iofd->recv_len = 0;
+				iofd->close_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( IOTHREAD_LINGER );
+				t->closing.push_back( fd );
+
+				if( !iothread_fd_send( t, fd ) && iofd->active ){
+					iothread_fd_update( t, fd );
+				}
+			}
+			break;
+
+		case IOMSG_STOP:
+			// Do not wait for the remaining data anymore
+			while( !t->closing.empty() ){
+				iothread_fd_close( t, t->closing.back() );
+			}
+
+			iomsg_free( msg );
+			return false;
+
+		default:
+			break;
+	}
+
+	iomsg_free( msg );
+
+	return true;
+}
+
+/// [I/O thread] Main loop
+static void iothread_main( s_iothread* t ){
+	struct epoll_event events[256];
+	sigset_t sigset;
+
+	// Signals are handled by the main thread
+	sigfillset( &sigset );
+	pthread_sigmask( SIG_BLOCK, &sigset, nullptr );
+
+	for( ;; ){
+		// Wake up regularly while closed connections are still sending
+		int ret = epoll_wait( t->epfd, events, ARRAYLENGTH( events ), t->closing.empty() ? -1 : 1000 );
+		bool wakeup = false;
+
+		if( ret == SOCKET_ERROR ){
+			if( errno == EINTR ){
+				continue;
+			}
+
+			break;
+		}
+
+		for( int i = 0; i < ret; i++ ){
+			struct epoll_event* it = &events[i];
+
+			if( it->data.u64 == IOTHREAD_WAKEUP_EVENT ){
+				wakeup = true;
+				continue;
+			}
+
+			int fd = it->data.fd;
+			s_iothread_fd* iofd = &iothread_fd[fd];
+
+			if( !iofd->active || iofd->failed ){
+				continue;
+			}
+
+			if( it->events & ( EPOLLERR | EPOLLHUP ) ){
+				iothread_fd_fail( t, fd );
+				continue;
+			}
+
+			if( ( it->events & EPOLLOUT ) && iofd->send_data != nullptr ){
+				iothread_fd_send( t, fd );
+			}
+
+			if( ( it->events & EPOLLIN ) && iofd->recv_len > 0 && !iofd->failed ){
+				iothread_fd_recv( t, fd );
+			}
+
+			if( iofd->active && !iofd->failed ){
+				iothread_fd_update( t, fd );
+			}
+		}
+
+		if( !t->closing.empty() ){
+			auto now = std::chrono::steady_clock::now();
+
+			for( size_t i = 0; i < t->closing.size(); ){
+				int fd = t->closing[i];
+
+				if( now >= iothread_fd[fd].close_deadline ){
+					iothread_fd_close( t, fd ); // removes it from the list
+				}else{
+					i++;
+				}
+			}
+		}
+
+		if( wakeup ){
+			eventfd_clear( t->wakeup_fd );
+
+			s_iomsg* msg;
+
+			while( ( msg = t->inbox.pop() ) != nullptr ){
+				if( !iothread_process( t, msg ) ){
+					return;
+				}
+			}
+		}
+
+		if( t->notify_pending ){
+			t->notify_pending = false;
+			eventfd_signal( t->notify_fd );
+		}
+	}
+}
+
+/// Hands a connection over to an I/O thread.
+static void iothread_assign( int fd ){
+	s_iothread_session* ios = &iothread_session[fd];
+
+	ios->assigned = true;
+	ios->sending = false;
+	ios->rearm = false;
+	ios->thread = (uint8)( fd % iothread_count );
+	ios->generation++;
+
+	s_iomsg* msg = iomsg_create( IOMSG_ADD, fd, ios->generation );
+
+	msg->len = RFIFOSPACE( fd );
+
+	iothread_post( ios->thread, msg );
+}
+
+/// Releases a connection from its I/O thread and closes it there.
+/// Everything that is left in the WFIFO is handed over, the I/O thread sends it after the send that is still in flight.
+static void iothread_release( int fd ){
+	s_iothread_session* ios = &iothread_session[fd];
+	struct socket_data* s = session[fd];
+	s_iomsg* msg = iomsg_create( IOMSG_CLOSE, fd, ios->generation );
+
+	ios->assigned = false;
+
+	if( s != nullptr && session_sendpending( s ) ){
+		size_t len = s->wdata_size + s->wshared_size;
+
+		msg->data = (uint8*)malloc( len );
+
+		// Without memory the data is lost, but the connection is closed all the same
+		if( msg->data != nullptr ){
+			msg->len = len;
+#ifdef SHOW_SERVER_STATS
+			socket_data_qo -= len;
+#endif
+			wfifo_linearize( fd, msg->data );
+		}
+	}
+
+	iothread_post( ios->thread, msg );
+}
+
+/// Send function of connections that are handled by an I/O thread.
+/// Only one send request is in flight per connection, everything else is collected in the WFIFO meanwhile.
+int send_to_iothread( int fd ){
+	if( !session_isValid( fd ) ){
+		return -1;
+	}
+
+	struct socket_data* s = session[fd];
+	s_iothread_session* ios = &iothread_session[fd];
+
+	if( !session_sendpending( s ) || ios->sending || !ios->assigned ){
+		return 0;
+	}
+
+	s_iomsg* msg = iomsg_create( IOMSG_SEND, fd, ios->generation );
+
+	msg->len = s->wdata_size + s->wshared_size;
+	msg->data = (uint8*)malloc( msg->len );
+
+	if( msg->data == nullptr ){
+		iomsg_free( msg );
+		return 0; // try again later
+	}
+
+#ifdef SHOW_SERVER_STATS
+	socket_data_qo -= msg->len;
+#endif
+	wfifo_linearize( fd, msg->data );
+	s->wdata_tick = last_tick;
+	ios->sending = true;
+
+	iothread_post( ios->thread, msg );
+
+	return 0;
+}
+
+/// Recv function of connections that are handled by an I/O thread.
+/// Data is delivered by iothread_receive, so there is nothing to do here.
+int recv_from_iothread( int fd ){
+	return 0;
+}
+
+/// Processes the messages of all I/O threads.
+static void iothread_receive( void ){
+	for( int i = 0; i < iothread_count; i++ ){
+		s_iomsg* msg;
+
+		while( ( msg = iothreads[i].outbox.pop() ) != nullptr ){
+			int fd = msg->fd;
+			s_iothread_session* ios = &iothread_session[fd];
+			struct socket_data* s = session[fd];
+
+			if( s == nullptr || !ios->assigned || ios->generation != msg->generation ){
+				// Message of an already closed connection
+				iomsg_free( msg );
+				continue;
+			}
+
+			switch( msg->type ){
+				case IOMSG_RECV: {
+					size_t len = msg->len;
+
+					if( len > RFIFOSPACE( fd ) ){
+						// The read fifo was shrunk in the meantime
+						ShowError( "iothread_receive: Received %" PRIuPTR " bytes for session #%d, but only %" PRIuPTR " bytes are available. Closing connection.\n", len, fd, RFIFOSPACE( fd ) );
+						set_eof( fd );
+						break;
+					}
+
+					memcpy( s->rdata + s->rdata_size, msg->data, len );
+					s->rdata_size += len;
+					s->rdata_tick = last_tick;
+#ifdef SHOW_SERVER_STATS
+					socket_data_i += len;
+					socket_data_qi += len;
+					if( !s->flag.server ){
+						socket_data_ci += len;
+					}
+#endif
+
+					if( !ios->rearm ){
+						ios->rearm = true;
+						iothread_rearm_list[iothread_rearm_count++] = fd;
+					}
+					break;
+				}
+
+				case IOMSG_SENT:
+					ios->sending = false;
+					s->wdata_tick = last_tick;
+#ifdef SHOW_SERVER_STATS
+					socket_data_o += msg->len;
+					if( !s->flag.server ){
+						socket_data_co += msg->len;
+					}
+#endif
+					// Send what has been collected meanwhile
+					if( session_sendpending( s ) ){
+						send_shortlist_add_fd( fd );
+					}
+					break;
+
+				case IOMSG_EOF:
+					set_eof( fd );
+					break;
+
+				default:
+					break;
+			}
+
+			iomsg_free( msg );
+		}
+	}
+}
+
+/// Allows the I/O threads to receive more data for all connections that got data delivered.
+/// Called after the data was parsed.
+static void iothread_rearm( void ){
+	int count = iothread_rearm_count;
+
+	iothread_rearm_count = 0;
+
+	for( int i = 0; i < count; i++ ){
+		int fd = iothread_rearm_list[i];
+		s_iothread_session* ios = &iothread_session[fd];
+
+		if( !session_isActive( fd ) || !ios->assigned ){
+			ios->rearm = false;
+			continue;
+		}
+
+		size_t space = RFIFOSPACE( fd );
+
+		if( space == 0 ){
+			// Nothing was parsed yet, retry on the next cycle
+			iothread_rearm_list[iothread_rearm_count++] = fd;
+			continue;
+		}
+
+		ios->rearm = false;
+
+		s_iomsg* msg = iomsg_create( IOMSG_REARM, fd, ios->generation );
+
+		msg->len = space;
+
+		iothread_post( ios->thread, msg );
+	}
+
+	iothread_flush();
+}
+
+/// Starts the I/O threads.
+static void iothread_init( int count ){
+	if( count <= 0 ){
+		return;
+	}
+
+	if( count > IOTHREAD_MAX ){
+		ShowWarning( "socket_init: io_threads is set too high. Defaulting to %d...\n", IOTHREAD_MAX );
+		count = IOTHREAD_MAX;
+	}
+
+	memset( iothread_session, 0, sizeof( iothread_session ) );
+	memset( iothread_fd, 0, sizeof( iothread_fd ) );
+
+	for( int i = 0; i < count; i++ ){
+		s_iothread* t = &iothreads[i];
+		struct epoll_event ev = {};
+
+		t->epfd = epoll_create( MAXCONN );
+		t->wakeup_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+		t->notify_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+		t->wakeup_pending = false;
+		t->notify_pending = false;
+
+		if( t->epfd == SOCKET_ERROR || t->wakeup_fd == SOCKET_ERROR || t->notify_fd == SOCKET_ERROR ){
+			ShowFatalError( "socket_init: Failed to create I/O thread %d: %s\n", i, error_msg() );
+			exit( EXIT_FAILURE );
+		}
+
+		ev.events = EPOLLIN;
+		ev.data.u64 = IOTHREAD_WAKEUP_EVENT;
+
+		if( epoll_ctl( t->epfd, EPOLL_CTL_ADD, t->wakeup_fd, &ev ) == SOCKET_ERROR ){
+			ShowFatalError( "socket_init: Failed to register the wakeup event of I/O thread %d: %s\n", i, error_msg() );
+			exit( EXIT_FAILURE );
+		}
+
+		// Let the main event dispatcher wake up when the thread delivers data
+		ev.events = EPOLLIN;
+		ev.data.fd = t->notify_fd;
+
+		if( epoll_ctl( epfd, EPOLL_CTL_ADD, t->notify_fd, &ev ) == SOCKET_ERROR ){
+			ShowFatalError( "socket_init: Failed to register the notification event of I/O thread %d: %s\n", i, error_msg() );
+			exit( EXIT_FAILURE );
+		}
+
+		t->thread = std::thread( iothread_main, t );
+	}
+
+	iothread_count = count;
+
+	ShowInfo( "Server uses " CL_WHITE "%d" CL_RESET " I/O threads for network traffic\n", iothread_count );
+}
+
+/// Stops the I/O threads after they processed all pending messages.
+static void iothread_final( void ){
+	for( int i = 0; i < iothread_count; i++ ){
+		iothread_post( i, iomsg_create( IOMSG_STOP, 0, 0 ) );
+	}
+
+	iothread_flush();
+
+	for( int i = 0; i < iothread_count; i++ ){
+		s_iothread* t = &iothreads[i];
+		s_iomsg* msg;
+
+		t->thread.join();
+
+		// Discard everything that was not processed anymore
+		while( ( msg = t->inbox.pop() ) != nullptr ){
+			iomsg_free( msg );
+		}
+
+		while( ( msg = t->outbox.pop() ) != nullptr ){
+			iomsg_free( msg );
+		}
+
+		epoll_ctl( epfd, EPOLL_CTL_DEL, t->notify_fd, nullptr );
+		sClose( t->notify_fd );
+		sClose( t->wakeup_fd );
+		sClose( t->epfd );
+	}
+
+	iothread_count = 0;
+}
+#endif
+
+#ifdef SOCKET_IOURING
+/*======================================
+ *	CORE : io_uring based Event Dispatcher
+ *--------------------------------------
+ * Listen sockets use a multishot accept, so new connections do not need a system call each.
+ * Every connection has at most one receive in flight, which picks a kernel provided buffer
+ * from one of the registered buffer rings when data arrives. It is armed again after the
+ * received data was parsed, which keeps the RFIFO limits intact.
+ * Every connection has at most one send in flight, everything else is collected in the
+ * WFIFO meanwhile, so WFIFO_MAX still applies.
+ * All requests of a cycle are submitted together with a single io_uring_enter call.
+ *--------------------------------------*/
+
+/// Submission queue size
+#define URING_ENTRIES 1024
+
+/// Provided buffers for client connections
+#define URING_BUFFERS_SMALL 1024
+#define URING_BUFFER_SIZE_SMALL RFIFO_SIZE
+/// Provided buffers for inter-server connections
+#define URING_BUFFERS_LARGE 16
+#define URING_BUFFER_SIZE_LARGE ( FIFOSIZE_SERVERLINK / 4 )
+
+enum e_uring_op : uint8 {
+	URING_ACCEPT = 0,
+	URING_RECV,
+	URING_SEND,
+};
+
+/// In flight request, used as user data of the submission
+struct s_uring_req {
+	e_uring_op op;
+	int fd;
+	uint32 generation;
+	int group; // buffer group of a receive
+	uint8* data; // send buffer
+	size_t len;
+	size_t pos;
+	struct s_uring_req* prev;
+	struct s_uring_req* next;
+};
+
+/// Registered ring of kernel provided receive buffers
+struct s_uring_bufgroup {
+	struct io_uring_buf* ring; // the kernel header declares the entries as flexible array, which C++ places at a different offset
+	uint8* base;
+	size_t size; // size of a single buffer
+	uint16 count;
+	uint16 tail;
+};
+
+struct s_uring_session {
+	uint32 generation; // distinguishes requests of a closed connection from its successor on the same fd
+	bool recv; // a receive is in flight
+	bool rearm; // a receive has to be armed after parsing
+	struct s_uring_req* send; // send in flight
+};
+
+static int uring_fd = SOCKET_ERROR;
+static uint32 *uring_sq_head, *uring_sq_tail, *uring_sq_mask, *uring_sq_array;
+static uint32 *uring_cq_head, *uring_cq_tail, *uring_cq_mask;
+static struct io_uring_sqe* uring_sqes = nullptr;
+static struct io_uring_cqe* uring_cqes = nullptr;
+static void* uring_sq_ptr = nullptr;
+static void* uring_cq_ptr = nullptr;
+static size_t uring_sq_size, uring_cq_size, uring_sqes_size;
+static uint32 uring_sq_local_tail; // tail of the submissions that were prepared but not submitted yet
+static uint32 uring_sq_submitted; // tail that was already handed to the kernel
+static struct s_uring_bufgroup uring_buffers[2];
+static struct s_uring_session uring_session[MAXCONN];
+static int uring_rearm_list[MAXCONN];
+static int uring_rearm_count = 0;
+static struct s_uring_req* uring_requests = nullptr; // all requests that are in flight
+
+static int uring_enter(uint32 to_submit, uint32 min_complete, uint32 flags, void* arg, size_t argsz){
+	return (int)syscall( __NR_io_uring_enter, uring_fd, to_submit, min_complete, flags, arg, argsz );
+}
+
+/// Hands all prepared submissions to the kernel without waiting.
+static void uring_submit( void ){
+	uint32 to_submit = uring_sq_local_tail - uring_sq_submitted;
+
+	if( to_submit == 0 ){
+		return;
+	}
+
+	__atomic_store_n( uring_sq_tail, uring_sq_local_tail, __ATOMIC_RELEASE );
+
+	while( to_submit > 0 ){
+		int ret = uring_enter( to_submit, 0, 0, nullptr, 0 );
+
+		if( ret < 0 ){
+			if( errno == EINTR ){
+				continue;
+			}
+
+			ShowFatalError( "uring_submit: io_uring_enter failed, %s!\n", error_msg() );
+			exit( EXIT_FAILURE );
+		}
+
+		to_submit -= ret;
+	}
+
+	uring_sq_submitted = uring_sq_local_tail;
+}
+
+/// Returns a free submission queue entry, submits the pending ones if the queue is full.
+static struct io_uring_sqe* uring_get_sqe( void ){
+	if( uring_sq_local_tail - __atomic_load_n( uring_sq_head, __ATOMIC_ACQUIRE ) >= URING_ENTRIES ){
+		uring_submit();
+	}
+
+	uint32 index = uring_sq_local_tail & *uring_sq_mask;
+	struct io_uring_sqe* sqe = &uring_sqes[index];
+
+	memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+	uring_sq_array[index] = index;
+	uring_sq_local_tail++;
+
+	return sqe;
+}
+
+static struct s_uring_req* uring_req_create( e_uring_op op, int fd ){
+	struct s_uring_req* req;
+
+	CREATE( req, struct s_uring_req, 1 );
+	req->op = op;
+	req->fd = fd;
+	req->generation = uring_session[fd].generation;
+
+	req->next = uring_requests;
+	if( uring_requests != nullptr ){
+		uring_requests->prev = req;
+	}
+	uring_requests = req;
+
+	return req;
+}
+
+static void uring_req_free( struct s_uring_req* req ){
+	if( req->prev != nullptr ){
+		req->prev->next = req->next;
+	}else{
+		uring_requests = req->next;
+	}
+
+	if( req->next != nullptr ){
+		req->next->prev = req->prev;
+	}
+
+	if( req->data != nullptr ){
+		aFree( req->data );
+	}
+
+	aFree( req );
+}
+
+/// Returns true if the request belongs to a connection that was closed meanwhile.
+static bool uring_req_stale( struct s_uring_req* req ){
+	return session[req->fd] == nullptr || uring_session[req->fd].generation != req->generation;
+}
+
+/// Gives a provided buffer back to the kernel.
+static void uring_buffer_recycle( int group, uint16 bid ){
+	struct s_uring_bufgroup* g = &uring_buffers[group];
+	struct io_uring_buf* buf = &g->ring[g->tail & ( g->count - 1 )];
+
+	buf->addr = (uint64)( g->base + bid * g->size );
+	buf->len = (uint32)g->size;
+	buf->bid = bid;
+	g->tail++;
+
+	// The tail overlays the reserved field of the first entry
+	__atomic_store_n( &( (struct io_uring_buf_ring*)g->ring )->tail, g->tail, __ATOMIC_RELEASE );
+}
+
+static void uring_buffer_init( int group, uint16 count, size_t size ){
+	struct s_uring_bufgroup* g = &uring_buffers[group];
+	struct io_uring_buf_reg reg;
+
+	g->ring = (struct io_uring_buf*)mmap( nullptr, count * sizeof( struct io_uring_buf ), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0 );
+	g->base = (uint8*)mmap( nullptr, count * size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0 );
+
+	if( g->ring == MAP_FAILED || g->base == MAP_FAILED ){
+		ShowFatalError( "socket_init: Failed to allocate io_uring receive buffers: %s\n", error_msg() );
+		exit( EXIT_FAILURE );
+	}
+
+	g->size = size;
+	g->count = count;
+	g->tail = 0;
+
+	memset( &reg, 0, sizeof( reg ) );
+	reg.ring_addr = (uint64)g->ring;
+	reg.ring_entries = count;
+	reg.bgid = group;
+
+	if( syscall( __NR_io_uring_register, uring_fd, IORING_REGISTER_PBUF_RING, &reg, 1 ) < 0 ){
+		ShowFatalError( "socket_init: Failed to register io_uring receive buffers (Linux 5.19 or newer is required): %s\n", error_msg() );
+		exit( EXIT_FAILURE );
+	}
+
+	for( uint16 bid = 0; bid < count; bid++ ){
+		uring_buffer_recycle( group, bid );
+	}
+}
+
+/// Starts accepting connections on a listen socket.
+static void uring_accept( int fd ){
+	struct s_uring_req* req = uring_req_create( URING_ACCEPT, fd );
+	struct io_uring_sqe* sqe = uring_get_sqe();
+
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK;
+	sqe->user_data = (uint64)req;
+}
+
+/// Arms a receive of up to RFIFOSPACE bytes.
+static void uring_recv( int fd ){
+	struct s_uring_session* us = &uring_session[fd];
+	int group = session[fd]->max_rdata > URING_BUFFER_SIZE_SMALL ? 1 : 0;
+	size_t len = RFIFOSPACE( fd );
+
+	if( len > uring_buffers[group].size ){
+		len = uring_buffers[group].size;
+	}
+
+	struct s_uring_req* req = uring_req_create( URING_RECV, fd );
+	struct io_uring_sqe* sqe = uring_get_sqe();
+
+	req->group = group;
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->len = (uint32)len;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = group;
+	sqe->user_data = (uint64)req;
+
+	us->recv = true;
+}
+
+static void uring_send_prep( struct s_uring_req* req ){
+	struct io_uring_sqe* sqe = uring_get_sqe();
+
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = req->fd;
+	sqe->addr = (uint64)( req->data + req->pos );
+	sqe->len = (uint32)( req->len - req->pos );
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = (uint64)req;
+}
+
+/// Send function of the io_uring based event dispatcher.
+/// Only one send is in flight per connection, everything else is collected in the WFIFO meanwhile.
+int send_to_uring( int fd ){
+	if( !session_isValid( fd ) ){
+		return -1;
+	}
+
+	struct socket_data* s = session[fd];
+	struct s_uring_session* us = &uring_session[fd];
+
+	if( !session_sendpending( s ) || us->send != nullptr ){
+		return 0;
+	}
+
+	struct s_uring_req* req = uring_req_create( URING_SEND, fd );
+
+	req->len = s->wdata_size + s->wshared_size;
+	req->data = (uint8*)aMalloc( req->len );
+#ifdef SHOW_SERVER_STATS
+	socket_data_qo -= req->len;
+#endif
+	wfifo_linearize( fd, req->data );
+	us->send = req;
+	s->wdata_tick = last_tick;
+
+	uring_send_prep( req );
+
+	return 0;
+}
+
+/// Recv function of the io_uring based event dispatcher.
+/// Data is delivered by uring_reap, so there is nothing to do here.
+int recv_from_uring( int fd ){
+	return 0;
+}
+
+/// Starts watching a new connection.
+static void uring_watch( int fd ){
+	struct s_uring_session* us = &uring_session[fd];
+
+	us->generation++;
+	us->recv = false;
+	us->rearm = false;
+	us->send = nullptr;
+
+	session[fd]->func_send = send_to_uring;
+
+	uring_recv( fd );
+}
+
+/// Stops watching a connection before it is closed.
+/// Requests that are still in flight are discarded when they complete.
+static void uring_unwatch( int fd ){
+	struct s_uring_session* us = &uring_session[fd];
+
+	us->generation++;
+	us->recv = false;
+	us->rearm = false;
+	us->send = nullptr;
+
+	// The kernel has to see everything that was queued for this fd before it is closed and the number is reused
+	uring_submit();
+}
+
+static void uring_complete_accept( struct s_uring_req* req, struct io_uring_cqe* cqe ){
+	if( cqe->res >= 0 ){
+		struct sockaddr_in client_address;
+		socklen_t len = sizeof( client_address );
+		int fd = cqe->res;
+
+		if( getpeername( fd, (struct sockaddr*)&client_address, &len ) == SOCKET_ERROR ){
+			sClose( fd );
+		}else{
+			connect_client_setup( fd, &client_address );
+		}
+	}else{
+		ShowError( "connect_client: accept failed (%s)!\n", strerror( -cqe->res ) );
+	}
+
+	if( !( cqe->flags & IORING_CQE_F_MORE ) ){
+		// The multishot accept terminated, start a new one
+		int fd = req->fd;
+
+		uring_req_free( req );
+
+		if( session_isValid( fd ) ){
+			uring_accept( fd );
+		}
+	}
+}
+
+static void uring_complete_recv( struct s_uring_req* req, struct io_uring_cqe* cqe ){
+	int fd = req->fd;
+	bool stale = uring_req_stale( req );
+	uint8* data = nullptr;
+
+	if( cqe->flags & IORING_CQE_F_BUFFER ){
+		uint16 bid = (uint16)( cqe->flags >> IORING_CQE_BUFFER_SHIFT );
+		int group = req->group;
+
+		data = uring_buffers[group].base + bid * uring_buffers[group].size;
+
+		if( !stale && cqe->res > 0 ){
+			struct socket_data* s = session[fd];
+			size_t len = cqe->res;
+
+			if( len > RFIFOSPACE( fd ) ){
+				// The read fifo was shrunk in the meantime
+				ShowError( "uring_complete_recv: Received %" PRIuPTR " bytes for session #%d, but only %" PRIuPTR " bytes are available. Closing connection.\n", len, fd, RFIFOSPACE( fd ) );
+				set_eof( fd );
+			}else{
+				memcpy( s->rdata + s->rdata_size, data, len );
+				s->rdata_size += len;
+				s->rdata_tick = last_tick;
+#ifdef SHOW_SERVER_STATS
+				socket_data_i += len;
+				socket_data_qi += len;
+				if( !s->flag.server ){
+					socket_data_ci += len;
+				}
+#endif
+			}
+		}
+
+		uring_buffer_recycle( group, bid );
+	}
+
+	uring_req_free( req );
+
+	if( stale ){
+		return;
+	}
+
+	uring_session[fd].recv = false;
+
+	if( cqe->res == 0 || ( cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -EAGAIN && cqe->res != -EINTR ) ){
+		// Normal connection end or an exception has occured
+		set_eof( fd );
+		return;
+	}
+
+	if( !uring_session[fd].rearm ){
+		uring_session[fd].rearm = true;
+		uring_rearm_list[uring_rearm_count++] = fd;
+	}
+}
+
+static void uring_complete_send( struct s_uring_req* req, struct io_uring_cqe* cqe ){
+	int fd = req->fd;
 
-	// force the socket into no-wait, graceful-close mode (should be the default, but better make sure)
-	//(https://msdn.microsoft.com/en-us/library/windows/desktop/ms737582%28v=vs.85%29.aspx)
-	{
-		struct linger opt;
-		opt.l_onoff = 0; // SO_DONTLINGER
-		opt.l_linger = 0; // Do not care
-		if( sSetsockopt(fd, SOL_SOCKET, SO_LINGER, (char*)&opt, sizeof(opt)) )
-			ShowWarning("setsocketopts: Unable to set SO_LINGER mode for connection #%d!\n", fd);
+	if( uring_req_stale( req ) ){
+		uring_req_free( req );
+		return;
 	}
-	if(delay_timeout){
-#if defined(WIN32)
-		int timeout = delay_timeout * 1000;
-#else
-		struct timeval timeout;
-		timeout.tv_sec = delay_timeout;
-		timeout.tv_usec = 0;
+
+	struct socket_data* s = session[fd];
+
+	if( cqe->res < 0 && cqe->res != -EAGAIN && cqe->res != -EINTR ){
+		// An exception has occured
+#ifdef SHOW_SERVER_STATS
+		socket_data_qo -= s->wdata_size + s->wshared_size;
+#endif
+		uring_session[fd].send = nullptr;
+		uring_req_free( req );
+		s->wdata_size = 0; //Clear the send queue as we can't send anymore. [Skotlex]
+#ifdef WFIFO_SHARED
+		wfifo_shared_clear( fd );
 #endif
+		set_eof( fd );
+		return;
+	}
 
-		if (sSetsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout,sizeof(timeout)) < 0)
-			ShowError("setsocketopts: Unable to set SO_RCVTIMEO timeout for connection #%d!\n", fd);
-		if (sSetsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, (char *)&timeout,sizeof(timeout)) < 0)
-			ShowError("setsocketopts: Unable to set SO_SNDTIMEO timeout for connection #%d!\n", fd);
+	if( cqe->res > 0 ){
+		req->pos += cqe->res;
+		s->wdata_tick = last_tick;
+#ifdef SHOW_SERVER_STATS
+		socket_data_o += cqe->res;
+		if( !s->flag.server ){
+			socket_data_co += cqe->res;
+		}
+#endif
 	}
-}
 
-/*======================================
- *	CORE : Socket Sub Function
- *--------------------------------------*/
-void set_eof(int fd)
-{
-	if( session_isActive(fd) )
-	{
+	if( req->pos < req->len ){
+		// Some data could not be transferred
+		uring_send_prep( req );
+		return;
+	}
+
+	uring_session[fd].send = nullptr;
+	uring_req_free( req );
+
 #ifdef SEND_SHORTLIST
-		// Add this socket to the shortlist for eof handling.
-		send_shortlist_add_fd(fd);
-#endif
-		session[fd]->flag.eof = 1;
+	// Send what has been collected meanwhile
+	if( session_sendpending( s ) ){
+		send_shortlist_add_fd( fd );
 	}
+#endif
 }
 
-int recv_to_fifo(int fd)
-{
-	int len;
+/// Processes all completions.
+static void uring_reap( void ){
+	uint32 head = *uring_cq_head;
 
-	if( !session_isActive(fd) )
-		return -1;
+	for( ;; ){
+		uint32 tail = __atomic_load_n( uring_cq_tail, __ATOMIC_ACQUIRE );
 
-	len = sRecv(fd, (char *) session[fd]->rdata + session[fd]->rdata_size, (int)RFIFOSPACE(fd), 0);
+		if( head == tail ){
+			break;
+		}
 
-	if( len == SOCKET_ERROR )
-	{//An exception has occured
-		if( sErrno != S_EWOULDBLOCK ) {
-			//ShowDebug("recv_to_fifo: %s, closing connection #%d\n", error_msg(), fd);
-			set_eof(fd);
+		for( ; head != tail; head++ ){
+			struct io_uring_cqe cqe = uring_cqes[head & *uring_cq_mask];
+			struct s_uring_req* req = (struct s_uring_req*)cqe.user_data;
+
+			// Let the kernel reuse the entry right away, completions may add new submissions
+			__atomic_store_n( uring_cq_head, head + 1, __ATOMIC_RELEASE );
+
+			if( req == nullptr ){
+				continue;
+			}
+
+			switch( req->op ){
+				case URING_ACCEPT:
+					uring_complete_accept( req, &cqe );
+					break;
+				case URING_RECV:
+					uring_complete_recv( req, &cqe );
+					break;
+				case URING_SEND:
+					uring_complete_send( req, &cqe );
+					break;
+			}
 		}
-		return 0;
 	}
+}
 
-	if( len == 0 )
-	{//Normal connection end.
-		set_eof(fd);
+/// Submits all pending requests and waits up to 'next' milliseconds for completions.
+/// Returns SOCKET_ERROR if it was interrupted by a signal.
+static int uring_wait( t_tick next ){
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+
+	ts.tv_sec = next / 1000;
+	ts.tv_nsec = next % 1000 * 1000000;
+
+	memset( &arg, 0, sizeof( arg ) );
+	arg.ts = (uint64)&ts;
+
+	__atomic_store_n( uring_sq_tail, uring_sq_local_tail, __ATOMIC_RELEASE );
+
+	int ret = uring_enter( uring_sq_local_tail - uring_sq_submitted, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof( arg ) );
+
+	if( ret == SOCKET_ERROR ){
+		if( errno == EINTR ){
+			return SOCKET_ERROR;
+		}
+
+		if( errno != ETIME && errno != EBUSY && errno != EAGAIN ){
+			ShowFatalError( "do_sockets: io_uring_enter() failed, %s!\n", error_msg() );
+			exit( EXIT_FAILURE );
+		}
+
+		// timed out or the completion queue is full - the submissions are retried on the next call
 		return 0;
 	}
 
-	session[fd]->rdata_size += len;
-	session[fd]->rdata_tick = last_tick;
-#ifdef SHOW_SERVER_STATS
-	socket_data_i += len;
-	socket_data_qi += len;
-	if (!session[fd]->flag.server)
-	{
-		socket_data_ci += len;
-	}
-#endif
+	uring_sq_submitted += ret;
+
 	return 0;
 }
 
-int send_from_fifo(int fd)
-{
-	int len;
+/// Arms the next receive for all connections that got data delivered.
+/// Called after the data was parsed.
+static void uring_rearm( void ){
+	int count = uring_rearm_count;
 
-	if( !session_isValid(fd) )
-		return -1;
+	uring_rearm_count = 0;
 
-	if( session[fd]->wdata_size == 0 )
-		return 0; // nothing to send
+	for( int i = 0; i < count; i++ ){
+		int fd = uring_rearm_list[i];
+		struct s_uring_session* us = &uring_session[fd];
 
-	len = sSend(fd, (const char *) session[fd]->wdata, (int)session[fd]->wdata_size, MSG_NOSIGNAL);
+		if( !session_isActive( fd ) || !us->rearm ){
+			us->rearm = false;
+			continue;
+		}
 
-	if( len == SOCKET_ERROR )
-	{//An exception has occured
-		if( sErrno != S_EWOULDBLOCK ) {
-			//ShowDebug("send_from_fifo: %s, ending connection #%d\n", error_msg(), fd);
-#ifdef SHOW_SERVER_STATS
-			socket_data_qo -= session[fd]->wdata_size;
-#endif
-			session[fd]->wdata_size = 0; //Clear the send queue as we can't send anymore. [Skotlex]
-			set_eof(fd);
+		if( RFIFOSPACE( fd ) == 0 ){
+			// Nothing was parsed yet, retry on the next cycle
+			uring_rearm_list[uring_rearm_count++] = fd;
+			continue;
 		}
-		return 0;
+
+		us->rearm = false;
+		uring_recv( fd );
 	}
+}
 
-	if( len > 0 )
-	{
-		session[fd]->wdata_tick = last_tick;
+static void uring_init( void ){
+	struct io_uring_params p;
 
-		// some data could not be transferred?
-		// shift unsent data to the beginning of the queue
-		if( (size_t)len < session[fd]->wdata_size )
-			memmove(session[fd]->wdata, session[fd]->wdata + len, session[fd]->wdata_size - len);
+	memset( &p, 0, sizeof( p ) );
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = 4 * ( URING_ENTRIES > MAXCONN ? URING_ENTRIES : MAXCONN );
 
-		session[fd]->wdata_size -= len;
-#ifdef SHOW_SERVER_STATS
-		socket_data_o += len;
-		socket_data_qo -= len;
-		if (!session[fd]->flag.server)
-		{
-			socket_data_co += len;
-		}
-#endif
+	uring_fd = (int)syscall( __NR_io_uring_setup, URING_ENTRIES, &p );
+
+	if( uring_fd == SOCKET_ERROR ){
+		ShowFatalError( "Failed to create io_uring event dispatcher: %s\n", error_msg() );
+		exit( EXIT_FAILURE );
 	}
 
-	return 0;
-}
+	if( !( p.features & IORING_FEAT_EXT_ARG ) || !( p.features & IORING_FEAT_NODROP ) ){
+		ShowFatalError( "The io_uring event dispatcher requires Linux 5.19 or newer.\n" );
+		exit( EXIT_FAILURE );
+	}
 
-/// Best effort - there's no warranty that the data will be sent.
-void flush_fifo(int fd)
-{
-	if(session[fd] != NULL)
-		session[fd]->func_send(fd);
+	uring_sq_size = p.sq_off.array + p.sq_entries * sizeof( uint32 );
+	uring_cq_size = p.cq_off.cqes + p.cq_entries * sizeof( struct io_uring_cqe );
+
+	if( p.features & IORING_FEAT_SINGLE_MMAP ){
+		uring_sq_size = uring_cq_size = ( uring_sq_size > uring_cq_size ? uring_sq_size : uring_cq_size );
+	}
+
+	uring_sq_ptr = mmap( nullptr, uring_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_SQ_RING );
+
+	if( p.features & IORING_FEAT_SINGLE_MMAP ){
+		uring_cq_ptr = uring_sq_ptr;
+	}else{
+		uring_cq_ptr = mmap( nullptr, uring_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_CQ_RING );
+	}
+
+	uring_sqes_size = p.sq_entries * sizeof( struct io_uring_sqe );
+	uring_sqes = (struct io_uring_sqe*)mmap( nullptr, uring_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_SQES );
+
+	if( uring_sq_ptr == MAP_FAILED || uring_cq_ptr == MAP_FAILED || uring_sqes == MAP_FAILED ){
+		ShowFatalError( "Failed to map io_uring event dispatcher: %s\n", error_msg() );
+		exit( EXIT_FAILURE );
+	}
+
+	uring_sq_head = (uint32*)( (uint8*)uring_sq_ptr + p.sq_off.head );
+	uring_sq_tail = (uint32*)( (uint8*)uring_sq_ptr + p.sq_off.tail );
+	uring_sq_mask = (uint32*)( (uint8*)uring_sq_ptr + p.sq_off.ring_mask );
+	uring_sq_array = (uint32*)( (uint8*)uring_sq_ptr + p.sq_off.array );
+	uring_cq_head = (uint32*)( (uint8*)uring_cq_ptr + p.cq_off.head );
+	uring_cq_tail = (uint32*)( (uint8*)uring_cq_ptr + p.cq_off.tail );
+	uring_cq_mask = (uint32*)( (uint8*)uring_cq_ptr + p.cq_off.ring_mask );
+	uring_cqes = (struct io_uring_cqe*)( (uint8*)uring_cq_ptr + p.cq_off.cqes );
+
+	uring_sq_local_tail = uring_sq_submitted = *uring_sq_tail;
+
+	uring_buffer_init( 0, URING_BUFFERS_SMALL, URING_BUFFER_SIZE_SMALL );
+	uring_buffer_init( 1, URING_BUFFERS_LARGE, URING_BUFFER_SIZE_LARGE );
+
+	memset( uring_session, 0, sizeof( uring_session ) );
+
+	ShowInfo( "Server uses '" CL_WHITE "io_uring" CL_RESET "' with " CL_WHITE "%d" CL_RESET " submission entries as event dispatcher\n", p.sq_entries );
 }
 
-void flush_fifos(void)
-{
-	int i;
-	for(i = 1; i < fd_max; i++)
-		flush_fifo(i);
+static void uring_final( void ){
+	if( uring_fd == SOCKET_ERROR ){
+		return;
+	}
+
+	// Closing the ring cancels everything that is still in flight
+	sClose( uring_fd );
+	uring_fd = SOCKET_ERROR;
+
+	while( uring_requests != nullptr ){
+		uring_req_free( uring_requests );
+	}
+
+	munmap( uring_sqes, uring_sqes_size );
+	if( uring_cq_ptr != uring_sq_ptr ){
+		munmap( uring_cq_ptr, uring_cq_size );
+	}
+	munmap( uring_sq_ptr, uring_sq_size );
+
+	for( size_t i = 0; i < ARRAYLENGTH( uring_buffers ); i++ ){
+		munmap( uring_buffers[i].ring, uring_buffers[i].count * sizeof( struct io_uring_buf ) );
+		munmap( uring_buffers[i].base, uring_buffers[i].count * uring_buffers[i].size );
+	}
 }
+#endif
 
 /*======================================
  *	CORE : Connection functions
@@ -479,6 +2179,13 @@ int connect_client(int listen_fd)
 		ShowError("connect_client: accept failed (%s)!\n", error_msg());
 		return -1;
 	}
+
+	return connect_client_setup(fd, &client_address);
+}
+
+/// Sets up a session for an accepted connection.
+static int connect_client_setup(int fd, struct sockaddr_in* client_address)
+{
 	if( fd == 0 )
 	{// reserved
 		ShowError("connect_client: Socket #0 is reserved - Please report this!!!\n");
@@ -496,31 +2203,39 @@ int connect_client(int listen_fd)
 	set_nonblocking(fd, 1);
 
 #ifndef MINICORE
-	if( ip_rules && !connect_check(ntohl(client_address.sin_addr.s_addr)) ) {
+	if( ip_rules && !connect_check(ntohl(client_address->sin_addr.s_addr)) ) {
 		do_close(fd);
 		return -1;
 	}
 #endif
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IOURING)
+	// io_uring based Event Dispatcher, the receive is armed in create_session
+#elif !defined(SOCKET_EPOLL)
 	// Select Based Event Dispatcher
 	sFD_SET(fd,&readfds);
 #else
 	// Epoll based Event Dispatcher
-	epevent.data.fd = fd;
-	epevent.events = EPOLLIN;
+#ifdef SOCKET_IOTHREADS
+	// Connections handled by I/O threads are registered in the epoll instance of their thread
+	if( iothread_count == 0 )
+#endif
+	{
+		epevent.data.fd = fd;
+		epevent.events = EPOLLIN;
 
-	if( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &epevent ) == SOCKET_ERROR ){
-		ShowError( "connect_client: Failed to add to epoll event dispatcher for new socket #%d: %s\n", fd, error_msg() );
-		sClose( fd );
-		return -1;
+		if( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &epevent ) == SOCKET_ERROR ){
+			ShowError( "connect_client: Failed to add to epoll event dispatcher for new socket #%d: %s\n", fd, error_msg() );
+			sClose( fd );
+			return -1;
+		}
 	}
 #endif
 
 	if( fd_max <= fd ) fd_max = fd + 1;
 
 	create_session(fd, recv_to_fifo, send_from_fifo, default_func_parse);
-	session[fd]->client_addr = ntohl(client_address.sin_addr.s_addr);
+	session[fd]->client_addr = ntohl(client_address->sin_addr.s_addr);
 
 	return fd;
 }
@@ -569,7 +2284,9 @@ int make_listen_bind(uint32 ip, uint16 port)
 		exit(EXIT_FAILURE);
 	}
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IOURING)
+	// io_uring based Event Dispatcher, the accept is armed in create_session
+#elif !defined(SOCKET_EPOLL)
 	// Select Based Event Dispatcher
 	sFD_SET(fd, &readfds);
 #else
@@ -696,18 +2413,26 @@ int make_connection(uint32 ip, uint16 port, bool silent,int timeout) {
 	set_nonblocking(fd, 1);
 #endif
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IOURING)
+	// io_uring based Event Dispatcher, the receive is armed in create_session
+#elif !defined(SOCKET_EPOLL)
 	// Select Based Event Dispatcher
 	sFD_SET(fd,&readfds);
 #else
 	// Epoll based Event Dispatcher
-	epevent.data.fd = fd;
-	epevent.events = EPOLLIN;
+#ifdef SOCKET_IOTHREADS
+	// Connections handled by I/O threads are registered in the epoll instance of their thread
+	if( iothread_count == 0 )
+#endif
+	{
+		epevent.data.fd = fd;
+		epevent.events = EPOLLIN;
 
-	if( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &epevent ) == SOCKET_ERROR ){
-		ShowError( "make_connection: failed to add socket #%d to epoll event dispatcher: %s\n", fd, error_msg() );
-		sClose(fd);
-		return -1;
+		if( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &epevent ) == SOCKET_ERROR ){
+			ShowError( "make_connection: failed to add socket #%d to epoll event dispatcher: %s\n", fd, error_msg() );
+			sClose(fd);
+			return -1;
+		}
 	}
 #endif
 
@@ -731,6 +2456,21 @@ static int create_session(int fd, RecvFunc func_recv, SendFunc func_send, ParseF
 	session[fd]->func_parse = func_parse;
 	session[fd]->rdata_tick = last_tick;
 	session[fd]->wdata_tick = last_tick;
+#ifdef SOCKET_IOTHREADS
+	if( iothread_count > 0 && func_recv == recv_to_fifo ){
+		session[fd]->func_recv = recv_from_iothread;
+		session[fd]->func_send = send_to_iothread;
+		iothread_assign( fd );
+	}
+#endif
+#ifdef SOCKET_IOURING
+	if( func_recv == recv_to_fifo ){
+		session[fd]->func_recv = recv_from_uring;
+		uring_watch( fd );
+	}else if( func_recv == connect_client ){
+		uring_accept( fd );
+	}
+#endif
 	return 0;
 }
 
@@ -740,7 +2480,12 @@ static void delete_session(int fd)
 	{
 #ifdef SHOW_SERVER_STATS
 		socket_data_qi -= session[fd]->rdata_size - session[fd]->rdata_pos;
-		socket_data_qo -= session[fd]->wdata_size;
+		socket_data_qo -= session[fd]->wdata_size + session[fd]->wshared_size;
+#endif
+#ifdef WFIFO_SHARED
+		wfifo_shared_clear(fd);
+		if( session[fd]->wshared )
+			aFree(session[fd]->wshared);
 #endif
 		aFree(session[fd]->rdata);
 		aFree(session[fd]->wdata);
@@ -858,7 +2603,7 @@ int WFIFOSET(int fd, size_t len)
 			return 0;
 		}
 
-		if( s->wdata_size+len > WFIFO_MAX ) {// reached maximum write fifo size
+		if( s->wdata_size+s->wshared_size+len > WFIFO_MAX ) {// reached maximum write fifo size
 			ShowError("WFIFOSET: Maximum write buffer size for client connection %d exceeded, most likely caused by packet 0x%04x (len=%" PRIuPTR ", ip=%lu.%lu.%lu.%lu).\n", fd, WFIFOW(fd,0), len, CONVIP(s->client_addr));
 			set_eof(fd);
 			return 0;
@@ -887,9 +2632,84 @@ int WFIFOSET(int fd, size_t len)
 	return 0;
 }
 
+/// Queues a shared packet buffer for sending, after the data that is already in the write fifo.
+/// The session holds a reference to the buffer until it was sent.
+int WFIFOSHARE(int fd, struct packet_buffer* pb)
+{
+	struct socket_data* s;
+
+	if( !session_isValid(fd) || pb == NULL || pb->len == 0 )
+		return 0;
+
+	s = session[fd];
+
+#ifdef WFIFO_SHARED
+	if( pb->len >= WFIFO_SHARED_MIN )
+	{
+		if( !s->flag.server ) {
+
+			if( pb->len > socket_max_client_packet ) {// see declaration of socket_max_client_packet for details
+				ShowError("WFIFOSHARE: Dropped too large client packet 0x%04x (length=%" PRIuPTR ", max=%" PRIuPTR ").\n", RBUFW(pb->data,0), pb->len, socket_max_client_packet);
+				return 0;
+			}
+
+			if( s->wdata_size+s->wshared_size+pb->len > WFIFO_MAX ) {// reached maximum write fifo size
+				ShowError("WFIFOSHARE: Maximum write buffer size for client connection %d exceeded, most likely caused by packet 0x%04x (len=%" PRIuPTR ", ip=%lu.%lu.%lu.%lu).\n", fd, RBUFW(pb->data,0), pb->len, CONVIP(s->client_addr));
+				set_eof(fd);
+				return 0;
+			}
+
+		}
+
+		if( s->wshared_count == s->max_wshared ) {
+			s->max_wshared = s->max_wshared ? s->max_wshared * 2 : 8;
+			RECREATE(s->wshared, struct wfifo_shared, s->max_wshared);
+		}
+
+		s->wshared[s->wshared_count].offset = s->wdata_size;
+		s->wshared[s->wshared_count].buf = pb;
+		s->wshared_count++;
+		s->wshared_size += pb->len;
+		pb->refcount++;
+#ifdef SHOW_SERVER_STATS
+		socket_data_qo += pb->len;
+#endif
+#ifdef SEND_SHORTLIST
+		send_shortlist_add_fd(fd);
+#endif
+		return 0;
+	}
+#endif
+
+	WFIFOHEAD(fd, pb->len);
+	memcpy(WFIFOP(fd,0), pb->data, pb->len);
+	return WFIFOSET(fd, pb->len);
+}
+
+/// Creates a shared packet buffer holding a copy of the data.
+/// The caller owns the first reference and has to release it.
+struct packet_buffer* packet_buffer_create(const void* data, size_t len)
+{
+	struct packet_buffer* pb = (struct packet_buffer*)aMalloc(sizeof(struct packet_buffer) + len);
+
+	pb->refcount = 1;
+	pb->len = len;
+	if( data != NULL )
+		memcpy(pb->data, data, len);
+
+	return pb;
+}
+
+/// Releases a reference of a shared packet buffer.
+void packet_buffer_release(struct packet_buffer* pb)
+{
+	if( pb != NULL && --pb->refcount <= 0 )
+		aFree(pb);
+}
+
 int do_sockets(t_tick next)
 {
-#ifndef SOCKET_EPOLL
+#if !defined(SOCKET_EPOLL) && !defined(SOCKET_IOURING)
 	fd_set rfd;
 	struct timeval timeout;
 #endif
@@ -905,12 +2725,25 @@ int do_sockets(t_tick next)
 		if(!session[i])
 			continue;
 
-		if(session[i]->wdata_size)
+		if(session_sendpending(session[i]))
 			session[i]->func_send(i);
 	}
 #endif
 
-#ifndef SOCKET_EPOLL
+#ifdef SOCKET_IOTHREADS
+	iothread_flush();
+#endif
+
+#if defined(SOCKET_IOURING)
+	// io_uring based Event Dispatcher
+
+	// submits all requests of this cycle and can timeout until the next tick
+	ret = uring_wait( next );
+
+	if( ret == SOCKET_ERROR ){
+		return 0; // interrupted by a signal, just loop and try again
+	}
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher
 
 	// can timeout until the next tick
@@ -946,7 +2779,10 @@ int do_sockets(t_tick next)
 
 	last_tick = time(NULL);
 
-#if defined(WIN32)
+#if defined(SOCKET_IOURING)
+	// io_uring based completion handling
+	uring_reap();
+#elif defined(WIN32)
 	// on windows, enumerating all members of the fd_set is way faster if we access the internals
 	for( i = 0; i < (int)rfd.fd_count; ++i )
 	{
@@ -963,6 +2799,12 @@ int do_sockets(t_tick next)
 		struct socket_data *sock = session[fd];
 
 		if( !sock ){
+#ifdef SOCKET_IOTHREADS
+			// An I/O thread delivered data, it is processed below
+			if( iothread_is_notify_fd( fd ) ){
+				eventfd_clear( fd );
+			}
+#endif
 			continue;
 		}
 
@@ -974,6 +2816,10 @@ int do_sockets(t_tick next)
 			sock->func_recv( fd );
 		}
 	}
+
+#ifdef SOCKET_IOTHREADS
+	iothread_receive();
+#endif
 #else
 	// otherwise assume that the fd_set is a bit-array and enumerate it in a standard way
 	for( i = 1; ret && i < fd_max; ++i )
@@ -995,7 +2841,7 @@ int do_sockets(t_tick next)
 		if(!session[i])
 			continue;
 
-		if(session[i]->wdata_size)
+		if(session_sendpending(session[i]))
 			session[i]->func_send(i);
 
 		if(session[i]->flag.eof) //func_send can't free a session, this is safe.
@@ -1005,6 +2851,10 @@ int do_sockets(t_tick next)
 	}
 #endif
 
+#ifdef SOCKET_IOTHREADS
+	iothread_flush();
+#endif
+
 	// parse input data on each socket
 	for(i = 1; i < fd_max; i++)
 	{
@@ -1034,6 +2884,15 @@ int do_sockets(t_tick next)
 		RFIFOFLUSH(i);
 	}
 
+#ifdef SOCKET_IOTHREADS
+	// Allow the I/O threads to receive the next data
+	iothread_rearm();
+#endif
+#ifdef SOCKET_IOURING
+	// Receive the next data
+	uring_rearm();
+#endif
+
 #ifdef SHOW_SERVER_STATS
 	if (last_tick != socket_data_last_tick)
 	{
@@ -1356,6 +3215,11 @@ int socket_config_read(const char* cfgName)
 			}
 		}
 #endif
+#ifdef SOCKET_IOTHREADS
+		else if( !strcmpi( w1, "io_threads" ) ){
+			io_threads = atoi( w2 );
+		}
+#endif
 #endif
 		else if (!strcmpi(w1, "import"))
 			socket_config_read(w2);
@@ -1393,6 +3257,14 @@ void socket_final(void)
 		if(session[i])
 			do_close(i);
 
+#ifdef SOCKET_IOTHREADS
+	// Wait until the I/O threads closed all connections
+	iothread_final();
+#endif
+#ifdef SOCKET_IOURING
+	uring_final();
+#endif
+
 	// session[0]
 	aFree(session[0]->rdata);
 	aFree(session[0]->wdata);
@@ -1426,7 +3298,19 @@ void do_close(int fd)
 
 	flush_fifo(fd); // Try to send what's left (although it might not succeed since it's a nonblocking socket)
 
-#ifndef SOCKET_EPOLL
+#ifdef SOCKET_IOTHREADS
+	if( iothread_session[fd].assigned ){
+		// The I/O thread sends what's left and closes the socket
+		iothread_release( fd );
+		if (session[fd]) delete_session(fd);
+		return;
+	}
+#endif
+
+#if defined(SOCKET_IOURING)
+	// io_uring based Event Dispatcher
+	if( session[fd] ) uring_unwatch(fd); // this needs to be done before closing the socket
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher
 	sFD_CLR(fd, &readfds);// this needs to be done before closing the socket
 #else
@@ -1580,7 +3464,10 @@ void socket_init(void)
 	// Get initial local ips
 	naddr_ = socket_getips(addr_,16);
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IOURING)
+	// io_uring based Event Dispatcher
+	uring_init();
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher:
 	sFD_ZERO(&readfds);
 	ShowInfo( "Server uses '" CL_WHITE "select" CL_RESET "' as event dispatcher\n" );
@@ -1605,6 +3492,10 @@ void socket_init(void)
 
 	socket_config_read(SOCKET_CONF_FILENAME);
 
+#ifdef SOCKET_IOTHREADS
+	iothread_init( io_threads );
+#endif
+
 	// initialise last send-receive tick
 	last_tick = time(NULL);
 
@@ -1723,7 +3614,7 @@ void send_shortlist_do_sends()
 		if( session[fd] )
 		{
 			// Send data
-			if( session[fd]->wdata_size )
+			if( session_sendpending(session[fd]) )
 				session[fd]->func_send(fd);
 
 			// If it's been marked as eof, call the parse func on it so that
@@ -1733,7 +3624,7 @@ void send_shortlist_do_sends()
 
 			// If the session still exists, is not eof and has things left to
 			// be sent from it we'll re-add it to the shortlist.
-			if( session[fd] && !session[fd]->flag.eof && session[fd]->wdata_size )
+			if( session[fd] && !session[fd]->flag.eof && session_sendpending(session[fd]) )
 				send_shortlist_add_fd(fd);
 		}
 	}
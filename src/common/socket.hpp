@@ -25,6 +25,16 @@
 
 #define FIFOSIZE_SERVERLINK 256*1024
 
+#ifndef WIN32
+/// Queue shared packet buffers by reference and send them with scatter-gather I/O (writev)
+/// instead of copying them into the write fifo of every receiving session.
+#define WFIFO_SHARED
+#endif
+
+/// Shared packet buffers smaller than this are still copied into the write fifo,
+/// since the copy is cheaper than an additional I/O vector.
+#define WFIFO_SHARED_MIN 64
+
 // socket I/O macros
 #define RFIFOHEAD(fd)
 #define WFIFOHEAD(fd, size) do{ if((fd) && session[fd]->wdata_size + (size) > session[fd]->max_wdata ) realloc_writefifo(fd, size); }while(0)
@@ -83,6 +93,19 @@ typedef int (*RecvFunc)(int fd);
 typedef int (*SendFunc)(int fd);
 typedef int (*ParseFunc)(int fd);
 
+/// Reference counted, immutable packet buffer that can be queued to multiple sessions at once
+struct packet_buffer {
+	int refcount;
+	size_t len;
+	uint8 data[1];
+};
+
+/// Shared packet buffer that is queued after 'offset' bytes of the write fifo
+struct wfifo_shared {
+	size_t offset;
+	struct packet_buffer* buf;
+};
+
 struct socket_data
 {
 	struct {
@@ -100,6 +123,11 @@ struct socket_data
 	time_t rdata_tick; // time of last recv (for detecting timeouts); zero when timeout is disabled
 	time_t wdata_tick; // time of last send (for detecting timeouts);
 
+	struct wfifo_shared* wshared; // shared packet buffers interleaved with the write fifo data
+	size_t wshared_count, max_wshared;
+	size_t wshared_size; // unsent bytes of all shared packet buffers
+	size_t wshared_pos; // bytes of the first shared packet buffer that were already sent
+
 	RecvFunc func_recv;
 	SendFunc func_send;
 	ParseFunc func_parse;
@@ -130,6 +158,7 @@ int make_connection(uint32 ip, uint16 port, bool silent, int timeout);
 int realloc_fifo(int fd, unsigned int rfifo_size, unsigned int wfifo_size);
 int realloc_writefifo(int fd, size_t addition);
 int WFIFOSET(int fd, size_t len);
+int WFIFOSHARE(int fd, struct packet_buffer* pb);
 int RFIFOSKIP(int fd, size_t len);
 
 int do_sockets(t_tick next);
@@ -143,6 +172,9 @@ extern void set_nonblocking(int fd, unsigned long yes);
 
 void set_defaultparse(ParseFunc defaultparse);
 
+struct packet_buffer* packet_buffer_create(const void* data, size_t len);
+void packet_buffer_release(struct packet_buffer* pb);
+
 
 /// Server operation request
 enum chrif_req_op {
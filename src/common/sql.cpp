@@ -7,8 +7,14 @@
 #include "winapi.hpp"
 #endif
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <mysql.h>
 #include <stdlib.h>// strtoul
+#include <thread>
+#include <unordered_map>
 
 #include "cbasetypes.hpp"
 #include "malloc.hpp"
@@ -130,6 +136,101 @@ int Sql_Connect(Sql* self, const char* user, const char* passwd, const char* hos
 
 
 
+/**
+ * Establishes a connection to schema for a handle owned by a background thread.
+ * No keepalive timer is created, the connection reconnects on demand instead.
+ * @param self : sql handle
+ * @param user : username to access
+ * @param passwd : password
+ * @param host : hostname
+ * @param port : port
+ * @param db : schema name
+ * @return SQL_SUCCESS or SQL_ERROR
+ */
+int Sql_ThreadConnect(Sql* self, const char* user, const char* passwd, const char* host, uint16 port, const char* db)
+{
+	if( self == NULL )
+		return SQL_ERROR;
+
+	StringBuf_Clear(&self->buf);
+	if( !mysql_real_connect(&self->handle, host, user, passwd, db, (unsigned int)port, NULL/*unix_socket*/, 0/*clientflag*/) )
+	{
+		ShowSQL("%s\n", mysql_error(&self->handle));
+		return SQL_ERROR;
+	}
+
+	return SQL_SUCCESS;
+}
+
+
+
+/// Prepares the calling background thread for the client library.
+void Sql_ThreadInit(void)
+{
+	mysql_thread_init();
+}
+
+
+
+/// Releases the client library data of the calling background thread.
+void Sql_ThreadFinal(void)
+{
+	mysql_thread_end();
+}
+
+
+
+/// Executes a query from a background thread.
+/// Neither the memory manager, timers nor the console are used, so the handle
+/// may be used by one thread other than the main one.
+/// A query that fails because the server was gone before it was sent is retried once.
+int Sql_ThreadQuery(Sql* self, const char* query, size_t len, char* error, size_t error_len)
+{
+	if( self == NULL )
+		return SQL_ERROR;
+
+	for( int retry = 0; retry < 2; retry++ )
+	{
+		if( mysql_real_query(&self->handle, query, (unsigned long)len) == 0 )
+		{
+			MYSQL_RES* result = mysql_store_result(&self->handle);
+
+			if( result != NULL )
+				mysql_free_result(result);
+			if( mysql_errno(&self->handle) == 0 )
+				return SQL_SUCCESS;
+		}
+
+		unsigned int ecode = mysql_errno(&self->handle);
+
+		// CR_SERVER_GONE_ERROR, reconnect and try again
+		// Not CR_SERVER_LOST, the server may have executed the query before the connection was lost
+		if( retry == 0 && ecode == 2006 && mysql_ping(&self->handle) == 0 )
+			continue;
+		break;
+	}
+
+	if( error != NULL && error_len > 0 )
+		safestrncpy(error, mysql_error(&self->handle), error_len);
+	return SQL_ERROR;
+}
+
+
+
+/// Whether the last query of a background thread failed because the connection was lost.
+bool Sql_ThreadConnectionLost(Sql* self)
+{
+	if( self == NULL )
+		return false;
+
+	unsigned int ecode = mysql_errno(&self->handle);
+
+	// CR_SERVER_GONE_ERROR or CR_SERVER_LOST
+	return ecode == 2006 || ecode == 2013;
+}
+
+
+
 /// Retrieves the timeout of the connection.
 int Sql_GetTimeout(Sql* self, uint32* out_timeout)
 {
@@ -1049,6 +1150,228 @@ void Sql_Init(void) {
 	Sql_inter_server_read(SQL_CONF_NAME,true);
 }
 
+
+
+/*==========================================
+ * Asynchronous executor
+ *------------------------------------------*/
+
+#define SQL_ASYNC_MAX_THREADS 16
+#define SQL_ASYNC_POLL_INTERVAL 10 // ms
+
+/// Job of the asynchronous executor
+struct s_sql_async_job {
+	uint32 key;
+	std::vector<std::string> queries;
+	SqlAsyncCallback callback;
+	std::vector<std::string> errors; ///< Error messages of the failed statements
+};
+
+/// Thread of the asynchronous executor, owns one connection
+struct s_sql_async_worker {
+	Sql* handle;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::deque<s_sql_async_job> jobs;
+	bool stop;
+};
+
+static struct {
+	std::vector<std::unique_ptr<s_sql_async_worker>> workers;
+	std::mutex mutex; ///< Protects done
+	std::condition_variable finished;
+	std::deque<s_sql_async_job> done; ///< Completed jobs waiting for the main thread
+	std::unordered_map<uint32, int> pending; ///< Number of incomplete jobs per key, main thread only
+	int poll_timer = INVALID_TIMER;
+} sql_async;
+
+static void sql_async_worker_main(s_sql_async_worker* worker)
+{
+	char error[256];
+
+	Sql_ThreadInit();
+
+	std::unique_lock<std::mutex> lock(worker->mutex);
+
+	for(;;) {
+		worker->wakeup.wait(lock, [worker]{ return worker->stop || !worker->jobs.empty(); });
+
+		if( worker->jobs.empty() )
+			break; // stop requested and every job executed
+
+		s_sql_async_job job = std::move(worker->jobs.front());
+
+		worker->jobs.pop_front();
+		lock.unlock();
+
+		for( const std::string& query : job.queries ) {
+			if( SQL_SUCCESS != Sql_ThreadQuery(worker->handle, query.c_str(), query.length(), error, sizeof(error)) )
+				job.errors.push_back(std::string(error) + " - " + query.substr(0, 128));
+		}
+
+		{
+			std::lock_guard<std::mutex> done_lock(sql_async.mutex);
+			sql_async.done.push_back(std::move(job));
+		}
+		sql_async.finished.notify_all();
+
+		lock.lock();
+	}
+
+	lock.unlock();
+	Sql_ThreadFinal();
+}
+
+/// Delivers the completed jobs on the main thread.
+static void sql_async_complete(void)
+{
+	std::deque<s_sql_async_job> done;
+
+	{
+		std::lock_guard<std::mutex> lock(sql_async.mutex);
+		done.swap(sql_async.done);
+	}
+
+	for( s_sql_async_job& job : done ) {
+		for( const std::string& error : job.errors )
+			ShowSQL("DB error - %s\n", error.c_str());
+
+		auto it = sql_async.pending.find(job.key);
+
+		if( it != sql_async.pending.end() && --it->second == 0 )
+			sql_async.pending.erase(it);
+
+		if( job.callback )
+			job.callback(job.errors.empty());
+	}
+}
+
+static TIMER_FUNC(sql_async_poll_timer)
+{
+	sql_async.poll_timer = INVALID_TIMER;
+	sql_async_complete();
+
+	if( !sql_async.pending.empty() )
+		sql_async.poll_timer = add_timer(tick + SQL_ASYNC_POLL_INTERVAL, sql_async_poll_timer, 0, 0);
+	return 0;
+}
+
+int Sql_AsyncInit(int threads, const char* user, const char* passwd, const char* host, uint16 port, const char* db, const char* codepage)
+{
+	if( threads > SQL_ASYNC_MAX_THREADS ) {
+		ShowWarning("Sql_AsyncInit: %d threads requested, limiting to %d...\n", threads, SQL_ASYNC_MAX_THREADS);
+		threads = SQL_ASYNC_MAX_THREADS;
+	}
+
+	for( int i = 0; i < threads; i++ ) {
+		std::unique_ptr<s_sql_async_worker> worker(new s_sql_async_worker());
+
+		worker->handle = Sql_Malloc();
+		if( SQL_ERROR == Sql_ThreadConnect(worker->handle, user, passwd, host, port, db) ) {
+			Sql_Free(worker->handle);
+			Sql_AsyncFinal();
+			return SQL_ERROR;
+		}
+		if( codepage != NULL && *codepage && SQL_ERROR == Sql_SetEncoding(worker->handle, codepage) )
+			Sql_ShowDebug(worker->handle);
+
+		worker->stop = false;
+		worker->thread = std::thread(sql_async_worker_main, worker.get());
+		sql_async.workers.push_back(std::move(worker));
+	}
+
+	add_timer_func_list(sql_async_poll_timer, "sql_async_poll_timer");
+	return SQL_SUCCESS;
+}
+
+void Sql_AsyncFinal(void)
+{
+	for( auto& worker : sql_async.workers ) {
+		{
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			worker->stop = true;
+		}
+		worker->wakeup.notify_one();
+	}
+
+	for( auto& worker : sql_async.workers ) {
+		worker->thread.join();
+		Sql_Free(worker->handle);
+	}
+	sql_async.workers.clear();
+
+	sql_async_complete();
+	sql_async.pending.clear();
+
+	if( sql_async.poll_timer != INVALID_TIMER ) {
+		delete_timer(sql_async.poll_timer, sql_async_poll_timer);
+		sql_async.poll_timer = INVALID_TIMER;
+	}
+}
+
+void Sql_AsyncAppend(std::vector<std::string>& queries, const char* query, ...)
+{
+	StringBuf buf;
+	va_list args;
+
+	StringBuf_Init(&buf);
+	va_start(args, query);
+	StringBuf_Vprintf(&buf, query, args);
+	va_end(args);
+
+	queries.emplace_back(StringBuf_Value(&buf), StringBuf_Length(&buf));
+	StringBuf_Destroy(&buf);
+}
+
+void Sql_AsyncExecute(Sql* self, uint32 key, std::vector<std::string>& queries, SqlAsyncCallback callback)
+{
+	if( sql_async.workers.empty() ) {
+		bool success = true;
+
+		for( const std::string& query : queries ) {
+			if( SQL_ERROR == Sql_QueryStr(self, query.c_str()) ) {
+				Sql_ShowDebug(self);
+				success = false;
+			}
+		}
+		queries.clear();
+
+		if( callback )
+			callback(success);
+		return;
+	}
+
+	s_sql_async_worker* worker = sql_async.workers[key % sql_async.workers.size()].get();
+	s_sql_async_job job;
+
+	job.key = key;
+	job.queries.swap(queries);
+	job.callback = std::move(callback);
+
+	sql_async.pending[key]++;
+
+	{
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		worker->jobs.push_back(std::move(job));
+	}
+	worker->wakeup.notify_one();
+
+	if( sql_async.poll_timer == INVALID_TIMER )
+		sql_async.poll_timer = add_timer(gettick() + SQL_ASYNC_POLL_INTERVAL, sql_async_poll_timer, 0, 0);
+}
+
+void Sql_AsyncWait(uint32 key)
+{
+	while( sql_async.pending.find(key) != sql_async.pending.end() ) {
+		{
+			std::unique_lock<std::mutex> lock(sql_async.mutex);
+			sql_async.finished.wait(lock, []{ return !sql_async.done.empty(); });
+		}
+		sql_async_complete();
+	}
+}
+
 #ifdef my_bool
 #undef my_bool
 #endif
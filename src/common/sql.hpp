@@ -4,7 +4,10 @@
 #ifndef SQL_HPP
 #define SQL_HPP
 
+#include <functional>
 #include <stdarg.h>// va_list
+#include <string>
+#include <vector>
 
 #include "cbasetypes.hpp"
 
@@ -99,6 +102,35 @@ int Sql_SetEncoding(Sql* self, const char* encoding);
 
 
 
+/// Establishes a connection to schema for a handle owned by a background thread.
+/// Unlike Sql_Connect no keepalive timer is created.
+///
+/// @return SQL_SUCCESS or SQL_ERROR
+int Sql_ThreadConnect(Sql* self, const char* user, const char* passwd, const char* host, uint16 port, const char* db);
+
+
+
+/// Prepares or releases the calling background thread for the client library.
+void Sql_ThreadInit(void);
+void Sql_ThreadFinal(void);
+
+
+
+/// Executes a query from the background thread owning the handle.
+/// Does not use the memory manager, timers or the console, any result is discarded.
+/// On failure the error message is copied to error.
+///
+/// @return SQL_SUCCESS or SQL_ERROR
+int Sql_ThreadQuery(Sql* self, const char* query, size_t len, char* error, size_t error_len);
+
+
+
+/// Whether the last query of a background thread failed because the connection to the server was lost.
+/// The query may or may not have been executed then.
+bool Sql_ThreadConnectionLost(Sql* self);
+
+
+
 /// Pings the connection.
 ///
 /// @return SQL_SUCCESS or SQL_ERROR
@@ -347,4 +379,43 @@ void SqlStmt_Free(SqlStmt* self);
 
 void Sql_Init(void);
 
+
+
+/// Callback of an asynchronous job, invoked on the main thread.
+/// success is false if any statement of the job failed.
+typedef std::function<void(bool success)> SqlAsyncCallback;
+
+
+
+/// Starts the asynchronous executor with a pool of threads, each owning a connection.
+/// Completed jobs are delivered back to the main thread by a timer.
+///
+/// @return SQL_SUCCESS or SQL_ERROR
+int Sql_AsyncInit(int threads, const char* user, const char* passwd, const char* host, uint16 port, const char* db, const char* codepage);
+
+
+
+/// Stops the asynchronous executor.
+/// Every queued job is executed and its callback invoked before this returns.
+void Sql_AsyncFinal(void);
+
+
+
+/// Formats a statement and appends it to the statements of a job.
+void Sql_AsyncAppend(std::vector<std::string>& queries, const char* query, ...);
+
+
+
+/// Executes the statements of a job in order.
+/// Jobs with the same key run on the same connection in the order they were submitted.
+/// If the executor is not running, the statements are executed right away on self
+/// and the callback is invoked before this returns.
+void Sql_AsyncExecute(Sql* self, uint32 key, std::vector<std::string>& queries, SqlAsyncCallback callback = nullptr);
+
+
+
+/// Blocks until every job submitted with key has completed.
+/// Must be called before reading data that pending jobs of key might still write.
+void Sql_AsyncWait(uint32 key);
+
 #endif /* SQL_HPP */
@@ -11,6 +11,10 @@
 #else
 #endif
 
+#ifdef _MSC_VER
+#include <intrin.h> // _BitScanForward64()
+#endif
+
 #include "cbasetypes.hpp"
 #include "db.hpp"
 #include "malloc.hpp"
@@ -36,16 +40,36 @@ static int free_timer_list_max = 0;
 static int free_timer_list_pos = 0;
 
 
-/// Comparator for the timer heap. (minimum tick at top)
-/// Returns negative if tid1's tick is smaller, positive if tid2's tick is smaller, 0 if equal.
-///
-/// @param tid1 First timer
-/// @param tid2 Second timer
-/// @return negative if tid1 is top, positive if tid2 is top, 0 if equal
-#define DIFFTICK_MINTOPCMP(tid1,tid2) DIFF_TICK(timer_data[tid1].tick,timer_data[tid2].tick)
-
-// timer heap (binary heap of tid's)
-static BHEAP_VAR(int, timer_heap);
+// Hierarchical timing wheel
+// Level 0 has one slot per millisecond, every upper level has slots that span a whole
+// rotation of the level below. Timers of an upper level are moved down (cascaded) when
+// the wheel reaches the start of their slot, so inserting and removing a timer is O(1).
+#define TIMER_WHEEL_BITS0 8 // bits of level 0 (256ms)
+#define TIMER_WHEEL_BITS 6 // bits of the upper levels (16s, 17min, 18h, 49d)
+#define TIMER_WHEEL_LEVELS 5
+#define TIMER_WHEEL_SIZE0 (1<<TIMER_WHEEL_BITS0)
+#define TIMER_WHEEL_SIZE (1<<TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK0 (TIMER_WHEEL_SIZE0-1)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE-1)
+#define TIMER_WHEEL_SLOTS (TIMER_WHEEL_SIZE0 + (TIMER_WHEEL_LEVELS-1)*TIMER_WHEEL_SIZE)
+
+/// Shift of the slot granularity of an upper level
+#define TIMER_WHEEL_SHIFT(level) (TIMER_WHEEL_BITS0 + ((level)-1)*TIMER_WHEEL_BITS)
+/// First slot of an upper level
+#define TIMER_WHEEL_LEVEL(level) (TIMER_WHEEL_SIZE0 + ((level)-1)*TIMER_WHEEL_SIZE)
+
+/// Position of a timer in the wheel
+struct timer_link {
+	int prev, next; // timers in the same slot
+	int slot; // -1 if the timer is not in the wheel
+};
+
+static struct timer_link* timer_links = NULL; // parallel to timer_data
+static int timer_wheel_head[TIMER_WHEEL_SLOTS];
+static int timer_wheel_tail[TIMER_WHEEL_SLOTS];
+static uint64 timer_wheel_used[TIMER_WHEEL_SLOTS/64]; // bitmap of the non-empty slots
+static t_tick timer_wheel_tick; // tick of the current level 0 slot
+static bool timer_wheel_started = false;
 
 
 // server startup time
@@ -196,14 +220,189 @@ t_tick gettick(void)
 //////////////////////////////////////////////////////////////////////////
 
 /*======================================
- * 	CORE : Timer Heap
+ * 	CORE : Timer Wheel
  *--------------------------------------*/
 
-/// Adds a timer to the timer_heap
-static void push_timer_heap(int tid)
+/// Empties the wheel and starts it at the given tick.
+static void timer_wheel_init(t_tick tick)
+{
+	memset(timer_wheel_head, -1, sizeof(timer_wheel_head));
+	memset(timer_wheel_tail, -1, sizeof(timer_wheel_tail));
+	memset(timer_wheel_used, 0, sizeof(timer_wheel_used));
+	timer_wheel_tick = tick;
+	timer_wheel_started = true;
+}
+
+/// Returns the index of the lowest set bit, the value must not be 0.
+static inline int timer_wheel_ffs(uint64 value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return (int)index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+/// Returns the first non-empty slot in [from, to), which must be within the same level, or -1.
+static int timer_wheel_find(int from, int to)
+{
+	while( from < to )
+	{
+		uint64 bits = timer_wheel_used[from/64] >> (from%64);
+
+		if( bits )
+		{
+			int slot = from + timer_wheel_ffs(bits);
+			return ( slot < to ) ? slot : -1;
+		}
+
+		from = (from/64 + 1) * 64;
+	}
+
+	return -1;
+}
+
+/// Adds a timer to the slot of its tick.
+static void timer_wheel_insert(int tid)
+{
+	t_tick tick = timer_data[tid].tick;
+	int slot;
+
+	if( !timer_wheel_started )
+		timer_wheel_init(gettick());
+
+	if( DIFF_TICK(tick, timer_wheel_tick) <= 0 )
+		slot = (int)(timer_wheel_tick & TIMER_WHEEL_MASK0); // already expired, run it with the current slot
+	else if( (tick >> TIMER_WHEEL_BITS0) == (timer_wheel_tick >> TIMER_WHEEL_BITS0) )
+		slot = (int)(tick & TIMER_WHEEL_MASK0);
+	else
+	{
+		int level;
+		t_tick index;
+
+		for( level = 1; level < TIMER_WHEEL_LEVELS; level++ )
+		{
+			index = tick >> TIMER_WHEEL_SHIFT(level);
+
+			if( index - (timer_wheel_tick >> TIMER_WHEEL_SHIFT(level)) <= TIMER_WHEEL_SIZE )
+				break;
+		}
+
+		if( level == TIMER_WHEEL_LEVELS )
+		{// beyond the last level, it is cascaded again when it reaches the last slot
+			level = TIMER_WHEEL_LEVELS - 1;
+			index = (timer_wheel_tick >> TIMER_WHEEL_SHIFT(level)) + TIMER_WHEEL_SIZE;
+		}
+
+		slot = TIMER_WHEEL_LEVEL(level) + (int)(index & TIMER_WHEEL_MASK);
+	}
+
+	timer_links[tid].slot = slot;
+	timer_links[tid].next = INVALID_TIMER;
+	timer_links[tid].prev = timer_wheel_tail[slot];
+
+	if( timer_wheel_tail[slot] != INVALID_TIMER )
+		timer_links[timer_wheel_tail[slot]].next = tid;
+	else
+	{
+		timer_wheel_head[slot] = tid;
+		timer_wheel_used[slot/64] |= UINT64_C(1) << (slot%64);
+	}
+
+	timer_wheel_tail[slot] = tid;
+}
+
+/// Removes a timer from its slot.
+static void timer_wheel_remove(int tid)
+{
+	struct timer_link* link = &timer_links[tid];
+	int slot = link->slot;
+
+	if( link->prev != INVALID_TIMER )
+		timer_links[link->prev].next = link->next;
+	else
+		timer_wheel_head[slot] = link->next;
+
+	if( link->next != INVALID_TIMER )
+		timer_links[link->next].prev = link->prev;
+	else
+		timer_wheel_tail[slot] = link->prev;
+
+	if( timer_wheel_head[slot] == INVALID_TIMER )
+		timer_wheel_used[slot/64] &= ~(UINT64_C(1) << (slot%64));
+
+	link->slot = -1;
+}
+
+/// Moves the timers of the upper level slots that start at the current tick down.
+static void timer_wheel_cascade(void)
 {
-	BHEAP_ENSURE(timer_heap, 1, 256);
-	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP, SWAP);
+	int level;
+
+	for( level = 1; level < TIMER_WHEEL_LEVELS; level++ )
+	{
+		t_tick index = timer_wheel_tick >> TIMER_WHEEL_SHIFT(level);
+		int slot = TIMER_WHEEL_LEVEL(level) + (int)(index & TIMER_WHEEL_MASK);
+		int tid;
+
+		while( (tid = timer_wheel_head[slot]) != INVALID_TIMER )
+		{
+			timer_wheel_remove(tid);
+			timer_wheel_insert(tid);
+		}
+
+		// the next level only starts a new slot if this level completed a rotation
+		if( index & TIMER_WHEEL_MASK )
+			break;
+	}
+}
+
+/// Advances the wheel to the given tick, which must not be beyond the next non-empty slot of level 0 or its next rotation.
+static void timer_wheel_advance(t_tick tick)
+{
+	timer_wheel_tick = tick;
+
+	if( (tick & TIMER_WHEEL_MASK0) == 0 )
+		timer_wheel_cascade();
+}
+
+/// Returns the earliest tick at which a timer can expire, or INFINITE_TICK if there are no timers.
+static t_tick timer_wheel_next(void)
+{
+	t_tick next = INFINITE_TICK;
+	int level, slot;
+
+	// level 0 is exact
+	slot = timer_wheel_find((int)(timer_wheel_tick & TIMER_WHEEL_MASK0), TIMER_WHEEL_SIZE0);
+	if( slot >= 0 )
+		return (timer_wheel_tick & ~(t_tick)TIMER_WHEEL_MASK0) + slot;
+
+	// upper levels give the start of the slot
+	for( level = 1; level < TIMER_WHEEL_LEVELS; level++ )
+	{
+		t_tick index = timer_wheel_tick >> TIMER_WHEEL_SHIFT(level);
+		int first = TIMER_WHEEL_LEVEL(level);
+		int current = (int)(index & TIMER_WHEEL_MASK);
+		int distance;
+		t_tick start;
+
+		// search the slots after the current one, wrapping around
+		if( (slot = timer_wheel_find(first + current + 1, first + TIMER_WHEEL_SIZE)) >= 0 )
+			distance = slot - first - current;
+		else if( (slot = timer_wheel_find(first, first + current + 1)) >= 0 )
+			distance = slot - first + TIMER_WHEEL_SIZE - current;
+		else
+			continue;
+
+		start = (index + distance) << TIMER_WHEEL_SHIFT(level);
+
+		if( next == INFINITE_TICK || DIFF_TICK(start, next) < 0 )
+			next = start;
+	}
+
+	return next;
 }
 
 /*==========================
@@ -227,13 +426,22 @@ static int acquire_timer(void)
 	if( tid >= timer_data_num )
 		for (tid = timer_data_num; tid < timer_data_max && timer_data[tid].type; tid++);
 	if (tid >= timer_data_num && tid >= timer_data_max)
-	{// expand timer array
-		timer_data_max += 256;
+	{// expand timer array (grows with the amount of timers to keep inserting them cheap)
+		int grow = max(256, timer_data_max/2);
+
+		timer_data_max += grow;
 		if( timer_data )
+		{
 			RECREATE(timer_data, struct TimerData, timer_data_max);
+			RECREATE(timer_links, struct timer_link, timer_data_max);
+		}
 		else
+		{
 			CREATE(timer_data, struct TimerData, timer_data_max);
-		memset(timer_data + (timer_data_max - 256), 0, sizeof(struct TimerData)*256);
+			CREATE(timer_links, struct timer_link, timer_data_max);
+		}
+		memset(timer_data + (timer_data_max - grow), 0, sizeof(struct TimerData)*grow);
+		memset(timer_links + (timer_data_max - grow), -1, sizeof(struct timer_link)*grow);
 	}
 
 	if( tid >= timer_data_num )
@@ -255,7 +463,7 @@ int add_timer(t_tick tick, TimerFunc func, int id, intptr_t data)
 	timer_data[tid].data     = data;
 	timer_data[tid].type     = TIMER_ONCE_AUTODEL;
 	timer_data[tid].interval = 1000;
-	push_timer_heap(tid);
+	timer_wheel_insert(tid);
 
 	return tid;
 }
@@ -279,7 +487,7 @@ int add_timer_interval(t_tick tick, TimerFunc func, int id, intptr_t data, int i
 	timer_data[tid].data     = data;
 	timer_data[tid].type     = TIMER_INTERVAL;
 	timer_data[tid].interval = interval;
-	push_timer_heap(tid);
+	timer_wheel_insert(tid);
 
 	return tid;
 }
@@ -323,11 +531,7 @@ t_tick addt_tickimer(int tid, t_tick tick)
 /// Returns the new tick value, or -1 if it fails.
 t_tick sett_tickimer(int tid, t_tick tick)
 {
-	size_t i;
-
-	// search timer position
-	ARR_FIND(0, BHEAP_LENGTH(timer_heap), i, BHEAP_DATA(timer_heap)[i] == tid);
-	if( i == BHEAP_LENGTH(timer_heap) )
+	if( tid < 0 || tid >= timer_data_num || timer_links[tid].slot < 0 )
 	{
 		ShowError("sett_tickimer: no such timer %d (%p(%s))\n", tid, timer_data[tid].func, search_timer_func_list(timer_data[tid].func));
 		return -1;
@@ -339,10 +543,10 @@ t_tick sett_tickimer(int tid, t_tick tick)
 	if( timer_data[tid].tick == tick )
 		return tick;// nothing to do, already in propper position
 
-	// pop and push adjusted timer
-	BHEAP_POPINDEX(timer_heap, i, DIFFTICK_MINTOPCMP, SWAP);
+	// move the timer to the slot of the adjusted tick
+	timer_wheel_remove(tid);
 	timer_data[tid].tick = tick;
-	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP, SWAP);
+	timer_wheel_insert(tid);
 	return tick;
 }
 
@@ -351,18 +555,33 @@ t_tick sett_tickimer(int tid, t_tick tick)
 t_tick do_timer(t_tick tick)
 {
 	t_tick diff = TIMER_MAX_INTERVAL; // return value
+	t_tick next;
+	int tid;
 
-	// process all timers one by one
-	while( BHEAP_LENGTH(timer_heap) )
+	if( !timer_wheel_started )
+		timer_wheel_init(tick);
+
+	// process all slots up to the given tick, one timer at a time
+	while( DIFF_TICK(timer_wheel_tick, tick) <= 0 )
 	{
-		int tid = BHEAP_PEEK(timer_heap);// top element in heap (smallest tick)
+		int slot = (int)(timer_wheel_tick & TIMER_WHEEL_MASK0);
+
+		if( (tid = timer_wheel_head[slot]) == INVALID_TIMER )
+		{
+			if( timer_wheel_tick == tick )
+				break; // no more expired timers to process
+
+			// skip to the next non-empty slot or the next rotation, whichever comes first
+			next = timer_wheel_find(slot + 1, TIMER_WHEEL_SIZE0);
+			next = (timer_wheel_tick & ~(t_tick)TIMER_WHEEL_MASK0) + ( next >= 0 ? next : TIMER_WHEEL_SIZE0 );
+			timer_wheel_advance(DIFF_TICK(next, tick) > 0 ? tick : next);
+			continue;
+		}
 
 		diff = DIFF_TICK(timer_data[tid].tick, tick);
-		if( diff > 0 )
-			break; // no more expired timers to process
 
 		// remove timer
-		BHEAP_POP(timer_heap, DIFFTICK_MINTOPCMP, SWAP);
+		timer_wheel_remove(tid);
 		timer_data[tid].type |= TIMER_REMOVE_HEAP;
 
 		if( timer_data[tid].func )
@@ -385,9 +604,11 @@ t_tick do_timer(t_tick tick)
 			case TIMER_ONCE_AUTODEL:
 				timer_data[tid].type = 0;
 				if (free_timer_list_pos >= free_timer_list_max) {
-					free_timer_list_max += 256;
+					int grow = max(256, free_timer_list_max/2);
+
+					free_timer_list_max += grow;
 					RECREATE(free_timer_list,int,free_timer_list_max);
-					memset(free_timer_list + (free_timer_list_max - 256), 0, 256 * sizeof(int));
+					memset(free_timer_list + (free_timer_list_max - grow), 0, grow * sizeof(int));
 				}
 				free_timer_list[free_timer_list_pos++] = tid;
 			break;
@@ -396,12 +617,15 @@ t_tick do_timer(t_tick tick)
 					timer_data[tid].tick = tick + timer_data[tid].interval;
 				else
 					timer_data[tid].tick += timer_data[tid].interval;
-				push_timer_heap(tid);
+				timer_wheel_insert(tid);
 			break;
 			}
 		}
 	}
 
+	next = timer_wheel_next();
+	diff = ( next == INFINITE_TICK ) ? TIMER_MAX_INTERVAL : DIFF_TICK(next, tick);
+
 	return cap_value(diff, TIMER_MIN_INTERVAL, TIMER_MAX_INTERVAL);
 }
 
@@ -515,6 +739,9 @@ void timer_init(void)
 #endif
 
 	time(&start_time);
+
+	if( !timer_wheel_started )
+		timer_wheel_init(gettick());
 }
 
 void timer_final(void)
@@ -529,6 +756,6 @@ void timer_final(void)
 	}
 
 	if (timer_data) aFree(timer_data);
-	BHEAP_CLEAR(timer_heap);
+	if (timer_links) aFree(timer_links);
 	if (free_timer_list) aFree(free_timer_list);
 }
@@ -34,7 +34,12 @@ using namespace rathena;
 
 void AchievementDatabase::clear(){
 	TypesafeYamlDatabase::clear();
-	this->achievement_mobs.clear();
+
+	for( auto &achievements : this->group_achievements ){
+		achievements.clear();
+	}
+
+	this->mob_achievements.clear();
 }
 
 const std::string AchievementDatabase::getDefaultLocation(){
@@ -161,10 +166,6 @@ uint64 AchievementDatabase::parseBodyNode(const YAML::Node &node){
 					return 0;
 				}
 
-				if( !this->mobexists( mob_id ) ){
-					this->achievement_mobs.push_back( mob_id );
-				}
-
 				target->mob = mob_id;
 			}else{
 				if( !targetExists ){
@@ -316,6 +317,84 @@ uint64 AchievementDatabase::parseBodyNode(const YAML::Node &node){
 	return 1;
 }
 
+/**
+ * Indexes the achievements by group and target monster.
+ */
+void AchievementDatabase::loadingFinished(){
+	for( auto &achievements : this->group_achievements ){
+		achievements.clear();
+	}
+
+	this->mob_achievements.clear();
+
+	for( const auto &it : *this ){
+		std::shared_ptr<s_achievement_db> achievement = it.second;
+
+		if( achievement->group <= AG_NONE || achievement->group >= AG_MAX ){
+			continue;
+		}
+
+		this->group_achievements[achievement->group].push_back( achievement );
+
+		if( achievement->group != AG_BATTLE && achievement->group != AG_TAMING ){
+			continue;
+		}
+
+		for( const auto &target : achievement->targets ){
+			if( target.second->mob == 0 ){
+				continue;
+			}
+
+			std::vector<std::shared_ptr<s_achievement_db>> &achievements = this->mob_achievements[( (uint64)achievement->group << 32 ) | (uint32)target.second->mob];
+
+			// An achievement may have several targets for the same monster
+			if( achievements.empty() || achievements.back() != achievement ){
+				achievements.push_back( achievement );
+			}
+		}
+	}
+
+	auto compare = []( const std::shared_ptr<s_achievement_db> &a, const std::shared_ptr<s_achievement_db> &b ){
+		return a->achievement_id < b->achievement_id;
+	};
+
+	for( auto &achievements : this->group_achievements ){
+		std::sort( achievements.begin(), achievements.end(), compare );
+	}
+
+	for( auto &it : this->mob_achievements ){
+		std::sort( it.second.begin(), it.second.end(), compare );
+	}
+}
+
+/**
+ * Returns the achievements an event can progress
+ * @param group: Achievement group of the event
+ * @param mob_id: Monster ID for AG_BATTLE and AG_TAMING, ignored for other groups
+ * @return Achievements ordered by ID or nullptr if there are none
+ */
+const std::vector<std::shared_ptr<s_achievement_db>>* AchievementDatabase::getAchievements( enum e_achievement_group group, uint32 mob_id ){
+	if( group <= AG_NONE || group >= AG_MAX ){
+		return nullptr;
+	}
+
+	if( group == AG_BATTLE || group == AG_TAMING ){
+		auto it = this->mob_achievements.find( ( (uint64)group << 32 ) | mob_id );
+
+		if( it == this->mob_achievements.end() ){
+			return nullptr;
+		}
+
+		return &it->second;
+	}
+
+	if( this->group_achievements[group].empty() ){
+		return nullptr;
+	}
+
+	return &this->group_achievements[group];
+}
+
 AchievementDatabase achievement_db;
 
 /**
@@ -327,9 +406,7 @@ bool AchievementDatabase::mobexists( uint32 mob_id ){
 	if (!battle_config.feature_achievement)
 		return false;
 
-	auto it = std::find(this->achievement_mobs.begin(), this->achievement_mobs.end(), mob_id);
-
-	return (it != this->achievement_mobs.end()) ? true : false;
+	return this->getAchievements( AG_BATTLE, mob_id ) != nullptr || this->getAchievements( AG_TAMING, mob_id ) != nullptr;
 }
 
 const std::string AchievementLevelDatabase::getDefaultLocation(){
@@ -815,6 +892,37 @@ int *achievement_level(struct map_session_data *sd, bool flag)
 	return info;
 }
 
+/// Arguments of the event whose achievements are updated, the conditions read them as ARG0 to ARG9
+struct s_achievement_arguments {
+	struct map_session_data *sd;
+	const std::array<int, MAX_ACHIEVEMENT_OBJECTIVES> *values;
+};
+
+static struct s_achievement_arguments *achievement_arguments = nullptr; // Arguments of the innermost event being updated
+static std::array<int64, MAX_ACHIEVEMENT_OBJECTIVES> achievement_argument_uids = {}; // Variable IDs of ARG0 to ARG9
+
+/**
+ * Reads an argument of the event whose achievement conditions are evaluated.
+ * @param sd: Player the condition runs for
+ * @param uid: Variable ID of a permanent character variable
+ * @param value: Value of the argument
+ * @return True if the variable is an argument of the event, false if it has to be read from the registry
+ */
+bool achievement_get_argument( struct map_session_data *sd, int64 uid, int64 &value ){
+	if( achievement_arguments == nullptr || achievement_arguments->sd != sd ){
+		return false;
+	}
+
+	for( int i = 0; i < MAX_ACHIEVEMENT_OBJECTIVES; i++ ){
+		if( achievement_argument_uids[i] == uid ){
+			value = ( *achievement_arguments->values )[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
 bool achievement_check_condition( struct script_code* condition, struct map_session_data* sd ){
 	// Save the old script the player was attached to
 	struct script_state* previous_st = sd->st;
@@ -1012,30 +1120,31 @@ void achievement_update_objective(struct map_session_data *sd, enum e_achievemen
 		std::array<int, MAX_ACHIEVEMENT_OBJECTIVES> count = {};
 
 		va_start(ap, arg_count);
-		for (int i = 0; i < arg_count; i++){
-			std::string name = "ARG" + std::to_string(i);
-
+		for (int i = 0; i < arg_count; i++)
 			count[i] = va_arg(ap, int);
-
-			pc_setglobalreg( sd, add_str( name.c_str() ), (int)count[i] );
-		}
 		va_end(ap);
 
 		switch(group) {
 			case AG_CHAT: //! TODO: Not sure how this works officially
 				// These have no objective use.
 				break;
-			default:
-				for (auto &ach : achievement_db)
-					achievement_update_objectives(sd, ach.second, group, count);
-				break;
-		}
+			default: {
+				// Only the achievements of the group, for monsters only those targeting it
+				const std::vector<std::shared_ptr<s_achievement_db>> *achievements = achievement_db.getAchievements(group, count[0]);
+
+				if (achievements == nullptr)
+					break;
 
-		// Remove variables that might have been set
-		for (int i = 0; i < arg_count; i++){
-			std::string name = "ARG" + std::to_string(i);
+				// The conditions read the arguments from this frame instead of the player's registry
+				struct s_achievement_arguments arguments = { sd, &count };
+				struct s_achievement_arguments *previous = achievement_arguments;
 
-			pc_setglobalreg( sd, add_str( name.c_str() ), 0 );
+				achievement_arguments = &arguments;
+				for (const auto &ach : *achievements)
+					achievement_update_objectives(sd, ach, group, count);
+				achievement_arguments = previous;
+				break;
+			}
 		}
 	}
 }
@@ -1079,6 +1188,13 @@ void do_init_achievement(void)
 {
 	if (!battle_config.feature_achievement)
 		return;
+
+	for (int i = 0; i < MAX_ACHIEVEMENT_OBJECTIVES; i++) {
+		std::string name = "ARG" + std::to_string(i);
+
+		achievement_argument_uids[i] = add_str(name.c_str());
+	}
+
 	achievement_read_db();
 }
 
@@ -94,8 +94,11 @@ struct s_achievement_db {
 
 class AchievementDatabase : public TypesafeYamlDatabase<uint32, s_achievement_db>{
 private:
+	// Achievements of each group ordered by ID, so an event only visits the achievements of its group
+	std::vector<std::shared_ptr<s_achievement_db>> group_achievements[AG_MAX];
+	// Achievements of AG_BATTLE and AG_TAMING by group and target monster ID
 	// Avoids checking achievements on every mob killed
-	std::vector<uint32> achievement_mobs;
+	std::unordered_map<uint64, std::vector<std::shared_ptr<s_achievement_db>>> mob_achievements;
 
 public:
 	AchievementDatabase() : TypesafeYamlDatabase( "ACHIEVEMENT_DB", 1 ){
@@ -105,9 +108,11 @@ public:
 	void clear();
 	const std::string getDefaultLocation();
 	uint64 parseBodyNode( const YAML::Node& node );
+	void loadingFinished();
 
 	// Additional
 	bool mobexists(uint32 mob_id);
+	const std::vector<std::shared_ptr<s_achievement_db>>* getAchievements( enum e_achievement_group group, uint32 mob_id );
 };
 
 extern AchievementDatabase achievement_db;
@@ -138,6 +143,7 @@ void achievement_free(struct map_session_data *sd);
 int achievement_check_progress(struct map_session_data *sd, int achievement_id, int type);
 int *achievement_level(struct map_session_data *sd, bool flag);
 bool achievement_check_condition(struct script_code* condition, struct map_session_data* sd);
+bool achievement_get_argument(struct map_session_data *sd, int64 uid, int64 &value);
 void achievement_get_titles(uint32 char_id);
 void achievement_update_objective(struct map_session_data *sd, enum e_achievement_group group, uint8 arg_count, ...);
 void achievement_read_db(void);
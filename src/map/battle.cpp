@@ -8958,6 +8958,8 @@ static const struct _battle_data {
 	{ "ping_time",                          &battle_config.ping_time,                       20,     0,      99999999,       },
 	{ "show_skill_scale",                   &battle_config.show_skill_scale,                1,      0,      1,              },
 	{ "feature.refineui",                   &battle_config.feature_refineui,                3,      0,      3,              },
+	{ "item_bonus_verify",                  &battle_config.item_bonus_verify,               0,      0,      1,              },
+	{ "monster_ai_threads",                 &battle_config.mob_ai_threads,                  1,      0,      64,             },
 
 #include "../custom/battle_config_init.inc"
 };
@@ -682,6 +682,8 @@ struct Battle_Config
 	int ping_time;
 	int show_skill_scale;
 	int feature_refineui;
+	int item_bonus_verify;
+	int mob_ai_threads;
 
 #include "../custom/battle_config_struct.inc"
 };
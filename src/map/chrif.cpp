@@ -8,6 +8,7 @@
 
 #include "../common/cbasetypes.hpp"
 #include "../common/ers.hpp"
+#include "../common/grfio.hpp" // grfio_crc32
 #include "../common/malloc.hpp"
 #include "../common/nullpo.hpp"
 #include "../common/showmsg.hpp"
@@ -46,7 +47,7 @@ static const int packet_len_table[0x3d] = { // U - used, F - free
 	11,10,10, 0,11, -1, 0,10,	// 2b10-2b17: U->2b10, U->2b11, U->2b12, F->2b13, U->2b14, U->2b15, F->2b16, U->2b17
 	 2,10, 2,-1,-1,-1, 2, 7,	// 2b18-2b1f: U->2b18, U->2b19, U->2b1a, U->2b1b, U->2b1c, U->2b1d, U->2b1e, U->2b1f
 	-1,10, 8, 2, 2,14,19,19,	// 2b20-2b27: U->2b20, U->2b21, U->2b22, U->2b23, U->2b24, U->2b25, U->2b26, U->2b27
-	-1, 0, 6,15, 0, 6,-1,-1,	// 2b28-2b2f: U->2b28, F->2b29, U->2b2a, U->2b2b, F->2b2c, U->2b2d, U->2b2e, U->2b2f
+	-1,10, 6,15,-1, 6,-1,-1,	// 2b28-2b2f: U->2b28, U->2b29, U->2b2a, U->2b2b, U->2b2c, U->2b2d, U->2b2e, U->2b2f
  };
 
 //Used Packets:
@@ -98,10 +99,10 @@ static const int packet_len_table[0x3d] = { // U - used, F - free
 //2b26: Outgoing, chrif_authreq -> 'client authentication request'
 //2b27: Incoming, chrif_authfail -> 'client authentication failed'
 //2b28: Outgoing, chrif_req_charban -> 'ban a specific char '
-//2b29: FREE
+//2b29: Incoming, chrif_save_resend -> 'delta save of 2b2c could not be applied, send the complete struct'
 //2b2a: Outgoing, chrif_req_charunban -> 'unban a specific char '
 //2b2b: Incoming, chrif_parse_ack_vipActive -> vip info result
-//2b2c: FREE
+//2b2c: Outgoing, chrif_save_delta -> 'charsave of char XY account XY (changed blocks only)'
 //2b2d: Outgoing, chrif_bsdata_request -> request bonus_script for pc_authok'ed char.
 //2b2e: Outgoing, chrif_bsdata_save -> Send bonus_script of player for saving.
 //2b2f: Incoming, chrif_bsdata_received -> received bonus_script of player for loading.
@@ -119,6 +120,8 @@ int other_mapserver_count=0; //Holds count of how many other map servers are onl
 #define CHECK_INTERVAL 3600000
 //Interval at which map server sends number of connected users. [Skotlex]
 #define UPDATE_INTERVAL 10000
+//Size of the status blocks compared for delta saves.
+#define CHRIF_SAVE_BLOCK 32
 //This define should spare writing the check in every function. [Skotlex]
 #define chrif_check(a) { if(!chrif_isconnected()) return a; }
 
@@ -170,6 +173,13 @@ bool chrif_auth_delete(uint32 account_id, uint32 char_id, enum sd_state state) {
 			if (node->sd->regs.arrays)
 				node->sd->regs.arrays->destroy(node->sd->regs.arrays, script_free_array_db);
 
+			if (node->sd->last_saved_status)
+				aFree(node->sd->last_saved_status);
+			if (node->sd->last_saved_inventory)
+				aFree(node->sd->last_saved_inventory);
+			if (node->sd->last_saved_cart)
+				aFree(node->sd->last_saved_cart);
+
 			aFree(node->sd);
 		}
 
@@ -279,6 +289,108 @@ int chrif_isconnected(void) {
 	return (char_fd > 0 && session[char_fd] != NULL && chrif_state == 2);
 }
 
+/**
+ * Sends only the changed blocks of the character status, compared to the
+ * status last sent to the char-server.
+ * The char-server applies them to its cached copy and verifies the result
+ * with the checksum, otherwise it requests a full save (0x2b29).
+ * ZA 0x2b2c
+ * <cmd>.W <len>.W <aid>.L <cid>.L <quit>.B <base crc>.L <crc>.L <block size>.W <count>.W { <block>.W <data>.?B }*count
+ * @param sd: Player data
+ * @param status: Status to save
+ * @param flag: Save flag types
+ * @return true if the delta was sent, false if a full save is needed
+ */
+static bool chrif_save_delta(struct map_session_data *sd, const struct mmo_charstatus *status, int flag) {
+	const unsigned char *base = (const unsigned char *)sd->last_saved_status;
+	const unsigned char *data = (const unsigned char *)status;
+	const size_t size = sizeof(struct mmo_charstatus);
+	size_t offset, len = 25;
+	uint16 count = 0;
+
+	WFIFOHEAD(char_fd, 25 + (size / CHRIF_SAVE_BLOCK + 1) * (2 + CHRIF_SAVE_BLOCK));
+
+	for( offset = 0; offset < size; offset += CHRIF_SAVE_BLOCK ) {
+		size_t block = umin(CHRIF_SAVE_BLOCK, size - offset);
+
+		if( memcmp(base + offset, data + offset, block) == 0 )
+			continue;
+		if( len + 2 + block >= size + 13 )
+			return false; // Not smaller than a full save
+		WFIFOW(char_fd, len) = (uint16)(offset / CHRIF_SAVE_BLOCK);
+		memcpy(WFIFOP(char_fd, len + 2), data + offset, block);
+		len += 2 + block;
+		count++;
+	}
+
+	WFIFOW(char_fd,0) = 0x2b2c;
+	WFIFOW(char_fd,2) = (uint16)len;
+	WFIFOL(char_fd,4) = sd->status.account_id;
+	WFIFOL(char_fd,8) = sd->status.char_id;
+	WFIFOB(char_fd,12) = (flag&CSAVE_QUIT) ? 1 : 0;
+	WFIFOL(char_fd,13) = (uint32)grfio_crc32(base, size);
+	WFIFOL(char_fd,17) = (uint32)grfio_crc32(data, size);
+	WFIFOW(char_fd,21) = CHRIF_SAVE_BLOCK;
+	WFIFOW(char_fd,23) = count;
+	WFIFOSET(char_fd, len);
+
+	return true;
+}
+
+/**
+ * Sends the character status to the char-server.
+ * Uses a delta save when possible, see save_delta.
+ * @param sd: Player data
+ * @param flag: Save flag types
+ * @param full: Whether to always send the whole status
+ */
+static void chrif_save_status(struct map_session_data *sd, int flag, bool full) {
+	struct mmo_charstatus status;
+
+	memcpy( &status, &sd->status, sizeof( struct mmo_charstatus ) );
+
+	// If the user is on a instance map, we have to fake his current position
+	if( map_getmapdata(sd->bl.m)->instance_id ){
+		// Change his current position to his savepoint
+		memcpy( &status.last_point, &status.save_point, sizeof( struct point ) );
+	}
+
+	// The player is removed after a quitting save, so it could not be resent on failure
+	if( full || !save_delta || sd->last_saved_status == NULL || (flag&CSAVE_QUITTING) || !chrif_save_delta(sd, &status, flag) ) {
+		uint16 mmo_charstatus_len = sizeof(sd->status) + 13;
+
+		WFIFOHEAD(char_fd, mmo_charstatus_len);
+		WFIFOW(char_fd,0) = 0x2b01;
+		WFIFOW(char_fd,2) = mmo_charstatus_len;
+		WFIFOL(char_fd,4) = sd->status.account_id;
+		WFIFOL(char_fd,8) = sd->status.char_id;
+		WFIFOB(char_fd,12) = (flag&CSAVE_QUIT) ? 1 : 0; //Flag to tell char-server this character is quitting.
+		memcpy( WFIFOP( char_fd, 13 ), &status, sizeof( struct mmo_charstatus ) );
+		WFIFOSET(char_fd, WFIFOW(char_fd,2));
+	}
+
+	if( save_delta && !(flag&CSAVE_QUITTING) ) {
+		if( sd->last_saved_status == NULL )
+			CREATE(sd->last_saved_status, struct mmo_charstatus, 1);
+		memcpy( sd->last_saved_status, &status, sizeof( struct mmo_charstatus ) );
+	}
+}
+
+/**
+ * The char-server could not apply a delta save, send the whole status.
+ * AZ 0x2b29
+ * <cmd>.W <aid>.L <cid>.L
+ */
+static void chrif_save_resend(int fd) {
+	struct map_session_data *sd = map_charid2sd(RFIFOL(fd,6));
+
+	if( sd == NULL || sd->status.account_id != RFIFOL(fd,2) )
+		return;
+
+	pc_makesavestatus(sd);
+	chrif_save_status(sd, CSAVE_NORMAL, true);
+}
+
 /**
  * Saves character data.
  * @param sd: Player data
@@ -291,10 +403,11 @@ int chrif_isconnected(void) {
  *  CSAVE_CART: Character changed cart data
  */
 int chrif_save(struct map_session_data *sd, int flag) {
-	uint16 mmo_charstatus_len = 0;
-
 	nullpo_retr(-1, sd);
 
+	if( !(flag&CSAVE_QUITTING) )
+		pc_autosave_saved(sd);
+
 	pc_makesavestatus(sd);
 
 	if ( (flag&CSAVE_QUITTING) && sd->state.active) { //Store player data which is quitting
@@ -312,10 +425,11 @@ int chrif_save(struct map_session_data *sd, int flag) {
 
 	if (sd->storage.dirty)
 		storage_storagesave(sd);
+	// The player is removed after a quitting save, so a delta could not be resent on failure
 	if (flag&CSAVE_INVENTORY)
-		intif_storage_save(sd,&sd->inventory);
+		intif_storage_save(sd,&sd->inventory,!(flag&CSAVE_QUITTING));
 	if (flag&CSAVE_CART)
-		intif_storage_save(sd,&sd->cart);
+		intif_storage_save(sd,&sd->cart,!(flag&CSAVE_QUITTING));
 
 	//For data sync
 	if (sd->state.storage_flag == 2)
@@ -330,30 +444,7 @@ int chrif_save(struct map_session_data *sd, int flag) {
 	if (sd->vars_dirty)
 		intif_saveregistry(sd);
 
-	mmo_charstatus_len = sizeof(sd->status) + 13;
-	WFIFOHEAD(char_fd, mmo_charstatus_len);
-	WFIFOW(char_fd,0) = 0x2b01;
-	WFIFOW(char_fd,2) = mmo_charstatus_len;
-	WFIFOL(char_fd,4) = sd->status.account_id;
-	WFIFOL(char_fd,8) = sd->status.char_id;
-	WFIFOB(char_fd,12) = (flag&CSAVE_QUIT) ? 1 : 0; //Flag to tell char-server this character is quitting.
-
-	// If the user is on a instance map, we have to fake his current position
-	if( map_getmapdata(sd->bl.m)->instance_id ){
-		struct mmo_charstatus status;
-
-		// Copy the whole status
-		memcpy( &status, &sd->status, sizeof( struct mmo_charstatus ) );
-		// Change his current position to his savepoint
-		memcpy( &status.last_point, &status.save_point, sizeof( struct point ) );
-		// Copy the copied status into the packet
-		memcpy( WFIFOP( char_fd, 13 ), &status, sizeof( struct mmo_charstatus ) );
-	} else {
-		// Copy the whole status into the packet
-		memcpy( WFIFOP( char_fd, 13 ), &sd->status, sizeof( struct mmo_charstatus ) );
-	}
-
-	WFIFOSET(char_fd, WFIFOW(char_fd,2));
+	chrif_save_status(sd, flag, false);
 
 	if( sd->status.pet_id > 0 && sd->pd )
 		intif_save_petdata(sd->status.account_id,&sd->pd->pet);
@@ -1813,6 +1904,7 @@ int chrif_parse(int fd) {
 			case 0x2b24: chrif_keepalive_ack(fd); break;
 			case 0x2b25: chrif_deadopt(RFIFOL(fd,2), RFIFOL(fd,6), RFIFOL(fd,10)); break;
 			case 0x2b27: chrif_authfail(fd); break;
+			case 0x2b29: chrif_save_resend(fd); break;
 			case 0x2b2b: chrif_parse_ack_vipActive(fd); break;
 			case 0x2b2f: chrif_bsdata_received(fd); break;
 			default:
@@ -362,7 +362,7 @@ static bool clif_session_isValid(struct map_session_data *sd) {
 
 /*==========================================
  * sub process of clif_send
- * Called from a map_foreachinallarea (grabs all players in specific area and subjects them to this function)
+ * Called for every player collected by map_blocks_inallarea (grabs all players in specific area and subjects them to this function)
  * In order to send area-wise packets, such as:
  * - AREA : everyone nearby your area
  * - AREA_WOSC (AREA WITHOUT SAME CHAT) : Not run for people in the same chat as yours
@@ -370,32 +370,24 @@ static bool clif_session_isValid(struct map_session_data *sd) {
  * - AREA_WOS (AREA WITHOUT SELF) : Not run for self
  * - AREA_CHAT_WOC : Everyone in the area of your chat without a chat
  *------------------------------------------*/
-static int clif_send_sub(struct block_list *bl, va_list ap)
+static int clif_send_sub(struct map_session_data *sd, struct packet_buffer *pb, struct block_list *src_bl, int type)
 {
-	struct block_list *src_bl;
-	struct map_session_data *sd;
-	unsigned char *buf;
-	int len, type, fd;
+	int fd;
 
-	nullpo_ret(bl);
-	nullpo_ret(sd = (struct map_session_data *)bl);
+	nullpo_ret(sd);
+	nullpo_ret(src_bl);
 
 	fd = sd->fd;
 	if (!fd) //Don't send to disconnected clients.
 		return 0;
 
-	buf = va_arg(ap,unsigned char*);
-	len = va_arg(ap,int);
-	nullpo_ret(src_bl = va_arg(ap,struct block_list*));
-	type = va_arg(ap,int);
-
 	switch(type) {
 	case AREA_WOS:
-		if (bl == src_bl)
+		if (&sd->bl == src_bl)
 			return 0;
 	break;
 	case AREA_WOC:
-		if (sd->chatID || bl == src_bl)
+		if (sd->chatID || &sd->bl == src_bl)
 			return 0;
 	break;
 	case AREA_WOSC:
@@ -422,19 +414,7 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
 		!sd->sc.data[SC_INTRAVISION] && battle_check_target(src_bl,&sd->bl,BCT_ENEMY) > 0)
 		return 0;
 
-	WFIFOHEAD(fd, len);
-	if (WFIFOP(fd,0) == buf) {
-		ShowError("WARNING: Invalid use of clif_send function\n");
-		ShowError("         Packet x%4x use a WFIFO of a player instead of to use a buffer.\n", WBUFW(buf,0));
-		ShowError("         Please correct your code.\n");
-		// don't send to not move the pointer of the packet for next sessions in the loop
-		//WFIFOSET(fd,0);//## TODO is this ok?
-		//NO. It is not ok. There is the chance WFIFOSET actually sends the buffer data, and shifts elements around, which will corrupt the buffer.
-		return 0;
-	}
-
-	memcpy(WFIFOP(fd,0), buf, len);
-	WFIFOSET(fd,len);
+	WFIFOSHARE(fd, pb);
 
 	return 0;
 }
@@ -452,20 +432,23 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 	std::shared_ptr<s_battleground_data> bg;
 	int x0 = 0, x1 = 0, y0 = 0, y1 = 0, fd;
 	struct s_mapiterator* iter;
+	struct packet_buffer* pb;
+	int ret = 0;
 
 	if( type != ALL_CLIENT )
 		nullpo_ret(bl);
 
 	sd = BL_CAST(BL_PC, bl);
 
+	// The packet is copied once and shared by all receiving sessions
+	pb = ( type != SELF ) ? packet_buffer_create(buf, len) : NULL;
+
 	switch(type) {
 
 	case ALL_CLIENT: //All player clients.
 		iter = mapit_getallusers();
 		while( (tsd = (TBL_PC*)mapit_next(iter)) != NULL ){
-			WFIFOHEAD(tsd->fd, len);
-			memcpy(WFIFOP(tsd->fd, 0), buf, len);
-			WFIFOSET(tsd->fd, len);
+			WFIFOSHARE(tsd->fd, pb);
 		}
 		mapit_free(iter);
 		break;
@@ -475,9 +458,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 		while( (tsd = (TBL_PC*)mapit_next(iter)) != NULL )
 		{
 			if( bl->m == tsd->bl.m ){
-				WFIFOHEAD(tsd->fd, len);
-				memcpy(WFIFOP(tsd->fd,0), buf, len);
-				WFIFOSET(tsd->fd,len);
+				WFIFOSHARE(tsd->fd, pb);
 			}
 		}
 		mapit_free(iter);
@@ -489,12 +470,14 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			clif_send (buf, len, bl, SELF);
 	case AREA_WOC:
 	case AREA_WOS:
-		map_foreachinallarea(clif_send_sub, bl->m, bl->x-AREA_SIZE, bl->y-AREA_SIZE, bl->x+AREA_SIZE, bl->y+AREA_SIZE,
-			BL_PC, buf, len, bl, type);
+		map_blocks_inallarea(bl->m, bl->x-AREA_SIZE, bl->y-AREA_SIZE, bl->x+AREA_SIZE, bl->y+AREA_SIZE, BL_PC).each([&](struct block_list* tbl) {
+			return clif_send_sub((TBL_PC*)tbl, pb, bl, type);
+		});
 		break;
 	case AREA_CHAT_WOC:
-		map_foreachinallarea(clif_send_sub, bl->m, bl->x-(AREA_SIZE-5), bl->y-(AREA_SIZE-5),
-			bl->x+(AREA_SIZE-5), bl->y+(AREA_SIZE-5), BL_PC, buf, len, bl, AREA_WOC);
+		map_blocks_inallarea(bl->m, bl->x-(AREA_SIZE-5), bl->y-(AREA_SIZE-5), bl->x+(AREA_SIZE-5), bl->y+(AREA_SIZE-5), BL_PC).each([&](struct block_list* tbl) {
+			return clif_send_sub((TBL_PC*)tbl, pb, bl, AREA_WOC);
+		});
 		break;
 
 	case CHAT:
@@ -512,9 +495,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 				if (type == CHAT_WOS && cd->usersd[i] == sd)
 					continue;
 				if ((fd=cd->usersd[i]->fd) >0 && session[fd]){ // Added check to see if session exists [PoW]
-					WFIFOHEAD(fd,len);
-					memcpy(WFIFOP(fd,0), buf, len);
-					WFIFOSET(fd,len);
+					WFIFOSHARE(fd, pb);
 				}
 			}
 		}
@@ -550,9 +531,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 				if( (type == PARTY_AREA || type == PARTY_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 					continue;
 
-				WFIFOHEAD(fd, len);
-				memcpy(WFIFOP(fd, 0), buf, len);
-				WFIFOSET(fd, len);
+				WFIFOSHARE(fd, pb);
 			}
 			if (!enable_spy) //Skip unnecessary parsing. [Skotlex]
 				break;
@@ -561,9 +540,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			while( (tsd = (TBL_PC*)mapit_next(iter)) != NULL )
 			{
 				if( tsd->partyspy == p->party.party_id ){
-					WFIFOHEAD(tsd->fd, len);
-					memcpy(WFIFOP(tsd->fd,0), buf, len);
-					WFIFOSET(tsd->fd,len);
+					WFIFOSHARE(tsd->fd, pb);
 				}
 			}
 			mapit_free(iter);
@@ -580,9 +557,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			if( type == DUEL_WOS && bl->id == tsd->bl.id )
 				continue;
 			if( sd->duel_group == tsd->duel_group ){
-				WFIFOHEAD(tsd->fd, len);
-				memcpy(WFIFOP(tsd->fd,0), buf, len);
-				WFIFOSET(tsd->fd,len);
+				WFIFOSHARE(tsd->fd, pb);
 			}
 		}
 		mapit_free(iter);
@@ -630,9 +605,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 					if( (type == GUILD_AREA || type == GUILD_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 						continue;
 
-					WFIFOHEAD(fd,len);
-					memcpy(WFIFOP(fd,0), buf, len);
-					WFIFOSET(fd,len);
+					WFIFOSHARE(fd, pb);
 				}
 			}
 			if (!enable_spy) //Skip unnecessary parsing. [Skotlex]
@@ -642,9 +615,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			while( (tsd = (TBL_PC*)mapit_next(iter)) != NULL )
 			{
 				if( tsd->guildspy == g->guild_id ){
-					WFIFOHEAD(tsd->fd, len);
-					memcpy(WFIFOP(tsd->fd,0), buf, len);
-					WFIFOSET(tsd->fd,len);
+					WFIFOSHARE(tsd->fd, pb);
 				}
 			}
 			mapit_free(iter);
@@ -672,9 +643,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 					continue;
 				if( (type == BG_AREA || type == BG_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 					continue;
-				WFIFOHEAD(fd,len);
-				memcpy(WFIFOP(fd,0), buf, len);
-				WFIFOSET(fd,len);
+				WFIFOSHARE(fd, pb);
 			}
 		}
 		break;
@@ -687,9 +656,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 					continue;
 				}
 
-				WFIFOHEAD(fd,len);
-				memcpy(WFIFOP(fd,0), buf, len);
-				WFIFOSET(fd,len);
+				WFIFOSHARE(fd, pb);
 			}
 
 			if (!enable_spy) //Skip unnecessary parsing. [Skotlex]
@@ -698,9 +665,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			iter = mapit_getallusers();
 			while ((tsd = (TBL_PC*)mapit_next(iter)) != NULL){
 				if (tsd->clanspy == clan->id){
-					WFIFOHEAD(tsd->fd, len);
-					memcpy(WFIFOP(tsd->fd, 0), buf, len);
-					WFIFOSET(tsd->fd, len);
+					WFIFOSHARE(tsd->fd, pb);
 				}
 			}
 			mapit_free(iter);
@@ -709,10 +674,13 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 
 	default:
 		ShowError("clif_send: Unrecognized type %d\n",type);
-		return -1;
+		ret = -1;
+		break;
 	}
 
-	return 0;
+	packet_buffer_release(pb);
+
+	return ret;
 }
 
 
@@ -3129,18 +3097,14 @@ void clif_guild_xy_remove(struct map_session_data *sd)
 /*==========================================
  *
  *------------------------------------------*/
-static int clif_hpmeter_sub(struct block_list *bl, va_list ap)
+static int clif_hpmeter_sub(struct map_session_data *tsd, struct map_session_data *sd)
 {
-	struct map_session_data *sd, *tsd;
 #if PACKETVER < 20100126
 	const int cmd = 0x106;
 #else
 	const int cmd = 0x80e;
 #endif
 
-	sd = va_arg(ap, struct map_session_data *);
-	tsd = (TBL_PC *)bl;
-
 	nullpo_ret(sd);
 	nullpo_ret(tsd);
 
@@ -3176,7 +3140,9 @@ static int clif_hpmeter_sub(struct block_list *bl, va_list ap)
 static int clif_hpmeter(struct map_session_data *sd)
 {
 	nullpo_ret(sd);
-	map_foreachinallarea(clif_hpmeter_sub, sd->bl.m, sd->bl.x-AREA_SIZE, sd->bl.y-AREA_SIZE, sd->bl.x+AREA_SIZE, sd->bl.y+AREA_SIZE, BL_PC, sd);
+	map_blocks_inallarea(sd->bl.m, sd->bl.x-AREA_SIZE, sd->bl.y-AREA_SIZE, sd->bl.x+AREA_SIZE, sd->bl.y+AREA_SIZE, BL_PC).each([sd](struct block_list* bl) {
+		return clif_hpmeter_sub((TBL_PC*)bl, sd);
+	});
 	return 0;
 }
 
@@ -2413,7 +2413,7 @@ void do_init_guild(void) {
 	};
 	int i;
 	
-	guild_db           = idb_alloc(DB_OPT_RELEASE_DATA);
+	guild_db           = idb_flat_alloc(DB_OPT_RELEASE_DATA);
 	castle_db          = idb_alloc(DB_OPT_BASE);
 	guild_expcache_db  = idb_alloc(DB_OPT_BASE);
 	guild_infoevent_db = idb_alloc(DB_OPT_BASE);
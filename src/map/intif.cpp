@@ -5,6 +5,7 @@
 
 #include <stdlib.h>
 
+#include "../common/grfio.hpp" // grfio_crc32
 #include "../common/malloc.hpp"
 #include "../common/mmo.hpp"
 #include "../common/nullpo.hpp"
@@ -43,7 +44,7 @@ static const int packet_len_table[] = {
 	-1,-1, 7, 7,  7,11, 8,-1,  0, 0, 0, 0,  0, 0,  0, 0, //0x3850  Auctions [Zephyrus] itembound[Akinari]
 	-1, 7,-1, 7, 14, 0, 0, 0,  0, 0, 0, 0,  0, 0,  0, 0, //0x3860  Quests [Kevin] [Inkfish] / Achievements [Aleos]
 	-1, 3, 3, 0,  0, 0, 0, 0,  0, 0, 0, 0, -1, 3,  3, 0, //0x3870  Mercenaries [Zephyrus] / Elemental [pakpil]
-	12,-1, 7, 3,  0, 0, 0, 0,  0, 0,-1, 9, -1, 0,  0, 0, //0x3880  Pet System,  Storages
+	12,-1, 7, 3,  0, 0, 0, 0,  0, 0,-1, 9, -1,11,  0, 0, //0x3880  Pet System,  Storages
 	-1,-1, 7, 3,  0, 0, 0, 0,  0, 0, 0, 0,  0, 0,  0, 0, //0x3890  Homunculus [albator]
 	-1,-1, 8, 0,  0, 0, 0, 0,  0, 0, 0, 0,  0, 0,  0, 0, //0x38A0  Clans
 };
@@ -3388,6 +3389,8 @@ void intif_parse_itembound_store2gstorage(int fd) {
 }
 #endif
 
+static void intif_storage_setbase(struct map_session_data *sd, struct s_storage *stor);
+
 /**
  * Receive inventory/cart/storage data for player
  * IZ 0x388a <size>.W <type>.B <account_id>.L <result>.B <storage>.?B
@@ -3447,6 +3450,7 @@ static bool intif_parse_StorageReceived(int fd)
 	}
 
 	memcpy(stor, p, sz_stor); //copy the items data to correct destination
+	intif_storage_setbase(sd, stor); // The char-server bases delta saves on the items it sent
 
 	switch (type) {
 		case TABLE_INVENTORY: {
@@ -3583,6 +3587,118 @@ bool intif_storage_request(struct map_session_data *sd, enum storage_type type,
 	return true;
 }
 
+/**
+ * Get the base of delta saves of an inventory or cart, see intif_storage_save_delta
+ * @param sd: Player
+ * @param stor: Inventory or cart of the player
+ * @param items: Items of the storage
+ * @param max: Number of slots
+ * @return Pointer to the base, nullptr for other storage types
+ */
+static struct item** intif_storage_base(struct map_session_data *sd, struct s_storage *stor, struct item **items, int *max)
+{
+	switch (stor->type) {
+		case TABLE_INVENTORY:
+			*items = stor->u.items_inventory;
+			*max = MAX_INVENTORY;
+			return &sd->last_saved_inventory;
+		case TABLE_CART:
+			*items = stor->u.items_cart;
+			*max = MAX_CART;
+			return &sd->last_saved_cart;
+		default:
+			return nullptr;
+	}
+}
+
+/**
+ * Remember the items of an inventory or cart as the char-server has them now
+ * The row ids are left out, the char-server keeps them per slot.
+ * @param sd: Player
+ * @param stor: Inventory or cart of the player
+ */
+static void intif_storage_setbase(struct map_session_data *sd, struct s_storage *stor)
+{
+	struct item *items, **base;
+	int max;
+
+	if (!save_delta || (base = intif_storage_base(sd, stor, &items, &max)) == nullptr)
+		return;
+
+	if (*base == nullptr)
+		CREATE(*base, struct item, max);
+	memcpy(*base, items, sizeof(struct item) * max);
+	for (int i = 0; i < max; i++)
+		(*base)[i].id = 0;
+}
+
+/**
+ * Sends only the slots of an inventory or cart that changed since the items last sent to the char-server.
+ * The char-server writes them by the row ids it keeps per slot, without reading the table,
+ * and asks for the complete items (0x388d) if its copy does not match the base.
+ * ZI 0x308c <size>.W <type>.B <account_id>.L <char_id>.L <base crc>.L <crc>.L <count>.W { <index>.W <item>.?B }*count
+ * @param sd: Player
+ * @param stor: Inventory or cart of the player
+ * @return true if the delta was sent, false if a full save is needed
+ */
+static bool intif_storage_save_delta(struct map_session_data *sd, struct s_storage *stor)
+{
+	const int entry_size = 2 + sizeof(struct item);
+	struct item *items, **base;
+	int max, len = 23;
+	uint16 count = 0;
+
+	if (!save_delta || (base = intif_storage_base(sd, stor, &items, &max)) == nullptr || *base == nullptr)
+		return false;
+
+	WFIFOHEAD(inter_fd, 23 + max * entry_size);
+	WFIFOL(inter_fd, 13) = (uint32)grfio_crc32((unsigned char*)*base, sizeof(struct item) * max);
+
+	// Compare without the row ids and move the base along
+	for (int i = 0; i < max; i++) {
+		struct item item;
+
+		memcpy(&item, &items[i], sizeof(struct item)); // Copy the padding as well, it is part of the crc
+		item.id = 0;
+		if (memcmp(&item, &(*base)[i], sizeof(struct item)) == 0)
+			continue;
+		WFIFOW(inter_fd, len) = i;
+		memcpy(WFIFOP(inter_fd, len + 2), &item, sizeof(struct item));
+		memcpy(&(*base)[i], &item, sizeof(struct item));
+		len += entry_size;
+		count++;
+	}
+
+	// Also sent without changes, the cart is reloaded on the save acknowledgement when vending
+	WFIFOW(inter_fd, 0) = 0x308c;
+	WFIFOW(inter_fd, 2) = len;
+	WFIFOB(inter_fd, 4) = stor->type;
+	WFIFOL(inter_fd, 5) = sd->status.account_id;
+	WFIFOL(inter_fd, 9) = sd->status.char_id;
+	WFIFOL(inter_fd, 17) = (uint32)grfio_crc32((unsigned char*)*base, sizeof(struct item) * max);
+	WFIFOW(inter_fd, 21) = count;
+	WFIFOSET(inter_fd, len);
+	return true;
+}
+
+/**
+ * The char-server could not apply a delta save of an inventory or cart, send the complete items.
+ * IZ 0x388d <account_id>.L <char_id>.L <type>.B
+ * @param fd
+ */
+static void intif_parse_StorageResend(int fd)
+{
+	struct map_session_data *sd = map_charid2sd(RFIFOL(fd, 6));
+
+	if (sd == nullptr || sd->status.account_id != RFIFOL(fd, 2))
+		return;
+
+	switch (RFIFOB(fd, 10)) {
+		case TABLE_INVENTORY: intif_storage_save(sd, &sd->inventory); break;
+		case TABLE_CART: intif_storage_save(sd, &sd->cart); break;
+	}
+}
+
 /**
  * Request to save inventory/cart/storage data from player
  * ZI 0x308b <size>.W <type>.B <account_id>.L <char_id>.L <entries>.?B
@@ -3590,7 +3706,7 @@ bool intif_storage_request(struct map_session_data *sd, enum storage_type type,
  * @param stor: Storage data
  * @ return false - error, true - message sent
  */
-bool intif_storage_save(struct map_session_data *sd, struct s_storage *stor)
+bool intif_storage_save(struct map_session_data *sd, struct s_storage *stor, bool delta)
 {
 	int stor_size = sizeof(struct s_storage);
 
@@ -3600,6 +3716,9 @@ bool intif_storage_save(struct map_session_data *sd, struct s_storage *stor)
 	if (CheckForCharServer())
 		return false;
 
+	if (delta && intif_storage_save_delta(sd, stor))
+		return true;
+
 	WFIFOHEAD(inter_fd, stor_size+13);
 	WFIFOW(inter_fd, 0) = 0x308b;
 	WFIFOW(inter_fd, 2) = stor_size+13;
@@ -3608,6 +3727,8 @@ bool intif_storage_save(struct map_session_data *sd, struct s_storage *stor)
 	WFIFOL(inter_fd, 9) = sd->status.char_id;
 	memcpy(WFIFOP(inter_fd, 13), stor, stor_size);
 	WFIFOSET(inter_fd, stor_size+13);
+
+	intif_storage_setbase(sd, stor);
 	return true;
 }
 
@@ -3816,6 +3937,7 @@ int intif_parse(int fd)
 	case 0x388a:	intif_parse_StorageReceived(fd); break;
 	case 0x388b:	intif_parse_StorageSaved(fd); break;
 	case 0x388c:	intif_parse_StorageInfo_recv(fd); break;
+	case 0x388d:	intif_parse_StorageResend(fd); break;
 
 	// Homunculus System
 	case 0x3890:	intif_parse_CreateHomunculus(fd); break;
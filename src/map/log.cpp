@@ -3,13 +3,22 @@
 
 #include "log.hpp"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "../common/cbasetypes.hpp"
 #include "../common/nullpo.hpp"
 #include "../common/showmsg.hpp"
 #include "../common/sql.hpp" // SQL_INNODB
 #include "../common/strlib.hpp"
+#include "../common/timer.hpp"
+#include "../common/utils.hpp" // cap_value
 
 #include "battle.hpp"
 #include "homunculus.hpp"
@@ -54,6 +63,214 @@ struct Log_Config log_config;
 #define LOG_QUERY "INSERT DELAYED"
 #endif
 
+/// Upper size of a batched statement, kept well below the default max_allowed_packet
+#define LOG_BATCH_MAX_LENGTH (512*1024)
+
+/// Multi-row INSERT being collected for one statement head
+struct s_log_batch {
+	std::string query;
+	std::vector<size_t> rows; ///< Offset of each row in query, the statement head ends at the first one
+};
+
+/// Asynchronous SQL log writer.
+/// Rows are formatted and escaped by the main thread and collected into one
+/// multi-row INSERT per statement head. A batch is handed over to the writer
+/// thread once it holds log_config.sql_batch_rows rows, or when the flush timer
+/// runs. The writer owns a separate connection to the log database.
+static struct {
+	bool active;
+	Sql* handle;
+	int flush_timer;
+	std::unordered_map<std::string, s_log_batch> batches; ///< Pending batch per INSERT head
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wakeup; ///< Wakes the writer for new statements or shutdown
+	std::condition_variable drained; ///< Wakes the main thread when the queue has room again
+	std::deque<s_log_batch> queue; ///< Statements waiting for or being executed by the writer
+	size_t queue_length; ///< Total length of the statements in queue
+	bool stop;
+	std::vector<std::string> errors; ///< Failed statements, reported by the main thread
+} log_writer;
+
+/**
+ * Executes a batch on the writer thread.
+ * When the batch fails for another reason than a lost connection, one of its rows is invalid.
+ * The rows are then written one by one, so only the invalid ones are lost.
+ * @param batch: Batch to execute
+ * @param errors: Receives the failed statements
+ */
+static void log_writer_execute(const s_log_batch& batch, std::vector<std::string>& errors)
+{
+	char error[256];
+
+	if( SQL_SUCCESS == Sql_ThreadQuery(log_writer.handle, batch.query.c_str(), batch.query.length(), error, sizeof(error)) )
+		return;
+
+	if( batch.rows.size() == 1 ) {
+		errors.push_back(std::string(error) + " - " + batch.query);
+		return;
+	}
+
+	std::string head = batch.query.substr(0, batch.rows[0]);
+
+	if( Sql_ThreadConnectionLost(log_writer.handle) ) {
+		errors.push_back(std::string(error) + " - " + std::to_string(batch.rows.size()) + " row(s) lost: " + head + "...");
+		return;
+	}
+
+	for( size_t i = 0; i < batch.rows.size(); i++ ) {
+		// Rows are separated by a comma
+		size_t end = ( i + 1 < batch.rows.size() ) ? batch.rows[i + 1] - 1 : batch.query.length();
+		std::string query = head + batch.query.substr(batch.rows[i], end - batch.rows[i]);
+
+		if( SQL_SUCCESS == Sql_ThreadQuery(log_writer.handle, query.c_str(), query.length(), error, sizeof(error)) )
+			continue;
+
+		if( Sql_ThreadConnectionLost(log_writer.handle) ) {
+			errors.push_back(std::string(error) + " - " + std::to_string(batch.rows.size() - i) + " row(s) lost: " + head + "...");
+			return;
+		}
+
+		errors.push_back(std::string(error) + " - " + query);
+	}
+}
+
+/// Writer thread, executes the queued statements.
+/// On shutdown it only exits once the queue is empty.
+static void log_writer_main(void)
+{
+	Sql_ThreadInit();
+
+	std::unique_lock<std::mutex> lock(log_writer.mutex);
+
+	for(;;) {
+		log_writer.wakeup.wait(lock, []{ return log_writer.stop || !log_writer.queue.empty(); });
+
+		if( log_writer.queue.empty() )
+			break; // stop requested and everything written
+
+		// Keep the statement queued while it runs, so its length counts against the limit
+		const s_log_batch& batch = log_writer.queue.front();
+		size_t length = batch.query.length();
+		std::vector<std::string> errors;
+
+		lock.unlock();
+		log_writer_execute(batch, errors);
+		lock.lock();
+
+		for( std::string& error : errors )
+			log_writer.errors.push_back(std::move(error));
+		log_writer.queue.pop_front();
+		log_writer.queue_length -= length;
+		log_writer.drained.notify_one();
+	}
+
+	lock.unlock();
+	Sql_ThreadFinal();
+}
+
+/// Shows the errors reported by the writer thread.
+static void log_writer_report(void)
+{
+	std::vector<std::string> errors;
+
+	{
+		std::lock_guard<std::mutex> lock(log_writer.mutex);
+		errors.swap(log_writer.errors);
+	}
+
+	for( const std::string& error : errors )
+		ShowSQL("Log writer: DB error - %s\n", error.c_str());
+}
+
+/// Hands a batch over to the writer thread, leaving it empty.
+/// Blocks while the queue already holds log_config.sql_queue_size KB, so memory stays bounded and no log is lost.
+static void log_writer_push(s_log_batch& batch)
+{
+	size_t limit = (size_t)log_config.sql_queue_size * 1024;
+	size_t length = batch.query.length();
+	std::unique_lock<std::mutex> lock(log_writer.mutex);
+
+	if( log_writer.queue_length > 0 && log_writer.queue_length + length > limit ) {
+		ShowWarning("log_writer_push: Log queue is full (%" PRIuPTR " bytes), waiting for the database...\n", log_writer.queue_length);
+		log_writer.drained.wait(lock, [&]{ return log_writer.queue_length == 0 || log_writer.queue_length + length <= limit; });
+	}
+
+	log_writer.queue_length += length;
+	log_writer.queue.push_back(std::move(batch));
+	batch.query.clear();
+	batch.rows.clear();
+	log_writer.wakeup.notify_one();
+}
+
+/// Hands all pending batches over to the writer thread.
+static void log_writer_flush(void)
+{
+	for( auto& it : log_writer.batches ) {
+		s_log_batch& batch = it.second;
+
+		if( batch.rows.empty() )
+			continue;
+		log_writer_push(batch);
+	}
+}
+
+static TIMER_FUNC(log_writer_flush_timer){
+	log_writer_flush();
+	log_writer_report();
+	return 0;
+}
+
+/// Escapes at most max_len characters of str for a quoted SQL value.
+/// @param out: Buffer of at least max_len*2+1 characters
+static char* log_sql_escape(char* out, const char* str, size_t max_len)
+{
+	Sql_EscapeStringLen(logmysql_handle, out, str, safestrnlen(str, max_len));
+	return out;
+}
+
+/**
+ * Inserts a row into a log table, through the writer thread when it is active.
+ * The time of the event is taken now, since batched rows reach the database later.
+ * @param table: Log table
+ * @param time_column: Column receiving the time of the event
+ * @param columns: Remaining columns
+ * @param values: Escaped values of the remaining columns
+ */
+static void log_sql_insert(const char* table, const char* time_column, const char* columns, const char* values)
+{
+	StringBuf head;
+
+	StringBuf_Init(&head);
+	StringBuf_Printf(&head, "%s INTO `%s` (`%s`, %s) VALUES", LOG_QUERY, table, time_column, columns);
+
+	if( !log_writer.active ) {
+		if( SQL_ERROR == Sql_Query(logmysql_handle, "%s (NOW(), %s)", StringBuf_Value(&head), values) )
+			Sql_ShowDebug(logmysql_handle);
+		StringBuf_Destroy(&head);
+		return;
+	}
+
+	char timestring[24];
+	time_t curtime = time(NULL);
+
+	strftime(timestring, sizeof(timestring), "%Y-%m-%d %H:%M:%S", localtime(&curtime));
+
+	s_log_batch& batch = log_writer.batches[StringBuf_Value(&head)];
+
+	if( batch.rows.empty() )
+		batch.query.assign(StringBuf_Value(&head));
+	else
+		batch.query.push_back(',');
+	batch.rows.push_back(batch.query.length());
+	batch.query.append(" ('").append(timestring).append("', ").append(values).append(")");
+
+	StringBuf_Destroy(&head);
+
+	if( batch.rows.size() >= (size_t)log_config.sql_batch_rows || batch.query.length() >= LOG_BATCH_MAX_LENGTH )
+		log_writer_push(batch);
+}
+
 
 /// obtain log type character for item/zeny logs
 static char log_picktype2char(e_log_pick_type type)
@@ -172,17 +389,13 @@ void log_branch(struct map_session_data* sd)
 		return;
 
 	if( log_config.sql_logs ) {
-		SqlStmt* stmt;
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`branch_date`, `account_id`, `char_id`, `char_name`, `map`) VALUES (NOW(), '%d', '%d', ?, '%s')", log_config.log_branch, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		char esc_name[NAME_LENGTH*2+1];
+		StringBuf buf;
+
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "'%d', '%d', '%s', '%s'", sd->status.account_id, sd->status.char_id, log_sql_escape(esc_name, sd->status.name, NAME_LENGTH), mapindex_id2name(sd->mapindex));
+		log_sql_insert(log_config.log_branch, "branch_date", "`account_id`, `char_id`, `char_name`, `map`", StringBuf_Value(&buf));
+		StringBuf_Destroy(&buf);
 	}
 	else
 	{
@@ -214,31 +427,29 @@ void log_pick(int id, int16 m, e_log_pick_type type, int amount, struct item* it
 	if( log_config.sql_logs )
 	{
 		int i;
-		SqlStmt* stmt = SqlStmt_Malloc(logmysql_handle);
-		StringBuf buf;
+		StringBuf columns, buf;
+		StringBuf_Init(&columns);
 		StringBuf_Init(&buf);
 
-		StringBuf_Printf(&buf, "%s INTO `%s` (`time`, `char_id`, `type`, `nameid`, `amount`, `refine`, `map`, `unique_id`, `bound`", LOG_QUERY, log_config.log_pick);
+		StringBuf_AppendStr(&columns, "`char_id`, `type`, `nameid`, `amount`, `refine`, `map`, `unique_id`, `bound`");
 		for (i = 0; i < MAX_SLOTS; ++i)
-			StringBuf_Printf(&buf, ", `card%d`", i);
+			StringBuf_Printf(&columns, ", `card%d`", i);
 		for (i = 0; i < MAX_ITEM_RDM_OPT; ++i) {
-			StringBuf_Printf(&buf, ", `option_id%d`", i);
-			StringBuf_Printf(&buf, ", `option_val%d`", i);
-			StringBuf_Printf(&buf, ", `option_parm%d`", i);
+			StringBuf_Printf(&columns, ", `option_id%d`", i);
+			StringBuf_Printf(&columns, ", `option_val%d`", i);
+			StringBuf_Printf(&columns, ", `option_parm%d`", i);
 		}
-		StringBuf_Printf(&buf, ") VALUES(NOW(),'%u','%c','%d','%d','%d','%s','%" PRIu64 "','%d'",
+		StringBuf_Printf(&buf, "'%u','%c','%d','%d','%d','%s','%" PRIu64 "','%d'",
 			id, log_picktype2char(type), itm->nameid, amount, itm->refine, map_getmapdata(m)->name[0] ? map_getmapdata(m)->name : "", itm->unique_id, itm->bound);
 
 		for (i = 0; i < MAX_SLOTS; i++)
 			StringBuf_Printf(&buf, ",'%d'", itm->card[i]);
 		for (i = 0; i < MAX_ITEM_RDM_OPT; i++)
 			StringBuf_Printf(&buf, ",'%d','%d','%d'", itm->option[i].id, itm->option[i].value, itm->option[i].param);
-		StringBuf_Printf(&buf, ")");
 
-		if (SQL_SUCCESS != SqlStmt_PrepareStr(stmt, StringBuf_Value(&buf)) || SQL_SUCCESS != SqlStmt_Execute(stmt))
-			SqlStmt_ShowDebug(stmt);
+		log_sql_insert(log_config.log_pick, "time", StringBuf_Value(&columns), StringBuf_Value(&buf));
 
-		SqlStmt_Free(stmt);
+		StringBuf_Destroy(&columns);
 		StringBuf_Destroy(&buf);
 	}
 	else
@@ -281,12 +492,12 @@ void log_zeny(struct map_session_data* sd, e_log_pick_type type, struct map_sess
 
 	if( log_config.sql_logs )
 	{
-		if( SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (`time`, `char_id`, `src_id`, `type`, `amount`, `map`) VALUES (NOW(), '%d', '%d', '%c', '%d', '%s')",
-			log_config.log_zeny, sd->status.char_id, src_sd->status.char_id, log_picktype2char(type), amount, mapindex_id2name(sd->mapindex)) )
-		{
-			Sql_ShowDebug(logmysql_handle);
-			return;
-		}
+		StringBuf buf;
+
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "'%d', '%d', '%c', '%d', '%s'", sd->status.char_id, src_sd->status.char_id, log_picktype2char(type), amount, mapindex_id2name(sd->mapindex));
+		log_sql_insert(log_config.log_zeny, "time", "`char_id`, `src_id`, `type`, `amount`, `map`", StringBuf_Value(&buf));
+		StringBuf_Destroy(&buf);
 	}
 	else
 	{
@@ -314,12 +525,12 @@ void log_mvpdrop(struct map_session_data* sd, int monster_id, unsigned int* log_
 
 	if( log_config.sql_logs )
 	{
-		if( SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (`mvp_date`, `kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`) VALUES (NOW(), '%d', '%d', '%hu', '%u', '%s') ",
-			log_config.log_mvpdrop, sd->status.char_id, monster_id, (unsigned short)log_mvp[0], log_mvp[1], mapindex_id2name(sd->mapindex)) )
-		{
-			Sql_ShowDebug(logmysql_handle);
-			return;
-		}
+		StringBuf buf;
+
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "'%d', '%d', '%hu', '%u', '%s'", sd->status.char_id, monster_id, (unsigned short)log_mvp[0], log_mvp[1], mapindex_id2name(sd->mapindex));
+		log_sql_insert(log_config.log_mvpdrop, "mvp_date", "`kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`", StringBuf_Value(&buf));
+		StringBuf_Destroy(&buf);
 	}
 	else
 	{
@@ -348,19 +559,13 @@ void log_atcommand(struct map_session_data* sd, const char* message)
 
 	if( log_config.sql_logs )
 	{
-		SqlStmt* stmt;
+		char esc_name[NAME_LENGTH*2+1], esc_message[255*2+1];
+		StringBuf buf;
 
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`atcommand_date`, `account_id`, `char_id`, `char_name`, `map`, `command`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", log_config.log_gm, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 1, SQLDT_STRING, (char*)message, safestrnlen(message, 255))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "'%d', '%d', '%s', '%s', '%s'", sd->status.account_id, sd->status.char_id, log_sql_escape(esc_name, sd->status.name, NAME_LENGTH), mapindex_id2name(sd->mapindex), log_sql_escape(esc_message, message, 255));
+		log_sql_insert(log_config.log_gm, "atcommand_date", "`account_id`, `char_id`, `char_name`, `map`, `command`", StringBuf_Value(&buf));
+		StringBuf_Destroy(&buf);
 	}
 	else
 	{
@@ -386,18 +591,13 @@ void log_npc( struct npc_data* nd, const char* message ){
 
 	if( log_config.sql_logs )
 	{
-		SqlStmt* stmt;
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`npc_date`, `char_name`, `map`, `mes`) VALUES (NOW(), ?, '%s', ?)", log_config.log_npc, map_mapid2mapname(nd->bl.m) )
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, nd->name, strnlen(nd->name, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 1, SQLDT_STRING, (char*)message, safestrnlen(message, 255))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		char esc_name[NAME_LENGTH*2+1], esc_message[255*2+1];
+		StringBuf buf;
+
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "'%s', '%s', '%s'", log_sql_escape(esc_name, nd->name, NAME_LENGTH), map_mapid2mapname(nd->bl.m), log_sql_escape(esc_message, message, 255));
+		log_sql_insert(log_config.log_npc, "npc_date", "`char_name`, `map`, `mes`", StringBuf_Value(&buf));
+		StringBuf_Destroy(&buf);
 	}
 	else
 	{
@@ -424,18 +624,13 @@ void log_npc(struct map_session_data* sd, const char* message)
 
 	if( log_config.sql_logs )
 	{
-		SqlStmt* stmt;
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`npc_date`, `account_id`, `char_id`, `char_name`, `map`, `mes`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", log_config.log_npc, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 1, SQLDT_STRING, (char*)message, safestrnlen(message, 255))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		char esc_name[NAME_LENGTH*2+1], esc_message[255*2+1];
+		StringBuf buf;
+
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "'%d', '%d', '%s', '%s', '%s'", sd->status.account_id, sd->status.char_id, log_sql_escape(esc_name, sd->status.name, NAME_LENGTH), mapindex_id2name(sd->mapindex), log_sql_escape(esc_message, message, 255));
+		log_sql_insert(log_config.log_npc, "npc_date", "`account_id`, `char_id`, `char_name`, `map`, `mes`", StringBuf_Value(&buf));
+		StringBuf_Destroy(&buf);
 	}
 	else
 	{
@@ -467,19 +662,14 @@ void log_chat(e_log_chat_type type, int type_id, int src_charid, int src_accid,
 	}
 
 	if( log_config.sql_logs ) {
-		SqlStmt* stmt;
+		char esc_name[NAME_LENGTH*2+1], esc_message[CHAT_SIZE_MAX*2+1];
+		StringBuf buf;
 
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`time`, `type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`) VALUES (NOW(), '%c', '%d', '%d', '%d', '%s', '%d', '%d', ?, ?)", log_config.log_chat, log_chattype2char(type), type_id, src_charid, src_accid, mapname, x, y)
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, (char*)dst_charname, safestrnlen(dst_charname, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 1, SQLDT_STRING, (char*)message, safestrnlen(message, CHAT_SIZE_MAX))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "'%c', '%d', '%d', '%d', '%s', '%d', '%d', '%s', '%s'", log_chattype2char(type), type_id, src_charid, src_accid, mapname, x, y,
+			log_sql_escape(esc_name, dst_charname, NAME_LENGTH), log_sql_escape(esc_message, message, CHAT_SIZE_MAX));
+		log_sql_insert(log_config.log_chat, "time", "`type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`", StringBuf_Value(&buf));
+		StringBuf_Destroy(&buf);
 	}
 	else
 	{
@@ -504,12 +694,12 @@ void log_cash( struct map_session_data* sd, e_log_pick_type type, e_log_cash_typ
 		return;
 
 	if( log_config.sql_logs ){
-		if( SQL_ERROR == Sql_Query( logmysql_handle, LOG_QUERY " INTO `%s` ( `time`, `char_id`, `type`, `cash_type`, `amount`, `map` ) VALUES ( NOW(), '%d', '%c', '%c', '%d', '%s' )",
-			log_config.log_cash, sd->status.char_id, log_picktype2char( type ), log_cashtype2char( cash_type ), amount, mapindex_id2name( sd->mapindex ) ) )
-		{
-			Sql_ShowDebug( logmysql_handle );
-			return;
-		}
+		StringBuf buf;
+
+		StringBuf_Init( &buf );
+		StringBuf_Printf( &buf, "'%d', '%c', '%c', '%d', '%s'", sd->status.char_id, log_picktype2char( type ), log_cashtype2char( cash_type ), amount, mapindex_id2name( sd->mapindex ) );
+		log_sql_insert( log_config.log_cash, "time", "`char_id`, `type`, `cash_type`, `amount`, `map`", StringBuf_Value( &buf ) );
+		StringBuf_Destroy( &buf );
 	}else{
 		char timestring[255];
 		time_t curtime;
@@ -557,12 +747,13 @@ void log_feeding(struct map_session_data *sd, e_log_feeding_type type, unsigned
 	}
 
 	if (log_config.sql_logs) {
-		if (SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (`time`, `char_id`, `target_id`, `target_class`, `type`, `intimacy`, `item_id`, `map`, `x`, `y`) VALUES ( NOW(), '%" PRIu32 "', '%" PRIu32 "', '%hu', '%c', '%" PRIu32 "', '%hu', '%s', '%hu', '%hu' )",
-			log_config.log_feeding, sd->status.char_id, target_id, target_class, log_feedingtype2char(type), intimacy, nameid, mapindex_id2name(sd->mapindex), sd->bl.x, sd->bl.y))
-		{
-			Sql_ShowDebug(logmysql_handle);
-			return;
-		}
+		StringBuf buf;
+
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "'%" PRIu32 "', '%" PRIu32 "', '%hu', '%c', '%" PRIu32 "', '%hu', '%s', '%hu', '%hu'",
+			sd->status.char_id, target_id, target_class, log_feedingtype2char(type), intimacy, nameid, mapindex_id2name(sd->mapindex), sd->bl.x, sd->bl.y);
+		log_sql_insert(log_config.log_feeding, "time", "`char_id`, `target_id`, `target_class`, `type`, `intimacy`, `item_id`, `map`, `x`, `y`", StringBuf_Value(&buf));
+		StringBuf_Destroy(&buf);
 	} else {
 		char timestring[255];
 		time_t curtime;
@@ -586,6 +777,10 @@ void log_set_defaults(void)
 	log_config.rare_items_log   = 100;  // log rare items. drop chance <= 1%
 	log_config.price_items_log  = 1000; // 1000z
 	log_config.amount_items_log = 100;
+	log_config.sql_async = true;
+	log_config.sql_batch_rows = 100;
+	log_config.sql_flush_interval = 1000;
+	log_config.sql_queue_size = 4096;
 
 	safestrncpy(log_timestamp_format, "%m/%d/%Y %H:%M:%S", sizeof(log_timestamp_format));
 }
@@ -617,6 +812,14 @@ int log_config_read(const char* cfgName)
 				log_config.enable_logs = (e_log_pick_type)config_switch(w2);
 			else if( strcmpi(w1, "sql_logs") == 0 )
 				log_config.sql_logs = config_switch(w2) > 0;
+			else if( strcmpi(w1, "sql_logs_async") == 0 )
+				log_config.sql_async = config_switch(w2) > 0;
+			else if( strcmpi(w1, "sql_logs_batch_rows") == 0 )
+				log_config.sql_batch_rows = cap_value(atoi(w2), 1, 10000);
+			else if( strcmpi(w1, "sql_logs_flush_interval") == 0 )
+				log_config.sql_flush_interval = cap_value(atoi(w2), 100, 60000);
+			else if( strcmpi(w1, "sql_logs_queue_size") == 0 )
+				log_config.sql_queue_size = cap_value(atoi(w2), 64, 1048576);
 //start of common filter settings
 			else if( strcmpi(w1, "rare_items_log") == 0 )
 				log_config.rare_items_log = atoi(w2);
@@ -720,3 +923,62 @@ int log_config_read(const char* cfgName)
 
 	return 0;
 }
+
+/**
+ * Starts the asynchronous SQL log writer.
+ * Needs the log configuration and the log database connection.
+ */
+void do_init_log(void)
+{
+	if( !log_config.sql_logs || !log_config.sql_async )
+		return;
+
+	log_writer.handle = Sql_Malloc();
+	if( SQL_ERROR == Sql_ThreadConnect(log_writer.handle, log_db_id, log_db_pw, log_db_ip, log_db_port, log_db_db) ) {
+		ShowError("do_init_log: Couldn't open the log writer connection, logging synchronously.\n");
+		Sql_Free(log_writer.handle);
+		log_writer.handle = NULL;
+		return;
+	}
+	if( strlen(default_codepage) > 0 && SQL_ERROR == Sql_SetEncoding(log_writer.handle, default_codepage) )
+		Sql_ShowDebug(log_writer.handle);
+
+	log_writer.active = true;
+	log_writer.stop = false;
+	log_writer.queue_length = 0;
+	log_writer.thread = std::thread(log_writer_main);
+
+	add_timer_func_list(log_writer_flush_timer, "log_writer_flush_timer");
+	log_writer.flush_timer = add_timer_interval(gettick() + log_config.sql_flush_interval, log_writer_flush_timer, 0, 0, log_config.sql_flush_interval);
+
+	ShowInfo("Writing SQL logs asynchronously in batches of up to %d rows.\n", log_config.sql_batch_rows);
+}
+
+/**
+ * Stops the asynchronous SQL log writer.
+ * Every pending row is written before this returns.
+ */
+void do_final_log(void)
+{
+	if( !log_writer.active )
+		return;
+
+	delete_timer(log_writer.flush_timer, log_writer_flush_timer);
+	log_writer.flush_timer = INVALID_TIMER;
+
+	log_writer_flush();
+	log_writer.batches.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(log_writer.mutex);
+		log_writer.stop = true;
+	}
+	log_writer.wakeup.notify_one();
+	log_writer.thread.join();
+	log_writer.active = false;
+
+	log_writer_report();
+
+	Sql_Free(log_writer.handle);
+	log_writer.handle = NULL;
+}
@@ -85,11 +85,16 @@ void log_mvpdrop(struct map_session_data* sd, int monster_id, unsigned int* log_
 
 int log_config_read(const char* cfgName);
 
+void do_init_log(void);
+void do_final_log(void);
+
 extern struct Log_Config
 {
 	e_log_pick_type enable_logs;
 	int filter;
 	bool sql_logs;
+	bool sql_async; ///< Write SQL logs in batches from a background thread
+	int sql_batch_rows, sql_flush_interval, sql_queue_size; ///< Rows per INSERT, flush interval in ms, queue limit in KB
 	bool log_chat_woe_disable;
 	bool cash;
 	int rare_items_log,refine_items_log,price_items_log,amount_items_log; //for filter
@@ -5,10 +5,18 @@
 
 #include <stdlib.h>
 #include <math.h>
+#ifndef WIN32
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
 
 #include "../common/cbasetypes.hpp"
 #include "../common/cli.hpp"
 #include "../common/core.hpp"
+#include "../common/database.hpp"
 #include "../common/ers.hpp"
 #include "../common/grfio.hpp"
 #include "../common/malloc.hpp"
@@ -110,7 +118,6 @@ static DBMap* map_msg_db=NULL;
 
 static int map_users=0;
 
-#define BLOCK_SIZE 8
 #define block_free_max 1048576
 struct block_list *block_free[block_free_max];
 static int block_free_count = 0, block_free_lock = 0;
@@ -130,7 +137,10 @@ int map_port=0;
 
 int autosave_interval = DEFAULT_AUTOSAVE_INTERVAL;
 int minsave_interval = 100;
+int autosave_max_per_tick = 10;
+int autosave_priority_zeny = 1000000;
 int16 save_settings = CHARSAVE_ALL;
+bool save_delta = true;
 bool agit_flag = false;
 bool agit2_flag = false;
 bool agit3_flag = false;
@@ -159,6 +169,31 @@ struct map_cache_map_info {
 	int32 len;
 };
 
+// This is the main header found at the very beginning of the raw map cache, followed by the map index
+struct map_cache_raw_header {
+	char magic[4]; // MAP_CACHE_RAW_MAGIC
+	uint32 version; // MAP_CACHE_RAW_VERSION
+	uint32 map_count;
+	uint32 file_size;
+};
+
+// Entry of the raw map cache index, the gat types of the cells are stored uncompressed at the page aligned offset
+struct map_cache_raw_map_info {
+	char name[MAP_NAME_LENGTH];
+	int16 xs;
+	int16 ys;
+	uint32 offset;
+};
+
+#define MAP_CACHE_RAW_MAGIC "RAMC"
+#define MAP_CACHE_RAW_VERSION 1
+
+/// Raw map caches kept mapped while the maps use them (main and import)
+static struct s_map_cache_raw {
+	char *data;
+	size_t size;
+} map_cache_raw[2];
+
 char motd_txt[256] = "conf/motd.txt";
 char charhelp_txt[256] = "conf/charhelp.txt";
 char channel_conf[256] = "conf/channels.conf";
@@ -180,6 +215,7 @@ struct s_map_default map_default;
 int console = 0;
 int enable_spy = 0; //To enable/disable @spy commands, which consume too much cpu time when sending packets. [Skotlex]
 int enable_grf = 0;	//To enable/disable reading maps from GRF files, bypassing mapcache [blackhole89]
+bool enable_map_cache_raw = false; // Read the maps from the uncompressed, mapped map cache instead
 
 /**
  * Get the map data
@@ -283,18 +319,22 @@ TIMER_FUNC(map_freeblock_timer){
  *------------------------------------------*/
 static struct block_list bl_head;
 
+static void map_layers_free(struct map_data *mapdata);
+
 #ifdef CELL_NOSTACK
 /*==========================================
  * These pair of functions update the counter of how many objects
  * lie on a tile.
  *------------------------------------------*/
+static struct mapcell* map_cells(struct map_data *mapdata);
+
 static void map_addblcell(struct block_list *bl)
 {
 	struct map_data *mapdata = map_getmapdata(bl->m);
 
 	if( bl->m<0 || bl->x<0 || bl->x>=mapdata->xs || bl->y<0 || bl->y>=mapdata->ys || !(bl->type&BL_CHAR) )
 		return;
-	mapdata->cell[bl->x+bl->y*mapdata->xs].cell_bl++;
+	map_cells(mapdata)[bl->x+bl->y*mapdata->xs].cell_bl++;
 	return;
 }
 
@@ -304,10 +344,147 @@ static void map_delblcell(struct block_list *bl)
 
 	if( bl->m <0 || bl->x<0 || bl->x>=mapdata->xs || bl->y<0 || bl->y>=mapdata->ys || !(bl->type&BL_CHAR) )
 		return;
-	mapdata->cell[bl->x+bl->y*mapdata->xs].cell_bl--;
+	map_cells(mapdata)[bl->x+bl->y*mapdata->xs].cell_bl--;
 }
 #endif
 
+/*==========================================
+ * Maintenance of the structure-of-arrays block index.
+ * Every block on a map has one entry in the map_block_soa of the
+ * map block it stands in, bl->blockidx being its position there.
+ *------------------------------------------*/
+static void map_block_soa_add(struct map_data *mapdata, int pos, struct block_list *bl)
+{
+	struct map_block_soa &soa = mapdata->block_soa[pos];
+
+	bl->blockidx = (int)soa.bl.size();
+	soa.bl.push_back(bl);
+	soa.x.push_back(bl->x);
+	soa.y.push_back(bl->y);
+	soa.type.push_back(bl->type);
+}
+
+static void map_block_soa_del(struct map_data *mapdata, int pos, struct block_list *bl)
+{
+	struct map_block_soa &soa = mapdata->block_soa[pos];
+	int i = bl->blockidx, last = (int)soa.bl.size() - 1;
+
+	if( i < 0 || i > last || soa.bl[i] != bl ) {
+		ShowError("map_block_soa_del: block %d is not indexed at (\"%s\",%d,%d)\n", bl->id, mapdata->name, bl->x, bl->y);
+		return;
+	}
+
+	// Swap with the last entry to keep the arrays dense
+	if( i != last ) {
+		soa.bl[i] = soa.bl[last];
+		soa.x[i] = soa.x[last];
+		soa.y[i] = soa.y[last];
+		soa.type[i] = soa.type[last];
+		soa.bl[i]->blockidx = i;
+	}
+	soa.bl.pop_back();
+	soa.x.pop_back();
+	soa.y.pop_back();
+	soa.type.pop_back();
+	bl->blockidx = -1;
+}
+
+/// Updates the indexed coordinates of a block that moved inside its map block.
+static inline void map_block_soa_move(struct map_data *mapdata, struct block_list *bl)
+{
+	struct map_block_soa &soa = mapdata->block_soa[bl->x/BLOCK_SIZE+(bl->y/BLOCK_SIZE)*mapdata->bxs];
+
+	soa.x[bl->blockidx] = bl->x;
+	soa.y[bl->blockidx] = bl->y;
+}
+
+/// Allocates the block lists of a map, mapdata->bxs and mapdata->bys must be set.
+static void map_block_alloc(struct map_data *mapdata)
+{
+	size_t size = mapdata->bxs * mapdata->bys * sizeof(struct block_list*);
+
+	mapdata->block = (struct block_list **)aCalloc(1,size);
+	mapdata->block_mob = (struct block_list **)aCalloc(1,size);
+	mapdata->block_soa.clear();
+	mapdata->block_soa.resize(mapdata->bxs * mapdata->bys);
+}
+
+/// Frees the block lists of a map.
+static void map_block_free(struct map_data *mapdata)
+{
+	if( mapdata->block )
+		aFree(mapdata->block);
+	if( mapdata->block_mob )
+		aFree(mapdata->block_mob);
+	mapdata->block = NULL;
+	mapdata->block_mob = NULL;
+	std::vector<map_block_soa>().swap(mapdata->block_soa);
+}
+
+#define MAP_SOA_CHUNK 64
+
+/*==========================================
+ * Writes the blocks of one map block that match type and lie inside
+ * (x0,y0)-(x1,y1) to out, which has room for max entries.
+ * The bounds are tested in chunks into a hit mask first, which the
+ * compiler turns into SIMD compares, then the hits are compacted.
+ * Returns the number of blocks written.
+ *------------------------------------------*/
+static int map_block_soa_collect_to(const struct map_block_soa &soa, struct block_list **out, int max, int type, int16 x0, int16 y0, int16 x1, int16 y1)
+{
+	int count = min((int)soa.bl.size(), max);
+	const int16 *xs = soa.x.data();
+	const int16 *ys = soa.y.data();
+	const uint16 *types = soa.type.data();
+	uint8 hit[MAP_SOA_CHUNK];
+	int n = 0;
+
+	for( int base = 0; base < count; base += MAP_SOA_CHUNK ) {
+		int len = min(count - base, MAP_SOA_CHUNK);
+
+		for( int i = 0; i < len; i++ ) {
+			int16 x = xs[base + i], y = ys[base + i];
+
+			hit[i] = ( (types[base + i]&type) != 0 ) & ( x >= x0 ) & ( x <= x1 ) & ( y >= y0 ) & ( y <= y1 );
+		}
+		for( int i = 0; i < len; i++ ) {
+			out[n] = soa.bl[base + i];
+			n += hit[i];
+		}
+	}
+
+	return n;
+}
+
+/// Appends the matching blocks of one map block to bl_list.
+static void map_block_soa_collect(const struct map_block_soa &soa, int type, int16 x0, int16 y0, int16 x1, int16 y1)
+{
+	bl_list_count += map_block_soa_collect_to(soa, &bl_list[bl_list_count], BL_LIST_MAX - bl_list_count, type, x0, y0, x1, y1);
+}
+
+/// Collects the matching blocks of every map block overlapping (x0,y0)-(x1,y1), the area must be clipped to the map.
+static void map_block_soa_collect_area(struct map_data *mapdata, int type, int16 x0, int16 y0, int16 x1, int16 y1)
+{
+	for( int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ )
+		for( int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ )
+			map_block_soa_collect(mapdata->block_soa[bx + by * mapdata->bxs], type, x0, y0, x1, y1);
+}
+
+/// Same as map_block_soa_collect_area, but appends to a vector of the caller instead of bl_list.
+static void map_block_soa_collect_area(struct map_data *mapdata, std::vector<struct block_list*> &out, int type, int16 x0, int16 y0, int16 x1, int16 y1)
+{
+	for( int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
+		for( int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
+			const struct map_block_soa &soa = mapdata->block_soa[bx + by * mapdata->bxs];
+			size_t n = out.size();
+
+			out.resize(n + soa.bl.size());
+			n += map_block_soa_collect_to(soa, out.data() + n, (int)soa.bl.size(), type, x0, y0, x1, y1);
+			out.resize(n);
+		}
+	}
+}
+
 /*==========================================
  * Adds a block to the map.
  * Returns 0 on success, 1 on failure (illegal coordinates).
@@ -355,6 +532,7 @@ int map_addblock(struct block_list* bl)
 		if (bl->next) bl->next->prev = bl;
 		mapdata->block[pos] = bl;
 	}
+	map_block_soa_add(mapdata, pos, bl);
 
 #ifdef CELL_NOSTACK
 	map_addblcell(bl);
@@ -402,6 +580,7 @@ int map_delblock(struct block_list* bl)
 	}
 	bl->next = NULL;
 	bl->prev = NULL;
+	map_block_soa_del(mapdata, pos, bl);
 
 	return 0;
 }
@@ -461,10 +640,12 @@ int map_moveblock(struct block_list *bl, int x1, int y1, t_tick tick)
 	if (moveblock) {
 		if(map_addblock(bl))
 			return 1;
-	}
+	} else {
+		map_block_soa_move(map_getmapdata(bl->m), bl);
 #ifdef CELL_NOSTACK
-	else map_addblcell(bl);
+		map_addblcell(bl);
 #endif
+	}
 
 	if (bl->type&BL_CHAR) {
 
@@ -608,25 +789,56 @@ struct skill_unit* map_find_skill_unit_oncell(struct block_list* target,int16 x,
 }
 
 /*==========================================
- * Adapted from foreachinarea for an easier invocation. [Skotlex]
+ * Releases the bl_list entries collected by a spatial query.
  *------------------------------------------*/
-int map_foreachinrangeV(int (*func)(struct block_list*,va_list),struct block_list* center, int16 range, int type, va_list ap, bool wall_check)
+void map_blocks_release(int blockcount)
+{
+	bl_list_count = blockcount;
+}
+
+/// Wraps the bl_list entries pushed since blockcount into a map_blocks range.
+static map_blocks map_blocks_collected(int blockcount, const char* name)
+{
+	if( bl_list_count >= BL_LIST_MAX )
+		ShowWarning("%s: block count too many!\n", name);
+
+	return map_blocks(&bl_list[blockcount], bl_list_count - blockcount, blockcount);
+}
+
+/// Calls a va_list callback for every block of a query, summing the results. [Skotlex]
+static int map_foreachV(int (*func)(struct block_list*,va_list), const map_blocks& blocks, va_list ap, int count = 0)
 {
-	int bx, by, m;
-	int returnCount = 0;	//total sum of returned values of func() [Skotlex]
+	return blocks.each([&](struct block_list* bl) {
+		va_list ap_copy;
+		va_copy(ap_copy, ap);
+		int ret = func(bl, ap_copy);
+		va_end(ap_copy);
+		return ret;
+	}, count);
+}
+
+/*==========================================
+ * Collects all blocks of a type within range of center.
+ * @param center: Center of the search
+ * @param range: Search range in cells
+ * @param type: Type of bl to search for
+ * @param wall_check: Only collect blocks with a shoot-able path from center
+ *------------------------------------------*/
+static map_blocks map_blocks_inrangeV(struct block_list* center, int16 range, int type, bool wall_check, const char* name)
+{
+	int m;
 	struct block_list *bl;
-	int blockcount = bl_list_count, i;
+	int blockcount = bl_list_count;
 	int x0, x1, y0, y1;
-	va_list ap_copy;
 
 	m = center->m;
 	if( m < 0 )
-		return 0;
+		return map_blocks();
 
 	struct map_data *mapdata = map_getmapdata(m);
 
 	if( mapdata == nullptr || mapdata->block == nullptr ){
-		return 0;
+		return map_blocks();
 	}
 
 	x0 = i16max(center->x - range, 0);
@@ -634,56 +846,230 @@ int map_foreachinrangeV(int (*func)(struct block_list*,va_list),struct block_lis
 	x1 = i16min(center->x + range, mapdata->xs - 1);
 	y1 = i16min(center->y + range, mapdata->ys - 1);
 
-	if ( type&~BL_MOB ) {
-		for( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
-			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
-				for(bl = mapdata->block[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next ) {
-					if( bl->type&type
-						&& bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1
+	map_block_soa_collect_area(mapdata, type, x0, y0, x1, y1);
+
+#ifndef CIRCULAR_AREA
+	if( wall_check )
+#endif
+	{
+		int n = blockcount;
+
+		for( int i = blockcount; i < bl_list_count; i++ ) {
+			bl = bl_list[i];
 #ifdef CIRCULAR_AREA
-						&& check_distance_bl(center, bl, range)
+			if( !check_distance_bl(center, bl, range) )
+				continue;
 #endif
-						&& ( !wall_check || path_search_long(NULL, center->m, center->x, center->y, bl->x, bl->y, CELL_CHKWALL) )
-					  	&& bl_list_count < BL_LIST_MAX )
-						bl_list[ bl_list_count++ ] = bl;
-				}
-			}
+			if( wall_check && !path_search_long(NULL, center->m, center->x, center->y, bl->x, bl->y, CELL_CHKWALL) )
+				continue;
+			bl_list[n++] = bl;
 		}
+		bl_list_count = n;
 	}
 
-	if ( type&BL_MOB ) {
-		for( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
-			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
-				for(bl = mapdata->block_mob[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next ) {
-					if( bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1
+	return map_blocks_collected(blockcount, name);
+}
+
+map_blocks map_blocks_inrange(struct block_list* center, int16 range, int type)
+{
+	return map_blocks_inrangeV(center, range, type, battle_config.skill_wall_check>0, "map_foreachinrange");
+}
+
+map_blocks map_blocks_inallrange(struct block_list* center, int16 range, int type)
+{
+	return map_blocks_inrangeV(center, range, type, false, "map_foreachinrange");
+}
+
+/*==========================================
+ * Same as inrange, but there must be a shoot-able range between center and target to be counted in. [Skotlex]
+ *------------------------------------------*/
+map_blocks map_blocks_inshootrange(struct block_list* center, int16 range, int type)
+{
+	return map_blocks_inrangeV(center, range, type, true, "map_foreachinrange");
+}
+
+/*==========================================
+ * Collects all blocks of a type within range of center into out, like map_blocks_inrangeV.
+ * Only reads the map, so worker threads may use it while the main thread
+ * leaves the blocks alone. With wall_check the cell layers of the map must
+ * have been built by map_walkable beforehand.
+ * @param out: Blocks found are appended to this vector
+ * @param center: Center of the search
+ * @param range: Search range in cells
+ * @param type: Type of bl to search for
+ * @param wall_check: Only collect blocks with a shoot-able path from center
+ *------------------------------------------*/
+void map_collect_inrange(std::vector<struct block_list*>& out, struct block_list* center, int16 range, int type, bool wall_check)
+{
+	if( center->m < 0 )
+		return;
+
+	struct map_data *mapdata = map_getmapdata(center->m);
+
+	if( mapdata == nullptr || mapdata->block == nullptr )
+		return;
+
+	size_t first = out.size();
+	int16 x0 = i16max(center->x - range, 0);
+	int16 y0 = i16max(center->y - range, 0);
+	int16 x1 = i16min(center->x + range, mapdata->xs - 1);
+	int16 y1 = i16min(center->y + range, mapdata->ys - 1);
+
+	map_block_soa_collect_area(mapdata, out, type, x0, y0, x1, y1);
+
+#ifndef CIRCULAR_AREA
+	if( wall_check )
+#endif
+	{
+		size_t n = first;
+
+		for( size_t i = first; i < out.size(); i++ ) {
+			struct block_list *bl = out[i];
 #ifdef CIRCULAR_AREA
-						&& check_distance_bl(center, bl, range)
+			if( !check_distance_bl(center, bl, range) )
+				continue;
 #endif
-						&& ( !wall_check || path_search_long(NULL, center->m, center->x, center->y, bl->x, bl->y, CELL_CHKWALL) )
-					  	&& bl_list_count < BL_LIST_MAX )
-						bl_list[ bl_list_count++ ] = bl;
+			if( wall_check && !path_search_long(NULL, center->m, center->x, center->y, bl->x, bl->y, CELL_CHKWALL) )
+				continue;
+			out[n++] = bl;
+		}
+		out.resize(n);
+	}
+}
+
+/// Collects the matching blocks of every map block overlapping (x0,y0)-(x1,y1) by walking the block_list chains.
+/// This is how the collectors worked before the structure-of-arrays index, map_block_benchmark compares against it.
+static void map_block_list_collect_area(struct map_data *mapdata, std::vector<struct block_list*> &out, int type, int16 x0, int16 y0, int16 x1, int16 y1)
+{
+	for( int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
+		for( int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
+			if( type&~BL_MOB ) {
+				for( struct block_list *bl = mapdata->block[bx + by * mapdata->bxs]; bl != NULL; bl = bl->next ) {
+					if( bl->type&type && bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1 )
+						out.push_back(bl);
+				}
+			}
+			if( type&BL_MOB ) {
+				for( struct block_list *bl = mapdata->block_mob[bx + by * mapdata->bxs]; bl != NULL; bl = bl->next ) {
+					if( bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1 )
+						out.push_back(bl);
 				}
 			}
 		}
 	}
+}
 
-	if( bl_list_count >= BL_LIST_MAX )
-		ShowWarning("map_foreachinrange: block count too many!\n");
+/**
+ * Measures the range queries of a crowded map and checks that the block lists and the
+ * structure-of-arrays index find the same blocks.
+ * Places 'crowd' temporary blocks (60% players, 20% monsters, 20% skill units) in the
+ * 40x40 cells around the center of the map, as at a WoE emperium or a town meeting point,
+ * then runs 'count' queries of both kinds around random cells of that area:
+ * AREA_SIZE for players (what clif sends to), and 3 cells for characters and skill units
+ * (what splash skills and skill units hit).
+ * The blocks are removed again before the function returns.
+ * @param m: Map to search on
+ * @param count: Number of queries per kind
+ * @param crowd: Number of blocks to place
+ */
+void map_block_benchmark(int16 m, int count, int crowd)
+{
+	const struct {
+		int16 range;
+		int type;
+	} queries[] = {
+		{ (int16)AREA_SIZE, BL_PC },
+		{ 3, BL_CHAR|BL_SKILL },
+	};
+	struct map_data *mapdata = map_getmapdata(m);
+
+	if( mapdata == nullptr || mapdata->block == nullptr )
+		return;
+
+	int16 cx = mapdata->xs / 2, cy = mapdata->ys / 2;
+	int16 ax0 = i16max(cx - 20, 0), ay0 = i16max(cy - 20, 0);
+	int16 ax1 = i16min(cx + 19, mapdata->xs - 1), ay1 = i16min(cy + 19, mapdata->ys - 1);
+	std::vector<struct block_list> blocks(crowd);
+	std::vector<int16> centers(count * 2);
+	std::vector<struct block_list*> found, expected;
+	t_tick list_time[ARRAYLENGTH(queries)] = {}, soa_time[ARRAYLENGTH(queries)] = {};
+	size_t hits[ARRAYLENGTH(queries)] = {};
+	int mismatches = 0;
+
+	for( int i = 0; i < crowd; i++ ) {
+		struct block_list *bl = &blocks[i];
+		int roll = rnd_value(0, 9);
+
+		memset(bl, 0, sizeof(*bl));
+		bl->type = ( roll < 6 ) ? BL_PC : ( roll < 8 ) ? BL_MOB : BL_SKILL;
+		bl->m = m;
+		bl->x = rnd_value(ax0, ax1);
+		bl->y = rnd_value(ay0, ay1);
+		map_addblock(bl);
+	}
+
+	for( int i = 0; i < count; i++ ) {
+		centers[i * 2] = rnd_value(ax0, ax1);
+		centers[i * 2 + 1] = rnd_value(ay0, ay1);
+	}
+
+	for( size_t q = 0; q < ARRAYLENGTH(queries); q++ ) {
+		int16 range = queries[q].range;
+		int type = queries[q].type;
+		t_tick tick;
+
+		// Time both scans on their own, then compare their results
+		tick = gettick_nocache();
+		for( int i = 0; i < count; i++ ) {
+			int16 x = centers[i * 2], y = centers[i * 2 + 1];
+
+			expected.clear();
+			map_block_list_collect_area(mapdata, expected, type, i16max(x - range, 0), i16max(y - range, 0), i16min(x + range, mapdata->xs - 1), i16min(y + range, mapdata->ys - 1));
+			hits[q] += expected.size();
+		}
+		list_time[q] = gettick_nocache() - tick;
 
-	map_freeblock_lock();
+		tick = gettick_nocache();
+		for( int i = 0; i < count; i++ ) {
+			int16 x = centers[i * 2], y = centers[i * 2 + 1];
 
-	for( i = blockcount; i < bl_list_count; i++ ) {
-		if( bl_list[ i ]->prev ) { //func() may delete this bl_list[] slot, checking for prev ensures it wasn't queued for deletion.
-			va_copy(ap_copy, ap);
-			returnCount += func(bl_list[i], ap_copy);
-			va_end(ap_copy);
+			found.clear();
+			map_block_soa_collect_area(mapdata, found, type, i16max(x - range, 0), i16max(y - range, 0), i16min(x + range, mapdata->xs - 1), i16min(y + range, mapdata->ys - 1));
+		}
+		soa_time[q] = gettick_nocache() - tick;
+
+		for( int i = 0; i < count; i++ ) {
+			int16 x = centers[i * 2], y = centers[i * 2 + 1];
+			int16 x0 = i16max(x - range, 0), y0 = i16max(y - range, 0), x1 = i16min(x + range, mapdata->xs - 1), y1 = i16min(y + range, mapdata->ys - 1);
+
+			expected.clear();
+			found.clear();
+			map_block_list_collect_area(mapdata, expected, type, x0, y0, x1, y1);
+			map_block_soa_collect_area(mapdata, found, type, x0, y0, x1, y1);
+			// The index does not keep the list order within a map block
+			std::sort(expected.begin(), expected.end());
+			std::sort(found.begin(), found.end());
+			if( found != expected )
+				mismatches++;
 		}
 	}
 
-	map_freeblock_unlock();
+	for( int i = 0; i < crowd; i++ )
+		map_delblock(&blocks[i]);
 
-	bl_list_count = blockcount;
-	return returnCount;	//[Skotlex]
+	for( size_t q = 0; q < ARRAYLENGTH(queries); q++ ) {
+		ShowInfo("map_block_benchmark: %d queries of range %d (type 0x%x) among %d blocks on '%s', %.1f hits each. block lists: %" PRtf " ms, arrays: %" PRtf " ms.\n",
+			count, queries[q].range, queries[q].type, crowd, mapdata->name, (double)hits[q] / count, list_time[q], soa_time[q]);
+	}
+	ShowInfo("map_block_benchmark: %d mismatches.\n", mismatches);
+}
+
+/*==========================================
+ * Adapted from foreachinarea for an easier invocation. [Skotlex]
+ *------------------------------------------*/
+int map_foreachinrangeV(int (*func)(struct block_list*,va_list),struct block_list* center, int16 range, int type, va_list ap, bool wall_check)
+{
+	return map_foreachV(func, map_blocks_inrangeV(center, range, type, wall_check, "map_foreachinrange"), ap);
 }
 
 int map_foreachinrange(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, ...)
@@ -722,24 +1108,22 @@ int map_foreachinshootrange(int (*func)(struct block_list*,va_list),struct block
 
 /*========================================== [Playtester]
  * range = map m (x0,y0)-(x1,y1)
- * Apply *func with ... arguments for the range.
+ * Collects all blocks of a type in the area.
  * @param m: ID of map
  * @param x0: West end of area
  * @param y0: South end of area
  * @param x1: East end of area
  * @param y1: North end of area
  * @param type: Type of bl to search for
+ * @param wall_check: Only collect blocks with a shoot-able path from the center of the area
 *------------------------------------------*/
-int map_foreachinareaV(int(*func)(struct block_list*, va_list), int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type, va_list ap, bool wall_check)
+static map_blocks map_blocks_inareaV(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type, bool wall_check, const char* name)
 {
-	int bx, by, cx, cy;
-	int returnCount = 0;	//total sum of returned values of func()
 	struct block_list *bl;
-	int blockcount = bl_list_count, i;
-	va_list ap_copy;
+	int blockcount = bl_list_count;
 
 	if (m < 0)
-		return 0;
+		return map_blocks();
 
 	if (x1 < x0)
 		SWAP(x0, x1);
@@ -749,7 +1133,7 @@ int map_foreachinareaV(int(*func)(struct block_list*, va_list), int16 m, int16 x
 	struct map_data *mapdata = map_getmapdata(m);
 
 	if( mapdata == nullptr || mapdata->block == nullptr ){
-		return 0;
+		return map_blocks();
 	}
 
 	x0 = i16max(x0, 0);
@@ -757,55 +1141,45 @@ int map_foreachinareaV(int(*func)(struct block_list*, va_list), int16 m, int16 x
 	x1 = i16min(x1, mapdata->xs - 1);
 	y1 = i16min(y1, mapdata->ys - 1);
 
-	if( wall_check ) {
-		cx = x0 + (x1 - x0) / 2;
-		cy = y0 + (y1 - y0) / 2;
-	}
-
-	if( type&~BL_MOB ) {
-		for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
-			for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
-				for(bl = mapdata->block[bx + by * mapdata->bxs]; bl != NULL; bl = bl->next) {
-					if ( bl->type&type
-						&& bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1
-						&& ( !wall_check || path_search_long(NULL, m, cx, cy, bl->x, bl->y, CELL_CHKWALL) )
-						&& bl_list_count < BL_LIST_MAX )
-						bl_list[bl_list_count++] = bl;
-				}
-			}
-		}
-	}
+	map_block_soa_collect_area(mapdata, type, x0, y0, x1, y1);
 
-	if( type&BL_MOB ) {
-		for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
-			for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
-				for(bl = mapdata->block_mob[bx + by * mapdata->bxs]; bl != NULL; bl = bl->next) {
-					if ( bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1
-						&& ( !wall_check || path_search_long(NULL, m, cx, cy, bl->x, bl->y, CELL_CHKWALL) )
-						&& bl_list_count < BL_LIST_MAX )
-						bl_list[bl_list_count++] = bl;
-				}
-			}
+	if( wall_check ) {
+		int cx = x0 + (x1 - x0) / 2;
+		int cy = y0 + (y1 - y0) / 2;
+		int n = blockcount;
+
+		for( int i = blockcount; i < bl_list_count; i++ ) {
+			bl = bl_list[i];
+			if( path_search_long(NULL, m, cx, cy, bl->x, bl->y, CELL_CHKWALL) )
+				bl_list[n++] = bl;
 		}
+		bl_list_count = n;
 	}
 
-	if (bl_list_count >= BL_LIST_MAX)
-		ShowWarning("map_foreachinarea: block count too many!\n");
+	return map_blocks_collected(blockcount, name);
+}
 
-	map_freeblock_lock();
+map_blocks map_blocks_inarea(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type)
+{
+	return map_blocks_inareaV(m, x0, y0, x1, y1, type, battle_config.skill_wall_check>0, "map_foreachinarea");
+}
 
-	for (i = blockcount; i < bl_list_count; i++) {
-		if (bl_list[i]->prev) { //func() may delete this bl_list[] slot, checking for prev ensures it wasn't queued for deletion.
-			va_copy(ap_copy, ap);
-			returnCount += func(bl_list[i], ap_copy);
-			va_end(ap_copy);
-		}
-	}
+map_blocks map_blocks_inallarea(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type)
+{
+	return map_blocks_inareaV(m, x0, y0, x1, y1, type, false, "map_foreachinarea");
+}
 
-	map_freeblock_unlock();
+map_blocks map_blocks_inshootarea(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type)
+{
+	return map_blocks_inareaV(m, x0, y0, x1, y1, type, true, "map_foreachinarea");
+}
 
-	bl_list_count = blockcount;
-	return returnCount;
+/*========================================== [Playtester]
+ * Apply *func with ... arguments for the area, see map_blocks_inareaV.
+*------------------------------------------*/
+int map_foreachinareaV(int(*func)(struct block_list*, va_list), int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type, va_list ap, bool wall_check)
+{
+	return map_foreachV(func, map_blocks_inareaV(m, x0, y0, x1, y1, type, wall_check, "map_foreachinarea"), ap);
 }
 
 int map_foreachinallarea(int (*func)(struct block_list*,va_list), int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type, ...)
@@ -842,156 +1216,43 @@ int map_foreachinarea(int(*func)(struct block_list*, va_list), int16 m, int16 x0
  *------------------------------------------*/
 int map_forcountinrange(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int count, int type, ...)
 {
-	int bx, by, m;
-	int returnCount = 0;	//total sum of returned values of func() [Skotlex]
-	struct block_list *bl;
-	int blockcount = bl_list_count, i;
-	int x0, x1, y0, y1;
-	struct map_data *mapdata;
+	int returnCount = 0;
 	va_list ap;
-
-	m = center->m;
-	mapdata = map_getmapdata(m);
-
-	if( mapdata == nullptr || mapdata->block == nullptr ){
-		return 0;
-	}
-
-	x0 = i16max(center->x - range, 0);
-	y0 = i16max(center->y - range, 0);
-	x1 = i16min(center->x + range, mapdata->xs - 1);
-	y1 = i16min(center->y + range, mapdata->ys - 1);
-
-	if ( type&~BL_MOB )
-		for ( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
-			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
-				for( bl = mapdata->block[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next ) {
-					if( bl->type&type
-						&& bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1
-#ifdef CIRCULAR_AREA
-						&& check_distance_bl(center, bl, range)
-#endif
-					  	&& bl_list_count < BL_LIST_MAX )
-						bl_list[ bl_list_count++ ] = bl;
-				}
-			}
-		}
-	if( type&BL_MOB )
-		for( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
-			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ){
-				for( bl = mapdata->block_mob[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next ) {
-					if( bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1
-#ifdef CIRCULAR_AREA
-						&& check_distance_bl(center, bl, range)
-#endif
-						&& bl_list_count < BL_LIST_MAX )
-						bl_list[ bl_list_count++ ] = bl;
-				}
-			}
-		}
-
-	if( bl_list_count >= BL_LIST_MAX )
-		ShowWarning("map_forcountinrange: block count too many!\n");
-
-	map_freeblock_lock();
-
-	for( i = blockcount; i < bl_list_count; i++ )
-		if( bl_list[ i ]->prev ) { //func() may delete this bl_list[] slot, checking for prev ensures it wasn't queued for deletion.
-			va_start(ap, type);
-			returnCount += func(bl_list[ i ], ap);
-			va_end(ap);
-			if( count && returnCount >= count )
-				break;
-		}
-
-	map_freeblock_unlock();
-
-	bl_list_count = blockcount;
+	va_start(ap, type);
+	returnCount = map_foreachV(func, map_blocks_inrangeV(center, range, type, false, "map_forcountinrange"), ap, count);
+	va_end(ap);
 	return returnCount;	//[Skotlex]
 }
 int map_forcountinarea(int (*func)(struct block_list*,va_list), int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int count, int type, ...)
 {
-	int bx, by;
-	int returnCount = 0;	//total sum of returned values of func() [Skotlex]
-	struct block_list *bl;
-	int blockcount = bl_list_count, i;
+	int returnCount = 0;
 	va_list ap;
-
-	if ( m < 0 )
-		return 0;
-
-	if ( x1 < x0 )
-		SWAP(x0, x1);
-	if ( y1 < y0 )
-		SWAP(y0, y1);
-
-	struct map_data *mapdata = map_getmapdata(m);
-
-	if( mapdata == nullptr || mapdata->block == nullptr ){
-		return 0;
-	}
-
-	x0 = i16max(x0, 0);
-	y0 = i16max(y0, 0);
-	x1 = i16min(x1, mapdata->xs - 1);
-	y1 = i16min(y1, mapdata->ys - 1);
-
-	if ( type&~BL_MOB )
-		for( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ )
-			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ )
-				for( bl = mapdata->block[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next )
-					if( bl->type&type && bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1 && bl_list_count < BL_LIST_MAX )
-						bl_list[ bl_list_count++ ] = bl;
-
-	if( type&BL_MOB )
-		for( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ )
-			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ )
-				for( bl = mapdata->block_mob[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next )
-					if( bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1 && bl_list_count < BL_LIST_MAX )
-						bl_list[ bl_list_count++ ] = bl;
-
-	if( bl_list_count >= BL_LIST_MAX )
-		ShowWarning("map_forcountinarea: block count too many!\n");
-
-	map_freeblock_lock();
-
-	for( i = blockcount; i < bl_list_count; i++ )
-		if(bl_list[ i ]->prev) { //func() may delete this bl_list[] slot, checking for prev ensures it wasn't queued for deletion.
-			va_start(ap, type);
-			returnCount += func(bl_list[ i ], ap);
-			va_end(ap);
-			if( count && returnCount >= count )
-				break;
-		}
-
-	map_freeblock_unlock();
-
-	bl_list_count = blockcount;
+	va_start(ap, type);
+	returnCount = map_foreachV(func, map_blocks_inareaV(m, x0, y0, x1, y1, type, false, "map_forcountinarea"), ap, count);
+	va_end(ap);
 	return returnCount;	//[Skotlex]
 }
 
 /*==========================================
- * Move bl and do func* with va_list while moving.
+ * Collects the blocks that enter the view of bl while moving.
  * Movement is set by dx dy which are distance in x and y
  *------------------------------------------*/
-int map_foreachinmovearea(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int16 dx, int16 dy, int type, ...)
+map_blocks map_blocks_inmovearea(struct block_list* center, int16 range, int16 dx, int16 dy, int type)
 {
-	int bx, by, m;
-	int returnCount = 0;  //total sum of returned values of func() [Skotlex]
+	int m;
 	struct block_list *bl;
-	int blockcount = bl_list_count, i;
+	int blockcount = bl_list_count;
 	int16 x0, x1, y0, y1;
-	va_list ap;
 
-	if ( !range ) return 0;
-	if ( !dx && !dy ) return 0; //No movement.
+	if ( !range ) return map_blocks();
+	if ( !dx && !dy ) return map_blocks(); //No movement.
 
 	m = center->m;
 
 	struct map_data *mapdata = map_getmapdata(m);
 
 	if( mapdata == nullptr || mapdata->block == nullptr ){
-		return 0;
+		return map_blocks();
 	}
 
 	x0 = center->x - range;
@@ -1011,92 +1272,49 @@ int map_foreachinmovearea(int (*func)(struct block_list*,va_list), struct block_
 				y0 = y1 + dy + 1;
 			else //North
 				y1 = y0 + dy - 1;
-		} else { //dy == 0
-			if( dx < 0 ) //West
-				x0 = x1 + dx + 1;
-			else //East
-				x1 = x0 + dx - 1;
-		}
-
-		x0 = i16max(x0, 0);
-		y0 = i16max(y0, 0);
-		x1 = i16min(x1, mapdata->xs - 1);
-		y1 = i16min(y1, mapdata->ys - 1);
-
-		for( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
-			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
-				if ( type&~BL_MOB ) {
-					for( bl = mapdata->block[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next ) {
-						if( bl->type&type &&
-							bl->x >= x0 && bl->x <= x1 &&
-							bl->y >= y0 && bl->y <= y1 &&
-							bl_list_count < BL_LIST_MAX )
-							bl_list[ bl_list_count++ ] = bl;
-					}
-				}
-				if ( type&BL_MOB ) {
-					for( bl = mapdata->block_mob[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next ) {
-						if( bl->x >= x0 && bl->x <= x1 &&
-							bl->y >= y0 && bl->y <= y1 &&
-							bl_list_count < BL_LIST_MAX )
-							bl_list[ bl_list_count++ ] = bl;
-					}
-				}
-			}
-		}
-	} else { // Diagonal movement
-		x0 = i16max(x0, 0);
-		y0 = i16max(y0, 0);
-		x1 = i16min(x1, mapdata->xs - 1);
-		y1 = i16min(y1, mapdata->ys - 1);
-
-		for( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
-			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
-				if ( type & ~BL_MOB ) {
-					for( bl = mapdata->block[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next ) {
-						if( bl->type&type &&
-							bl->x >= x0 && bl->x <= x1 &&
-							bl->y >= y0 && bl->y <= y1 &&
-							bl_list_count < BL_LIST_MAX )
-						if( ( dx > 0 && bl->x < x0 + dx) ||
-							( dx < 0 && bl->x > x1 + dx) ||
-							( dy > 0 && bl->y < y0 + dy) ||
-							( dy < 0 && bl->y > y1 + dy) )
-							bl_list[ bl_list_count++ ] = bl;
-					}
-				}
-				if ( type&BL_MOB ) {
-					for( bl = mapdata->block_mob[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next ) {
-						if( bl->x >= x0 && bl->x <= x1 &&
-							bl->y >= y0 && bl->y <= y1 &&
-							bl_list_count < BL_LIST_MAX)
-						if( ( dx > 0 && bl->x < x0 + dx) ||
-							( dx < 0 && bl->x > x1 + dx) ||
-							( dy > 0 && bl->y < y0 + dy) ||
-							( dy < 0 && bl->y > y1 + dy) )
-							bl_list[ bl_list_count++ ] = bl;
-					}
-				}
-			}
+		} else { //dy == 0
+			if( dx < 0 ) //West
+				x0 = x1 + dx + 1;
+			else //East
+				x1 = x0 + dx - 1;
 		}
-
 	}
 
-	if( bl_list_count >= BL_LIST_MAX )
-		ShowWarning("map_foreachinmovearea: block count too many!\n");
+	x0 = i16max(x0, 0);
+	y0 = i16max(y0, 0);
+	x1 = i16min(x1, mapdata->xs - 1);
+	y1 = i16min(y1, mapdata->ys - 1);
+
+	map_block_soa_collect_area(mapdata, type, x0, y0, x1, y1);
 
-	map_freeblock_lock();	// Prohibit the release from memory
+	if( dx != 0 && dy != 0 ) { // Diagonal movement, only keep the blocks entering the view
+		int n = blockcount;
 
-	for( i = blockcount; i < bl_list_count; i++ )
-		if( bl_list[ i ]->prev ) { //func() may delete this bl_list[] slot, checking for prev ensures it wasn't queued for deletion.
-			va_start(ap, type);
-			returnCount += func(bl_list[ i ], ap);
-			va_end(ap);
+		for( int i = blockcount; i < bl_list_count; i++ ) {
+			bl = bl_list[i];
+			if( ( dx > 0 && bl->x < x0 + dx) ||
+				( dx < 0 && bl->x > x1 + dx) ||
+				( dy > 0 && bl->y < y0 + dy) ||
+				( dy < 0 && bl->y > y1 + dy) )
+				bl_list[n++] = bl;
 		}
+		bl_list_count = n;
+	}
 
-	map_freeblock_unlock();	// Allow Free
+	return map_blocks_collected(blockcount, "map_foreachinmovearea");
+}
 
-	bl_list_count = blockcount;
+/*==========================================
+ * Move bl and do func* with va_list while moving.
+ * Movement is set by dx dy which are distance in x and y
+ *------------------------------------------*/
+int map_foreachinmovearea(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int16 dx, int16 dy, int type, ...)
+{
+	int returnCount = 0;  //total sum of returned values of func() [Skotlex]
+	va_list ap;
+	va_start(ap, type);
+	returnCount = map_foreachV(func, map_blocks_inmovearea(center, range, dx, dy, type), ap);
+	va_end(ap);
 	return returnCount;
 }
 
@@ -1104,57 +1322,37 @@ int map_foreachinmovearea(int (*func)(struct block_list*,va_list), struct block_
 //			 which only checks the exact single x/y passed to it rather than an
 //			 area radius - may be more useful in some instances)
 //
-int map_foreachincell(int (*func)(struct block_list*,va_list), int16 m, int16 x, int16 y, int type, ...)
+map_blocks map_blocks_incell(int16 m, int16 x, int16 y, int type)
 {
-	int bx, by;
-	int returnCount = 0;  //total sum of returned values of func() [Skotlex]
-	struct block_list *bl;
-	int blockcount = bl_list_count, i;
+	int blockcount = bl_list_count;
 	struct map_data *mapdata = map_getmapdata(m);
-	va_list ap;
 
 	if( mapdata == nullptr || mapdata->block == nullptr ){
-		return 0;
+		return map_blocks();
 	}
 
-	if ( x < 0 || y < 0 || x >= mapdata->xs || y >= mapdata->ys ) return 0;
-
-	by = y / BLOCK_SIZE;
-	bx = x / BLOCK_SIZE;
-
-	if( type&~BL_MOB )
-		for( bl = mapdata->block[ bx + by * mapdata->bxs ]; bl != NULL; bl = bl->next )
-			if( bl->type&type && bl->x == x && bl->y == y && bl_list_count < BL_LIST_MAX )
-				bl_list[ bl_list_count++ ] = bl;
-	if( type&BL_MOB )
-		for( bl = mapdata->block_mob[ bx + by * mapdata->bxs]; bl != NULL; bl = bl->next )
-			if( bl->x == x && bl->y == y && bl_list_count < BL_LIST_MAX)
-				bl_list[ bl_list_count++ ] = bl;
-
-	if( bl_list_count >= BL_LIST_MAX )
-		ShowWarning("map_foreachincell: block count too many!\n");
-
-	map_freeblock_lock();
+	if ( x < 0 || y < 0 || x >= mapdata->xs || y >= mapdata->ys ) return map_blocks();
 
-	for( i = blockcount; i < bl_list_count; i++ )
-		if( bl_list[ i ]->prev ) { //func() may delete this bl_list[] slot, checking for prev ensures it wasn't queued for deletion.
-			va_start(ap, type);
-			returnCount += func(bl_list[ i ], ap);
-			va_end(ap);
-		}
+	map_block_soa_collect(mapdata->block_soa[x / BLOCK_SIZE + (y / BLOCK_SIZE) * mapdata->bxs], type, x, y, x, y);
 
-	map_freeblock_unlock();
+	return map_blocks_collected(blockcount, "map_foreachincell");
+}
 
-	bl_list_count = blockcount;
+int map_foreachincell(int (*func)(struct block_list*,va_list), int16 m, int16 x, int16 y, int type, ...)
+{
+	int returnCount = 0;  //total sum of returned values of func() [Skotlex]
+	va_list ap;
+	va_start(ap, type);
+	returnCount = map_foreachV(func, map_blocks_incell(m, x, y, type), ap);
+	va_end(ap);
 	return returnCount;
 }
 
 /*============================================================
 * For checking a path between two points (x0, y0) and (x1, y1)
 *------------------------------------------------------------*/
-int map_foreachinpath(int (*func)(struct block_list*,va_list),int16 m,int16 x0,int16 y0,int16 x1,int16 y1,int16 range,int length, int type,...)
+map_blocks map_blocks_inpath(int16 m,int16 x0,int16 y0,int16 x1,int16 y1,int16 range,int length, int type)
 {
-	int returnCount = 0;  //total sum of returned values of func() [Skotlex]
 //////////////////////////////////////////////////////////////
 //
 // sharp shooting 3 [Skotlex]
@@ -1189,24 +1387,23 @@ int map_foreachinpath(int (*func)(struct block_list*,va_list),int16 m,int16 x0,i
 // kRO.
 
 	//Generic map_foreach* variables.
-	int i, blockcount = bl_list_count;
+	int blockcount = bl_list_count;
 	struct block_list *bl;
 	int bx, by;
 	//method specific variables
 	int magnitude2, len_limit; //The square of the magnitude
 	int k, xi, yi, xu, yu;
 	int mx0 = x0, mx1 = x1, my0 = y0, my1 = y1;
-	va_list ap;
 
 	//Avoid needless calculations by not getting the sqrt right away.
 	#define MAGNITUDE2(x0, y0, x1, y1) ( ( ( x1 ) - ( x0 ) ) * ( ( x1 ) - ( x0 ) ) + ( ( y1 ) - ( y0 ) ) * ( ( y1 ) - ( y0 ) ) )
 
 	if ( m < 0 )
-		return 0;
+		return map_blocks();
 
 	len_limit = magnitude2 = MAGNITUDE2(x0, y0, x1, y1);
 	if ( magnitude2 < 1 ) //Same begin and ending point, can't trace path.
-		return 0;
+		return map_blocks();
 
 	if ( length ) { //Adjust final position to fit in the given area.
 		//TODO: Find an alternate method which does not requires a square root calculation.
@@ -1240,7 +1437,7 @@ int map_foreachinpath(int (*func)(struct block_list*,va_list),int16 m,int16 x0,i
 	struct map_data *mapdata = map_getmapdata(m);
 
 	if( mapdata == nullptr || mapdata->block == nullptr ){
-		return 0;
+		return map_blocks();
 	}
 
 	mx0 = max(mx0, 0);
@@ -1316,23 +1513,17 @@ int map_foreachinpath(int (*func)(struct block_list*,va_list),int16 m,int16 x0,i
 			}
 		}
 
-	if( bl_list_count >= BL_LIST_MAX )
-		ShowWarning("map_foreachinpath: block count too many!\n");
-
-	map_freeblock_lock();
-
-	for( i = blockcount; i < bl_list_count; i++ )
-		if( bl_list[ i ]->prev ) { //func() may delete this bl_list[] slot, checking for prev ensures it wasn't queued for deletion.
-			va_start(ap, type);
-			returnCount += func(bl_list[ i ], ap);
-			va_end(ap);
-		}
-
-	map_freeblock_unlock();
+	return map_blocks_collected(blockcount, "map_foreachinpath");
+}
 
-	bl_list_count = blockcount;
+int map_foreachinpath(int (*func)(struct block_list*,va_list),int16 m,int16 x0,int16 y0,int16 x1,int16 y1,int16 range,int length, int type,...)
+{
+	int returnCount = 0;  //total sum of returned values of func() [Skotlex]
+	va_list ap;
+	va_start(ap, type);
+	returnCount = map_foreachV(func, map_blocks_inpath(m, x0, y0, x1, y1, range, length, type), ap);
+	va_end(ap);
 	return returnCount;	//[Skotlex]
-
 }
 
 /*========================================== [Playtester]
@@ -1350,28 +1541,25 @@ int map_foreachinpath(int (*func)(struct block_list*,va_list),int16 m,int16 x0,i
 * @param offset: Moves the whole path, half-length for diagonal paths
 * @param type: Type of bl to search for
 *------------------------------------------*/
-int map_foreachindir(int(*func)(struct block_list*, va_list), int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int16 range, int length, int offset, int type, ...)
+map_blocks map_blocks_indir(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int16 range, int length, int offset, int type)
 {
-	int returnCount = 0;  //Total sum of returned values of func()
-
-	int i, blockcount = bl_list_count;
+	int blockcount = bl_list_count;
 	struct block_list *bl;
 	int bx, by;
 	int mx0, mx1, my0, my1, rx, ry;
 	uint8 dir = map_calc_dir_xy(x0, y0, x1, y1, 6);
 	short dx = dirx[dir];
 	short dy = diry[dir];
-	va_list ap;
 
 	if (m < 0)
-		return 0;
+		return map_blocks();
 
 	if (range < 0)
-		return 0;
+		return map_blocks();
 	if (length < 1)
-		return 0;
+		return map_blocks();
 	if (offset < 0)
-		return 0;
+		return map_blocks();
 
 	//Special offset handling for diagonal paths
 	if (offset && (dir % 2)) {
@@ -1384,7 +1572,7 @@ int map_foreachindir(int(*func)(struct block_list*, va_list), int16 m, int16 x0,
 	struct map_data *mapdata = map_getmapdata(m);
 
 	if( mapdata == nullptr || mapdata->block == nullptr ){
-		return 0;
+		return map_blocks();
 	}
 
 	//Get area that needs to be checked
@@ -1483,67 +1671,41 @@ int map_foreachindir(int(*func)(struct block_list*, va_list), int16 m, int16 x0,
 		}
 	}
 
-	if( bl_list_count >= BL_LIST_MAX )
-		ShowWarning("map_foreachindir: block count too many!\n");
-
-	map_freeblock_lock();
-
-	for( i = blockcount; i < bl_list_count; i++ )
-		if( bl_list[ i ]->prev ) { //func() may delete this bl_list[] slot, checking for prev ensures it wasn't queued for deletion.
-			va_start(ap, type);
-			returnCount += func(bl_list[ i ], ap);
-			va_end(ap);
-		}
-
-	map_freeblock_unlock();
+	return map_blocks_collected(blockcount, "map_foreachindir");
+}
 
-	bl_list_count = blockcount;
+int map_foreachindir(int(*func)(struct block_list*, va_list), int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int16 range, int length, int offset, int type, ...)
+{
+	int returnCount = 0;  //Total sum of returned values of func()
+	va_list ap;
+	va_start(ap, type);
+	returnCount = map_foreachV(func, map_blocks_indir(m, x0, y0, x1, y1, range, length, offset, type), ap);
+	va_end(ap);
 	return returnCount;
 }
 
 // Copy of map_foreachincell, but applied to the whole map. [Skotlex]
-int map_foreachinmap(int (*func)(struct block_list*,va_list), int16 m, int type,...)
+map_blocks map_blocks_inmap(int16 m, int type)
 {
-	int b, bsize;
-	int returnCount = 0;  //total sum of returned values of func() [Skotlex]
-	struct block_list *bl;
-	int blockcount = bl_list_count, i;
+	int blockcount = bl_list_count;
 	struct map_data *mapdata = map_getmapdata(m);
-	va_list ap;
 
 	if( mapdata == nullptr || mapdata->block == nullptr ){
-		return 0;
+		return map_blocks();
 	}
 
-	bsize = mapdata->bxs * mapdata->bys;
-
-	if( type&~BL_MOB )
-		for( b = 0; b < bsize; b++ )
-			for( bl = mapdata->block[ b ]; bl != NULL; bl = bl->next )
-				if( bl->type&type && bl_list_count < BL_LIST_MAX )
-					bl_list[ bl_list_count++ ] = bl;
-
-	if( type&BL_MOB )
-		for( b = 0; b < bsize; b++ )
-			for( bl = mapdata->block_mob[ b ]; bl != NULL; bl = bl->next )
-				if( bl_list_count < BL_LIST_MAX )
-					bl_list[ bl_list_count++ ] = bl;
-
-	if( bl_list_count >= BL_LIST_MAX )
-		ShowWarning("map_foreachinmap: block count too many!\n");
-
-	map_freeblock_lock();
-
-	for( i = blockcount; i < bl_list_count ; i++ )
-		if( bl_list[ i ]->prev ) { //func() may delete this bl_list[] slot, checking for prev ensures it wasn't queued for deletion.
-			va_start(ap, type);
-			returnCount += func(bl_list[ i ], ap);
-			va_end(ap);
-		}
+	map_block_soa_collect_area(mapdata, type, 0, 0, mapdata->xs - 1, mapdata->ys - 1);
 
-	map_freeblock_unlock();
+	return map_blocks_collected(blockcount, "map_foreachinmap");
+}
 
-	bl_list_count = blockcount;
+int map_foreachinmap(int (*func)(struct block_list*,va_list), int16 m, int type,...)
+{
+	int returnCount = 0;  //total sum of returned values of func() [Skotlex]
+	va_list ap;
+	va_start(ap, type);
+	returnCount = map_foreachV(func, map_blocks_inmap(m, type), ap);
+	va_end(ap);
 	return returnCount;
 }
 
@@ -2194,7 +2356,7 @@ int map_quit(struct map_session_data *sd) {
 	}
 
 	if (sd->state.vending)
-		idb_remove(vending_getdb(), sd->status.char_id);
+		vending_removedb(sd);
 
 	if (sd->state.buyingstore)
 		idb_remove(buyingstore_getdb(), sd->status.char_id);
@@ -2687,6 +2849,7 @@ bool map_addnpc(int16 m,struct npc_data *nd)
 		}
 	}
 	mapdata->npc_num++;
+	mapdata->npc_area_generation++;
 	idb_put(id_db,nd->bl.id,nd);
 	return true;
 }
@@ -2753,17 +2916,20 @@ int map_addinstancemap(int src_m, int instance_id)
 	dst_map->npc_num = 0;
 	dst_map->npc_num_area = 0;
 	dst_map->npc_num_warp = 0;
+	dst_map->npc_area_first.clear();
+	dst_map->npc_area.clear();
 
-	// Reallocate cells
-	size_t num_cell = dst_map->xs * dst_map->ys;
+	// Reallocate cells, an unchanged map from the raw map cache shares the mapped cells until the instance changes them
+	dst_map->gat = src_map->gat;
 
-	CREATE( dst_map->cell, struct mapcell, num_cell );
-	memcpy( dst_map->cell, src_map->cell, num_cell * sizeof(struct mapcell) );
+	if( src_map->cell ){
+		size_t num_cell = dst_map->xs * dst_map->ys;
 
-	size_t size = dst_map->bxs * dst_map->bys * sizeof(struct block_list*);
+		CREATE( dst_map->cell, struct mapcell, num_cell );
+		memcpy( dst_map->cell, src_map->cell, num_cell * sizeof(struct mapcell) );
+	}
 
-	dst_map->block = (struct block_list **)aCalloc(1,size);
-	dst_map->block_mob = (struct block_list **)aCalloc(1,size);
+	map_block_alloc(dst_map);
 
 	dst_map->index = mapindex_addmap(-1, dst_map->name);
 	dst_map->channel = nullptr;
@@ -2847,6 +3013,8 @@ int map_delinstancemap(int m)
 	if (mapdata->cell)
 		aFree(mapdata->cell);
 	mapdata->cell = NULL;
+	mapdata->gat = NULL;
+	map_layers_free(mapdata);
 	if (mapdata->block)
 		aFree(mapdata->block);
 	mapdata->block = NULL;
@@ -3031,7 +3199,7 @@ int16 map_mapindex2mapid(unsigned short mapindex)
 		return -1;
 
 	md = (struct map_data*)uidb_get(map_db,(unsigned int)mapindex);
-	if(md==NULL || md->cell==NULL)
+	if(md==NULL || !map_haslocalcells(md))
 		return -1;
 	return md->m;
 }
@@ -3044,7 +3212,7 @@ int map_mapname2ipport(unsigned short name, uint32* ip, uint16* port)
 	struct map_data_other_server *mdos;
 
 	mdos = (struct map_data_other_server*)uidb_get(map_db,(unsigned int)name);
-	if(mdos==NULL || mdos->cell) //If gat isn't null, this is a local map.
+	if(mdos==NULL || mdos->cell || mdos->gat) //If gat isn't null, this is a local map.
 		return -1;
 	*ip=mdos->ip;
 	*port=mdos->port;
@@ -3182,6 +3350,142 @@ inline static struct mapcell map_gat2cell(int gat) {
 	return cell;
 }
 
+/**
+ * Returns the cells of a local map for changing them.
+ * Maps read from the raw map cache only get their own copy of the cells on the first change.
+ * @param mapdata: Map
+ * @return Cells of the map
+ */
+static struct mapcell* map_cells(struct map_data *mapdata)
+{
+	if( mapdata->cell == NULL && mapdata->gat != NULL ){
+		size_t num_cells = (size_t)mapdata->xs * (size_t)mapdata->ys;
+
+		CREATE(mapdata->cell, struct mapcell, num_cells);
+
+		for( size_t xy = 0; xy < num_cells; ++xy )
+			mapdata->cell[xy] = map_gat2cell(mapdata->gat[xy]);
+
+#ifndef WIN32
+		// The map does not read its mapped cells anymore, so the kernel may drop them from memory
+		madvise((void *)mapdata->gat, num_cells, MADV_DONTNEED);
+#endif
+	}
+
+	return mapdata->cell;
+}
+
+static uint32 map_walkable_generation = 0; // Last generation given to a walkable layer
+
+/**
+ * Builds the cell layers of a local map: bitmaps of its walkable and of its shootable cells, 64 cells per word.
+ * The last row and column are always walkable and shootable, like map_getcellp reports them for all checks but CELL_CHKNOPASS.
+ * @param mapdata: Map
+ */
+static void map_layers_build(struct map_data *mapdata)
+{
+	size_t words;
+
+	mapdata->layer_stride = ( mapdata->xs + 63 ) / 64;
+	mapdata->walkable_generation = ++map_walkable_generation;
+
+	words = (size_t)mapdata->layer_stride * mapdata->ys;
+
+	CREATE(mapdata->walkable, uint64, words);
+	CREATE(mapdata->shootable, uint64, words);
+
+	for( int16 y = 0; y < mapdata->ys; y++ ){
+		uint64 *walkable = &mapdata->walkable[(size_t)y * mapdata->layer_stride];
+		uint64 *shootable = &mapdata->shootable[(size_t)y * mapdata->layer_stride];
+
+		for( int16 x = 0; x < mapdata->xs; x++ ){
+			int xy = x + y * mapdata->xs;
+			struct mapcell cell = {};
+
+			if( x >= mapdata->xs - 1 || y >= mapdata->ys - 1 ){
+				cell.walkable = 1;
+				cell.shootable = 1;
+			}else if( mapdata->cell )
+				cell = mapdata->cell[xy];
+			else
+				cell = map_gat2cell(mapdata->gat[xy]);
+
+			if( cell.walkable )
+				walkable[x >> 6] |= UINT64_C(1) << ( x & 63 );
+			if( cell.shootable )
+				shootable[x >> 6] |= UINT64_C(1) << ( x & 63 );
+		}
+	}
+}
+
+/**
+ * Returns the walkable layer of a local map, building the layers on first use.
+ * @param mapdata: Map
+ * @return Bitmap with layer_stride words per row
+ */
+const uint64* map_walkable(struct map_data *mapdata)
+{
+	if( mapdata->walkable == NULL && map_haslocalcells(mapdata) )
+		map_layers_build(mapdata);
+
+	return mapdata->walkable;
+}
+
+/**
+ * Returns the shootable layer of a local map, building the layers on first use.
+ * @param mapdata: Map
+ * @return Bitmap with layer_stride words per row
+ */
+const uint64* map_shootable(struct map_data *mapdata)
+{
+	if( mapdata->shootable == NULL && map_haslocalcells(mapdata) )
+		map_layers_build(mapdata);
+
+	return mapdata->shootable;
+}
+
+/// Updates a cell of a layer, if the map has built its layers
+/// @return Whether the cell changed
+static bool map_layer_update(struct map_data *mapdata, uint64 *layer, int16 x, int16 y, bool flag)
+{
+	if( layer == NULL || x >= mapdata->xs - 1 || y >= mapdata->ys - 1 )
+		return false;
+
+	uint64 *word = &layer[(size_t)y * mapdata->layer_stride + ( x >> 6 )];
+	uint64 bit = UINT64_C(1) << ( x & 63 );
+
+	if( flag == ( ( *word & bit ) != 0 ) )
+		return false;
+
+	if( flag )
+		*word |= bit;
+	else
+		*word &= ~bit;
+
+	return true;
+}
+
+/// Updates a cell of the walkable layer
+static void map_walkable_update(struct map_data *mapdata, int16 x, int16 y, bool walkable)
+{
+	// Paths searched before the change are not valid anymore
+	if( map_layer_update(mapdata, mapdata->walkable, x, y, walkable) )
+		mapdata->walkable_generation = ++map_walkable_generation;
+}
+
+/// Frees the cell layers of a map
+static void map_layers_free(struct map_data *mapdata)
+{
+	if( mapdata->walkable ){
+		aFree(mapdata->walkable);
+		mapdata->walkable = NULL;
+	}
+	if( mapdata->shootable ){
+		aFree(mapdata->shootable);
+		mapdata->shootable = NULL;
+	}
+}
+
 static int map_cell2gat(struct mapcell cell)
 {
 	if( cell.walkable == 1 && cell.shootable == 1 && cell.water == 0 ) return 0;
@@ -3214,7 +3518,10 @@ int map_getcellp(struct map_data* m,int16 x,int16 y,cell_chk cellchk)
 	if(x<0 || x>=m->xs-1 || y<0 || y>=m->ys-1)
 		return( cellchk == CELL_CHKNOPASS );
 
-	cell = m->cell[x + y*m->xs];
+	if( m->cell )
+		cell = m->cell[x + y*m->xs];
+	else // Unchanged map from the raw map cache, no dynamic flags are set yet
+		cell = map_gat2cell(m->gat[x + y*m->xs]);
 
 	switch(cellchk)
 	{
@@ -3291,18 +3598,24 @@ void map_setcell(int16 m, int16 x, int16 y, cell_t cell, bool flag)
 
 	j = x + y*mapdata->xs;
 
+	// Dynamic flags of an unchanged map are all unset, so there is nothing to clear
+	if( mapdata->cell == NULL && cell >= CELL_NPC && !flag )
+		return;
+
+	struct mapcell *cells = map_cells(mapdata);
+
 	switch( cell ) {
-		case CELL_WALKABLE:      mapdata->cell[j].walkable = flag;      break;
-		case CELL_SHOOTABLE:     mapdata->cell[j].shootable = flag;     break;
-		case CELL_WATER:         mapdata->cell[j].water = flag;         break;
-
-		case CELL_NPC:           mapdata->cell[j].npc = flag;           break;
-		case CELL_BASILICA:      mapdata->cell[j].basilica = flag;      break;
-		case CELL_LANDPROTECTOR: mapdata->cell[j].landprotector = flag; break;
-		case CELL_NOVENDING:     mapdata->cell[j].novending = flag;     break;
-		case CELL_NOCHAT:        mapdata->cell[j].nochat = flag;        break;
-		case CELL_MAELSTROM:	 mapdata->cell[j].maelstrom = flag;	  break;
-		case CELL_ICEWALL:		 mapdata->cell[j].icewall = flag;		  break;
+		case CELL_WALKABLE:      cells[j].walkable = flag;      map_walkable_update(mapdata, x, y, flag); break;
+		case CELL_SHOOTABLE:     cells[j].shootable = flag;     map_layer_update(mapdata, mapdata->shootable, x, y, flag); break;
+		case CELL_WATER:         cells[j].water = flag;         break;
+
+		case CELL_NPC:           cells[j].npc = flag;           break;
+		case CELL_BASILICA:      cells[j].basilica = flag;      break;
+		case CELL_LANDPROTECTOR: cells[j].landprotector = flag; break;
+		case CELL_NOVENDING:     cells[j].novending = flag;     break;
+		case CELL_NOCHAT:        cells[j].nochat = flag;        break;
+		case CELL_MAELSTROM:	 cells[j].maelstrom = flag;	  break;
+		case CELL_ICEWALL:		 cells[j].icewall = flag;		  break;
 		default:
 			ShowWarning("map_setcell: invalid cell type '%d'\n", (int)cell);
 			break;
@@ -3321,9 +3634,15 @@ void map_setgatcell(int16 m, int16 x, int16 y, int gat)
 	j = x + y*mapdata->xs;
 
 	cell = map_gat2cell(gat);
-	mapdata->cell[j].walkable = cell.walkable;
-	mapdata->cell[j].shootable = cell.shootable;
-	mapdata->cell[j].water = cell.water;
+
+	struct mapcell *cells = map_cells(mapdata);
+
+	cells[j].walkable = cell.walkable;
+	cells[j].shootable = cell.shootable;
+	cells[j].water = cell.water;
+
+	map_walkable_update(mapdata, x, y, cell.walkable);
+	map_layer_update(mapdata, mapdata->shootable, x, y, cell.shootable);
 }
 
 /*==========================================
@@ -3464,7 +3783,7 @@ int map_setipport(unsigned short mapindex, uint32 ip, uint16 port)
 
 	mdos= (struct map_data_other_server *)uidb_ensure(map_db,(unsigned int)mapindex, create_map_data_other_server);
 
-	if(mdos->cell) //Local map,Do nothing. Give priority to our own local maps over ones from another server. [Skotlex]
+	if(mdos->cell || mdos->gat) //Local map,Do nothing. Give priority to our own local maps over ones from another server. [Skotlex]
 		return 0;
 	if(ip == clif_getip() && port == clif_getport()) {
 		//That's odd, we received info that we are the ones with this map, but... we don't have it.
@@ -3483,7 +3802,7 @@ int map_setipport(unsigned short mapindex, uint32 ip, uint16 port)
 int map_eraseallipport_sub(DBKey key, DBData *data, va_list va)
 {
 	struct map_data_other_server *mdos = (struct map_data_other_server *)db_data2ptr(data);
-	if(mdos->cell == NULL) {
+	if(mdos->cell == NULL && mdos->gat == NULL) {
 		db_remove(map_db,key);
 		aFree(mdos);
 	}
@@ -3504,7 +3823,7 @@ int map_eraseipport(unsigned short mapindex, uint32 ip, uint16 port)
 	struct map_data_other_server *mdos;
 
 	mdos = (struct map_data_other_server*)uidb_get(map_db,(unsigned int)mapindex);
-	if(!mdos || mdos->cell) //Map either does not exists or is a local map.
+	if(!mdos || mdos->cell || mdos->gat) //Map either does not exists or is a local map.
 		return 0;
 
 	if(mdos->ip==ip && mdos->port == port) {
@@ -3597,6 +3916,123 @@ int map_readfromcache(struct map_data *m, char *buffer, char *decode_buffer)
 	return 0; // Not found
 }
 
+/*==========================================
+ * Releases a raw map cache file
+ *------------------------------------------*/
+static void map_final_mapcache_raw(struct s_map_cache_raw *cache)
+{
+	if( cache->data == NULL )
+		return;
+
+#ifdef WIN32
+	aFree(cache->data);
+#else
+	munmap(cache->data, cache->size);
+#endif
+	cache->data = NULL;
+	cache->size = 0;
+}
+
+/*==========================================
+ * Maps a raw map cache file into memory
+ * Cells are only read from disk when a map uses them.
+ *------------------------------------------*/
+static bool map_init_mapcache_raw(const char *filename, struct s_map_cache_raw *cache)
+{
+	cache->data = NULL;
+	cache->size = 0;
+
+#ifdef WIN32
+	FILE *fp = fopen(filename, "rb");
+
+	if( fp == NULL )
+		return false;
+
+	fseek(fp, 0, SEEK_END);
+	cache->size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	CREATE(cache->data, char, cache->size);
+
+	if( fread(cache->data, 1, cache->size, fp) != cache->size ){
+		ShowError("map_init_mapcache_raw: Could not read entire map cache file %s\n", filename);
+		aFree(cache->data);
+		cache->data = NULL;
+		fclose(fp);
+		return false;
+	}
+	fclose(fp);
+#else
+	int fd = open(filename, O_RDONLY);
+	struct stat st;
+
+	if( fd < 0 )
+		return false;
+
+	if( fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct map_cache_raw_header) ){
+		ShowError("map_init_mapcache_raw: Invalid map cache file %s\n", filename);
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	close(fd);
+
+	if( data == MAP_FAILED ){
+		ShowError("map_init_mapcache_raw: Could not map %s: %s\n", filename, strerror(errno));
+		return false;
+	}
+
+	cache->data = (char *)data;
+	cache->size = (size_t)st.st_size;
+#endif
+
+	struct map_cache_raw_header *header = (struct map_cache_raw_header *)cache->data;
+
+	if( cache->size < sizeof(struct map_cache_raw_header) || memcmp(header->magic, MAP_CACHE_RAW_MAGIC, sizeof(header->magic)) != 0 || header->version != MAP_CACHE_RAW_VERSION
+		|| header->file_size != cache->size || sizeof(struct map_cache_raw_header) + (size_t)header->map_count * sizeof(struct map_cache_raw_map_info) > cache->size ){
+		ShowError("map_init_mapcache_raw: %s is not a raw map cache of version %d\n", filename, MAP_CACHE_RAW_VERSION);
+		map_final_mapcache_raw(cache);
+		return false;
+	}
+
+	return true;
+}
+
+/*==========================================
+ * Raw map cache reading
+ * The map points to the mapped cells, nothing is decoded or copied.
+ *==========================================*/
+static int map_readfromcache_raw(struct map_data *m, struct s_map_cache_raw *cache)
+{
+	struct map_cache_raw_header *header = (struct map_cache_raw_header *)cache->data;
+	struct map_cache_raw_map_info *info = (struct map_cache_raw_map_info *)(cache->data + sizeof(struct map_cache_raw_header));
+
+	for( uint32 i = 0; i < header->map_count; i++, info++ ){
+		if( strncmp(m->name, info->name, MAP_NAME_LENGTH) != 0 )
+			continue;
+
+		size_t size = (size_t)info->xs * (size_t)info->ys;
+
+		if( info->xs <= 0 || info->ys <= 0 || info->offset + size > cache->size )
+			return 0;// Invalid
+
+		if( size > MAX_MAP_SIZE ){
+			ShowWarning("map_readfromcache_raw: %s exceeded MAX_MAP_SIZE of %d\n", info->name, MAX_MAP_SIZE);
+			return 0;
+		}
+
+		m->xs = info->xs;
+		m->ys = info->ys;
+		m->gat = (const uint8 *)(cache->data + info->offset);
+		m->cell = NULL;
+
+		return 1;
+	}
+
+	return 0; // Not found
+}
+
 int map_addmap(char* mapname)
 {
 	if( strcmpi(mapname,"clear")==0 )
@@ -3804,7 +4240,27 @@ int map_readallmaps (void)
 
 	if( enable_grf )
 		ShowStatus("Loading maps (using GRF files)...\n");
-	else {
+	else if( enable_map_cache_raw ){
+		const char* mapcachefilepath[] = {
+			"db/" DBPATH "map_cache_raw.dat",
+			"db/" DBIMPORT "/map_cache_raw.dat"
+		};
+
+		for( int i = 0; i < 2; i++ ){
+			ShowStatus( "Loading maps (using %s as raw map cache)...\n", mapcachefilepath[i] );
+
+			if( !map_init_mapcache_raw( mapcachefilepath[i], &map_cache_raw[i] ) ){
+				if( i == 0 ){
+					ShowFatalError( "Unable to open raw map cache file " CL_WHITE "%s" CL_RESET ", create it with 'mapcache -raw'\n", mapcachefilepath[i] );
+					exit(EXIT_FAILURE); //No use launching server if maps can't be read.
+				}else{
+					// The import cache is optional
+					ShowInfo( "No raw map cache file " CL_WHITE "%s" CL_RESET " to import.\n", mapcachefilepath[i] );
+					break;
+				}
+			}
+		}
+	} else {
 		const char* mapcachefilepath[] = {
 			"db/" DBPATH "map_cache.dat",
 			"db/" DBIMPORT "/map_cache.dat"
@@ -3838,7 +4294,6 @@ int map_readallmaps (void)
 	int maps_removed = 0;
 
 	for (int i = 0; i < map_num; i++) {
-		size_t size;
 		bool success = false;
 		unsigned short idx = 0;
 		struct map_data *mapdata = &map[i];
@@ -3849,6 +4304,15 @@ int map_readallmaps (void)
 		if( enable_grf ){
 			// try to load the map
 			success = map_readgat(mapdata) != 0;
+		}else if( enable_map_cache_raw ){
+			// Read from import first, in case of override
+			if( map_cache_raw[1].data != NULL ){
+				success = map_readfromcache_raw( mapdata, &map_cache_raw[1] ) != 0;
+			}
+
+			if( !success ){
+				success = map_readfromcache_raw( mapdata, &map_cache_raw[0] ) != 0;
+			}
 		}else{
 			// try to load the map
 			// Read from import first, in case of override
@@ -3878,6 +4342,7 @@ int map_readallmaps (void)
 				aFree(mapdata->cell);
 				mapdata->cell = NULL;
 			}
+			mapdata->gat = NULL;
 			map_delmapid(i);
 			maps_removed++;
 			i--;
@@ -3893,9 +4358,7 @@ int map_readallmaps (void)
 		mapdata->bxs = (mapdata->xs + BLOCK_SIZE - 1) / BLOCK_SIZE;
 		mapdata->bys = (mapdata->ys + BLOCK_SIZE - 1) / BLOCK_SIZE;
 
-		size = mapdata->bxs * mapdata->bys * sizeof(struct block_list*);
-		mapdata->block = (struct block_list**)aCalloc(size, 1);
-		mapdata->block_mob = (struct block_list**)aCalloc(size, 1);
+		map_block_alloc(mapdata);
 
 		memset(&mapdata->save, 0, sizeof(struct point));
 		mapdata->damage_adjust = {};
@@ -3905,7 +4368,7 @@ int map_readallmaps (void)
 	// intialization and configuration-dependent adjustments of mapflags
 	map_flags_init();
 
-	if( !enable_grf ) {
+	if( !enable_grf && !enable_map_cache_raw ) {
 		// The cache isn't needed anymore, so free it. [Shinryo]
 		if( map_cache_buffer[1] != NULL ){
 			aFree(map_cache_buffer[1]);
@@ -3987,12 +4450,38 @@ int parse_console(const char* buf){
 	else if( strcmpi("ers_report", type) == 0 ){
 		ers_report();
 	}
+	else if( strcmpi("autosave_report", type) == 0 ){
+		pc_autosave_report();
+	}
+	else if( n == 2 && strcmpi("path_benchmark", type) == 0 ){
+		int16 m = map_mapname2mapid(command);
+
+		if( m < 0 )
+			ShowWarning("Console: Unknown map.\n");
+		else
+			path_benchmark(m, 100000);
+	}
+	else if( n == 2 && strcmpi("block_benchmark", type) == 0 ){
+		int16 m = map_mapname2mapid(command);
+
+		if( m < 0 )
+			ShowWarning("Console: Unknown map.\n");
+		else
+			map_block_benchmark(m, 100000, 2000);
+	}
+	else if( strcmpi("status_benchmark", type) == 0 ){
+		status_calc_pc_benchmark(100000);
+	}
 	else if( strcmpi("help", type) == 0 ) {
 		ShowInfo("Available commands:\n");
 		ShowInfo("\t admin:@<atcommand> => Uses an atcommand. Do NOT use commands requiring an attached player.\n");
 		ShowInfo("\t admin:map:<map> <x> <y> => Changes the map from which console commands are executed.\n");
 		ShowInfo("\t server:shutdown => Stops the server.\n");
 		ShowInfo("\t ers_report => Displays database usage.\n");
+		ShowInfo("\t autosave_report => Displays autosave queue statistics.\n");
+		ShowInfo("\t path_benchmark:<map> => Measures path searches on a map and checks their results.\n");
+		ShowInfo("\t block_benchmark:<map> => Measures range queries among a crowd on a map and checks their results.\n");
+		ShowInfo("\t status_benchmark => Measures status recalculations on equipment changes with and without precompiled item bonuses.\n");
 	}
 
 	return 0;
@@ -4071,8 +4560,16 @@ int map_config_read(const char *cfgName)
 			minsave_interval= atoi(w2);
 			if (minsave_interval < 1)
 				minsave_interval = 1;
-		} else if (strcmpi(w1, "save_settings") == 0)
+		} else if (strcmpi(w1, "autosave_max_per_tick") == 0) {
+			autosave_max_per_tick = atoi(w2);
+			if (autosave_max_per_tick < 1)
+				autosave_max_per_tick = 1;
+		} else if (strcmpi(w1, "autosave_priority_zeny") == 0)
+			autosave_priority_zeny = cap_value(atoi(w2), 0, MAX_ZENY);
+		else if (strcmpi(w1, "save_settings") == 0)
 			save_settings = cap_value(atoi(w2),CHARSAVE_NONE,CHARSAVE_ALL);
+		else if (strcmpi(w1, "save_delta") == 0)
+			save_delta = config_switch(w2) != 0;
 		else if (strcmpi(w1, "motd_txt") == 0)
 			safestrncpy(motd_txt, w2, sizeof(motd_txt));
 		else if (strcmpi(w1, "charhelp_txt") == 0)
@@ -4089,6 +4586,8 @@ int map_config_read(const char *cfgName)
 			enable_spy = config_switch(w2);
 		else if (strcmpi(w1, "use_grf") == 0)
 			enable_grf = config_switch(w2);
+		else if (strcmpi(w1, "map_cache_raw") == 0)
+			enable_map_cache_raw = config_switch(w2) != 0;
 		else if (strcmpi(w1, "console_msg_log") == 0)
 			console_msg_log = atoi(w2);//[Ind]
 		else if (strcmpi(w1, "console_log_filepath") == 0)
@@ -4374,7 +4873,7 @@ static void map_free_questinfo(struct map_data *mapdata) {
 int map_db_final(DBKey key, DBData *data, va_list ap)
 {
 	struct map_data_other_server *mdos = (struct map_data_other_server *)db_data2ptr(data);
-	if(mdos && mdos->cell == NULL)
+	if(mdos && mdos->cell == NULL && mdos->gat == NULL)
 		aFree(mdos);
 	return 0;
 }
@@ -4931,8 +5430,8 @@ void do_final(void){
 		struct map_data *mapdata = map_getmapdata(i);
 
 		if(mapdata->cell) aFree(mapdata->cell);
-		if(mapdata->block) aFree(mapdata->block);
-		if(mapdata->block_mob) aFree(mapdata->block_mob);
+		map_layers_free(mapdata);
+		map_block_free(mapdata);
 		if(battle_config.dynamic_mobs) { //Dynamic mobs flag by [random]
 			if(mapdata->mob_delete_timer != INVALID_TIMER)
 				delete_timer(mapdata->mob_delete_timer, map_removemobs_timer);
@@ -4946,6 +5445,8 @@ void do_final(void){
 	mapindex_final();
 	if(enable_grf)
 		grfio_final();
+	for (size_t i = 0; i < ARRAYLENGTH(map_cache_raw); i++)
+		map_final_mapcache_raw(&map_cache_raw[i]);
 
 	id_db->destroy(id_db, NULL);
 	pc_db->destroy(pc_db, NULL);
@@ -4956,6 +5457,7 @@ void do_final(void){
 	iwall_db->destroy(iwall_db, NULL);
 	regen_db->destroy(regen_db, NULL);
 
+	do_final_log();
 	map_sql_close();
 
 	ShowStatus("Finished.\n");
@@ -5196,19 +5698,23 @@ int do_init(int argc, char *argv[])
 	inter_config_read(INTER_CONF_NAME);
 	log_config_read(LOG_CONF_NAME);
 
-	id_db = idb_alloc(DB_OPT_BASE);
-	pc_db = idb_alloc(DB_OPT_BASE);	//Added for reliable map_id2sd() use. [Skotlex]
-	mobid_db = idb_alloc(DB_OPT_BASE);	//Added to lower the load of the lazy mob ai. [Skotlex]
+	id_db = idb_flat_alloc(DB_OPT_BASE);
+	pc_db = idb_flat_alloc(DB_OPT_BASE);	//Added for reliable map_id2sd() use. [Skotlex]
+	mobid_db = idb_flat_alloc(DB_OPT_BASE);	//Added to lower the load of the lazy mob ai. [Skotlex]
 	bossid_db = idb_alloc(DB_OPT_BASE); // Used for Convex Mirror quick MVP search
 	map_db = uidb_alloc(DB_OPT_BASE);
 	nick_db = idb_alloc(DB_OPT_BASE);
-	charid_db = uidb_alloc(DB_OPT_BASE);
+	charid_db = uidb_flat_alloc(DB_OPT_BASE);
 	regen_db = idb_alloc(DB_OPT_BASE); // efficient status_natural_heal processing
 	iwall_db = strdb_alloc(DB_OPT_RELEASE_DATA,2*NAME_LENGTH+2+1); // [Zephyrus] Invisible Walls
 
 	map_sql_init();
 	if (log_config.sql_logs)
 		log_sql_init();
+	do_init_log();
+
+	// Parse the YAML databases on worker threads while the maps are loading
+	YamlDatabase::startPreloading();
 
 	mapindex_init();
 	if(enable_grf)
@@ -5253,6 +5759,8 @@ int do_init(int argc, char *argv[])
 	do_init_vending();
 	do_init_buyingstore();
 
+	YamlDatabase::stopPreloading();
+
 	npc_event_do_oninit();	// Init npcs (OnInit)
 
 	if (battle_config.pk_mode)
@@ -56,6 +56,7 @@ void map_msg_reload(void);
 #define MAX_IGNORE_LIST 20 	// official is 14
 #define MAX_VENDING 12
 #define MAX_MAP_SIZE 512*512 	// Wasn't there something like this already? Can't find it.. [Shinryo]
+#define BLOCK_SIZE 8 // Size of a map block in cells
 
 //The following system marks a different job ID system used by the map server,
 //which makes a lot more sense than the normal one. [Skotlex]
@@ -389,6 +390,7 @@ struct block_list {
 	int id;
 	int16 m,x,y;
 	enum bl_type type;
+	int blockidx; ///< Position in the map block's map_block_soa while on a map
 };
 
 
@@ -724,12 +726,26 @@ struct s_questinfo {
 	struct script_code* condition;
 };
 
+/// Structure-of-arrays copy of the blocks in one map block (BLOCK_SIZE x BLOCK_SIZE cells).
+/// Range scans filter the contiguous coordinate and type arrays instead of walking the block_list chains.
+struct map_block_soa {
+	std::vector<struct block_list*> bl;
+	std::vector<int16> x, y;
+	std::vector<uint16> type;
+};
+
 struct map_data {
 	char name[MAP_NAME_LENGTH];
 	uint16 index; // The map index used by the mapindex* functions.
-	struct mapcell* cell; // Holds the information of each map cell (NULL if the map is not on this map-server).
+	struct mapcell* cell; // Holds the information of each map cell (NULL if the map is not on this map-server, or not changed yet when read from the raw map cache).
+	const uint8* gat; // Gat types of the cells in the mapped raw map cache (NULL if not read from it). Read until the first cell change builds 'cell'.
 	struct block_list **block;
 	struct block_list **block_mob;
+	std::vector<map_block_soa> block_soa; // bxs * bys entries, mirrors block and block_mob
+	uint64* walkable; // Layer of the walkable cells, a bitmap with 64 cells per word (NULL until built by map_walkable)
+	uint64* shootable; // Layer of the shootable cells, built with 'walkable'
+	uint16 layer_stride; // Words per row of the layers
+	uint32 walkable_generation; // Changes whenever a cell of 'walkable' changes
 	int16 m;
 	int16 xs,ys; // map dimensions (in cells)
 	int16 bxs,bys; // map dimensions (in blocks)
@@ -737,6 +753,10 @@ struct map_data {
 	int npc_num; // number total of npc on the map
 	int npc_num_area; // number of npc with a trigger area on the map
 	int npc_num_warp; // number of warp npc on the map
+	uint32 npc_area_generation; // Changes whenever a npc with a trigger area is added, removed or its cells are set
+	uint32 npc_area_built; // npc_area_generation the npc_area lists were built for
+	std::vector<uint32> npc_area_first; // Per map block, first entry in npc_area of the npcs whose trigger area overlaps it, one more entry ends the last block
+	std::vector<uint16> npc_area; // Indexes into npc of the npcs with a trigger area, grouped by map block
 	int users;
 	int users_pvp;
 	int iwall_num; // Total of invisible walls in this map
@@ -772,22 +792,39 @@ struct map_data {
 struct map_data_other_server {
 	char name[MAP_NAME_LENGTH];
 	unsigned short index; //Index is the map index used by the mapindex* functions.
-	struct mapcell* cell; // If this is NULL, the map is not on this map-server
+	struct mapcell* cell; // If this and gat are NULL, the map is not on this map-server
+	const uint8* gat;
 	uint32 ip;
 	uint16 port;
 };
 
+/// Whether the cells of the map are on this map-server
+inline bool map_haslocalcells(struct map_data *mapdata) {
+	return mapdata->cell != NULL || mapdata->gat != NULL;
+}
+
 int map_getcell(int16 m,int16 x,int16 y,cell_chk cellchk);
 int map_getcellp(struct map_data* m,int16 x,int16 y,cell_chk cellchk);
 void map_setcell(int16 m, int16 x, int16 y, cell_t cell, bool flag);
 void map_setgatcell(int16 m, int16 x, int16 y, int gat);
+const uint64* map_walkable(struct map_data* mapdata);
+const uint64* map_shootable(struct map_data* mapdata);
+
+/// Whether a cell is set in a layer returned by map_walkable or map_shootable.
+/// Same as !map_getcellp(mapdata,x,y,CELL_CHKNOREACH) for the walkable layer, but the cell must be on the map.
+inline bool map_layer_cell(struct map_data *mapdata, const uint64 *layer, int16 x, int16 y) {
+	return ( layer[y * mapdata->layer_stride + ( x >> 6 )] >> ( x & 63 ) ) & 1;
+}
 
 extern struct map_data map[];
 extern int map_num;
 
 extern int autosave_interval;
 extern int minsave_interval;
+extern int autosave_max_per_tick;
+extern int autosave_priority_zeny;
 extern int16 save_settings;
+extern bool save_delta;
 extern int night_flag; // 0=day, 1=night [Yor]
 extern int enable_spy; //Determines if @spy commands are active.
 
@@ -1009,6 +1046,74 @@ int map_freeblock_unlock(void);
 int map_addblock(struct block_list* bl);
 int map_delblock(struct block_list* bl);
 int map_moveblock(struct block_list *, int, int, t_tick);
+
+// spatial queries
+void map_blocks_release(int blockcount);
+
+/// Blocks collected by a spatial query (map_blocks_in*).
+/// The entries live on the shared block list stack and are released when the object goes out of scope,
+/// so queries can be nested as long as they are destroyed in reverse order.
+class map_blocks {
+private:
+	struct block_list** first;
+	int count;
+	int blockcount; ///< Stack height to restore on release, -1 if nothing to release
+
+public:
+	map_blocks() : first(nullptr), count(0), blockcount(-1) {}
+	map_blocks(struct block_list** first, int count, int blockcount) : first(first), count(count), blockcount(blockcount) {}
+	map_blocks(map_blocks&& other) : first(other.first), count(other.count), blockcount(other.blockcount) { other.blockcount = -1; }
+	map_blocks(const map_blocks&) = delete;
+	map_blocks& operator=(const map_blocks&) = delete;
+	~map_blocks() {
+		if( blockcount >= 0 )
+			map_blocks_release(blockcount);
+	}
+
+	struct block_list** begin() const { return first; }
+	struct block_list** end() const { return first + count; }
+	int size() const { return count; }
+
+	/// Calls func(bl) for every collected block that is still on a map.
+	/// Blocks freed during the iteration are kept alive until it ends.
+	/// @param func: Functor taking a block_list* and returning an int
+	/// @param limit: Stop once the sum of the returned values reaches this value (0 = no limit)
+	/// @return Sum of the returned values
+	template <typename F> int each(F func, int limit = 0) const {
+		int returnCount = 0;
+
+		map_freeblock_lock();
+
+		for( int i = 0; i < count; i++ ) {
+			if( first[i]->prev == nullptr ) // func() may delete this slot, checking for prev ensures it wasn't queued for deletion.
+				continue;
+			returnCount += func(first[i]);
+			if( limit && returnCount >= limit )
+				break;
+		}
+
+		map_freeblock_unlock();
+
+		return returnCount;
+	}
+};
+
+map_blocks map_blocks_inrange(struct block_list* center, int16 range, int type);
+map_blocks map_blocks_inallrange(struct block_list* center, int16 range, int type);
+map_blocks map_blocks_inshootrange(struct block_list* center, int16 range, int type);
+map_blocks map_blocks_inarea(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type);
+map_blocks map_blocks_inallarea(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type);
+map_blocks map_blocks_inshootarea(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type);
+map_blocks map_blocks_inmovearea(struct block_list* center, int16 range, int16 dx, int16 dy, int type);
+map_blocks map_blocks_incell(int16 m, int16 x, int16 y, int type);
+map_blocks map_blocks_inpath(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int16 range, int length, int type);
+map_blocks map_blocks_indir(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int16 range, int length, int offset, int type);
+map_blocks map_blocks_inmap(int16 m, int type);
+
+// Spatial query into a vector of the caller, it only reads the map so worker threads may use it
+void map_collect_inrange(std::vector<struct block_list*>& out, struct block_list* center, int16 range, int type, bool wall_check);
+void map_block_benchmark(int16 m, int count, int crowd);
+
 int map_foreachinrange(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, ...);
 int map_foreachinallrange(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, ...);
 int map_foreachinshootrange(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, ...);
@@ -1179,6 +1284,13 @@ extern Sql* mmysql_handle;
 extern Sql* qsmysql_handle;
 extern Sql* logmysql_handle;
 
+extern char default_codepage[32];
+extern char log_db_ip[64];
+extern int log_db_port;
+extern char log_db_id[32];
+extern char log_db_pw[32];
+extern char log_db_db[32];
+
 extern char buyingstores_table[32];
 extern char buyingstore_items_table[32];
 extern char item_table[32];
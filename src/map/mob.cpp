@@ -4,9 +4,12 @@
 #include "mob.hpp"
 
 #include <algorithm>
+#include <condition_variable>
 #include <map>
 #include <math.h>
+#include <mutex>
 #include <stdlib.h>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -1260,17 +1263,11 @@ int mob_target(struct mob_data *md,struct block_list *bl,int dist)
 /*==========================================
  * The ?? routine of an active monster
  *------------------------------------------*/
-static int mob_ai_sub_hard_activesearch(struct block_list *bl,va_list ap)
+static int mob_ai_sub_hard_activesearch(struct block_list *bl, struct mob_data *md, struct block_list **target, enum e_mode mode)
 {
-	struct mob_data *md;
-	struct block_list **target;
-	enum e_mode mode;
 	int dist;
 
 	nullpo_ret(bl);
-	md=va_arg(ap,struct mob_data *);
-	target= va_arg(ap,struct block_list**);
-	mode= static_cast<enum e_mode>(va_arg(ap, int));
 
 	//If can't seek yet, not an enemy, or you can't attack it, skip.
 	if ((*target) == bl || !status_check_skilluse(&md->bl, bl, 0, 0))
@@ -1322,14 +1319,9 @@ static int mob_ai_sub_hard_activesearch(struct block_list *bl,va_list ap)
 /*==========================================
  * chase target-change routine.
  *------------------------------------------*/
-static int mob_ai_sub_hard_changechase(struct block_list *bl,va_list ap)
+static int mob_ai_sub_hard_changechase(struct block_list *bl, struct mob_data *md, struct block_list **target)
 {
-	struct mob_data *md;
-	struct block_list **target;
-
 	nullpo_ret(bl);
-	md=va_arg(ap,struct mob_data *);
-	target= va_arg(ap,struct block_list**);
 
 	//If can't seek yet, not an enemy, or you can't attack it, skip.
 	if ((*target) == bl ||
@@ -1349,13 +1341,8 @@ static int mob_ai_sub_hard_changechase(struct block_list *bl,va_list ap)
 /*==========================================
  * finds nearby bg ally for guardians looking for users to follow.
  *------------------------------------------*/
-static int mob_ai_sub_hard_bg_ally(struct block_list *bl,va_list ap) {
-	struct mob_data *md;
-	struct block_list **target;
-
+static int mob_ai_sub_hard_bg_ally(struct block_list *bl, struct mob_data *md, struct block_list **target) {
 	nullpo_ret(bl);
-	md=va_arg(ap,struct mob_data *);
-	target= va_arg(ap,struct block_list**);
 
 	if( status_check_skilluse(&md->bl, bl, 0, 0) && battle_check_target(&md->bl,bl,BCT_ENEMY)<=0 ) {
 		(*target) = bl;
@@ -1366,15 +1353,10 @@ static int mob_ai_sub_hard_bg_ally(struct block_list *bl,va_list ap) {
 /*==========================================
  * loot monster item search
  *------------------------------------------*/
-static int mob_ai_sub_hard_lootsearch(struct block_list *bl,va_list ap)
+static int mob_ai_sub_hard_lootsearch(struct block_list *bl, struct mob_data *md, struct block_list **target)
 {
-	struct mob_data* md;
-	struct block_list **target;
 	int dist;
 
-	md = va_arg(ap,struct mob_data *);
-	target = va_arg(ap,struct block_list**);
-
 	dist = distance_bl(&md->bl, bl);
 	if (mob_can_reach(md,bl,dist+1, MSS_LOOT) && (
 		(*target) == nullptr ||
@@ -1391,6 +1373,340 @@ static int mob_ai_sub_hard_lootsearch(struct block_list *bl,va_list ap)
 	return 0;
 }
 
+/*==========================================
+ * Parallel search phase of mob_ai_hard.
+ * Before the AI runs, the target and loot searches of the mobs on maps with
+ * players are evaluated on worker threads, one map at a time. These only read
+ * the world, which does not change while the workers run. The candidates that
+ * pass the checks which do not depend on the mob's current target are kept in
+ * the order the searches visit them. mob_ai_sub_hard then runs serially as
+ * before and only checks these candidates, so actions are applied in order.
+ * Path searches stay on the main thread, as they share their node table and
+ * path cache.
+ *------------------------------------------*/
+
+/// Search candidates of one mob
+struct s_mob_ai_plan {
+	struct s_mob_ai_task *task; // Task holding the candidate ids
+	int16 view_range; // Range the candidates were searched in
+	int target_type; // Types of the target candidates, 0 if targets were not searched
+	bool loot; // Whether floor items were searched
+	uint32 targets, target_count; // Target candidates in task->ids
+	uint32 items, item_count; // Floor item candidates in task->ids
+};
+
+/// Searches of the mobs on one map
+struct s_mob_ai_task {
+	int16 m;
+	std::vector<struct s_mob_ai_plan> plans;
+	std::vector<struct mob_data*> planned; // Mob of each plan
+	std::vector<int> ids; // Candidate ids of all plans
+	std::vector<struct block_list*> players; // Players on the map, their surroundings are searched
+	std::vector<struct block_list*> mobs, blocks; // Search buffers
+};
+
+static struct {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wakeup; ///< Wakes the workers for new tasks or shutdown
+	std::condition_variable finished; ///< Wakes the main thread when all tasks are done
+	std::vector<struct s_mob_ai_task> tasks;
+	std::vector<int> map_task; ///< Task of each map, -1 if it has none
+	size_t task_count; ///< Tasks of the current round
+	size_t next_task; ///< Next task to take
+	size_t busy; ///< Tasks being evaluated
+	t_tick tick;
+	uint32 round; ///< Current round, plans of other rounds are outdated
+	bool planned; ///< Whether the plans of the current round may be used
+	bool stop;
+} mob_ai_workers;
+
+/**
+ * Checks of mob_ai_sub_hard_activesearch that do not depend on the current target of the mob.
+ * Only reads the world, so it is safe on the workers.
+ */
+static bool mob_ai_sub_hard_activecandidate(struct block_list *bl, struct mob_data *md, enum e_mode mode)
+{
+	if (!status_check_skilluse(&md->bl, bl, 0, 0))
+		return false;
+
+	if ((mode&MD_TARGETWEAK) && status_get_lv(bl) >= md->level-5)
+		return false;
+
+	if (battle_check_target(&md->bl, bl, BCT_ENEMY) <= 0)
+		return false;
+
+	if (bl->type == BL_PC && ((TBL_PC*)bl)->state.gangsterparadise && !status_has_mode(&md->status, MD_STATUS_IMMUNE))
+		return false;
+
+	return battle_check_range(&md->bl, bl, md->db->range2);
+}
+
+/**
+ * Evaluates the searches mob_ai_sub_hard is going to do for a mob.
+ * @param task: Task of the mob's map
+ * @param md: Mob
+ */
+static void mob_ai_plan_mob(struct s_mob_ai_task &task, struct mob_data *md)
+{
+	if (md->ai_round == mob_ai_workers.round)
+		return; // Already evaluated for another player
+	md->ai_round = mob_ai_workers.round;
+	md->ai_plan = nullptr;
+
+	if (md->bl.prev == nullptr || md->status.hp == 0 || DIFF_TICK(mob_ai_workers.tick, md->last_thinktime) < MIN_MOBTHINKTIME || md->ud.skilltimer != INVALID_TIMER)
+		return;
+
+	// Charmed mobs walk to their charmer in status_check_skilluse, they are searched on the main thread
+	if (md->sc.data[SC_WINKCHARM])
+		return;
+
+	struct s_mob_ai_plan plan = {};
+	enum e_mode mode = status_get_mode(&md->bl);
+
+	plan.task = &task;
+	plan.view_range = (md->sc.count && md->sc.data[SC_BLIND]) ? 3 : md->db->range2;
+	plan.loot = (mode&MD_CANMOVE) && (mode&MD_LOOTER) && md->lootitems && DIFF_TICK(mob_ai_workers.tick, md->ud.canact_tick) > 0 &&
+		(md->lootitem_count < LOOTITEM_SIZE || battle_config.monster_loot_type != 1);
+
+	if ((mode&MD_AGGRESSIVE) || md->state.skillstate == MSS_FOLLOW)
+		plan.target_type = DEFAULT_ENEMY_TYPE(md);
+
+	if (!plan.loot && !plan.target_type)
+		return;
+
+	if (plan.loot) {
+		task.blocks.clear();
+		map_collect_inrange(task.blocks, &md->bl, plan.view_range, BL_ITEM, true);
+		plan.items = (uint32)task.ids.size();
+		for (struct block_list *bl : task.blocks)
+			task.ids.push_back(bl->id);
+		plan.item_count = (uint32)task.ids.size() - plan.items;
+	}
+
+	if (plan.target_type) {
+		task.blocks.clear();
+		map_collect_inrange(task.blocks, &md->bl, plan.view_range, plan.target_type, false);
+		plan.targets = (uint32)task.ids.size();
+		for (struct block_list *bl : task.blocks) {
+			if (mob_ai_sub_hard_activecandidate(bl, md, mode))
+				task.ids.push_back(bl->id);
+		}
+		plan.target_count = (uint32)task.ids.size() - plan.targets;
+	}
+
+	task.plans.push_back(plan);
+	task.planned.push_back(md);
+}
+
+/**
+ * Evaluates the searches of the mobs on the map of a task that mob_ai_hard is going to process.
+ * @param task: Task
+ */
+static void mob_ai_plan_task(struct s_mob_ai_task &task)
+{
+	task.plans.clear();
+	task.planned.clear();
+	task.ids.clear();
+
+	for (struct block_list *bl : task.players)
+		map_collect_inrange(task.mobs, bl, AREA_SIZE+ACTIVE_AI_RANGE, BL_MOB, false);
+
+	for (struct block_list *bl : task.mobs)
+		mob_ai_plan_mob(task, (TBL_MOB*)bl);
+
+	// The plans do not move anymore
+	for (size_t i = 0; i < task.plans.size(); i++)
+		task.planned[i]->ai_plan = &task.plans[i];
+}
+
+/// Evaluates tasks until none are left. Requires mob_ai_workers.mutex.
+static void mob_ai_plan_work(std::unique_lock<std::mutex> &lock)
+{
+	while (mob_ai_workers.next_task < mob_ai_workers.task_count) {
+		struct s_mob_ai_task &task = mob_ai_workers.tasks[mob_ai_workers.next_task++];
+
+		mob_ai_workers.busy++;
+		lock.unlock();
+		mob_ai_plan_task(task);
+		lock.lock();
+		if (--mob_ai_workers.busy == 0 && mob_ai_workers.next_task >= mob_ai_workers.task_count)
+			mob_ai_workers.finished.notify_all();
+	}
+}
+
+/// Worker thread, evaluates tasks of the rounds started by mob_ai_plan.
+static void mob_ai_plan_worker(void)
+{
+	std::unique_lock<std::mutex> lock(mob_ai_workers.mutex);
+
+	for (;;) {
+		mob_ai_workers.wakeup.wait(lock, []{ return mob_ai_workers.stop || mob_ai_workers.next_task < mob_ai_workers.task_count; });
+
+		if (mob_ai_workers.stop)
+			break;
+
+		mob_ai_plan_work(lock);
+	}
+}
+
+/// Stops and joins the worker threads.
+static void mob_ai_workers_stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(mob_ai_workers.mutex);
+
+		mob_ai_workers.stop = true;
+	}
+	mob_ai_workers.wakeup.notify_all();
+
+	for (std::thread &thread : mob_ai_workers.threads)
+		thread.join();
+	mob_ai_workers.threads.clear();
+	mob_ai_workers.stop = false;
+}
+
+/// Starts count worker threads, restarting them when the count changed.
+static void mob_ai_workers_start(size_t count)
+{
+	if (mob_ai_workers.threads.size() == count)
+		return;
+
+	mob_ai_workers_stop();
+
+	// Workers must be joined even when the server exits without its finalization
+	static bool registered = false;
+
+	if (!registered) {
+		atexit(mob_ai_workers_stop);
+		registered = true;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		mob_ai_workers.threads.push_back(std::thread(mob_ai_plan_worker));
+}
+
+/// Adds a mob to the task of its map (map_foreachmob)
+static int mob_ai_plan_addmob(struct mob_data *md, va_list ap)
+{
+	if (md->bl.prev != nullptr && mob_ai_workers.map_task[md->bl.m] >= 0)
+		mob_ai_workers.tasks[mob_ai_workers.map_task[md->bl.m]].mobs.push_back(&md->bl);
+	return 0;
+}
+
+/// Adds a player to the task of its map (map_foreachpc)
+static int mob_ai_plan_addpc(struct map_session_data *sd, va_list ap)
+{
+	if (sd->bl.prev != nullptr && sd->bl.m >= 0 && mob_ai_workers.map_task[sd->bl.m] >= 0)
+		mob_ai_workers.tasks[mob_ai_workers.map_task[sd->bl.m]].players.push_back(&sd->bl);
+	return 0;
+}
+
+/**
+ * Evaluates the searches of the mobs on all maps with players in parallel.
+ * @param tick: Tick of the AI round
+ * @return Whether plans were made for the round
+ */
+static bool mob_ai_plan(t_tick tick)
+{
+	size_t threads = battle_config.mob_ai_threads;
+
+	if (threads == 0)
+		threads = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+
+	mob_ai_workers_start(threads - 1);
+
+	if (threads == 1)
+		return false;
+
+	size_t count = 0;
+
+	mob_ai_workers.map_task.assign(map_num, -1);
+
+	for (int16 m = 0; m < map_num; m++) {
+		struct map_data *mapdata = map_getmapdata(m);
+
+		if (mapdata->users == 0 || mapdata->block == nullptr)
+			continue;
+
+		// Build the cell layers here, the line of sight checks of the workers must not allocate
+		map_walkable(mapdata);
+
+		if (count == mob_ai_workers.tasks.size())
+			mob_ai_workers.tasks.emplace_back();
+		mob_ai_workers.tasks[count].m = m;
+		mob_ai_workers.tasks[count].mobs.clear();
+		mob_ai_workers.tasks[count].players.clear();
+		mob_ai_workers.map_task[m] = (int)count++;
+	}
+
+	if (count == 0)
+		return false;
+
+	// The mobs mob_ai_hard is going to process, either all mobs on these maps or the ones around their players
+	if (battle_config.mob_ai&0x20)
+		map_foreachmob(mob_ai_plan_addmob);
+	else
+		map_foreachpc(mob_ai_plan_addpc);
+
+	std::unique_lock<std::mutex> lock(mob_ai_workers.mutex);
+
+	mob_ai_workers.tick = tick;
+	if (++mob_ai_workers.round == 0) // 0 is the round of new mobs
+		mob_ai_workers.round = 1;
+	mob_ai_workers.next_task = 0;
+	mob_ai_workers.task_count = count;
+	mob_ai_workers.wakeup.notify_all();
+
+	// The main thread helps, then waits for the tasks still running
+	mob_ai_plan_work(lock);
+	mob_ai_workers.finished.wait(lock, []{ return mob_ai_workers.busy == 0; });
+	mob_ai_workers.task_count = 0;
+	mob_ai_workers.next_task = 0;
+
+	return true;
+}
+
+/**
+ * Returns the plan of a mob for the current round, if it was made with the given view range.
+ * @param md: Mob
+ * @param view_range: View range the mob searches in
+ * @return Plan or nullptr
+ */
+static struct s_mob_ai_plan* mob_ai_getplan(struct mob_data *md, int16 view_range)
+{
+	if (!mob_ai_workers.planned || md->ai_round != mob_ai_workers.round || md->ai_plan == nullptr)
+		return nullptr;
+	if (md->ai_plan->view_range != view_range)
+		return nullptr;
+	return md->ai_plan;
+}
+
+/**
+ * Calls func(bl) for the candidates of a plan that are still on the mob's map and in view range, like map_blocks::each.
+ * @param md: Mob
+ * @param plan: Plan of the mob
+ * @param first: First candidate in plan->task->ids
+ * @param count: Number of candidates
+ * @param func: Functor taking a block_list*
+ */
+template <typename F> static void mob_ai_plan_each(struct mob_data *md, struct s_mob_ai_plan *plan, uint32 first, uint32 count, F func)
+{
+	for (uint32 i = first; i < first + count; i++) {
+		struct block_list *bl = map_id2bl(plan->task->ids[i]);
+
+		if (bl == nullptr || bl->prev == nullptr || bl->m != md->bl.m)
+			continue;
+		if (abs(bl->x - md->bl.x) > plan->view_range || abs(bl->y - md->bl.y) > plan->view_range)
+			continue;
+#ifdef CIRCULAR_AREA
+		if (!check_distance_bl(&md->bl, bl, plan->view_range))
+			continue;
+#endif
+		func(bl);
+	}
+}
+
 static int mob_warpchase_sub(struct block_list *bl,va_list ap) {
 	struct block_list *target;
 	struct npc_data **target_nd;
@@ -1681,6 +1997,7 @@ int mob_warpchase(struct mob_data *md, struct block_list *target)
 static bool mob_ai_sub_hard(struct mob_data *md, t_tick tick)
 {
 	struct block_list *tbl = nullptr, *abl = nullptr;
+	struct s_mob_ai_plan *plan;
 	enum e_mode mode;
 	int view_range, can_move;
 
@@ -1707,6 +2024,7 @@ static bool mob_ai_sub_hard(struct mob_data *md, t_tick tick)
 	else
 		view_range = md->db->range2;
 	mode = status_get_mode(&md->bl);
+	plan = mob_ai_getplan(md, view_range);
 
 	can_move = (mode&MD_CANMOVE) && unit_can_move(&md->bl);
 
@@ -1811,19 +2129,37 @@ static bool mob_ai_sub_hard(struct mob_data *md, t_tick tick)
 	if (!tbl && can_move && mode&MD_LOOTER && md->lootitems && DIFF_TICK(tick, md->ud.canact_tick) > 0 &&
 		(md->lootitem_count < LOOTITEM_SIZE || battle_config.monster_loot_type != 1))
 	{	// Scan area for items to loot, avoid trying to loot if the mob is full and can't consume the items.
-		map_foreachinshootrange (mob_ai_sub_hard_lootsearch, &md->bl, view_range, BL_ITEM, md, &tbl);
+		if (plan && plan->loot) {
+			mob_ai_plan_each(md, plan, plan->items, plan->item_count, [&](struct block_list* bl) {
+				return mob_ai_sub_hard_lootsearch(bl, md, &tbl);
+			});
+		} else {
+			map_blocks_inshootrange(&md->bl, view_range, BL_ITEM).each([&](struct block_list* bl) {
+				return mob_ai_sub_hard_lootsearch(bl, md, &tbl);
+			});
+		}
 	}
 
 	if ((!tbl && mode&MD_AGGRESSIVE) || md->state.skillstate == MSS_FOLLOW)
 	{
-		map_foreachinallrange (mob_ai_sub_hard_activesearch, &md->bl, view_range, DEFAULT_ENEMY_TYPE(md), md, &tbl, mode);
+		if (plan && plan->target_type == DEFAULT_ENEMY_TYPE(md)) {
+			mob_ai_plan_each(md, plan, plan->targets, plan->target_count, [&](struct block_list* bl) {
+				return mob_ai_sub_hard_activesearch(bl, md, &tbl, mode);
+			});
+		} else {
+			map_blocks_inallrange(&md->bl, view_range, DEFAULT_ENEMY_TYPE(md)).each([&](struct block_list* bl) {
+				return mob_ai_sub_hard_activesearch(bl, md, &tbl, mode);
+			});
+		}
 	}
 	else
 	if (mode&MD_CHANGECHASE && (md->state.skillstate == MSS_RUSH || md->state.skillstate == MSS_FOLLOW))
 	{
 		int search_size;
 		search_size = view_range<md->status.rhw.range ? view_range:md->status.rhw.range;
-		map_foreachinallrange (mob_ai_sub_hard_changechase, &md->bl, search_size, DEFAULT_ENEMY_TYPE(md), md, &tbl);
+		map_blocks_inallrange(&md->bl, search_size, DEFAULT_ENEMY_TYPE(md)).each([&](struct block_list* bl) {
+			return mob_ai_sub_hard_changechase(bl, md, &tbl);
+		});
 	}
 
 	if (!tbl) { //No targets available.
@@ -1831,7 +2167,9 @@ static bool mob_ai_sub_hard(struct mob_data *md, t_tick tick)
 		if( md->bg_id && mode&MD_CANATTACK ) {
 			if( md->ud.walktimer != INVALID_TIMER )
 				return true;/* we are already moving */
-			map_foreachinallrange (mob_ai_sub_hard_bg_ally, &md->bl, view_range, BL_PC, md, &tbl, mode);
+			map_blocks_inallrange(&md->bl, view_range, BL_PC).each([&](struct block_list* bl) {
+				return mob_ai_sub_hard_bg_ally(bl, md, &tbl);
+			});
 			if( tbl ) {
 				if( distance_blxy(&md->bl, tbl->x, tbl->y) <= 3 || unit_walktobl(&md->bl, tbl, 1, 1) )
 					return true;/* we're moving or close enough don't unlock the target. */
@@ -1968,11 +2306,8 @@ static bool mob_ai_sub_hard(struct mob_data *md, t_tick tick)
 	return true;
 }
 
-static int mob_ai_sub_hard_timer(struct block_list *bl,va_list ap)
+static int mob_ai_sub_hard_timer(struct mob_data *md, uint32 char_id, t_tick tick)
 {
-	struct mob_data *md = (struct mob_data*)bl;
-	uint32 char_id = va_arg(ap, uint32);
-	t_tick tick = va_arg(ap, t_tick);
 	if (mob_ai_sub_hard(md, tick))
 	{	//Hard AI triggered.
 		mob_add_spotted(md, char_id);
@@ -1987,7 +2322,9 @@ static int mob_ai_sub_hard_timer(struct block_list *bl,va_list ap)
 static int mob_ai_sub_foreachclient(struct map_session_data *sd,va_list ap)
 {
 	t_tick tick=va_arg(ap,t_tick);
-	map_foreachinallrange(mob_ai_sub_hard_timer,&sd->bl, AREA_SIZE+ACTIVE_AI_RANGE, BL_MOB, sd->status.char_id, tick);
+	map_blocks_inallrange(&sd->bl, AREA_SIZE+ACTIVE_AI_RANGE, BL_MOB).each([sd, tick](struct block_list* bl) {
+		return mob_ai_sub_hard_timer((TBL_MOB*)bl, sd->status.char_id, tick);
+	});
 
 	return 0;
 }
@@ -2081,11 +2418,15 @@ static TIMER_FUNC(mob_ai_lazy){
  *------------------------------------------*/
 static TIMER_FUNC(mob_ai_hard){
 
+	mob_ai_workers.planned = mob_ai_plan(tick);
+
 	if (battle_config.mob_ai&0x20)
 		map_foreachmob(mob_ai_sub_lazy,tick);
 	else
 		map_foreachpc(mob_ai_sub_foreachclient,tick);
 
+	mob_ai_workers.planned = false;
+
 	return 0;
 }
 
@@ -5755,5 +6096,8 @@ void do_final_mob(bool is_reload){
 	if( !is_reload ) {
 		ers_destroy(item_drop_ers);
 		ers_destroy(item_drop_list_ers);
+		mob_ai_workers_stop();
+		std::vector<struct s_mob_ai_task>().swap(mob_ai_workers.tasks);
+		std::vector<int>().swap(mob_ai_workers.map_task);
 	}
 }
@@ -176,6 +176,8 @@ struct mob_db {
 	struct mob_skill skill[MAX_MOBSKILL];
 };
 
+struct s_mob_ai_plan;
+
 struct mob_data {
 	struct block_list bl;
 	struct unit_data  ud;
@@ -242,6 +244,8 @@ struct mob_data {
 	 * MvP Tombstone NPC ID
 	 **/
 	int tomb_nid;
+	struct s_mob_ai_plan *ai_plan; // Search candidates evaluated by the parallel phase of mob_ai_hard, valid in round ai_round
+	uint32 ai_round;
 };
 
 class MobAvailDatabase : public YamlDatabase {
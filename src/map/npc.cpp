@@ -3,9 +3,12 @@
 
 #include "npc.hpp"
 
+#include <algorithm>
 #include <errno.h>
 #include <map>
 #include <stdlib.h>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "../common/cbasetypes.hpp"
@@ -94,8 +97,15 @@ static DBMap* npcname_db; // const char* npc_name -> struct npc_data*
 struct event_data {
 	struct npc_data *nd;
 	int pos;
+	char name[EVENT_NAME_LENGTH]; // Key of the event in ev_db
 };
 
+// Index of ev_db by lower case event name and by lower case "::label" of the events
+// Global events and case insensitive lookups do not have to go through all events
+static std::unordered_map<std::string, std::vector<struct event_data*>> ev_label_db;
+static int ev_label_dispatch = 0; // Number of running npc_event_do_label calls
+static std::vector<std::string> ev_label_compact; // Keys of ev_label_db with events removed during a dispatch
+
 static struct eri *timer_event_ers; //For the npc timer data. [Skotlex]
 
 /* hello */
@@ -451,6 +461,85 @@ int npc_event_dequeue(struct map_session_data* sd,bool free_script_stack)
 	return 1;
 }
 
+/**
+ * Returns the key of an event name in ev_label_db.
+ * @param name: Event name, "npcname::label" or "::label"
+ */
+static std::string npc_event_labelkey(const char* name)
+{
+	std::string key(name);
+
+	for( char &c : key )
+		c = TOLOWER(c);
+
+	return key;
+}
+
+/**
+ * Adds an event of ev_db to ev_label_db, by its name and by the part starting at the first ':'.
+ */
+static void npc_event_label_add(struct event_data* ev)
+{
+	const char* label = strchr(ev->name, ':');
+
+	ev_label_db[npc_event_labelkey(ev->name)].push_back(ev);
+
+	if( label != nullptr )
+		ev_label_db[npc_event_labelkey(label)].push_back(ev);
+}
+
+/**
+ * Removes an event of ev_db from ev_label_db.
+ * While a dispatch walks a list, the event is only cleared from it. The list is compacted
+ * and removed when empty once the last dispatch has finished, see npc_event_label_compact.
+ */
+static void npc_event_label_remove(struct event_data* ev)
+{
+	const char* label = strchr(ev->name, ':');
+	std::string keys[2] = { npc_event_labelkey(ev->name), label != nullptr ? npc_event_labelkey(label) : std::string() };
+
+	for( const std::string &key : keys ) {
+		auto it = ev_label_db.find(key);
+
+		if( it == ev_label_db.end() )
+			continue;
+
+		std::vector<struct event_data*> &events = it->second;
+
+		if( ev_label_dispatch > 0 ) {
+			std::replace(events.begin(), events.end(), ev, (struct event_data*)nullptr);
+			ev_label_compact.push_back(key);
+		} else {
+			events.erase(std::remove(events.begin(), events.end(), ev), events.end());
+
+			if( events.empty() )
+				ev_label_db.erase(it);
+		}
+	}
+}
+
+/**
+ * Removes the events cleared during a dispatch from ev_label_db, and the lists that became empty.
+ */
+static void npc_event_label_compact(void)
+{
+	for( const std::string &key : ev_label_compact ) {
+		auto it = ev_label_db.find(key);
+
+		if( it == ev_label_db.end() )
+			continue;
+
+		std::vector<struct event_data*> &events = it->second;
+
+		events.erase(std::remove(events.begin(), events.end(), (struct event_data*)nullptr), events.end());
+
+		if( events.empty() )
+			ev_label_db.erase(it);
+	}
+
+	ev_label_compact.clear();
+}
+
 /*==========================================
  * exports a npc event label
  * called from npc_parse_script
@@ -486,6 +575,14 @@ static int npc_event_export(struct npc_data *nd, int i)
 		CREATE(ev, struct event_data, 1);
 		ev->nd = nd;
 		ev->pos = pos;
+		safestrncpy(ev->name, buf, sizeof(ev->name));
+
+		struct event_data* old_ev = (struct event_data*)strdb_get(ev_db, buf);
+
+		if (old_ev != nullptr) // released by strdb_put
+			npc_event_label_remove(old_ev);
+		npc_event_label_add(ev);
+
 		if (strdb_put(ev_db, buf, ev)) // There was already another event of the same name?
 			return 1;
 	}
@@ -496,68 +593,49 @@ int npc_event_sub(struct map_session_data* sd, struct event_data* ev, const char
 
 /**
  * Exec name (NPC events) on player or global
- * Do on all NPC when called with foreach
- * @see DBApply
+ * @param name: Event name, "npcname::label" or "::label" for the label on all NPCs (case insensitive)
+ * @param rid: Player to attach
+ * @param queue: Whether to run the events through npc_event_sub, which queues them while the player runs a script
+ * @return Number of executed events
  */
-int npc_event_doall_sub(DBKey key, DBData *data, va_list ap)
+static int npc_event_do_label(const char* name, int rid, bool queue)
 {
-	const char* p = key.str;
-	struct event_data* ev;
-	int* c;
-	const char* name;
-	int rid;
+	auto it = ev_label_db.find(npc_event_labelkey(name));
+	int c = 0;
 
-	nullpo_ret(ev = (struct event_data*)db_data2ptr(data));
-	nullpo_ret(c = va_arg(ap, int *));
-	nullpo_ret(name = va_arg(ap, const char *));
-	rid = va_arg(ap, int);
+	if( it == ev_label_db.end() )
+		return 0;
 
-	p = strchr(p, ':'); // match only the event name
-	if( p && strcmpi(name, p) == 0 /* && !ev->nd->src_id */ ) // Do not run on duplicates. [Paradox924X]
-	{
-		if(rid) // a player may only have 1 script running at the same time
-			npc_event_sub(map_id2sd(rid),ev,key.str);
-		else
-			run_script(ev->nd->u.scr.script,ev->pos,rid,ev->nd->bl.id);
-		(*c)++;
-	}
+	std::vector<struct event_data*> &events = it->second;
 
-	return 0;
-}
+	// The events may load and unload NPCs. Until the last dispatch has finished, unloaded
+	// events are only cleared from the lists, so neither the list nor the indices change.
+	ev_label_dispatch++;
 
-/**
- * @see DBApply
- */
-static int npc_event_do_sub(DBKey key, DBData *data, va_list ap)
-{
-	const char* p = key.str;
-	struct event_data* ev;
-	int* c, rid;
-	const char* name;
+	for( size_t i = 0; i < events.size(); i++ ) {
+		struct event_data* ev = events[i];
 
-	nullpo_ret(ev = (struct event_data*)db_data2ptr(data));
-	nullpo_ret(c = va_arg(ap, int *));
-	nullpo_ret(name = va_arg(ap, const char *));
-	rid = va_arg(ap, int);
+		if( ev == nullptr ) // unloaded
+			continue;
 
-	if( p && strcmpi(name, p) == 0 )
-	{
-		run_script(ev->nd->u.scr.script,ev->pos,rid,ev->nd->bl.id);
-		(*c)++;
+		if( queue ) // a player may only have 1 script running at the same time
+			npc_event_sub(map_id2sd(rid),ev,ev->name);
+		else
+			run_script(ev->nd->u.scr.script,ev->pos,rid,ev->nd->bl.id);
+		c++;
 	}
 
-	return 0;
+	if( --ev_label_dispatch == 0 && !ev_label_compact.empty() )
+		npc_event_label_compact();
+
+	return c;
 }
 
 int npc_event_do_id(const char* name, int rid) {
-	int c = 0;
-
 	if( name[0] == ':' && name[1] == ':' )
-		ev_db->foreach(ev_db,npc_event_doall_sub,&c,name,0,rid);
+		return npc_event_do_label(name, 0, false);
 	else
-		ev_db->foreach(ev_db,npc_event_do_sub,&c,name,rid);
-
-	return c;
+		return npc_event_do_label(name, rid, false);
 }
 
 // runs the specified event (supports both single-npc and global events)
@@ -579,11 +657,9 @@ void npc_event_runall( const char* eventname ){
 // runs the specified event, with a RID attached (global only)
 int npc_event_doall_id(const char* name, int rid)
 {
-	int c = 0;
 	char buf[EVENT_NAME_LENGTH];
 	safesnprintf(buf, sizeof(buf), "::%s", name);
-	ev_db->foreach(ev_db,npc_event_doall_sub,&c,buf,rid);
-	return c;
+	return npc_event_do_label(buf, rid, rid != 0);
 }
 
 /*==========================================
@@ -1122,12 +1198,101 @@ int npc_touchnext_areanpc(struct map_session_data* sd, bool leavemap)
 	return found;
 }
 
+/**
+ * Gets the npcs whose trigger area overlaps a map block.
+ * The lists are built again when npcs with a trigger area were added, removed or had their cells set since.
+ * @param mapdata : map data
+ * @param bx : x coordinate of the map block
+ * @param by : y coordinate of the map block
+ * @param list : set to the indexes into mapdata->npc, in the order of mapdata->npc
+ * @return number of npcs in list
+ */
+static int npc_area_inblock(struct map_data* mapdata, int bx, int by, const uint16*& list)
+{
+	if( mapdata->npc_area_first.empty() || mapdata->npc_area_built != mapdata->npc_area_generation ) {
+		int blocks = mapdata->bxs * mapdata->bys;
+		int i, x, y;
+
+		mapdata->npc_area_first.assign(blocks + 1, 0);
+
+		// Count and place the npcs per block, an ascending index keeps the order of mapdata->npc
+		for( int pass = 0; pass < 2; pass++ ) {
+			for( i = 0; i < mapdata->npc_num_area; i++ ) {
+				struct npc_data* nd = mapdata->npc[i];
+				int xs, ys;
+
+				switch( nd->subtype ) {
+				case NPCTYPE_WARP:
+					xs = nd->u.warp.xs;
+					ys = nd->u.warp.ys;
+					break;
+				case NPCTYPE_SCRIPT:
+					xs = nd->u.scr.xs;
+					ys = nd->u.scr.ys;
+					break;
+				default:
+					continue;
+				}
+
+				if( xs < 0 || ys < 0 )
+					continue;
+
+				int bx0 = cap_value(nd->bl.x - xs, 0, mapdata->xs - 1) / BLOCK_SIZE;
+				int bx1 = cap_value(nd->bl.x + xs, 0, mapdata->xs - 1) / BLOCK_SIZE;
+				int by0 = cap_value(nd->bl.y - ys, 0, mapdata->ys - 1) / BLOCK_SIZE;
+				int by1 = cap_value(nd->bl.y + ys, 0, mapdata->ys - 1) / BLOCK_SIZE;
+
+				for( y = by0; y <= by1; y++ ) {
+					for( x = bx0; x <= bx1; x++ ) {
+						if( pass == 0 )
+							mapdata->npc_area_first[x + y * mapdata->bxs + 1]++;
+						else
+							mapdata->npc_area[mapdata->npc_area_first[x + y * mapdata->bxs]++] = i;
+					}
+				}
+			}
+
+			if( pass == 0 ) {
+				for( i = 0; i < blocks; i++ )
+					mapdata->npc_area_first[i + 1] += mapdata->npc_area_first[i];
+				mapdata->npc_area.resize(mapdata->npc_area_first[blocks]);
+			} else { // placing advanced every block to the first entry of the next one
+				for( i = blocks; i > 0; i-- )
+					mapdata->npc_area_first[i] = mapdata->npc_area_first[i - 1];
+				mapdata->npc_area_first[0] = 0;
+			}
+		}
+
+		mapdata->npc_area_built = mapdata->npc_area_generation;
+	}
+
+	int b = bx + by * mapdata->bxs;
+
+	list = mapdata->npc_area.data() + mapdata->npc_area_first[b];
+	return mapdata->npc_area_first[b + 1] - mapdata->npc_area_first[b];
+}
+
+/**
+ * Gets the npcs whose trigger area may cover a cell, see npc_area_inblock.
+ * The indexes are copied to 'list', scripts run for them may change the npcs of the map.
+ * @return number of npcs in list
+ */
+static int npc_area_oncell(struct map_data* mapdata, int16 x, int16 y, uint16 list[MAX_NPC_PER_MAP])
+{
+	const uint16* block_list;
+	int count = npc_area_inblock(mapdata, x / BLOCK_SIZE, y / BLOCK_SIZE, block_list);
+
+	memcpy(list, block_list, count * sizeof(uint16));
+	return count;
+}
+
 /*==========================================
  * Exec OnTouch for player if in range of area event
  *------------------------------------------*/
 int npc_touch_areanpc(struct map_session_data* sd, int16 m, int16 x, int16 y)
 {
-	int xs, ys, i, f = 1;
+	int xs, ys, i, k, count, f = 1;
+	uint16 list[MAX_NPC_PER_MAP];
 
 	nullpo_retr(1, sd);
 
@@ -1145,7 +1310,13 @@ int npc_touch_areanpc(struct map_session_data* sd, int16 m, int16 x, int16 y)
 
 	struct map_data *mapdata = map_getmapdata(m);
 
-	for (i = 0; i < mapdata->npc_num_area; i++) {
+	count = npc_area_oncell(mapdata, x, y, list);
+
+	for (k = 0; k < count; k++) {
+		i = list[k];
+		if (i >= mapdata->npc_num_area) // removed by a script of this cell
+			continue;
+
 		if (mapdata->npc[i]->sc.option&OPTION_INVISIBLE) {
 			f = 0; // a npc was found, but it is disabled; don't print warning
 			continue;
@@ -1215,11 +1386,18 @@ int npc_touch_areanpc2(struct mob_data *md)
 	int i, x = md->bl.x, y = md->bl.y, id;
 	char eventname[EVENT_NAME_LENGTH];
 	struct event_data* ev;
-	int xs, ys;
+	int xs, ys, k, count;
+	uint16 list[MAX_NPC_PER_MAP];
 	struct map_data *mapdata = map_getmapdata(md->bl.m);
 
-	for( i = 0; i < mapdata->npc_num_area; i++ )
+	count = npc_area_oncell(mapdata, x, y, list);
+
+	for( k = 0; k < count; k++ )
 	{
+		i = list[k];
+		if( i >= mapdata->npc_num_area ) // removed by a script of this cell
+			continue;
+
 		if( mapdata->npc[i]->sc.option&(OPTION_INVISIBLE|OPTION_CLOAK) )
 			continue;
 
@@ -1272,6 +1450,38 @@ int npc_touch_areanpc2(struct mob_data *md)
 	return 0;
 }
 
+/**
+ * Checks if the on-touch area of a NPC overlaps the area (x0,y0)-(x1,y1), see npc_check_areanpc.
+ */
+static bool npc_check_areanpc_sub(struct npc_data* nd, int flag, int x0, int y0, int x1, int y1)
+{
+	int xs,ys;
+
+	if (nd->sc.option&OPTION_INVISIBLE)
+		return false;
+
+	switch(nd->subtype)
+	{
+	case NPCTYPE_WARP:
+		if (!(flag&1))
+			return false;
+		xs=nd->u.warp.xs;
+		ys=nd->u.warp.ys;
+		break;
+	case NPCTYPE_SCRIPT:
+		if (!(flag&2))
+			return false;
+		xs=nd->u.scr.xs;
+		ys=nd->u.scr.ys;
+		break;
+	default:
+		return false;
+	}
+
+	return x1 >= nd->bl.x-xs && x0 <= nd->bl.x+xs
+		&& y1 >= nd->bl.y-ys && y0 <= nd->bl.y+ys;
+}
+
 /**
  * Checks if there are any NPC on-touch objects on the given range.
  * @param flag : Flag determines the type of object to check for
@@ -1308,38 +1518,27 @@ int npc_check_areanpc(int flag, int16 m, int16 x, int16 y, int16 range)
 	}
 	if (!i) return 0; //No NPC_CELLs.
 
-	//Now check for the actual NPC on said range.
-	for (i = 0; i < mapdata->npc_num_area; i++)
-	{
-		if (mapdata->npc[i]->sc.option&OPTION_INVISIBLE)
-			continue;
+	//Now check for the actual NPC on said range, the blocks of the range list the candidates.
+	int found = mapdata->npc_num_area; // first npc in the order of mapdata->npc
 
-		switch(mapdata->npc[i]->subtype)
-		{
-		case NPCTYPE_WARP:
-			if (!(flag&1))
-				continue;
-			xs=mapdata->npc[i]->u.warp.xs;
-			ys=mapdata->npc[i]->u.warp.ys;
-			break;
-		case NPCTYPE_SCRIPT:
-			if (!(flag&2))
-				continue;
-			xs=mapdata->npc[i]->u.scr.xs;
-			ys=mapdata->npc[i]->u.scr.ys;
-			break;
-		default:
-			continue;
-		}
+	for (int by = y0/BLOCK_SIZE; by <= y1/BLOCK_SIZE; by++) {
+		for (int bx = x0/BLOCK_SIZE; bx <= x1/BLOCK_SIZE; bx++) {
+			const uint16* list;
+			int count = npc_area_inblock(mapdata, bx, by, list);
 
-		if( x1 >= mapdata->npc[i]->bl.x-xs && x0 <= mapdata->npc[i]->bl.x+xs
-		&&  y1 >= mapdata->npc[i]->bl.y-ys && y0 <= mapdata->npc[i]->bl.y+ys )
-			break; // found a npc
+			for (int k = 0; k < count && list[k] < found; k++) {
+				if (npc_check_areanpc_sub(mapdata->npc[list[k]], flag, x0, y0, x1, y1)) {
+					found = list[k];
+					break;
+				}
+			}
+		}
 	}
-	if (i == mapdata->npc_num_area)
+
+	if (found == mapdata->npc_num_area)
 		return 0;
 
-	return (mapdata->npc[i]->bl.id);
+	return (mapdata->npc[found]->bl.id);
 }
 
 /*==========================================
@@ -2329,6 +2528,7 @@ int npc_remove_map(struct npc_data* nd)
 		mapdata->npc[ mapdata->npc_num_area ] = mapdata->npc[ mapdata->npc_num ];
 	}
 	mapdata->npc[ mapdata->npc_num ] = NULL;
+	mapdata->npc_area_generation++;
 	return 0;
 }
 
@@ -2341,6 +2541,7 @@ static int npc_unload_ev(DBKey key, DBData *data, va_list ap)
 	char* npcname = va_arg(ap, char *);
 
 	if(strcmp(ev->nd->exname,npcname)==0){
+		npc_event_label_remove(ev);
 		db_remove(ev_db, key);
 		return 1;
 	}
@@ -3812,6 +4013,8 @@ void npc_setcells(struct npc_data* nd)
 	if (m < 0 || xs < 0 || ys < 0) //invalid range or map
 		return;
 
+	map_getmapdata(m)->npc_area_generation++;
+
 	for (i = y-ys; i <= y+ys; i++) {
 		for (j = x-xs; j <= x+xs; j++) {
 			if (map_getcell(m, j, i, CELL_CHKNOPASS))
@@ -3848,6 +4051,8 @@ void npc_unsetcells(struct npc_data* nd)
 
 	struct map_data *mapdata = map_getmapdata(m);
 
+	mapdata->npc_area_generation++;
+
 	//Locate max range on which we can locate npc cells
 	//FIXME: does this really do what it's supposed to do? [ultramage]
 	for(x0 = x-xs; x0 > 0 && map_getcell(m, x0, y, CELL_CHKNPC); x0--);
@@ -4639,29 +4844,27 @@ void npc_read_event_script(void)
 
 	for (i = 0; i < NPCE_MAX; i++)
 	{
-		DBIterator* iter;
-		DBKey key;
-		DBData *data;
 		char name[EVENT_NAME_LENGTH];
 
 		safesnprintf(name,EVENT_NAME_LENGTH,"::%s", npc_get_script_event_name(i));
 
-		iter = db_iterator(ev_db);
-		for( data = iter->first(iter,&key); iter->exists(iter); data = iter->next(iter,&key) )
+		auto it = ev_label_db.find(npc_event_labelkey(name));
+
+		if( it == ev_label_db.end() )
+			continue;
+
+		for( struct event_data* ed : it->second )
 		{
-			const char* p = key.str;
-			struct event_data* ed = (struct event_data*)db_data2ptr(data);
+			struct script_event_s evt;
 
-			if( (p=strchr(p,':')) && strcmpi(name,p)==0 ){
-				struct script_event_s evt;
+			if( ed == nullptr ) // unloaded during a running dispatch
+				continue;
 
-				evt.event = ed;
-				evt.event_name = key.str;
+			evt.event = ed;
+			evt.event_name = ed->name;
 
-				script_event[static_cast<enum npce_event>(i)].push_back(evt);
-			}
+			script_event[static_cast<enum npce_event>(i)].push_back(evt);
 		}
-		dbi_destroy(iter);
 	}
 
 	if (battle_config.etc_log) {
@@ -4700,6 +4903,8 @@ int npc_reload(void) {
 
 	db_clear(npcname_db);
 	db_clear(ev_db);
+	ev_label_db.clear();
+	ev_label_compact.clear();
 
 	//Remove all npcs/mobs. [Skotlex]
 
@@ -4820,6 +5025,8 @@ bool npc_unloadfile( const char* path ) {
 void do_clear_npc(void) {
 	db_clear(npcname_db);
 	db_clear(ev_db);
+	ev_label_db.clear();
+	ev_label_compact.clear();
 }
 
 /*==========================================
@@ -4829,6 +5036,8 @@ void do_final_npc(void) {
 	npc_clear_pathlist();
 	script_event.clear();
 	ev_db->destroy(ev_db, NULL);
+	ev_label_db.clear();
+	ev_label_compact.clear();
 	npcname_db->destroy(npcname_db, NULL);
 	npc_path_db->destroy(npc_path_db, NULL);
 #if PACKETVER >= 20131223
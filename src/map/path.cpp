@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 
 #include "../common/cbasetypes.hpp"
 #include "../common/db.hpp"
@@ -14,6 +15,8 @@
 #include "../common/nullpo.hpp"
 #include "../common/random.hpp"
 #include "../common/showmsg.hpp"
+#include "../common/timer.hpp"
+#include "../common/utils.hpp"
 
 #include "battle.hpp"
 #include "map.hpp"
@@ -37,6 +40,7 @@ struct path_node {
 	short g_cost; ///< Actual cost from start to this node
 	short f_cost; ///< g_cost + heuristic(this, goal)
 	short flag; ///< SET_OPEN / SET_CLOSED
+	uint32 search; ///< Search that last used this node, the node is unused if it is not the current one
 };
 
 /// Binary heap of path nodes
@@ -50,11 +54,40 @@ static BHEAP_STRUCT_VAR(node_heap, g_open_set);	// use static heap for all path
 
 #define calc_index(x,y) (((x)+(y)*MAX_WALKPATH) & (MAX_WALKPATH*MAX_WALKPATH-1))
 
+// FIXME: This array is too small to ensure all paths shorter than MAX_WALKPATH
+// can be found without node collision: calc_index(node1) = calc_index(node2).
+// Figure out more proper size or another way to keep track of known nodes.
+static struct path_node g_nodes[MAX_WALKPATH * MAX_WALKPATH]; // Nodes of the current search, see path_node_get
+static uint32 g_search = 0; // Current search
+
 /// Estimates the cost from (x0,y0) to (x1,y1).
 /// This is inadmissible (overestimating) heuristic used by game client.
 #define heuristic(x0, y0, x1, y1)	(MOVE_COST * (abs((x1) - (x0)) + abs((y1) - (y0)))) // Manhattan distance
 /// @}
 
+/// @name Cache of recently searched paths
+/// Units chasing the same target search the same paths over and over again.
+/// Searches on the walkable bitmap of a map are cached, until a cell of the map changes.
+/// @{
+
+#define PATH_CACHE_SETS 1024 ///< Must be a power of 2
+#define PATH_CACHE_WAYS 4
+
+/// Cached path search
+struct path_cache_entry {
+	uint32 generation; ///< walkable_generation of the map at the time of the search, 0 if unused
+	uint32 last_use; ///< Value of path_cache_tick at the last use, to replace the least recently used entry of a set
+	int16 m;
+	int16 x0, y0, x1, y1;
+	cell_chk cell;
+	bool found; ///< Whether a path was found
+	struct walkpath_data wpd; ///< The path, if found
+};
+
+static struct path_cache_entry path_cache[PATH_CACHE_SETS][PATH_CACHE_WAYS];
+static uint32 path_cache_tick = 0;
+/// @}
+
 // Translates dx,dy into walking direction
 static enum directions walk_choices [3][3] =
 {
@@ -72,6 +105,62 @@ void do_final_path(){
 	BHEAP_CLEAR(g_open_set);
 }//
 
+/// Returns the walkable bitmap of the map if it can be used to check the given cell type, NULL otherwise
+static const uint64* path_walkable(struct map_data *mapdata, cell_chk cell)
+{
+	switch( cell ){
+#ifndef CELL_NOSTACK
+		case CELL_CHKNOPASS:
+#endif
+		case CELL_CHKNOREACH:
+			return map_walkable(mapdata);
+		default:
+			return NULL; // Depends on more than the walkable flag
+	}
+}
+
+/// Whether the cell is blocked, like map_getcellp(mapdata,x,y,cell) but faster if 'walkable' is given
+static inline bool path_blocked(struct map_data *mapdata, const uint64 *walkable, int16 x, int16 y, cell_chk cell)
+{
+	if( walkable == NULL )
+		return map_getcellp(mapdata, x, y, cell) != 0;
+
+	// CELL_CHKNOPASS treats the last row and column as blocked
+	if( cell == CELL_CHKNOPASS && ( x >= mapdata->xs - 1 || y >= mapdata->ys - 1 ) )
+		return true;
+
+	return !map_layer_cell(mapdata, walkable, x, y);
+}
+
+/// Returns the cache entry of a path search, or the entry to replace with it
+static struct path_cache_entry* path_cache_find(struct map_data *mapdata, int16 x0, int16 y0, int16 x1, int16 y1, cell_chk cell, bool *hit)
+{
+	uint32 hash = ( (uint32)mapdata->m * 2654435761U ) ^ ( (uint32)x0 * 73856093U ) ^ ( (uint32)y0 * 19349663U ) ^ ( (uint32)x1 * 83492791U ) ^ ( (uint32)y1 * 50331653U ) ^ (uint32)cell;
+	struct path_cache_entry *set = path_cache[( hash ^ ( hash >> 16 ) ) & ( PATH_CACHE_SETS - 1 )];
+	struct path_cache_entry *oldest = &set[0];
+
+	path_cache_tick++;
+
+	for( int i = 0; i < PATH_CACHE_WAYS; i++ ){
+		struct path_cache_entry *entry = &set[i];
+
+		if( entry->generation == mapdata->walkable_generation && entry->m == mapdata->m && entry->x0 == x0 && entry->y0 == y0 && entry->x1 == x1 && entry->y1 == y1 && entry->cell == cell ){
+			entry->last_use = path_cache_tick;
+			*hit = true;
+			return entry;
+		}
+
+		if( entry->generation == 0 || path_cache_tick - entry->last_use > path_cache_tick - oldest->last_use )
+			oldest = entry;
+
+		if( entry->generation == 0 )
+			break;
+	}
+
+	*hit = false;
+	return oldest;
+}
+
 
 /*==========================================
  * Find the closest reachable cell, 'count' cells away from (x0,y0) in direction (dx,dy).
@@ -81,7 +170,7 @@ int path_blownpos(int16 m,int16 x0,int16 y0,int16 dx,int16 dy,int count)
 {
 	struct map_data *mapdata = map_getmapdata(m);
 
-	if( !mapdata->cell )
+	if( !map_haslocalcells(mapdata) )
 		return -1;
 
 	if( count>25 ){ //Cap to prevent too much processing...?
@@ -126,6 +215,91 @@ int path_blownpos(int16 m,int16 x0,int16 y0,int16 dx,int16 dy,int count)
 	return (x0<<16)|y0; //TODO: use 'struct point' here instead?
 }
 
+/*==========================================
+ * Same line check as path_search_long, but on the cell layers of the map.
+ * The cells of the line are collected and checked a word of a layer at a
+ * time, which checks a run of cells on the same row at once.
+ * Returns 1 if the line is free, 0 if it is blocked, or -1 if the layers
+ * can not be used for the cell type or the line.
+ *------------------------------------------*/
+static int path_search_long_layers(struct map_data *mapdata, int16 x0, int16 y0, int16 x1, int16 y1, cell_chk cell)
+{
+	const uint64 *walkable, *shootable = NULL;
+	int dx, dy;
+	int wx = 0, wy = 0;
+	int weight;
+	size_t word = SIZE_MAX; // Word of the cells in 'mask'
+	uint64 mask = 0; // Cells of the line in 'word' that still have to be checked
+
+	// The layers store the last row and column like all checks but CELL_CHKNOPASS see them, so lines that touch them are left to map_getcellp
+	if( x0 < 0 || x0 >= mapdata->xs - 1 || y0 < 0 || y0 >= mapdata->ys - 1 || x1 < 0 || x1 >= mapdata->xs - 1 || y1 < 0 || y1 >= mapdata->ys - 1 )
+		return -1;
+
+	switch( cell ){
+		case CELL_CHKWALL: // Neither walkable nor shootable
+			shootable = map_shootable(mapdata);
+			walkable = map_walkable(mapdata);
+			break;
+#ifndef CELL_NOSTACK
+		case CELL_CHKNOPASS:
+#endif
+		case CELL_CHKNOREACH:
+			walkable = map_walkable(mapdata);
+			break;
+		default:
+			return -1; // Depends on more than the layers
+	}
+
+#define path_layers_blocked(w, bits) ((~(walkable[w] | (shootable ? shootable[w] : 0)) & (bits)) != 0)
+	dx = (x1 - x0);
+	if (dx < 0) {
+		SWAP(x0, x1);
+		SWAP(y0, y1);
+		dx = -dx;
+	}
+	dy = (y1 - y0);
+
+	if (dx > abs(dy))
+		weight = dx;
+	else
+		weight = abs(y1 - y0);
+
+	while (x0 != x1 || y0 != y1)
+	{
+		wx += dx;
+		wy += dy;
+		if (wx >= weight) {
+			wx -= weight;
+			x0++;
+		}
+		if (wy >= weight) {
+			wy -= weight;
+			y0++;
+		} else if (wy < 0) {
+			wy += weight;
+			y0--;
+		}
+		if (x0 == x1 && y0 == y1)
+			break; // The target cell is not checked
+
+		size_t w = (size_t)y0 * mapdata->layer_stride + (x0 >> 6);
+
+		if (w != word) { // Check the finished run
+			if (mask && path_layers_blocked(word, mask))
+				return 0;
+			word = w;
+			mask = 0;
+		}
+		mask |= UINT64_C(1) << (x0 & 63);
+	}
+
+	if (mask && path_layers_blocked(word, mask))
+		return 0;
+#undef path_layers_blocked
+
+	return 1;
+}
+
 /*==========================================
  * is ranged attack from (x0,y0) to (x1,y1) possible?
  *------------------------------------------*/
@@ -137,12 +311,19 @@ bool path_search_long(struct shootpath_data *spd,int16 m,int16 x0,int16 y0,int16
 	struct map_data *mapdata = map_getmapdata(m);
 	struct shootpath_data s_spd;
 
-	if( spd == NULL )
-		spd = &s_spd; // use dummy output variable
-
-	if (!mapdata->cell)
+	if (!map_haslocalcells(mapdata))
 		return false;
 
+	if( spd == NULL ){
+		// Only the result is needed, so the whole line can be checked on the cell layers
+		int result = path_search_long_layers(mapdata, x0, y0, x1, y1, cell);
+
+		if( result >= 0 )
+			return result != 0;
+
+		spd = &s_spd; // use dummy output variable
+	}
+
 	dx = (x1 - x0);
 	if (dx < 0) {
 		SWAP(x0, x1);
@@ -221,44 +402,170 @@ static int heap_update_node(struct node_heap *heap, struct path_node *node)
 	return 0;
 }
 
+/// Returns a node of the current search.
+/// Nodes left over from previous searches are reset on first use, instead of clearing all nodes for every search.
+static inline struct path_node* path_node_get(int i)
+{
+	struct path_node *node = &g_nodes[i];
+
+	if (node->search != g_search) {
+		memset(node, 0, sizeof(*node));
+		node->search = g_search;
+	}
+
+	return node;
+}
+
 /// Path_node processing in A* pathfinding.
 /// Adds new node to heap and updates/re-adds old ones if necessary.
-static int add_path(struct node_heap *heap, struct path_node *tp, int16 x, int16 y, int g_cost, struct path_node *parent, int h_cost)
+static int add_path(struct node_heap *heap, int16 x, int16 y, int g_cost, struct path_node *parent, int h_cost)
 {
-	int i = calc_index(x, y);
+	struct path_node *node = path_node_get(calc_index(x, y));
 
-	if (tp[i].x == x && tp[i].y == y) { // We processed this node before
-		if (g_cost < tp[i].g_cost) { // New path to this node is better than old one
+	if (node->x == x && node->y == y) { // We processed this node before
+		if (g_cost < node->g_cost) { // New path to this node is better than old one
 			// Update costs and parent
-			tp[i].g_cost = g_cost;
-			tp[i].parent = parent;
-			tp[i].f_cost = g_cost + h_cost;
-			if (tp[i].flag == SET_CLOSED) {
-				heap_push_node(heap, &tp[i]); // Put it in open set again
+			node->g_cost = g_cost;
+			node->parent = parent;
+			node->f_cost = g_cost + h_cost;
+			if (node->flag == SET_CLOSED) {
+				heap_push_node(heap, node); // Put it in open set again
 			}
-			else if (heap_update_node(heap, &tp[i])) {
+			else if (heap_update_node(heap, node)) {
 				return 1;
 			}
-			tp[i].flag = SET_OPEN;
+			node->flag = SET_OPEN;
 		}
 		return 0;
 	}
 
-	if (tp[i].x || tp[i].y) // Index is already taken; see `tp` array FIXME for details
+	if (node->x || node->y) // Index is already taken; see `g_nodes` array FIXME for details
 		return 1;
 
 	// New node
-	tp[i].x = x;
-	tp[i].y = y;
-	tp[i].g_cost = g_cost;
-	tp[i].parent = parent;
-	tp[i].f_cost = g_cost + h_cost;
-	tp[i].flag = SET_OPEN;
-	heap_push_node(heap, &tp[i]);
+	node->x = x;
+	node->y = y;
+	node->g_cost = g_cost;
+	node->parent = parent;
+	node->f_cost = g_cost + h_cost;
+	node->flag = SET_OPEN;
+	heap_push_node(heap, node);
 	return 0;
 }
 ///@}
 
+/*==========================================
+ * A* path search (x0,y0)->(x1,y1)
+ * walkable: walkable bitmap of the map, or NULL to check 'cell' with map_getcellp
+ *
+ * Note: uses global g_open_set, therefore this method can't be called in parallel or recursivly.
+ *------------------------------------------*/
+static bool path_search_astar(struct walkpath_data *wpd, struct map_data *mapdata, int16 x0, int16 y0, int16 x1, int16 y1, cell_chk cell, const uint64 *walkable)
+{
+	struct path_node *start, *current, *it;
+	int xs = mapdata->xs - 1;
+	int ys = mapdata->ys - 1;
+	int len = 0;
+	int j, x, y, dx, dy;
+
+	// A* (A-star) pathfinding
+	// We always use A* for finding walkpaths because it is what game client uses.
+	// Easy pathfinding cuts corners of non-walkable cells, but client always walks around it.
+	BHEAP_RESET(g_open_set);
+
+	// Start a new search, which makes all nodes unused
+	if (++g_search == 0) {
+		memset(g_nodes, 0, sizeof(g_nodes));
+		g_search = 1;
+	}
+
+	// Start node
+	start = path_node_get(calc_index(x0, y0));
+	start->parent = NULL;
+	start->x      = x0;
+	start->y      = y0;
+	start->g_cost = 0;
+	start->f_cost = heuristic(x0, y0, x1, y1);
+	start->flag   = SET_OPEN;
+
+	heap_push_node(&g_open_set, start); // Put start node to 'open' set
+
+	for(;;) {
+		int e = 0; // error flag
+
+		// Saves allowed directions for the current cell. Diagonal directions
+		// are only allowed if both directions around it are allowed. This is
+		// to prevent cutting corner of nearby wall.
+		// For example, you can only go NW from the current cell, if you can
+		// go N *and* you can go W. Otherwise you need to walk around the
+		// (corner of the) non-walkable cell.
+		int allowed_dirs = 0;
+
+		int g_cost;
+
+		if (BHEAP_LENGTH(g_open_set) == 0) {
+			return false;
+		}
+
+		current = BHEAP_PEEK(g_open_set); // Look for the lowest f_cost node in the 'open' set
+		BHEAP_POP2(g_open_set, NODE_MINTOPCMP, swap_ptrcast_pathnode); // Remove it from 'open' set
+
+		x      = current->x;
+		y      = current->y;
+		g_cost = current->g_cost;
+
+		current->flag = SET_CLOSED; // Add current node to 'closed' set
+
+		if (x == x1 && y == y1) {
+			break;
+		}
+
+		if (y < ys && !path_blocked(mapdata, walkable, x, y+1, cell)) allowed_dirs |= PATH_DIR_NORTH;
+		if (y >  0 && !path_blocked(mapdata, walkable, x, y-1, cell)) allowed_dirs |= PATH_DIR_SOUTH;
+		if (x < xs && !path_blocked(mapdata, walkable, x+1, y, cell)) allowed_dirs |= PATH_DIR_EAST;
+		if (x >  0 && !path_blocked(mapdata, walkable, x-1, y, cell)) allowed_dirs |= PATH_DIR_WEST;
+
+#define chk_dir(d) ((allowed_dirs & (d)) == (d))
+		// Process neighbors of current node
+		if (chk_dir(PATH_DIR_SOUTH|PATH_DIR_EAST) && !path_blocked(mapdata, walkable, x+1, y-1, cell))
+			e += add_path(&g_open_set, x+1, y-1, g_cost + MOVE_DIAGONAL_COST, current, heuristic(x+1, y-1, x1, y1)); // (x+1, y-1) 5
+		if (chk_dir(PATH_DIR_EAST))
+			e += add_path(&g_open_set, x+1, y, g_cost + MOVE_COST, current, heuristic(x+1, y, x1, y1)); // (x+1, y) 6
+		if (chk_dir(PATH_DIR_NORTH|PATH_DIR_EAST) && !path_blocked(mapdata, walkable, x+1, y+1, cell))
+			e += add_path(&g_open_set, x+1, y+1, g_cost + MOVE_DIAGONAL_COST, current, heuristic(x+1, y+1, x1, y1)); // (x+1, y+1) 7
+		if (chk_dir(PATH_DIR_NORTH))
+			e += add_path(&g_open_set, x, y+1, g_cost + MOVE_COST, current, heuristic(x, y+1, x1, y1)); // (x, y+1) 0
+		if (chk_dir(PATH_DIR_NORTH|PATH_DIR_WEST) && !path_blocked(mapdata, walkable, x-1, y+1, cell))
+			e += add_path(&g_open_set, x-1, y+1, g_cost + MOVE_DIAGONAL_COST, current, heuristic(x-1, y+1, x1, y1)); // (x-1, y+1) 1
+		if (chk_dir(PATH_DIR_WEST))
+			e += add_path(&g_open_set, x-1, y, g_cost + MOVE_COST, current, heuristic(x-1, y, x1, y1)); // (x-1, y) 2
+		if (chk_dir(PATH_DIR_SOUTH|PATH_DIR_WEST) && !path_blocked(mapdata, walkable, x-1, y-1, cell))
+			e += add_path(&g_open_set, x-1, y-1, g_cost + MOVE_DIAGONAL_COST, current, heuristic(x-1, y-1, x1, y1)); // (x-1, y-1) 3
+		if (chk_dir(PATH_DIR_SOUTH))
+			e += add_path(&g_open_set, x, y-1, g_cost + MOVE_COST, current, heuristic(x, y-1, x1, y1)); // (x, y-1) 4
+#undef chk_dir
+		if (e) {
+			return false;
+		}
+	}
+
+	for (it = current; it->parent != NULL; it = it->parent, len++);
+	if (len > (int)sizeof(wpd->path))
+		return false;
+
+	// Recreate path
+	wpd->path_len = len;
+	wpd->path_pos = 0;
+
+	for (it = current, j = len-1; j >= 0; it = it->parent, j--) {
+		dx = it->x - it->parent->x;
+		dy = it->y - it->parent->y;
+		wpd->path[j] = walk_choices[-dy + 1][dx + 1];
+	}
+
+	return true;
+}
+
 /*==========================================
  * path search (x0,y0)->(x1,y1)
  * wpd: path info will be written here
@@ -273,6 +580,7 @@ bool path_search(struct walkpath_data *wpd, int16 m, int16 x0, int16 y0, int16 x
 	register int i, x, y, dx = 0, dy = 0;
 	struct map_data *mapdata = map_getmapdata(m);
 	struct walkpath_data s_wpd;
+	const uint64 *walkable;
 
 	if (flag&2)
 		return path_search_long(NULL, m, x0, y0, x1, y1, cell);
@@ -280,7 +588,7 @@ bool path_search(struct walkpath_data *wpd, int16 m, int16 x0, int16 y0, int16 x
 	if (wpd == NULL)
 		wpd = &s_wpd; // use dummy output variable
 
-	if (!mapdata->cell)
+	if (!map_haslocalcells(mapdata))
 		return false;
 
 	//Do not check starting cell as that would get you stuck.
@@ -291,6 +599,8 @@ bool path_search(struct walkpath_data *wpd, int16 m, int16 x0, int16 y0, int16 x
 	if (x1 < 0 || x1 >= mapdata->xs || y1 < 0 || y1 >= mapdata->ys || map_getcellp(mapdata,x1,y1,cell))
 		return false;
 
+	walkable = path_walkable(mapdata, cell);
+
 	if (flag&1) {
 		// Try finding direct path to target
 		// Direct path goes diagonally first, then in straight line.
@@ -314,7 +624,7 @@ bool path_search(struct walkpath_data *wpd, int16 m, int16 x0, int16 y0, int16 x
 
 			if( dx == 0 && dy == 0 )
 				break; // success
-			if( map_getcellp(mapdata,x,y,cell) )
+			if( path_blocked(mapdata, walkable, x, y, cell) )
 				break; // obstacle = failure
 		}
 
@@ -325,112 +635,30 @@ bool path_search(struct walkpath_data *wpd, int16 m, int16 x0, int16 y0, int16 x
 		}
 
 		return false; // easy path unsuccessful
-	} else { // !(flag&1)
-		// FIXME: This array is too small to ensure all paths shorter than MAX_WALKPATH
-		// can be found without node collision: calc_index(node1) = calc_index(node2).
-		// Figure out more proper size or another way to keep track of known nodes.
-		struct path_node tp[MAX_WALKPATH * MAX_WALKPATH];
-		struct path_node *current, *it;
-		int xs = mapdata->xs - 1;
-		int ys = mapdata->ys - 1;
-		int len = 0;
-		int j;
-
-		// A* (A-star) pathfinding
-		// We always use A* for finding walkpaths because it is what game client uses.
-		// Easy pathfinding cuts corners of non-walkable cells, but client always walks around it.
-		BHEAP_RESET(g_open_set);
-
-		memset(tp, 0, sizeof(tp));
-
-		// Start node
-		i = calc_index(x0, y0);
-		tp[i].parent = NULL;
-		tp[i].x      = x0;
-		tp[i].y      = y0;
-		tp[i].g_cost = 0;
-		tp[i].f_cost = heuristic(x0, y0, x1, y1);
-		tp[i].flag   = SET_OPEN;
-
-		heap_push_node(&g_open_set, &tp[i]); // Put start node to 'open' set
-
-		for(;;) {
-			int e = 0; // error flag
-
-			// Saves allowed directions for the current cell. Diagonal directions
-			// are only allowed if both directions around it are allowed. This is
-			// to prevent cutting corner of nearby wall.
-			// For example, you can only go NW from the current cell, if you can
-			// go N *and* you can go W. Otherwise you need to walk around the
-			// (corner of the) non-walkable cell.
-			int allowed_dirs = 0;
-
-			int g_cost;
-
-			if (BHEAP_LENGTH(g_open_set) == 0) {
-				return false;
-			}
-
-			current = BHEAP_PEEK(g_open_set); // Look for the lowest f_cost node in the 'open' set
-			BHEAP_POP2(g_open_set, NODE_MINTOPCMP, swap_ptrcast_pathnode); // Remove it from 'open' set
-
-			x      = current->x;
-			y      = current->y;
-			g_cost = current->g_cost;
-
-			current->flag = SET_CLOSED; // Add current node to 'closed' set
-
-			if (x == x1 && y == y1) {
-				break;
-			}
-
-			if (y < ys && !map_getcellp(mapdata, x, y+1, cell)) allowed_dirs |= PATH_DIR_NORTH;
-			if (y >  0 && !map_getcellp(mapdata, x, y-1, cell)) allowed_dirs |= PATH_DIR_SOUTH;
-			if (x < xs && !map_getcellp(mapdata, x+1, y, cell)) allowed_dirs |= PATH_DIR_EAST;
-			if (x >  0 && !map_getcellp(mapdata, x-1, y, cell)) allowed_dirs |= PATH_DIR_WEST;
-
-#define chk_dir(d) ((allowed_dirs & (d)) == (d))
-			// Process neighbors of current node
-			if (chk_dir(PATH_DIR_SOUTH|PATH_DIR_EAST) && !map_getcellp(mapdata, x+1, y-1, cell))
-				e += add_path(&g_open_set, tp, x+1, y-1, g_cost + MOVE_DIAGONAL_COST, current, heuristic(x+1, y-1, x1, y1)); // (x+1, y-1) 5
-			if (chk_dir(PATH_DIR_EAST))
-				e += add_path(&g_open_set, tp, x+1, y, g_cost + MOVE_COST, current, heuristic(x+1, y, x1, y1)); // (x+1, y) 6
-			if (chk_dir(PATH_DIR_NORTH|PATH_DIR_EAST) && !map_getcellp(mapdata, x+1, y+1, cell))
-				e += add_path(&g_open_set, tp, x+1, y+1, g_cost + MOVE_DIAGONAL_COST, current, heuristic(x+1, y+1, x1, y1)); // (x+1, y+1) 7
-			if (chk_dir(PATH_DIR_NORTH))
-				e += add_path(&g_open_set, tp, x, y+1, g_cost + MOVE_COST, current, heuristic(x, y+1, x1, y1)); // (x, y+1) 0
-			if (chk_dir(PATH_DIR_NORTH|PATH_DIR_WEST) && !map_getcellp(mapdata, x-1, y+1, cell))
-				e += add_path(&g_open_set, tp, x-1, y+1, g_cost + MOVE_DIAGONAL_COST, current, heuristic(x-1, y+1, x1, y1)); // (x-1, y+1) 1
-			if (chk_dir(PATH_DIR_WEST))
-				e += add_path(&g_open_set, tp, x-1, y, g_cost + MOVE_COST, current, heuristic(x-1, y, x1, y1)); // (x-1, y) 2
-			if (chk_dir(PATH_DIR_SOUTH|PATH_DIR_WEST) && !map_getcellp(mapdata, x-1, y-1, cell))
-				e += add_path(&g_open_set, tp, x-1, y-1, g_cost + MOVE_DIAGONAL_COST, current, heuristic(x-1, y-1, x1, y1)); // (x-1, y-1) 3
-			if (chk_dir(PATH_DIR_SOUTH))
-				e += add_path(&g_open_set, tp, x, y-1, g_cost + MOVE_COST, current, heuristic(x, y-1, x1, y1)); // (x, y-1) 4
-#undef chk_dir
-			if (e) {
-				return false;
-			}
-		}
-
-		for (it = current; it->parent != NULL; it = it->parent, len++);
-		if (len > sizeof(wpd->path))
-			return false;
-
-		// Recreate path
-		wpd->path_len = len;
-		wpd->path_pos = 0;
+	}
 
-		for (it = current, j = len-1; j >= 0; it = it->parent, j--) {
-			dx = it->x - it->parent->x;
-			dy = it->y - it->parent->y;
-			wpd->path[j] = walk_choices[-dy + 1][dx + 1];
-		}
+	if (walkable == NULL)
+		return path_search_astar(wpd, mapdata, x0, y0, x1, y1, cell, NULL);
+
+	bool hit;
+	struct path_cache_entry *entry = path_cache_find(mapdata, x0, y0, x1, y1, cell, &hit);
+
+	if (!hit) {
+		entry->found = path_search_astar(&entry->wpd, mapdata, x0, y0, x1, y1, cell, walkable);
+		entry->generation = mapdata->walkable_generation;
+		entry->last_use = path_cache_tick;
+		entry->m = m;
+		entry->x0 = x0;
+		entry->y0 = y0;
+		entry->x1 = x1;
+		entry->y1 = y1;
+		entry->cell = cell;
+	}
 
-		return true;
-	} // A* end
+	if (entry->found)
+		memcpy(wpd, &entry->wpd, sizeof(struct walkpath_data));
 
-	return false;
+	return entry->found;
 }
 
 
@@ -514,3 +742,81 @@ int distance_client(int dx, int dy)
 bool direction_diagonal( enum directions direction ){
 	return direction == DIR_NORTHWEST || direction == DIR_SOUTHWEST || direction == DIR_SOUTHEAST || direction == DIR_NORTHEAST;
 }
+
+/**
+ * Measures path_search on a map and checks that its walkable bitmap and cache find the same paths.
+ * Searches between random cells up to 14 cells apart, for CELL_CHKNOPASS and CELL_CHKNOREACH:
+ * first the A* with map_getcellp, then the A* on the walkable bitmap, then path_search
+ * four times per search, as units chasing the same target do.
+ * @param m: Map to search on
+ * @param count: Number of searches per cell type
+ */
+void path_benchmark(int16 m, int count)
+{
+	static const cell_chk cells[] = { CELL_CHKNOPASS, CELL_CHKNOREACH };
+	struct map_data *mapdata = map_getmapdata(m);
+	std::vector<int16> coords(count * 4); // x0, y0, x1, y1 of each search
+	std::vector<struct walkpath_data> paths(count);
+	std::vector<bool> found(count);
+	t_tick getcell_time = 0, bitmap_time = 0, cached_time = 0;
+	int mismatches = 0;
+
+	if (!map_haslocalcells(mapdata) || mapdata->xs < 2 || mapdata->ys < 2)
+		return;
+
+	for (size_t c = 0; c < ARRAYLENGTH(cells); c++) {
+		cell_chk cell = cells[c];
+		const uint64 *walkable = path_walkable(mapdata, cell);
+		struct walkpath_data wpd;
+		t_tick tick;
+
+		for (int i = 0; i < count; i++) {
+			int16 *coord = &coords[i * 4];
+			int tries = 0;
+
+			do {
+				if (++tries > 1000000) {
+					ShowWarning("path_benchmark: Map '%s' has no free cells.\n", mapdata->name);
+					return;
+				}
+				coord[0] = rnd_value(0, mapdata->xs - 1);
+				coord[1] = rnd_value(0, mapdata->ys - 1);
+				coord[2] = cap_value(coord[0] + rnd_value(-14, 14), 0, mapdata->xs - 1);
+				coord[3] = cap_value(coord[1] + rnd_value(-14, 14), 0, mapdata->ys - 1);
+			} while (map_getcellp(mapdata, coord[0], coord[1], cell) || map_getcellp(mapdata, coord[2], coord[3], cell));
+		}
+
+		tick = gettick_nocache();
+		for (int i = 0; i < count; i++) {
+			int16 *coord = &coords[i * 4];
+
+			found[i] = path_search_astar(&paths[i], mapdata, coord[0], coord[1], coord[2], coord[3], cell, NULL);
+		}
+		getcell_time += gettick_nocache() - tick;
+
+		if (walkable != NULL) {
+			tick = gettick_nocache();
+			for (int i = 0; i < count; i++) {
+				int16 *coord = &coords[i * 4];
+
+				if (path_search_astar(&wpd, mapdata, coord[0], coord[1], coord[2], coord[3], cell, walkable) != found[i] || (found[i] && (wpd.path_len != paths[i].path_len || memcmp(wpd.path, paths[i].path, wpd.path_len * sizeof(wpd.path[0])))))
+					mismatches++;
+			}
+			bitmap_time += gettick_nocache() - tick;
+		}
+
+		tick = gettick_nocache();
+		for (int i = 0; i < count; i++) {
+			int16 *coord = &coords[i * 4];
+
+			for (int j = 0; j < 4; j++) {
+				if (path_search(&wpd, m, coord[0], coord[1], coord[2], coord[3], 0, cell) != found[i] || (found[i] && (wpd.path_len != paths[i].path_len || memcmp(wpd.path, paths[i].path, wpd.path_len * sizeof(wpd.path[0])))))
+					mismatches++;
+			}
+		}
+		cached_time += gettick_nocache() - tick;
+	}
+
+	ShowInfo("path_benchmark: %d searches on '%s' per cell type. map_getcellp: %" PRtf " ms, walkable bitmap: %" PRtf " ms, path_search 4 times each: %" PRtf " ms, %d mismatches.\n",
+		count, mapdata->name, getcell_time, bitmap_time, cached_time, mismatches);
+}
@@ -70,6 +70,8 @@ int distance_client(int dx, int dy);
 
 bool direction_diagonal( enum directions direction );
 
+void path_benchmark(int16 m, int count);
+
 //
 void do_init_path();
 void do_final_path();
@@ -1510,6 +1510,13 @@ bool pc_authok(struct map_session_data *sd, uint32 login_id2, time_t expiration_
 		return false;
 	}
 
+	// The char-server caches the status it sent, so the first save can already be a delta
+	if (save_delta) {
+		if (sd->last_saved_status == NULL)
+			CREATE(sd->last_saved_status, struct mmo_charstatus, 1);
+		memcpy(sd->last_saved_status, st, sizeof(*st));
+	}
+
 	//Set the map-server used job id. [Skotlex]
 	i = pc_jobid2mapid(sd->status.class_);
 	if (i == -1) { //Invalid class?
@@ -4798,6 +4805,9 @@ char pc_payzeny(struct map_session_data *sd, int zeny, enum e_log_pick_type type
 	sd->status.zeny -= zeny;
 	clif_updatestatus(sd,SP_ZENY);
 
+	if( autosave_priority_zeny > 0 && zeny >= autosave_priority_zeny )
+		pc_autosave_prioritize(sd);
+
 	if(!tsd) tsd = sd;
 	log_zeny(sd, type, tsd, -zeny);
 	if( zeny > 0 && sd->state.showzeny ) {
@@ -4833,6 +4843,9 @@ char pc_getzeny(struct map_session_data *sd, int zeny, enum e_log_pick_type type
 	sd->status.zeny += zeny;
 	clif_updatestatus(sd,SP_ZENY);
 
+	if( autosave_priority_zeny > 0 && zeny >= autosave_priority_zeny )
+		pc_autosave_prioritize(sd);
+
 	if(!tsd) tsd = sd;
 	log_zeny(sd, type, tsd, zeny);
 	if( zeny > 0 && sd->state.showzeny ) {
@@ -11310,46 +11323,173 @@ void pc_setsavepoint(struct map_session_data *sd, short mapindex,int x,int y)
 	sd->status.save_point.y = y;
 }
 
+/// Intrusive list of players, linked through map_session_data::autosave
+struct s_autosave_queue {
+	struct map_session_data *head, *tail;
+	int count;
+};
+
+static struct s_autosave_queue autosave_queue; ///< Regular cycle, ordered by last save
+static struct s_autosave_queue autosave_priority_queue; ///< Players with valuable unsaved changes
+
+/// Autosave statistics, see pc_autosave_report
+static struct {
+	uint64 saves; ///< Saves done by the regular cycle
+	uint64 priority_saves; ///< Saves done from the priority queue
+	uint64 latency_sum; ///< Sum of the time since the last save of every regular save
+	t_tick latency_max; ///< Longest time between two saves of the same player
+	uint64 priority_latency_sum; ///< Sum of the time spent in the priority queue
+	t_tick priority_latency_max; ///< Longest time spent in the priority queue
+	int max_backlog; ///< Highest number of players saved by a single run
+} autosave_stats;
+
+static void pc_autosave_link(struct s_autosave_queue *queue, struct map_session_data *sd) {
+	sd->autosave.prev = queue->tail;
+	sd->autosave.next = NULL;
+	if( queue->tail )
+		queue->tail->autosave.next = sd;
+	else
+		queue->head = sd;
+	queue->tail = sd;
+	queue->count++;
+}
+
+static void pc_autosave_unlink(struct s_autosave_queue *queue, struct map_session_data *sd) {
+	if( sd->autosave.prev )
+		sd->autosave.prev->autosave.next = sd->autosave.next;
+	else
+		queue->head = sd->autosave.next;
+	if( sd->autosave.next )
+		sd->autosave.next->autosave.prev = sd->autosave.prev;
+	else
+		queue->tail = sd->autosave.prev;
+	sd->autosave.prev = sd->autosave.next = NULL;
+	queue->count--;
+}
+
+/**
+ * Adds a player to the autosave cycle once its data is fully loaded.
+ * @param sd: Player
+ */
+void pc_autosave_enqueue(struct map_session_data *sd) {
+	nullpo_retv(sd);
+
+	if( sd->autosave.queued )
+		return;
+
+	sd->autosave.last_save = gettick();
+	sd->autosave.priority = false;
+	sd->autosave.queued = true;
+	pc_autosave_link(&autosave_queue, sd);
+}
+
+/**
+ * Removes a player from the autosave cycle.
+ * @param sd: Player
+ */
+void pc_autosave_dequeue(struct map_session_data *sd) {
+	nullpo_retv(sd);
+
+	if( !sd->autosave.queued )
+		return;
+
+	pc_autosave_unlink(sd->autosave.priority ? &autosave_priority_queue : &autosave_queue, sd);
+	sd->autosave.queued = false;
+	sd->autosave.priority = false;
+}
+
+/**
+ * Moves a player to the end of the autosave cycle after it was saved,
+ * no matter if the save came from the autosave timer or not.
+ * @param sd: Player
+ */
+void pc_autosave_saved(struct map_session_data *sd) {
+	nullpo_retv(sd);
+
+	if( !sd->autosave.queued )
+		return;
+
+	pc_autosave_dequeue(sd);
+	pc_autosave_enqueue(sd);
+}
+
+/**
+ * Saves a player on the next autosave run, ahead of the regular cycle.
+ * @param sd: Player
+ */
+void pc_autosave_prioritize(struct map_session_data *sd) {
+	nullpo_retv(sd);
+
+	if( !sd->autosave.queued || sd->autosave.priority )
+		return;
+
+	pc_autosave_unlink(&autosave_queue, sd);
+	sd->autosave.priority = true;
+	sd->autosave.priority_tick = gettick();
+	pc_autosave_link(&autosave_priority_queue, sd);
+}
+
+/**
+ * Displays the autosave queue statistics on the console.
+ */
+void pc_autosave_report(void) {
+	t_tick tick = gettick();
+	t_tick oldest = autosave_queue.head ? DIFF_TICK(tick, autosave_queue.head->autosave.last_save) : 0;
+
+	ShowInfo("Autosave queue: " CL_WHITE "%d" CL_RESET " player(s), " CL_WHITE "%d" CL_RESET " waiting for a priority save.\n", autosave_queue.count, autosave_priority_queue.count);
+	ShowInfo("  Oldest unsaved player: %" PRtf " ms ago (autosave_time: %d ms).\n", oldest, autosave_interval);
+	ShowInfo("  Regular saves: %" PRIu64 ", average latency %" PRIu64 " ms, max %" PRtf " ms.\n",
+		autosave_stats.saves, autosave_stats.saves ? autosave_stats.latency_sum / autosave_stats.saves : 0, autosave_stats.latency_max);
+	ShowInfo("  Priority saves: %" PRIu64 ", average latency %" PRIu64 " ms, max %" PRtf " ms.\n",
+		autosave_stats.priority_saves, autosave_stats.priority_saves ? autosave_stats.priority_latency_sum / autosave_stats.priority_saves : 0, autosave_stats.priority_latency_max);
+	ShowInfo("  Most players saved by a single run: %d (autosave_max_per_tick: %d).\n", autosave_stats.max_backlog, autosave_max_per_tick);
+}
+
 /*==========================================
- * Save 1 player data at autosave interval
+ * Save the next players in the autosave queue at autosave interval
  *------------------------------------------*/
 static TIMER_FUNC(pc_autosave){
-	int interval;
-	struct s_mapiterator* iter;
-	struct map_session_data* sd;
-	static int last_save_id = 0, save_flag = 0;
+	int interval, users, saves, i;
 
-	if(save_flag == 2) //Someone was saved on last call, normal cycle
-		save_flag = 0;
-	else
-		save_flag = 1; //Noone was saved, so save first found char.
+	users = autosave_queue.count + autosave_priority_queue.count;
 
-	iter = mapit_getallusers();
-	for( sd = (TBL_PC*)mapit_first(iter); mapit_exists(iter); sd = (TBL_PC*)mapit_next(iter) )
-	{
-		if (!sd->state.pc_loaded) // Player data hasn't fully loaded
-			continue;
-		if(sd->bl.id == last_save_id && save_flag != 1) {
-			save_flag = 1;
-			continue;
-		}
+	interval = autosave_interval/(users+1);
+	if(interval < minsave_interval)
+		interval = minsave_interval;
 
-		if(save_flag != 1) //Not our turn to save yet.
-			continue;
+	// When minsave_interval stretches the cycle beyond autosave_interval, catch up with several saves per run
+	saves = 1;
+	if( (int64)users * interval > autosave_interval )
+		saves = (int)(((int64)users * interval + autosave_interval - 1) / autosave_interval);
+	saves = cap_value(saves, max(1, autosave_priority_queue.count), autosave_max_per_tick);
+
+	for( i = 0; i < saves; i++ ) {
+		struct map_session_data *sd;
+
+		if( autosave_priority_queue.head ) {
+			sd = autosave_priority_queue.head;
+			t_tick latency = DIFF_TICK(tick, sd->autosave.priority_tick);
+
+			autosave_stats.priority_saves++;
+			autosave_stats.priority_latency_sum += latency;
+			autosave_stats.priority_latency_max = max(autosave_stats.priority_latency_max, latency);
+		} else if( autosave_queue.head ) {
+			sd = autosave_queue.head;
+			t_tick latency = DIFF_TICK(tick, sd->autosave.last_save);
+
+			autosave_stats.saves++;
+			autosave_stats.latency_sum += latency;
+			autosave_stats.latency_max = max(autosave_stats.latency_max, latency);
+		} else
+			break;
 
-		//Save char.
-		last_save_id = sd->bl.id;
-		save_flag = 2;
 		if (pc_isvip(sd)) // Check if we're still VIP
 			chrif_req_login_operation(1, sd->status.name, CHRIF_OP_LOGIN_VIP, 0, 1, 0);
-		chrif_save(sd, CSAVE_INVENTORY|CSAVE_CART);
-		break;
+		chrif_save(sd, CSAVE_INVENTORY|CSAVE_CART); // Moves the player to the end of the queue
 	}
-	mapit_free(iter);
 
-	interval = autosave_interval/(map_usercount()+1);
-	if(interval < minsave_interval)
-		interval = minsave_interval;
+	autosave_stats.max_backlog = max(autosave_stats.max_backlog, i);
+
 	add_timer(gettick()+interval,pc_autosave,0,0);
 
 	return 0;
@@ -12539,6 +12679,7 @@ void pc_scdata_received(struct map_session_data *sd) {
 	}
 
 	sd->state.pc_loaded = true;
+	pc_autosave_enqueue(sd);
 
 	if (sd->state.connect_new == 0 && sd->fd) { // Character already loaded map! Gotta trigger LoadEndAck manually.
 		sd->state.connect_new = 1;
@@ -13253,7 +13394,7 @@ bool pc_job_can_entermap(enum e_job jobid, int m, int group_lv) {
 
 	struct map_data *mapdata = map_getmapdata(m);
 
-	if (!mapdata->cell)
+	if (!map_haslocalcells(mapdata))
 		return false;
 
 	if (!pcdb_checkid(jobid))
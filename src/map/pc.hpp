@@ -342,6 +342,16 @@ struct map_session_data {
 
 	int langtype;
 	struct mmo_charstatus status;
+	struct mmo_charstatus* last_saved_status; ///< Status last sent to the char-server, base of delta saves
+	struct item* last_saved_inventory; ///< Inventory last sent to or loaded from the char-server without row ids, base of delta saves
+	struct item* last_saved_cart; ///< Cart last sent to or loaded from the char-server without row ids, base of delta saves
+	struct {
+		struct map_session_data *prev, *next; ///< Neighbours in the autosave queue
+		t_tick last_save; ///< Tick of the last save, or of the login
+		t_tick priority_tick; ///< Tick at which the player was moved to the priority queue
+		bool queued; ///< Player is linked into one of the autosave queues
+		bool priority; ///< Player is linked into the priority queue
+	} autosave;
 
 	// Item Storages
 	struct s_storage storage, premiumStorage;
@@ -1108,6 +1118,11 @@ enum e_setpos{
 
 enum e_setpos pc_setpos(struct map_session_data* sd, unsigned short mapindex, int x, int y, clr_type clrtype);
 void pc_setsavepoint(struct map_session_data *sd, short mapindex,int x,int y);
+void pc_autosave_enqueue(struct map_session_data *sd);
+void pc_autosave_dequeue(struct map_session_data *sd);
+void pc_autosave_saved(struct map_session_data *sd);
+void pc_autosave_prioritize(struct map_session_data *sd);
+void pc_autosave_report(void);
 char pc_randomwarp(struct map_session_data *sd,clr_type type);
 bool pc_memo(struct map_session_data* sd, int pos);
 
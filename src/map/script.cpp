@@ -2838,7 +2838,9 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 						break;
 					}
 				default:
-					data->u.num = pc_readglobalreg(sd, data->u.num);
+					// Arguments of an achievement event are not stored in the registry
+					if( !achievement_get_argument(sd, data->u.num, data->u.num) )
+						data->u.num = pc_readglobalreg(sd, data->u.num);
 					break;
 			}
 
@@ -3626,6 +3628,8 @@ void script_free_code(struct script_code* code)
 	if (code->local.arrays)
 		code->local.arrays->destroy(code->local.arrays, script_free_array_db);
 	aFree(code->script_buf);
+	if (code->bonus)
+		aFree(code->bonus);
 	aFree(code);
 }
 
@@ -9396,20 +9400,9 @@ BUILDIN_FUNC(statusup2)
 /// bonus3 <bonus type>,<val1>,<val2>,<val3>;
 /// bonus4 <bonus type>,<val1>,<val2>,<val3>,<val4>;
 /// bonus5 <bonus type>,<val1>,<val2>,<val3>,<val4>,<val5>;
-BUILDIN_FUNC(bonus)
+/// Checks if the first value of a bonus can be given as skill name
+static bool script_bonus_skillname(int type)
 {
-	int type;
-	int val1 = 0;
-	int val2 = 0;
-	int val3 = 0;
-	int val4 = 0;
-	int val5 = 0;
-	TBL_PC* sd;
-
-	if( !script_rid2sd(sd) )
-		return SCRIPT_CMD_SUCCESS; // no player attached
-
-	type = script_getnum(st,2);
 	switch( type ) {
 		case SP_AUTOSPELL:
 		case SP_AUTOSPELL_WHENHIT:
@@ -9429,28 +9422,45 @@ BUILDIN_FUNC(bonus)
 		case SP_SKILL_DELAY:
 		case SP_SKILL_USE_SP:
 		case SP_SUB_SKILL:
-			// these bonuses support skill names
-			if (script_isstring(st, 3)) {
-				const char *name = script_getstr(st, 3);
+			return true;
+		default:
+			return false;
+	}
+}
 
-				if (!(val1 = skill_name2id(name))) {
-					ShowError("buildin_bonus: Invalid skill name %s passed to item bonus. Skipping.\n", name);
-					return SCRIPT_CMD_FAILURE;
-				}
-			} else {
-				val1 = script_getnum(st, 3);
+BUILDIN_FUNC(bonus)
+{
+	int type;
+	int val1 = 0;
+	int val2 = 0;
+	int val3 = 0;
+	int val4 = 0;
+	int val5 = 0;
+	TBL_PC* sd;
 
-				if (strcmpi(script_getfuncname(st), "bonus") && !skill_get_index(val1)) { // Only check skill ID for bonus2, bonus3, bonus4, or bonus5
-					ShowError("buildin_bonus: Invalid skill ID %d passed to item bonus. Skipping.\n", val1);
-					return SCRIPT_CMD_FAILURE;
-				}
+	if( !script_rid2sd(sd) )
+		return SCRIPT_CMD_SUCCESS; // no player attached
+
+	type = script_getnum(st,2);
+	if( script_bonus_skillname(type) ) {
+		// these bonuses support skill names
+		if (script_isstring(st, 3)) {
+			const char *name = script_getstr(st, 3);
+
+			if (!(val1 = skill_name2id(name))) {
+				ShowError("buildin_bonus: Invalid skill name %s passed to item bonus. Skipping.\n", name);
+				return SCRIPT_CMD_FAILURE;
 			}
-			break;
-		default:
-			if (script_hasdata(st, 3))
-				val1 = script_getnum(st, 3);
-			break;
-	}
+		} else {
+			val1 = script_getnum(st, 3);
+
+			if (strcmpi(script_getfuncname(st), "bonus") && !skill_get_index(val1)) { // Only check skill ID for bonus2, bonus3, bonus4, or bonus5
+				ShowError("buildin_bonus: Invalid skill ID %d passed to item bonus. Skipping.\n", val1);
+				return SCRIPT_CMD_FAILURE;
+			}
+		}
+	} else if (script_hasdata(st, 3))
+		val1 = script_getnum(st, 3);
 
 	switch( script_lastdata(st)-2 ) {
 		case 0:
@@ -9495,6 +9505,117 @@ BUILDIN_FUNC(bonus)
 	return SCRIPT_CMD_SUCCESS;
 }
 
+/*==========================================
+ * Checks if a script only consists of bonus commands with constant
+ * arguments and stores them in code->bonus, so they can be applied
+ * without the script engine. Anything else marks the script to be run
+ * normally.
+ *------------------------------------------*/
+static void script_bonus_compile(struct script_code* code)
+{
+	std::vector<struct script_bonus> bonus;
+	unsigned char* buf = code->script_buf;
+	int pos = 0;
+
+	code->bonus_state = SCRIPT_BONUS_NONE;
+
+	for(;;) {
+		struct script_data arg[6];
+		int argc = 0, l;
+		c_op c = get_com(buf, &pos);
+
+		if( c == C_NOP )
+			break;
+		if( c != C_NAME )
+			return;
+		l = GETVALUE(buf, pos);
+		pos += 3;
+		if( str_data[l].type != C_FUNC || str_data[l].func != buildin_bonus || get_com(buf, &pos) != C_ARG )
+			return;
+
+		while( (c = get_com(buf, &pos)) != C_FUNC ) {
+			if( argc == ARRAYLENGTH(arg) )
+				return;
+			if( c == C_INT ) {
+				int64 num = get_num(buf, &pos);
+
+				while( buf[pos] == C_NEG ) {
+					num = -num;
+					pos++;
+				}
+				arg[argc].type = C_INT;
+				arg[argc].u.num = num;
+			} else if( c == C_STR ) {
+				arg[argc].type = C_CONSTSTR;
+				arg[argc].u.str = (char*)(buf + pos);
+				pos += (int)strlen((char*)(buf + pos)) + 1;
+			} else
+				return;
+			argc++;
+		}
+		if( argc == 0 || arg[0].type != C_INT || get_com(buf, &pos) != C_EOL )
+			return;
+
+		struct script_bonus entry = {};
+
+		entry.type = static_cast<int>(arg[0].u.num);
+		entry.argc = argc - 1;
+		for( int i = 1; i < argc; i++ ) {
+			if( arg[i].type == C_INT ) {
+				entry.val[i - 1] = static_cast<int>(arg[i].u.num);
+				continue;
+			}
+			// only skill names are accepted as string arguments, see buildin_bonus
+			if( i == 1 && script_bonus_skillname(entry.type) )
+				entry.val[0] = skill_name2id(arg[i].u.str);
+			else if( i == 2 && entry.type == SP_AUTOSPELL_ONSKILL && (entry.argc == 4 || entry.argc == 5) )
+				entry.val[1] = skill_name2id(arg[i].u.str);
+			else
+				return;
+			if( i == 1 && entry.val[0] == 0 )
+				return; // invalid skill name, let buildin_bonus report it
+		}
+		if( entry.argc > 0 && arg[1].type == C_INT && script_bonus_skillname(entry.type) && strcmpi(get_str(l), "bonus") && !skill_get_index(entry.val[0]) )
+			return; // invalid skill id, let buildin_bonus report it
+		bonus.push_back(entry);
+	}
+
+	if( !bonus.empty() ) {
+		CREATE(code->bonus, struct script_bonus, bonus.size());
+		memcpy(code->bonus, bonus.data(), bonus.size() * sizeof(struct script_bonus));
+	}
+	code->bonus_count = (int)bonus.size();
+	code->bonus_state = SCRIPT_BONUS_COMPILED;
+}
+
+/*==========================================
+ * Applies a script made only of bonus commands directly to the player.
+ * Returns false if the script has to be run by the script engine.
+ *------------------------------------------*/
+bool script_run_bonus(struct script_code* code, struct map_session_data* sd)
+{
+	if( code == NULL || sd == NULL )
+		return false;
+	if( code->bonus_state == SCRIPT_BONUS_UNKNOWN )
+		script_bonus_compile(code);
+	if( code->bonus_state != SCRIPT_BONUS_COMPILED )
+		return false;
+
+	for( int i = 0; i < code->bonus_count; i++ ) {
+		const struct script_bonus* b = &code->bonus[i];
+
+		switch( b->argc ) {
+			case 0:
+			case 1: pc_bonus(sd, b->type, b->val[0]); break;
+			case 2: pc_bonus2(sd, b->type, b->val[0], b->val[1]); break;
+			case 3: pc_bonus3(sd, b->type, b->val[0], b->val[1], b->val[2]); break;
+			case 4: pc_bonus4(sd, b->type, b->val[0], b->val[1], b->val[2], b->val[3]); break;
+			case 5: pc_bonus5(sd, b->type, b->val[0], b->val[1], b->val[2], b->val[3], b->val[4]); break;
+		}
+	}
+	return true;
+}
+
 BUILDIN_FUNC(autobonus)
 {
 	unsigned int dur, pos;
@@ -279,6 +279,20 @@ struct script_data {
 	struct reg_db *ref;
 };
 
+/// Call of bonus, bonus2, ..., bonus5 with constant arguments, see script_run_bonus
+struct script_bonus {
+	int type;
+	int argc;   ///< Number of values after the type
+	int val[5];
+};
+
+/// Whether a script is a plain list of bonus commands
+enum e_script_bonus_state : uint8 {
+	SCRIPT_BONUS_UNKNOWN = 0, ///< Not checked yet
+	SCRIPT_BONUS_COMPILED,    ///< Only bonus commands with constant arguments, precompiled into bonus
+	SCRIPT_BONUS_NONE,        ///< Has to be run by the script engine
+};
+
 // Moved defsp from script_state to script_stack since
 // it must be saved when script state is RERUNLINE. [Eoe / jA 1094]
 struct script_code {
@@ -286,6 +300,9 @@ struct script_code {
 	unsigned char* script_buf;
 	struct reg_db local;
 	unsigned short instances;
+	e_script_bonus_state bonus_state;
+	int bonus_count;
+	struct script_bonus* bonus; ///< Precompiled bonus commands
 };
 
 struct script_stack {
@@ -2017,6 +2034,7 @@ void script_warning(const char* src, const char* file, int start_line, const cha
 bool is_number(const char *p);
 struct script_code* parse_script(const char* src,const char* file,int line,int options);
 void run_script(struct script_code *rootscript,int pos,int rid,int oid);
+bool script_run_bonus(struct script_code* code, struct map_session_data* sd);
 
 bool set_reg_num(struct script_state* st, struct map_session_data* sd, int64 num, const char* name, const int64 value, struct reg_db *ref);
 bool set_reg_str(struct script_state* st, struct map_session_data* sd, int64 num, const char* name, const char* value, struct reg_db* ref);
@@ -58,13 +58,13 @@ static searchstore_search_t searchstore_getsearchfunc(unsigned char type)
 
 /**
  * Retrieves search-all function by type.
+ * Vending is searched through its item index instead, see vending_searchall.
  * @param type : type of search to conduct
  * @return : search type
  */
 static searchstore_searchall_t searchstore_getsearchallfunc(unsigned char type)
 {
 	switch( type ) {
-		case SEARCHTYPE_VENDING:      return &vending_searchall;
 		case SEARCHTYPE_BUYING_STORE: return &buyingstore_searchall;
 	}
 
@@ -144,7 +144,7 @@ void searchstore_query(struct map_session_data* sd, unsigned char type, unsigned
 	struct map_session_data* pl_sd;
 	struct DBIterator *iter;
 	struct s_search_store_search s;
-	searchstore_searchall_t store_searchall;
+	searchstore_searchall_t store_searchall = NULL;
 	time_t querytime;
 
 	if( !battle_config.feature_search_stores )
@@ -153,7 +153,7 @@ void searchstore_query(struct map_session_data* sd, unsigned char type, unsigned
 	if( !sd->searchstore.open )
 		return;
 
-	if( ( store_searchall = searchstore_getsearchallfunc(type) ) == NULL ) {
+	if( type != SEARCHTYPE_VENDING && ( store_searchall = searchstore_getsearchallfunc(type) ) == NULL ) {
 		ShowError("searchstore_query: Unknown search type %u (account_id=%d).\n", (unsigned int)type, sd->bl.id);
 		return;
 	}
@@ -207,19 +207,25 @@ void searchstore_query(struct map_session_data* sd, unsigned char type, unsigned
 	s.card_count = card_count;
 	s.min_price  = min_price;
 	s.max_price  = max_price;
-	iter         = db_iterator((type == SEARCHTYPE_VENDING) ? vending_getdb() : buyingstore_getdb());
 
-	for( pl_sd = (struct map_session_data*)dbi_first(iter); dbi_exists(iter);  pl_sd = (struct map_session_data*)dbi_next(iter) ) {
-		if( sd == pl_sd ) // skip own shop, if any
-			continue;
-
-		if( !store_searchall(pl_sd, &s) ) { // exceeded result size
+	if( type == SEARCHTYPE_VENDING ) {
+		if( !vending_searchall(&s) ) // exceeded result size
 			clif_search_store_info_failed(sd, SSI_FAILED_OVER_MAXCOUNT);
-			break;
+	} else {
+		iter = db_iterator(buyingstore_getdb());
+
+		for( pl_sd = (struct map_session_data*)dbi_first(iter); dbi_exists(iter);  pl_sd = (struct map_session_data*)dbi_next(iter) ) {
+			if( sd == pl_sd ) // skip own shop, if any
+				continue;
+
+			if( !store_searchall(pl_sd, &s) ) { // exceeded result size
+				clif_search_store_info_failed(sd, SSI_FAILED_OVER_MAXCOUNT);
+				break;
+			}
 		}
-	}
 
-	dbi_destroy(iter);
+		dbi_destroy(iter);
+	}
 
 	if( sd->searchstore.count ) {
 		// reclaim unused memory
@@ -3837,24 +3837,11 @@ int64 skill_attack (int attack_type, struct block_list* src, struct block_list *
  * Checking bl battle flag and display damage
  * then call func with source,target,skill_id,skill_lv,tick,flag
  *------------------------------------------*/
-typedef int (*SkillFunc)(struct block_list *, struct block_list *, int, int, t_tick, int);
-int skill_area_sub(struct block_list *bl, va_list ap)
+typedef int (*SkillFunc)(struct block_list *, struct block_list *, uint16, uint16, t_tick, int);
+int skill_area_sub(struct block_list *bl, struct block_list *src, uint16 skill_id, uint16 skill_lv, t_tick tick, int flag, SkillFunc func)
 {
-	struct block_list *src;
-	uint16 skill_id,skill_lv;
-	int flag;
-	t_tick tick;
-	SkillFunc func;
-
 	nullpo_ret(bl);
 
-	src = va_arg(ap,struct block_list *);
-	skill_id = va_arg(ap,int);
-	skill_lv = va_arg(ap,int);
-	tick = va_arg(ap,t_tick);
-	flag = va_arg(ap,int);
-	func = va_arg(ap,SkillFunc);
-
 	if (flag&BCT_WOS && src == bl)
 		return 0;
 
@@ -3871,6 +3858,18 @@ int skill_area_sub(struct block_list *bl, va_list ap)
 	return 0;
 }
 
+int skill_area_sub(struct block_list *bl, va_list ap)
+{
+	struct block_list *src = va_arg(ap,struct block_list *);
+	uint16 skill_id = va_arg(ap,int);
+	uint16 skill_lv = va_arg(ap,int);
+	t_tick tick = va_arg(ap,t_tick);
+	int flag = va_arg(ap,int);
+	SkillFunc func = va_arg(ap,SkillFunc);
+
+	return skill_area_sub(bl, src, skill_id, skill_lv, tick, flag, func);
+}
+
 static int skill_check_unit_range_sub(struct block_list *bl, va_list ap)
 {
 	struct skill_unit *unit;
@@ -5239,10 +5238,14 @@ int skill_castend_damage_id (struct block_list* src, struct block_list *bl, uint
 			//SD_LEVEL -> Forced splash damage for Auto Blitz-Beat -> count targets
 			//special case: Venom Splasher uses a different range for searching than for splashing
 			if( flag&SD_LEVEL || skill_get_nk(skill_id, NK_SPLASHSPLIT) )
-				skill_area_temp[0] = map_foreachinallrange(skill_area_sub, bl, (skill_id == AS_SPLASHER)?1:skill_get_splash(skill_id, skill_lv), BL_CHAR, src, skill_id, skill_lv, tick, BCT_ENEMY, skill_area_sub_count);
+				skill_area_temp[0] = map_blocks_inallrange(bl, (skill_id == AS_SPLASHER)?1:skill_get_splash(skill_id, skill_lv), BL_CHAR).each([&](struct block_list* target) {
+					return skill_area_sub(target, src, skill_id, skill_lv, tick, BCT_ENEMY, skill_area_sub_count);
+				});
 
 			// recursive invocation of skill_castend_damage_id() with flag|1
-			map_foreachinrange(skill_area_sub, bl, skill_get_splash(skill_id, skill_lv), starget, src, skill_id, skill_lv, tick, flag|BCT_ENEMY|SD_SPLASH|1, skill_castend_damage_id);
+			map_blocks_inrange(bl, skill_get_splash(skill_id, skill_lv), starget).each([&](struct block_list* target) {
+				return skill_area_sub(target, src, skill_id, skill_lv, tick, flag|BCT_ENEMY|SD_SPLASH|1, skill_castend_damage_id);
+			});
 
 			if (skill_id == RA_ARROWSTORM)
 				status_change_end(src, SC_CAMOUFLAGE, INVALID_TIMER);
@@ -19133,11 +19136,9 @@ struct skill_unit_group_tickset *skill_unitgrouptickset_search(struct block_list
  * Check for validity skill unit that triggered by skill_unit_timer_sub
  * And trigger skill_unit_onplace_timer for object that maybe stands there (catched object is *bl)
  *------------------------------------------*/
-int skill_unit_timer_sub_onplace(struct block_list* bl, va_list ap)
+int skill_unit_timer_sub_onplace(struct block_list* bl, struct skill_unit* unit, t_tick tick)
 {
-	struct skill_unit* unit = va_arg(ap,struct skill_unit *);
 	struct skill_unit_group* group = NULL;
-	t_tick tick = va_arg(ap,t_tick);
 
 	nullpo_ret(unit);
 
@@ -19401,7 +19402,9 @@ static int skill_unit_timer_sub(DBKey key, DBData *data, va_list ap)
 
 	if( unit->range >= 0 && group->interval != -1 )
 	{
-		map_foreachinrange(skill_unit_timer_sub_onplace, bl, unit->range, group->bl_flag, bl,tick);
+		map_blocks_inrange(bl, unit->range, group->bl_flag).each([unit, tick](struct block_list* target) {
+			return skill_unit_timer_sub_onplace(target, unit, tick);
+		});
 
 		if(unit->range == -1) //Unit disabled, but it should not be deleted yet.
 			group->unit_id = UNT_USED_TRAPS;
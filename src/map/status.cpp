@@ -3751,6 +3751,20 @@ bool status_calc_cart_weight(struct map_session_data *sd, enum e_status_calc_wei
 	return true;
 }
 
+static bool status_calc_pc_bonus_script = false; ///< Run all bonus scripts by the script engine, see status_calc_pc_verify
+
+/**
+ * Runs an equipment, card, combo or random option bonus script for a player
+ * Scripts made only of bonus commands are applied without the script engine
+ * @param sd: Player object
+ * @param script: Bonus script
+ */
+static void status_calc_pc_script(struct map_session_data* sd, struct script_code* script)
+{
+	if (status_calc_pc_bonus_script || !script_run_bonus(script, sd))
+		run_script(script, 0, sd->bl.id, 0);
+}
+
 /**
  * Calculates player data from scratch without counting SC adjustments
  * Should be invoked whenever players raise stats, learn passive skills or change equipment
@@ -3989,10 +4003,10 @@ int status_calc_pc_sub(struct map_session_data* sd, enum e_status_calc_opt opt)
 			if(sd->inventory_data[index]->script && (pc_has_permission(sd,PC_PERM_USE_ALL_EQUIPMENT) || !itemdb_isNoEquip(sd->inventory_data[index],sd->bl.m))) {
 				if (wd == &sd->left_weapon) {
 					sd->state.lr_flag = 1;
-					run_script(sd->inventory_data[index]->script,0,sd->bl.id,0);
+					status_calc_pc_script(sd, sd->inventory_data[index]->script);
 					sd->state.lr_flag = 0;
 				} else
-					run_script(sd->inventory_data[index]->script,0,sd->bl.id,0);
+					status_calc_pc_script(sd, sd->inventory_data[index]->script);
 				if (!calculating) // Abort, run_script retriggered this. [Skotlex]
 					return 1;
 			}
@@ -4016,7 +4030,7 @@ int status_calc_pc_sub(struct map_session_data* sd, enum e_status_calc_opt opt)
 			if(sd->inventory_data[index]->script && (pc_has_permission(sd,PC_PERM_USE_ALL_EQUIPMENT) || !itemdb_isNoEquip(sd->inventory_data[index],sd->bl.m))) {
 				if( i == EQI_HAND_L ) // Shield
 					sd->state.lr_flag = 3;
-				run_script(sd->inventory_data[index]->script,0,sd->bl.id,0);
+				status_calc_pc_script(sd, sd->inventory_data[index]->script);
 				if( i == EQI_HAND_L ) // Shield
 					sd->state.lr_flag = 0;
 				if (!calculating) // Abort, run_script retriggered this. [Skotlex]
@@ -4024,7 +4038,7 @@ int status_calc_pc_sub(struct map_session_data* sd, enum e_status_calc_opt opt)
 			}
 		} else if( sd->inventory_data[index]->type == IT_SHADOWGEAR ) { // Shadow System
 			if (sd->inventory_data[index]->script && (pc_has_permission(sd,PC_PERM_USE_ALL_EQUIPMENT) || !itemdb_isNoEquip(sd->inventory_data[index],sd->bl.m))) {
-				run_script(sd->inventory_data[index]->script,0,sd->bl.id,0);
+				status_calc_pc_script(sd, sd->inventory_data[index]->script);
 				if( !calculating )
 					return 1;
 			}
@@ -4037,7 +4051,7 @@ int status_calc_pc_sub(struct map_session_data* sd, enum e_status_calc_opt opt)
 			sd->bonus.arrow_atk += sd->inventory_data[index]->atk;
 			sd->state.lr_flag = 2;
 			if( !itemdb_group_item_exists(IG_THROWABLE, sd->inventory_data[index]->nameid) ) // Don't run scripts on throwable items
-				run_script(sd->inventory_data[index]->script,0,sd->bl.id,0);
+				status_calc_pc_script(sd, sd->inventory_data[index]->script);
 			sd->state.lr_flag = 0;
 			if (!calculating) // Abort, run_script retriggered status_calc_pc. [Skotlex]
 				return 1;
@@ -4068,7 +4082,7 @@ int status_calc_pc_sub(struct map_session_data* sd, enum e_status_calc_opt opt)
 			}
 			if (no_run)
 				continue;
-			run_script(sd->combos.bonus[i],0,sd->bl.id,0);
+			status_calc_pc_script(sd, sd->combos.bonus[i]);
 			if (!calculating) // Abort, run_script retriggered this
 				return 1;
 		}
@@ -4117,10 +4131,10 @@ int status_calc_pc_sub(struct map_session_data* sd, enum e_status_calc_opt opt)
 					continue;
 				if(i == EQI_HAND_L && sd->inventory.u.items_inventory[index].equip == EQP_HAND_L) { // Left hand status.
 					sd->state.lr_flag = 1;
-					run_script(data->script,0,sd->bl.id,0);
+					status_calc_pc_script(sd, data->script);
 					sd->state.lr_flag = 0;
 				} else
-					run_script(data->script,0,sd->bl.id,0);
+					status_calc_pc_script(sd, data->script);
 				if (!calculating) // Abort, run_script his function. [Skotlex]
 					return 1;
 			}
@@ -4157,11 +4171,11 @@ int status_calc_pc_sub(struct map_session_data* sd, enum e_status_calc_opt opt)
 					continue;
 				if (i == EQI_HAND_L && sd->inventory.u.items_inventory[index].equip == EQP_HAND_L) { // Left hand status.
 					sd->state.lr_flag = 1;
-					run_script(data->script, 0, sd->bl.id, 0);
+					status_calc_pc_script(sd, data->script);
 					sd->state.lr_flag = 0;
 				}
 				else
-					run_script(data->script, 0, sd->bl.id, 0);
+					status_calc_pc_script(sd, data->script);
 				if (!calculating)
 					return 1;
 			}
@@ -4716,6 +4730,55 @@ int status_calc_pc_sub(struct map_session_data* sd, enum e_status_calc_opt opt)
 	return 0;
 }
 
+/**
+ * Recalculates a player with all bonus scripts run by the script engine and
+ * reports any difference to the precompiled bonuses applied before
+ * Enabled by battle config item_bonus_verify
+ * @param sd: Player object
+ * @param opt: Whether it is first calc (login) or not
+ */
+static void status_calc_pc_verify(struct map_session_data* sd, enum e_status_calc_opt opt)
+{
+	const size_t zeroed_size = (char*)(sd->dropaddclass + ARRAYLENGTH(sd->dropaddclass)) - (char*)sd->param_bonus;
+	const size_t weapon_size = offsetof(struct weapon_data, add_dmg) - offsetof(struct weapon_data, overrefine);
+	std::vector<char> snapshot;
+	size_t vectors;
+
+	auto bonus_vectors = [sd]() {
+		return sd->autospell.size() + sd->autospell2.size() + sd->autospell3.size() + sd->addeff.size() + sd->addeff_atked.size()
+			+ sd->addeff_onskill.size() + sd->skillatk.size() + sd->skillusesprate.size() + sd->skillusesp.size() + sd->skillheal.size()
+			+ sd->skillheal2.size() + sd->skillblown.size() + sd->skillcastrate.size() + sd->skillfixcastrate.size() + sd->subskill.size()
+			+ sd->skillcooldown.size() + sd->skillfixcast.size() + sd->skillvarcast.size() + sd->skilldelay.size() + sd->itemhealrate.size()
+			+ sd->add_def.size() + sd->add_mdef.size() + sd->add_mdmg.size() + sd->reseff.size() + sd->itemgrouphealrate.size()
+			+ sd->add_drop.size() + sd->subele2.size() + sd->sp_vanish.size() + sd->hp_vanish.size()
+			+ sd->autobonus.size() + sd->autobonus2.size() + sd->autobonus3.size()
+			+ sd->right_weapon.add_dmg.size() + sd->right_weapon.addele2.size()
+			+ sd->left_weapon.add_dmg.size() + sd->left_weapon.addele2.size();
+	};
+	auto take_snapshot = [&]() {
+		std::vector<char> data;
+
+		data.insert(data.end(), (char*)&sd->base_status, (char*)(&sd->base_status + 1));
+		data.insert(data.end(), (char*)&sd->bonus, (char*)(&sd->bonus + 1));
+		data.insert(data.end(), (char*)sd->param_bonus, (char*)sd->param_bonus + zeroed_size);
+		data.insert(data.end(), (char*)&sd->right_weapon.overrefine, (char*)&sd->right_weapon.overrefine + weapon_size);
+		data.insert(data.end(), (char*)&sd->left_weapon.overrefine, (char*)&sd->left_weapon.overrefine + weapon_size);
+		return data;
+	};
+
+	snapshot = take_snapshot();
+	vectors = bonus_vectors();
+
+	status_calc_pc_bonus_script = true;
+	int ret = status_calc_pc_sub(sd, opt);
+	status_calc_pc_bonus_script = false;
+
+	if (ret != 0)
+		return;
+	if (snapshot != take_snapshot() || vectors != bonus_vectors())
+		ShowWarning("status_calc_pc_verify: Precompiled item bonuses of '%s' (char_id: %d) differ from the script engine results.\n", sd->status.name, sd->status.char_id);
+}
+
 /// Intermediate function since C++ does not have a try-finally syntax
 int status_calc_pc_( struct map_session_data* sd, enum e_status_calc_opt opt ){
 	// Save the old script the player was attached to
@@ -4724,6 +4787,10 @@ int status_calc_pc_( struct map_session_data* sd, enum e_status_calc_opt opt ){
 	// Store the return value of the original function
 	int ret = status_calc_pc_sub( sd, opt );
 
+	// Compare the precompiled bonuses with a full script run
+	if( ret == 0 && battle_config.item_bonus_verify && !(opt&SCO_FIRST) )
+		status_calc_pc_verify( sd, opt );
+
 	// If an old script is present
 	if( previous_st ){
 		// Reattach the player to it, so that the limitations of that script kick back in
@@ -4734,6 +4801,155 @@ int status_calc_pc_( struct map_session_data* sd, enum e_status_calc_opt opt ){
 	return ret;
 }
 
+/**
+ * Measures full status recalculations of a player whose equipment changes
+ * The same random sequence of equipment and card changes is applied once with the precompiled
+ * item bonuses and once with all bonus scripts run by the script engine, see status_calc_pc_script
+ * The player does not exist outside of this function.
+ * @param count: Number of equipment changes
+ */
+void status_calc_pc_benchmark(int count)
+{
+	const struct {
+		uint8 index; // Equip index
+		int pos; // Equip position
+		int type; // Item type
+	} slots[] = {
+		{ EQI_HEAD_TOP, EQP_HEAD_TOP, IT_ARMOR },
+		{ EQI_HEAD_MID, EQP_HEAD_MID, IT_ARMOR },
+		{ EQI_HEAD_LOW, EQP_HEAD_LOW, IT_ARMOR },
+		{ EQI_ARMOR, EQP_ARMOR, IT_ARMOR },
+		{ EQI_HAND_R, EQP_HAND_R, IT_WEAPON },
+		{ EQI_HAND_L, EQP_HAND_L, IT_ARMOR },
+		{ EQI_GARMENT, EQP_GARMENT, IT_ARMOR },
+		{ EQI_SHOES, EQP_SHOES, IT_ARMOR },
+		{ EQI_ACC_L, EQP_ACC_L, IT_ARMOR },
+		{ EQI_ACC_R, EQP_ACC_R, IT_ARMOR },
+	};
+	struct s_equip_change {
+		uint8 slot;
+		struct item item;
+	};
+	std::vector<struct item_data*> equips[ARRAYLENGTH(slots)], cards[ARRAYLENGTH(slots)];
+	std::vector<s_equip_change> changes(count);
+	std::vector<struct status_data> results(count);
+	t_tick times[2] = {};
+	int mismatches = 0, compiled = 0, scripts = 0;
+
+	for( int nameid = 1; nameid <= MAX_ITEMID; nameid++ ) {
+		struct item_data *id = itemdb_exists(nameid);
+
+		if( id == nullptr || id->script == nullptr )
+			continue;
+		for( size_t i = 0; i < ARRAYLENGTH(slots); i++ ) {
+			if( !(id->equip&slots[i].pos) )
+				continue;
+			if( id->type == slots[i].type )
+				equips[i].push_back(id);
+			else if( id->type == IT_CARD )
+				cards[i].push_back(id);
+		}
+	}
+
+	for( size_t i = 0; i < ARRAYLENGTH(slots); i++ ) {
+		if( equips[i].empty() ) {
+			ShowWarning("status_calc_pc_benchmark: No equipment with a script for position 0x%x.\n", slots[i].pos);
+			return;
+		}
+	}
+
+	// Generate the changes first, so that both runs apply the same ones
+	for( int i = 0; i < count; i++ ) {
+		uint8 slot = (uint8)rnd_value(0, (int)ARRAYLENGTH(slots) - 1);
+		struct item_data *id = equips[slot][rnd_value(0, (int)equips[slot].size() - 1)];
+		struct item *item = &changes[i].item;
+
+		changes[i].slot = slot;
+		memset(item, 0, sizeof(*item));
+		item->nameid = id->nameid;
+		item->amount = 1;
+		item->identify = 1;
+		item->equip = slots[slot].pos;
+		if( !id->flag.no_refine )
+			item->refine = rnd_value(0, 10);
+		for( int j = 0; j < id->slot && j < MAX_SLOTS && !cards[slot].empty(); j++ )
+			item->card[j] = cards[slot][rnd_value(0, (int)cards[slot].size() - 1)]->nameid;
+	}
+
+	struct map_session_data *sd;
+	int verify = battle_config.item_bonus_verify;
+
+	CREATE(sd, TBL_PC, 1);
+	sd->bl.type = BL_PC;
+	sd->bl.id = npc_get_new_npc_id();
+	sd->status.account_id = sd->status.char_id = sd->bl.id;
+	safestrncpy(sd->status.name, "benchmark", sizeof(sd->status.name));
+	sd->status.class_ = JOB_LORD_KNIGHT;
+	sd->class_ = pc_jobid2mapid(sd->status.class_);
+	sd->status.base_level = 99;
+	sd->status.job_level = 50;
+	sd->status.str = sd->status.agi = sd->status.vit = sd->status.dex = 90;
+	sd->status.int_ = sd->status.luk = 30;
+	sd->status.hp = sd->status.sp = 1;
+	sd->regen.sregen = &sd->sregen;
+	sd->regen.ssregen = &sd->ssregen;
+	map_addiddb(&sd->bl);
+	battle_config.item_bonus_verify = 0;
+
+	for( int run = 0; run < 2; run++ ) {
+		t_tick tick;
+
+		// Start each run from the first change of every slot
+		memset(sd->inventory.u.items_inventory, 0, sizeof(sd->inventory.u.items_inventory));
+		for( int i = count - 1; i >= 0; i-- )
+			sd->inventory.u.items_inventory[changes[i].slot] = changes[i].item;
+		pc_setinventorydata(sd);
+		pc_setequipindex(sd);
+		status_calc_pc_bonus_script = ( run == 1 );
+		status_calc_pc(sd, SCO_NONE);
+
+		tick = gettick_nocache();
+		for( int i = 0; i < count; i++ ) {
+			uint8 slot = changes[i].slot;
+
+			sd->inventory.u.items_inventory[slot] = changes[i].item;
+			sd->inventory_data[slot] = itemdb_search(changes[i].item.nameid);
+			if( slots[slot].index == EQI_HAND_R )
+				sd->weapontype1 = sd->inventory_data[slot]->look;
+			status_calc_pc(sd, SCO_NONE);
+			if( run == 0 )
+				results[i] = sd->battle_status;
+			else if( memcmp(&results[i], &sd->battle_status, sizeof(results[i])) != 0 )
+				mismatches++;
+		}
+		times[run] = gettick_nocache() - tick;
+	}
+
+	status_calc_pc_bonus_script = false;
+	battle_config.item_bonus_verify = verify;
+
+	for( size_t i = 0; i < ARRAYLENGTH(slots); i++ ) {
+		for( struct item_data *id : equips[i] ) {
+			scripts++;
+			if( id->script->bonus_state == SCRIPT_BONUS_COMPILED )
+				compiled++;
+		}
+	}
+
+	pc_delautobonus(sd, sd->autobonus, false);
+	pc_delautobonus(sd, sd->autobonus2, false);
+	pc_delautobonus(sd, sd->autobonus3, false);
+	status_change_clear(&sd->bl, 1);
+	if( sd->hatEffectCount > 0 )
+		aFree(sd->hatEffectIDs);
+	map_deliddb(&sd->bl);
+	aFree(sd);
+
+	ShowInfo("status_calc_pc_benchmark: %d equipment changes, %d of %d equipment scripts precompiled. precompiled: %" PRtf " ms, script engine: %" PRtf " ms.\n",
+		count, compiled, scripts, times[0], times[1]);
+	ShowInfo("status_calc_pc_benchmark: %d mismatches.\n", mismatches);
+}
+
 /**
  * Calculates Mercenary data
  * @param md: Mercenary object
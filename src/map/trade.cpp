@@ -660,5 +660,8 @@ void trade_tradecommit(struct map_session_data *sd)
 	if (save_settings&CHARSAVE_TRADE) {
 		chrif_save(sd, CSAVE_INVENTORY|CSAVE_CART);
 		chrif_save(tsd, CSAVE_INVENTORY|CSAVE_CART);
+	} else { // save both on the next autosave run instead
+		pc_autosave_prioritize(sd);
+		pc_autosave_prioritize(tsd);
 	}
 }
@@ -3283,6 +3283,7 @@ int unit_free(struct block_list *bl, clr_type clrtype)
 				pc_setrestartvalue(sd,2);
 
 			pc_delinvincibletimer(sd);
+			pc_autosave_dequeue(sd);
 
 			pc_delautobonus(sd, sd->autobonus, false);
 			pc_delautobonus(sd, sd->autobonus2, false);
@@ -3313,6 +3314,19 @@ int unit_free(struct block_list *bl, clr_type clrtype)
 				sd->npc_id = 0;
 			}
 
+			if( sd->last_saved_status ) {
+				aFree(sd->last_saved_status);
+				sd->last_saved_status = NULL;
+			}
+			if( sd->last_saved_inventory ) {
+				aFree(sd->last_saved_inventory);
+				sd->last_saved_inventory = NULL;
+			}
+			if( sd->last_saved_cart ) {
+				aFree(sd->last_saved_cart);
+				sd->last_saved_cart = NULL;
+			}
+
 			if( sd->combos.count ) {
 				aFree(sd->combos.bonus);
 				aFree(sd->combos.id);
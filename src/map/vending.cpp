@@ -3,7 +3,11 @@
 
 #include "vending.hpp"
 
+#include <algorithm>
+#include <set>
 #include <stdlib.h> // atoi
+#include <unordered_map>
+#include <vector>
 
 #include "../common/malloc.hpp" // aMalloc, aFree
 #include "../common/nullpo.hpp"
@@ -24,9 +28,26 @@
 #include "path.hpp"
 #include "pc.hpp"
 #include "pc_groups.hpp"
+#include "searchstore.hpp" // struct s_search_store_search
+
+/// Item for sale in a shop, as kept in the search index
+struct s_vending_offer {
+	unsigned int value; ///price of the item
+	uint32 char_id; ///vender
+	short index; ///cart index
+
+	bool operator<(const s_vending_offer &other) const {
+		if( this->value != other.value )
+			return this->value < other.value;
+		if( this->char_id != other.char_id )
+			return this->char_id < other.char_id;
+		return this->index < other.index;
+	}
+};
 
 static uint32 vending_nextid = 0; ///Vending_id counter
 static DBMap *vending_db; ///DB holder the vender : charid -> map_session_data
+static std::unordered_map<unsigned short, std::set<s_vending_offer>> vending_offers; ///Search index of the open shops: nameid -> offers ordered by price
 
 //Autotrader
 static DBMap *vending_autotrader_db; /// Holds autotrader info: char_id -> struct s_autotrader
@@ -51,6 +72,49 @@ static int vending_getuid(void)
 	return ++vending_nextid;
 }
 
+/**
+ * Adds or removes an item of a shop to the search index
+ * @param sd : vender session (player)
+ * @param slot : vending slot of the item
+ * @param add : true to add the item, false to remove it
+ */
+static void vending_offers_update(struct map_session_data* sd, int slot, bool add)
+{
+	unsigned short nameid = sd->cart.u.items_cart[sd->vending[slot].index].nameid;
+	struct s_vending_offer offer;
+
+	offer.value = sd->vending[slot].value;
+	offer.char_id = sd->status.char_id;
+	offer.index = sd->vending[slot].index;
+
+	if( add ) {
+		vending_offers[nameid].insert(offer);
+		return;
+	}
+
+	auto it = vending_offers.find(nameid);
+
+	if( it == vending_offers.end() )
+		return;
+
+	it->second.erase(offer);
+
+	if( it->second.empty() )
+		vending_offers.erase(it);
+}
+
+/**
+ * Removes a shop from the vending db and all of its items from the search index
+ * @param sd : vender session (player)
+ */
+void vending_removedb(struct map_session_data* sd)
+{
+	for( int i = 0; i < sd->vend_num; i++ )
+		vending_offers_update(sd, i, false);
+
+	idb_remove(vending_db, sd->status.char_id);
+}
+
 /**
  * Make a player close his shop
  * @param sd : player session
@@ -68,7 +132,7 @@ void vending_closevending(struct map_session_data* sd)
 		sd->state.vending = false;
 		sd->vender_id = 0;
 		clif_closevendingboard(&sd->bl, 0);
-		idb_remove(vending_db, sd->status.char_id);
+		vending_removedb(sd);
 	}
 }
 
@@ -237,6 +301,9 @@ void vending_purchasereq(struct map_session_data* sd, int aid, int uid, const ui
 			if( Sql_Query( mmysql_handle, "DELETE FROM `%s` WHERE `vending_id` = %d and `cartinventory_id` = %d", vending_items_table, vsd->vender_id, vsd->cart.u.items_cart[idx].id ) != SQL_SUCCESS ) {
 				Sql_ShowDebug( mmysql_handle );
 			}
+
+			// sold out, no longer searchable (before the cart item is deleted)
+			vending_offers_update(vsd, vend_list[i], false);
 		}
 
 		pc_cart_delitem(vsd, idx, amount, 0, LOG_TYPE_VENDING);
@@ -392,6 +459,9 @@ int8 vending_openvending(struct map_session_data* sd, const char* message, const
 
 	idb_put(vending_db, sd->status.char_id, sd);
 
+	for( j = 0; j < i; j++ )
+		vending_offers_update(sd, j, true);
+
 	return 0;
 }
 
@@ -418,54 +488,87 @@ bool vending_search(struct map_session_data* sd, unsigned short nameid)
 }
 
 /**
- * Searches for all items in a vending, that match given ids, price and possible cards.
- * @param sd : The vender session to search into
+ * Searches the open shops for items, that match given ids, price and possible cards.
+ * The offers are looked up in the search index and added to the results in order of their price.
  * @param s : parameter of the search (see s_search_store_search)
- * @return Whether or not the search should be continued.
+ * @return Whether or not all matching items fit into the results.
  */
-bool vending_searchall(struct map_session_data* sd, const struct s_search_store_search* s)
+bool vending_searchall(const struct s_search_store_search* s)
 {
-	int i, c, slot;
+	std::vector<std::pair<const struct s_vending_offer*, struct map_session_data*>> found;
+	size_t max_results = (size_t)battle_config.searchstore_maxresults;
 	unsigned int idx, cidx;
+	int i, c, slot;
 	struct item* it;
 
-	if( !sd->state.vending ) // not vending
-		return true;
-
 	for( idx = 0; idx < s->item_count; idx++ ) {
-		ARR_FIND( 0, sd->vend_num, i, sd->cart.u.items_cart[sd->vending[i].index].nameid == s->itemlist[idx].itemId );
-		if( i == sd->vend_num ) { // not found
-			continue;
-		}
-		it = &sd->cart.u.items_cart[sd->vending[i].index];
+		auto offers = vending_offers.find(s->itemlist[idx].itemId);
+		size_t item_found = 0;
 
-		if( s->min_price && s->min_price > sd->vending[i].value ) { // too low price
+		if( offers == vending_offers.end() ) { // nobody sells it
 			continue;
 		}
 
-		if( s->max_price && s->max_price < sd->vending[i].value ) { // too high price
-			continue;
-		}
+		struct s_vending_offer first = { s->min_price, 0, 0 };
+
+		for( auto offer = offers->second.lower_bound(first); offer != offers->second.end(); ++offer ) {
+			if( s->max_price && s->max_price < offer->value ) { // too high price, so are the following
+				break;
+			}
 
-		if( s->card_count ) { // check cards
-			if( itemdb_isspecial(it->card[0]) ) { // something, that is not a carded
+			if( offer->char_id == s->search_sd->status.char_id ) { // skip own shop
 				continue;
 			}
-			slot = itemdb_slot(it->nameid);
 
-			for( c = 0; c < slot && it->card[c]; c ++ ) {
-				ARR_FIND( 0, s->card_count, cidx, s->cardlist[cidx].itemId == it->card[c] );
-				if( cidx != s->card_count ) { // found
-					break;
+			struct map_session_data* vsd = (struct map_session_data*)idb_get(vending_db, offer->char_id);
+
+			if( vsd == NULL ) {
+				continue;
+			}
+
+			it = &vsd->cart.u.items_cart[offer->index];
+
+			if( s->card_count ) { // check cards
+				if( itemdb_isspecial(it->card[0]) ) { // something, that is not a carded
+					continue;
+				}
+				slot = itemdb_slot(it->nameid);
+
+				for( c = 0; c < slot && it->card[c]; c ++ ) {
+					ARR_FIND( 0, s->card_count, cidx, s->cardlist[cidx].itemId == it->card[c] );
+					if( cidx != s->card_count ) { // found
+						break;
+					}
+				}
+
+				if( c == slot || !it->card[c] ) { // no card match
+					continue;
 				}
 			}
 
-			if( c == slot || !it->card[c] ) { // no card match
-				continue;
+			found.push_back(std::make_pair(&*offer, vsd));
+
+			// the cheapest offers of this item already exceed the results
+			if( ++item_found > max_results ) {
+				break;
 			}
 		}
+	}
+
+	std::sort(found.begin(), found.end(), [](const std::pair<const struct s_vending_offer*, struct map_session_data*> &a, const std::pair<const struct s_vending_offer*, struct map_session_data*> &b) {
+		return *a.first < *b.first;
+	});
+
+	for( const auto &result : found ) {
+		struct map_session_data* vsd = result.second;
+		it = &vsd->cart.u.items_cart[result.first->index];
+
+		ARR_FIND( 0, vsd->vend_num, i, vsd->vending[i].index == result.first->index );
+		if( i == vsd->vend_num ) { // not found
+			continue;
+		}
 
-		if( !searchstore_result(s->search_sd, sd->vender_id, sd->status.account_id, sd->message, it->nameid, sd->vending[i].amount, sd->vending[i].value, it->card, it->refine) ) { // result set full
+		if( !searchstore_result(s->search_sd, vsd->vender_id, vsd->status.account_id, vsd->message, it->nameid, vsd->vending[i].amount, vsd->vending[i].value, it->card, it->refine) ) { // result set full
 			return false;
 		}
 	}
@@ -700,6 +803,7 @@ static int vending_autotrader_free(DBKey key, DBData *data, va_list ap) {
 void do_final_vending(void)
 {
 	db_destroy(vending_db);
+	vending_offers.clear();
 	vending_autotrader_db->destroy(vending_autotrader_db, vending_autotrader_free);
 }
 
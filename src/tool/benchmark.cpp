@@ -0,0 +1,388 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+// Micro-benchmarks of the common library.
+// Usage: benchmark <name> [<arguments>]
+// Build the same benchmark against an older revision to compare both implementations.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "../common/cbasetypes.hpp"
+#include "../common/core.hpp"
+#include "../common/db.hpp"
+#include "../common/ers.hpp"
+#include "../common/showmsg.hpp"
+#include "../common/timer.hpp"
+
+/// Deterministic random numbers, so that every revision runs the same workload
+static uint32 benchmark_seed = 2463534242U;
+
+static uint32 benchmark_rand(void){
+	benchmark_seed ^= benchmark_seed << 13;
+	benchmark_seed ^= benchmark_seed >> 17;
+	benchmark_seed ^= benchmark_seed << 5;
+	return benchmark_seed;
+}
+
+/// Milliseconds since an arbitrary point
+static double benchmark_now(void){
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+/// @name Timer benchmark
+/// Keeps a given number of timers alive while simulating the main loop in 20ms steps.
+/// Expired timers are added again with a new delay, like mob and skill timers, and a share
+/// of the timers is delayed or replaced every step. 1% of the timers are interval timers.
+/// The order of timers that expire at the same tick is not defined, so the delays and the
+/// checksum only depend on which timers expire at which tick. It has to match between implementations.
+/// @{
+
+static std::vector<int> timer_ids; ///< Timer of every slot
+static t_tick timer_tick = 0; ///< Last tick given to do_timer, which has to be monotonic
+static t_tick timer_base; ///< Tick the current run started at
+static uint64 timer_checksum;
+static uint32 timer_calls;
+
+/// Mixes the bits of a and b
+static uint32 benchmark_hash(uint32 a, uint32 b){
+	uint32 h = a * 0x9E3779B1U ^ b * 0x85EBCA77U;
+
+	h ^= h >> 15;
+	h *= 0x2C1B3C6DU;
+	h ^= h >> 12;
+	return h;
+}
+
+/// Delay of a new or delayed timer: mostly short, some up to a minute
+static int benchmark_timer_delay(uint32 r){
+	if( r % 10 < 7 )
+		return 1 + ( r >> 8 ) % 2000;
+	return 1 + ( r >> 8 ) % 60000;
+}
+
+static TIMER_FUNC(benchmark_timer_expire){
+	uint32 h = benchmark_hash( (uint32)data, (uint32)( tick - timer_base ) );
+
+	timer_calls++;
+	timer_checksum += h;
+
+	if( id == 0 ) // not an interval timer
+		timer_ids[data] = add_timer( tick + benchmark_timer_delay( h ), benchmark_timer_expire, 0, data );
+
+	return 0;
+}
+
+static void benchmark_timer_run(int live, int seconds){
+	const int step = 20;
+	int intervals = live / 100;
+	int changes = live / 1000 + 1;
+
+	benchmark_seed = 2463534242U;
+	timer_checksum = 0;
+	timer_calls = 0;
+	timer_ids.assign( live, INVALID_TIMER );
+	timer_base = timer_tick;
+
+	double start = benchmark_now();
+
+	for( int i = 0; i < live; i++ ){
+		if( i < intervals )
+			timer_ids[i] = add_timer_interval( timer_base + benchmark_rand() % 1000, benchmark_timer_expire, 1, i, 100 + benchmark_rand() % 900 );
+		else
+			timer_ids[i] = add_timer( timer_base + benchmark_timer_delay( benchmark_rand() ), benchmark_timer_expire, 0, i );
+	}
+
+	double added = benchmark_now();
+
+	for( int i = 0; i < seconds * 1000 / step; i++ ){
+		timer_tick += step;
+
+		for( int j = 0; j < changes; j++ ){
+			int slot = intervals + benchmark_rand() % ( live - intervals );
+
+			if( benchmark_rand() % 2 )
+				sett_tickimer( timer_ids[slot], timer_tick + benchmark_timer_delay( benchmark_rand() ) );
+			else{
+				delete_timer( timer_ids[slot], benchmark_timer_expire );
+				timer_ids[slot] = add_timer( timer_tick + benchmark_timer_delay( benchmark_rand() ), benchmark_timer_expire, 0, slot );
+			}
+		}
+
+		do_timer( timer_tick );
+	}
+
+	double ran = benchmark_now();
+
+	for( int i = 0; i < live; i++ )
+		delete_timer( timer_ids[i], benchmark_timer_expire );
+
+	ShowInfo( "timer: %7d live, add %8.2f ms, %ds of %dms steps %8.2f ms, %u calls, checksum %016" PRIx64 "\n", live, added - start, seconds, step, ran - added, timer_calls, timer_checksum );
+}
+
+static void benchmark_timer(int argc, char** argv){
+	int seconds = ( argc > 0 ) ? atoi( argv[0] ) : 10;
+
+	add_timer_func_list( benchmark_timer_expire, "benchmark_timer_expire" );
+	timer_tick = gettick_nocache();
+
+	benchmark_timer_run( 10000, seconds );
+	benchmark_timer_run( 100000, seconds );
+	benchmark_timer_run( 1000000, seconds );
+}
+/// @}
+
+/// @name Entry manager benchmark
+/// Every thread keeps a window of 256 slots and allocates or frees a random one, 4M times in total.
+/// Compares the plain and the thread-safe entry managers with malloc.
+/// The cross-thread run frees entries from other threads than the ones that allocated them
+/// and checks that no entry was handed out twice.
+/// @{
+
+struct s_ers_entry {
+	uint32 owner;
+	char data[92];
+};
+
+static const int ers_operations = 4000000;
+
+/// Runs the workload on threads threads and returns the time it took
+template <typename A, typename F> static double benchmark_ers_run(int threads, A alloc, F release){
+	std::vector<std::thread> workers;
+	double start = benchmark_now();
+
+	for( int t = 0; t < threads; t++ ){
+		workers.emplace_back( [&, t]{
+			std::vector<void*> slots( 256, nullptr );
+			uint32 r = 2463534242U + t;
+
+			for( int i = 0; i < ers_operations / threads; i++ ){
+				r ^= r << 13;
+				r ^= r >> 17;
+				r ^= r << 5;
+
+				void*& slot = slots[r & 255];
+
+				if( slot != nullptr ){
+					release( slot );
+					slot = nullptr;
+				}else
+					slot = alloc();
+			}
+
+			for( void* slot : slots ){
+				if( slot != nullptr )
+					release( slot );
+			}
+		} );
+	}
+
+	for( std::thread& worker : workers )
+		worker.join();
+
+	return benchmark_now() - start;
+}
+
+/// Entries are passed to the next thread through a shared list, which frees them
+static void benchmark_ers_cross(ERS* ers){
+	const int threads = 4;
+	std::vector<std::thread> workers;
+	std::vector<s_ers_entry*> shared;
+	std::mutex shared_mutex;
+	std::atomic<int> corrupted( 0 );
+	double start = benchmark_now();
+
+	for( int t = 0; t < threads; t++ ){
+		workers.emplace_back( [&, t]{
+			std::vector<s_ers_entry*> mine;
+			uint32 owner = t + 1;
+
+			for( int i = 0; i < ers_operations / threads; i++ ){
+				s_ers_entry* entry = ers_alloc( ers, s_ers_entry );
+
+				entry->owner = owner;
+				memset( entry->data, owner, sizeof( entry->data ) );
+				mine.push_back( entry );
+
+				if( mine.size() > 64 ){
+					entry = mine.front();
+					mine.erase( mine.begin() );
+
+					if( entry->owner != owner || entry->data[sizeof( entry->data ) - 1] != (char)owner )
+						corrupted++;
+					entry->owner = 0;
+
+					std::lock_guard<std::mutex> lock( shared_mutex );
+					shared.push_back( entry );
+				}
+
+				if( i % 2 ){
+					entry = nullptr;
+					{
+						std::lock_guard<std::mutex> lock( shared_mutex );
+
+						if( !shared.empty() ){
+							entry = shared.back();
+							shared.pop_back();
+						}
+					}
+					if( entry != nullptr ){
+						if( entry->owner != 0 )
+							corrupted++;
+						ers_free( ers, entry );
+					}
+				}
+			}
+
+			for( s_ers_entry* entry : mine )
+				ers_free( ers, entry );
+		} );
+	}
+
+	for( std::thread& worker : workers )
+		worker.join();
+	for( s_ers_entry* entry : shared )
+		ers_free( ers, entry );
+
+	ShowInfo( "ers: cross-thread, %d threads %8.2f ms, %d corrupted entries\n", threads, benchmark_now() - start, corrupted.load() );
+}
+
+static void benchmark_ers(int argc, char** argv){
+	ERS* plain = ers_new( sizeof( s_ers_entry ), "benchmark.cpp::plain", ERS_OPT_NONE );
+	ERS* safe = ers_new( sizeof( s_ers_entry ), "benchmark.cpp::safe", ERS_OPT_THREAD_SAFE );
+	auto plain_alloc = [plain]{ return plain->alloc( plain ); };
+	auto plain_free = [plain]( void* entry ){ plain->free( plain, entry ); };
+	auto safe_alloc = [safe]{ return safe->alloc( safe ); };
+	auto safe_free = [safe]( void* entry ){ safe->free( safe, entry ); };
+	auto system_alloc = []{ return malloc( sizeof( s_ers_entry ) ); };
+	auto system_free = []( void* entry ){ free( entry ); };
+
+	// The first run of each allocator warms it up
+	for( int i = 0; i < 2; i++ ){
+		ShowInfo( "ers: 1 thread,  plain %8.2f ms, thread-safe %8.2f ms, malloc %8.2f ms\n", benchmark_ers_run( 1, plain_alloc, plain_free ), benchmark_ers_run( 1, safe_alloc, safe_free ), benchmark_ers_run( 1, system_alloc, system_free ) );
+		ShowInfo( "ers: 4 threads,                  thread-safe %8.2f ms, malloc %8.2f ms\n", benchmark_ers_run( 4, safe_alloc, safe_free ), benchmark_ers_run( 4, system_alloc, system_free ) );
+	}
+
+	benchmark_ers_cross( safe );
+
+	ers_destroy( plain );
+	ers_destroy( safe );
+}
+/// @}
+
+/// @name Database benchmark
+/// Compares the tree and the flat databases with integer keys that are handed out
+/// like game object IDs: ascending, with small gaps.
+/// The locked run removes and puts back 10k keys while an iterator is open, which keeps
+/// the removed entries pending until the iterator is destroyed.
+/// @{
+
+static const int db_lookups = 4000000;
+static const int db_locked_keys = 10000;
+
+static void benchmark_db_run(bool flat, int count){
+	std::vector<int> keys( count );
+	std::vector<int> lookups( db_lookups );
+	DBMap* db = flat ? idb_flat_alloc( DB_OPT_BASE ) : idb_alloc( DB_OPT_BASE );
+	intptr_t checksum = 0;
+
+	benchmark_seed = 2463534242U;
+	for( int i = 0; i < count; i++ )
+		keys[i] = 110000000 + i * 3 + benchmark_rand() % 3;
+	for( int& key : lookups )
+		key = keys[benchmark_rand() % count];
+
+	double start = benchmark_now();
+
+	for( int i = 0; i < count; i++ )
+		idb_put( db, keys[i], (void*)(intptr_t)( i + 1 ) );
+
+	double put = benchmark_now();
+
+	for( int key : lookups )
+		checksum += (intptr_t)idb_get( db, key );
+
+	double hit = benchmark_now();
+
+	for( int key : lookups )
+		checksum += (intptr_t)idb_get( db, key + 1000000000 );
+
+	double miss = benchmark_now();
+
+	for( int i = 0; i < count; i += 2 )
+		idb_remove( db, keys[i] );
+
+	double removed = benchmark_now();
+
+	// Every key removed while locked is put back before the unlock
+	DBIterator* iter = db_iterator( db );
+	int locked_count = std::min( count, 2 * db_locked_keys );
+
+	for( int i = 1; i < locked_count; i += 2 )
+		idb_remove( db, keys[i] );
+	for( int i = 1; i < locked_count; i += 2 )
+		idb_put( db, keys[i], (void*)(intptr_t)( i + 1 ) );
+	dbi_destroy( iter );
+
+	double locked = benchmark_now();
+
+	checksum += db_size( db );
+	db_destroy( db );
+
+	ShowInfo( "db: %s %7d keys, put %8.2f ms, 4M hits %8.2f ms, 4M misses %8.2f ms, remove %8.2f ms, 10k locked remove and put %8.2f ms, checksum %" PRIdPTR "\n",
+		flat ? "flat" : "tree", count, put - start, hit - put, miss - hit, removed - miss, locked - removed, checksum );
+}
+
+static void benchmark_db(int argc, char** argv){
+	for( int count : { 10000, 100000, 1000000 } ){
+		benchmark_db_run( false, count );
+		benchmark_db_run( true, count );
+	}
+}
+/// @}
+
+struct s_benchmark {
+	const char* name;
+	const char* description;
+	void (*func)(int argc, char** argv);
+};
+
+static struct s_benchmark benchmarks[] = {
+	{ "timer", "timer [<seconds>] - add, delay, delete and run timers", benchmark_timer },
+	{ "ers", "ers - allocate and free entries from one and more threads", benchmark_ers },
+	{ "db", "db - put, get and remove integer keys of tree and flat databases", benchmark_db },
+};
+
+int do_init(int argc, char** argv){
+	bool found = false;
+
+	db_init();
+	timer_init();
+
+	for( size_t i = 0; i < ARRAYLENGTH(benchmarks); i++ ){
+		if( argc < 2 || strcmp( argv[1], benchmarks[i].name ) == 0 ){
+			benchmarks[i].func( argc > 2 ? argc - 2 : 0, argv + 2 );
+			found = true;
+		}
+	}
+
+	if( !found ){
+		ShowInfo( "Available benchmarks:\n" );
+		for( size_t i = 0; i < ARRAYLENGTH(benchmarks); i++ )
+			ShowInfo( "\t%s\n", benchmarks[i].description );
+	}
+
+	return 0;
+}
+
+void do_final(void){
+	timer_final();
+	db_final();
+	ers_final();
+}
@@ -20,7 +20,9 @@
 std::string grf_list_file = "conf/grf-files.txt";
 std::string map_list_file = "map_index.txt";
 std::string map_cache_file;
+std::string map_cache_raw_file;
 int rebuild = 0;
+int raw = 0;
 
 FILE *map_cache_fp;
 
@@ -47,6 +49,37 @@ struct map_info {
 	int32 len;
 };
 
+// This is the main header found at the very beginning of the raw map cache, followed by the map index
+struct raw_header {
+	char magic[4];
+	uint32 version;
+	uint32 map_count;
+	uint32 file_size;
+};
+
+// Entry of the raw map cache index, the uncompressed cells are stored at the page aligned offset
+struct raw_map_info {
+	char name[MAP_NAME_LENGTH];
+	int16 xs;
+	int16 ys;
+	uint32 offset;
+};
+
+#define RAW_MAGIC "RAMC"
+#define RAW_VERSION 1
+
+// Alignment of the cells of each map, so the map-server can release the cells of a map by pages
+static uint32 raw_page_size(void)
+{
+#ifndef _WIN32
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	if (page_size > 0)
+		return (uint32)page_size;
+#endif
+	return 4096;
+}
+
 
 // Reads a map from GRF's GAT and RSW files
 int read_map(char *name, struct map_data *m)
@@ -152,6 +185,108 @@ int find_map(char *name)
 	return 0;
 }
 
+// Writes the maps of the compressed map cache into a raw map cache
+// The cells of every map start on a page boundary, so the map-server can map them without copying.
+int convert_raw(void)
+{
+	FILE *in, *out;
+	unsigned char *buffer;
+	unsigned long size;
+
+	ShowStatus("Converting map cache %s to raw map cache %s\n", map_cache_file.c_str(), map_cache_raw_file.c_str());
+
+	if ((in = fopen(map_cache_file.c_str(), "rb")) == NULL) {
+		ShowError("Failure when opening map cache file %s\n", map_cache_file.c_str());
+		return 0;
+	}
+
+	fseek(in, 0, SEEK_END);
+	size = ftell(in);
+	fseek(in, 0, SEEK_SET);
+	buffer = (unsigned char *)aMalloc(size);
+	if (size < sizeof(struct main_header) || fread(buffer, 1, size, in) != size) {
+		ShowError("Could not read map cache file %s\n", map_cache_file.c_str());
+		aFree(buffer);
+		fclose(in);
+		return 0;
+	}
+	fclose(in);
+
+	if ((out = fopen(map_cache_raw_file.c_str(), "wb")) == NULL) {
+		ShowError("Failure when opening raw map cache file %s\n", map_cache_raw_file.c_str());
+		aFree(buffer);
+		return 0;
+	}
+
+	uint16 map_count = GetUShort(buffer + 4);
+	std::vector<struct raw_map_info> index;
+	std::vector<unsigned long> positions;
+	unsigned long pos = sizeof(struct main_header);
+
+	// Build the index first, the cells follow it
+	for (int i = 0; i < map_count && pos + sizeof(struct map_info) <= size; i++) {
+		struct map_info *info = (struct map_info *)(buffer + pos);
+		struct raw_map_info entry;
+
+		memset(&entry, 0, sizeof(entry));
+		strncpy(entry.name, info->name, MAP_NAME_LENGTH);
+		entry.xs = info->xs;
+		entry.ys = info->ys;
+		index.push_back(entry);
+		positions.push_back(pos);
+		pos += sizeof(struct map_info) + GetULong((unsigned char *)&info->len);
+	}
+
+	uint32 page_size = raw_page_size();
+	uint32 offset = sizeof(struct raw_header) + (uint32)(index.size() * sizeof(struct raw_map_info));
+
+	for (auto &entry : index) {
+		offset = (offset + page_size - 1) / page_size * page_size;
+		entry.offset = offset;
+		offset += (uint32)GetUShort((unsigned char *)&entry.xs) * (uint32)GetUShort((unsigned char *)&entry.ys);
+	}
+
+	struct raw_header raw_header;
+
+	memcpy(raw_header.magic, RAW_MAGIC, sizeof(raw_header.magic));
+	raw_header.version = MakeLongLE(RAW_VERSION);
+	raw_header.map_count = MakeLongLE((int32)index.size());
+	raw_header.file_size = MakeLongLE(offset);
+	fwrite(&raw_header, sizeof(raw_header), 1, out);
+
+	for (auto &entry : index) {
+		struct raw_map_info le = entry;
+
+		le.offset = MakeLongLE(entry.offset);
+		fwrite(&le, sizeof(le), 1, out);
+	}
+
+	std::vector<unsigned char> padding(page_size, 0);
+
+	for (size_t i = 0; i < index.size(); i++) {
+		struct map_info *info = (struct map_info *)(buffer + positions[i]);
+		unsigned long len = (unsigned long)GetUShort((unsigned char *)&info->xs) * (unsigned long)GetUShort((unsigned char *)&info->ys);
+		unsigned long decoded = len;
+		unsigned char *cells = (unsigned char *)aMalloc(len);
+
+		fwrite(padding.data(), 1, index[i].offset - ftell(out), out);
+
+		if (decode_zip(cells, &decoded, buffer + positions[i] + sizeof(struct map_info), GetULong((unsigned char *)&info->len)) != 0 || decoded != len) {
+			ShowWarning("Map '" CL_WHITE "%s" CL_RESET "' could not be decoded, its cells are stored as walls.\n", index[i].name);
+			memset(cells, 1, len);
+		}
+		fwrite(cells, 1, len, out);
+		aFree(cells);
+	}
+
+	aFree(buffer);
+	fclose(out);
+
+	ShowInfo("%" PRIuPTR " maps now in raw cache\n", index.size());
+
+	return 1;
+}
+
 // Cuts the extension from a map name
 char *remove_extension(char *mapname)
 {
@@ -179,8 +314,13 @@ void process_args(int argc, char *argv[])
 		} else if(strcmp(argv[i], "-cache") == 0) {
 			if(++i < argc)
 				map_cache_file = argv[i];
+		} else if(strcmp(argv[i], "-rawcache") == 0) {
+			if(++i < argc)
+				map_cache_raw_file = argv[i];
 		} else if(strcmp(argv[i], "-rebuild") == 0)
 			rebuild = 1;
+		else if(strcmp(argv[i], "-raw") == 0)
+			raw = 1;
 	}
 
 }
@@ -189,10 +329,18 @@ int do_init(int argc, char** argv)
 {
 	/* setup pre-defined, #define-dependant */
 	map_cache_file = std::string(db_path) + "/" + std::string(DBPATH) + "map_cache.dat";
+	map_cache_raw_file = std::string(db_path) + "/" + std::string(DBPATH) + "map_cache_raw.dat";
 
 	// Process the command-line arguments
 	process_args(argc, argv);
 
+	// Only convert the existing map cache, the GRF files are not needed for this
+	if (raw) {
+		if (!convert_raw())
+			exit(EXIT_FAILURE);
+		return 0;
+	}
+
 	ShowStatus("Initializing grfio with %s\n", grf_list_file.c_str());
 	grfio_init(grf_list_file.c_str());
 